@@ -35,6 +35,9 @@ public:
 
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
 
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                harvest_accessed_fn_t accessed_fn, void* context) override;
+
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
                      vaddr_t align, size_t size, uint mmu_flags) override;
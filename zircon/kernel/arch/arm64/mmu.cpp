@@ -200,6 +200,13 @@ zx_status_t ArmArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return QueryLocked(vaddr, paddr, mmu_flags);
 }
 
+zx_status_t ArmArchVmAspace::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                             harvest_accessed_fn_t accessed_fn, void* context) {
+    // Mappings are created with the access flag already set, and clearing it
+    // would require handling access flag faults, which we do not do yet.
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 zx_status_t ArmArchVmAspace::QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
     ulong index;
     uint index_shift;
@@ -1101,6 +1108,20 @@ void arch_zero_page(void* _ptr) {
     } while (ptr != end_ptr);
 }
 
+void arch_zero_page_nontemporal(void* _ptr) {
+    uintptr_t ptr = (uintptr_t)_ptr;
+
+    uintptr_t end_ptr = ptr + PAGE_SIZE;
+    do {
+        __asm volatile("stnp xzr, xzr, [%0]\n"
+                       "stnp xzr, xzr, [%0, #16]\n"
+                       "stnp xzr, xzr, [%0, #32]\n"
+                       "stnp xzr, xzr, [%0, #48]" ::"r"(ptr)
+                       : "memory");
+        ptr += 64;
+    } while (ptr != end_ptr);
+}
+
 zx_status_t arm64_mmu_translate(vaddr_t va, paddr_t* pa, bool user, bool write) {
     // disable interrupts around this operation to make the at/par instruction combination atomic
     spin_lock_saved_state_t state;
@@ -0,0 +1,123 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+// Copies of at least this many bytes bypass the cache with non-temporal
+// stores.  Below this size the destination is likely to be touched again soon
+// and a cached copy is cheaper overall.
+#define X86_NT_COPY_THRESHOLD (1024 * 1024)
+
+// Copies of at most this many bytes take the small-size path, which avoids
+// the startup cost of "rep movs" on CPUs without Fast Short REP MOVSB.
+#define X86_SMALL_COPY_MAX 16
+
+#if defined(__ASSEMBLER__)
+
+// Copy %rdx <= X86_SMALL_COPY_MAX bytes from (%rsi) to (%rdi) and jump to
+// |done|.  If %rdx is larger, fall through without modifying any register.
+// Each size class is handled with a pair of possibly overlapping loads and
+// stores, so there is no per-byte loop.  Clobbers %rcx, %r8, %r9 and %r11.
+.macro X86_SMALL_COPY done
+    cmp $X86_SMALL_COPY_MAX, %rdx
+    ja 4f
+    cmp $8, %rdx
+    jb 1f
+    // 8 to 16 bytes.
+    mov (%rsi), %r8
+    mov -8(%rsi,%rdx), %r9
+    mov %r8, (%rdi)
+    mov %r9, -8(%rdi,%rdx)
+    jmp \done
+1:
+    cmp $4, %rdx
+    jb 2f
+    // 4 to 7 bytes.
+    mov (%rsi), %r8d
+    mov -4(%rsi,%rdx), %r9d
+    mov %r8d, (%rdi)
+    mov %r9d, -4(%rdi,%rdx)
+    jmp \done
+2:
+    test %rdx, %rdx
+    jz \done
+    // 1 to 3 bytes: first, middle and last byte.
+    mov %rdx, %rcx
+    shr $1, %rcx
+    movzbl (%rsi), %r8d
+    movzbl (%rsi,%rcx), %r11d
+    movzbl -1(%rsi,%rdx), %r9d
+    mov %r8b, (%rdi)
+    mov %r11b, (%rdi,%rcx)
+    mov %r9b, -1(%rdi,%rdx)
+    jmp \done
+4:
+.endm
+
+// Copy %rdx >= X86_NT_COPY_THRESHOLD bytes from (%rsi) to (%rdi) using
+// non-temporal stores, then jump to |done|.  If %rdx is smaller, fall through
+// without modifying any register.  The stores are fenced before |done|.
+// Only general purpose registers are used, so no FPU/vector state needs to
+// be saved.  Clobbers %rcx, %rdx, %rsi, %rdi, %r8, %r9 and %r11.
+.macro X86_NT_COPY done
+    cmp $X86_NT_COPY_THRESHOLD, %rdx
+    jb 2f
+    // Align the destination to 8 bytes so every movnti is aligned.
+    mov %rdi, %rcx
+    neg %rcx
+    and $7, %rcx
+    sub %rcx, %rdx
+    rep movsb
+    // Copy 32 bytes per iteration.
+    mov %rdx, %rcx
+    shr $5, %rcx
+1:
+    mov (%rsi), %r8
+    mov 8(%rsi), %r9
+    mov 16(%rsi), %r11
+    movnti %r8, (%rdi)
+    movnti %r9, 8(%rdi)
+    movnti %r11, 16(%rdi)
+    mov 24(%rsi), %r8
+    movnti %r8, 24(%rdi)
+    add $32, %rsi
+    add $32, %rdi
+    dec %rcx
+    jnz 1b
+    sfence
+    // Copy the remaining tail.
+    mov %rdx, %rcx
+    and $31, %rcx
+    rep movsb
+    jmp \done
+2:
+.endm
+
+#else // !__ASSEMBLER__
+
+#include <assert.h>
+#include <lib/code_patching.h>
+#include <stdint.h>
+
+// Fill in a code patch site reserved for a "jmp rel32" instruction with a
+// jump to |target|.
+static inline void x86_patch_jmp(const CodePatchInfo* patch, const void* target) {
+    const size_t kSize = 5;
+    DEBUG_ASSERT(patch->dest_size == kSize);
+
+    // The rel32 value is relative to the address of the next instruction.
+    const intptr_t offset = reinterpret_cast<intptr_t>(target) -
+                            (reinterpret_cast<intptr_t>(patch->dest_addr) + kSize);
+    DEBUG_ASSERT(offset >= INT32_MIN && offset <= INT32_MAX);
+    const int32_t rel32 = static_cast<int32_t>(offset);
+
+    patch->dest_addr[0] = 0xe9; /* jmp rel32 */
+    for (size_t i = 0; i < sizeof(rel32); ++i) {
+        patch->dest_addr[i + 1] = static_cast<uint8_t>(static_cast<uint32_t>(rel32) >> (8 * i));
+    }
+}
+
+#endif // __ASSEMBLER__
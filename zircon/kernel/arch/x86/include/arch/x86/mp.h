@@ -97,6 +97,9 @@ void x86_set_local_apic_id(uint32_t apic_id);
 
 int x86_apic_id_to_cpu_num(uint32_t apic_id);
 
+/* returns INVALID_APIC_ID if the cpu has not been brought up */
+uint32_t x86_cpu_num_to_apic_id(cpu_num_t cpu_num);
+
 // Allocate all of the necessary structures for all of the APs to run.
 zx_status_t x86_allocate_ap_structures(uint32_t *apic_ids, uint8_t cpu_count);
 
@@ -14,9 +14,11 @@
 #include <arch/x86.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mem_ops.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
 #include <kernel/mp.h>
+#include <lib/code_patching.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -54,6 +56,21 @@ static const paddr_t kernel_pt_phys = (vaddr_t)KERNEL_PT - KERNEL_BASE + KERNEL_
 static const uint kValidEptFlags =
     ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_EXECUTE;
 
+extern "C" {
+
+void arch_zero_page_erms(void*);
+void arch_zero_page_quad(void*);
+
+void x86_zero_page_select(const CodePatchInfo* patch) {
+    if (x86_feature_test(X86_FEATURE_ERMS)) {
+        x86_patch_jmp(patch, reinterpret_cast<const void*>(arch_zero_page_erms));
+    } else {
+        x86_patch_jmp(patch, reinterpret_cast<const void*>(arch_zero_page_quad));
+    }
+}
+
+}
+
 paddr_t x86_kernel_cr3(void) {
     return kernel_pt_phys;
 }
@@ -617,6 +634,19 @@ zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return pt_->QueryVaddr(vaddr, paddr, mmu_flags);
 }
 
+zx_status_t X86ArchVmAspace::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                             harvest_accessed_fn_t accessed_fn, void* context) {
+    // The accessed flag of EPT entries is only maintained if the hypervisor
+    // enables it, which we do not.
+    if (flags_ & ARCH_ASPACE_FLAG_GUEST)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+
+    return pt_->HarvestAccessed(vaddr, count, accessed_fn, context);
+}
+
 void x86_mmu_percpu_init(void) {
     ulong cr0 = x86_get_cr0();
     /* Set write protect bit in CR0*/
@@ -199,6 +199,14 @@ int x86_apic_id_to_cpu_num(uint32_t apic_id) {
     return -1;
 }
 
+uint32_t x86_cpu_num_to_apic_id(cpu_num_t cpu_num) {
+    if (cpu_num >= x86_num_cpus)
+        return INVALID_APIC_ID;
+    if (cpu_num == 0)
+        return bp_percpu.apic_id;
+    return ap_percpus[cpu_num - 1].apic_id;
+}
+
 zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t ipi) {
     uint8_t vector = 0;
     switch (ipi) {
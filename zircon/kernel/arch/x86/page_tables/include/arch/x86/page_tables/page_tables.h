@@ -8,6 +8,7 @@
 
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
+#include <vm/arch_vm_aspace.h>
 
 typedef uint64_t pt_entry_t;
 #define PRIxPTE PRIx64
@@ -49,6 +50,9 @@ public:
 
     zx_status_t QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags);
 
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                harvest_accessed_fn_t accessed_fn, void* context);
+
 protected:
     // Initialize an empty page table, assigning this given context to it.
     zx_status_t Init(void* ctx);
@@ -121,6 +125,10 @@ private:
                                 const MappingCursor& start_cursor,
                                 MappingCursor* new_cursor) TA_REQ(lock_);
 
+    void HarvestMapping(volatile pt_entry_t* table, PageTableLevel level,
+                        vaddr_t vaddr, vaddr_t end,
+                        harvest_accessed_fn_t accessed_fn, void* context) TA_REQ(lock_);
+
     zx_status_t GetMapping(volatile pt_entry_t* table, vaddr_t vaddr,
                            PageTableLevel level,
                            PageTableLevel* ret_level,
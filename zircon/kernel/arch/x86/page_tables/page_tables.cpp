@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
+#include <kernel/atomic.h>
 #include <trace.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
@@ -936,6 +937,69 @@ zx_status_t X86PageTableBase::QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mm
     return ZX_OK;
 }
 
+/**
+ * @brief Test and clear the accessed flag of the entries mapping [vaddr, end).
+ *
+ * Level must be top_level() when invoked.
+ */
+void X86PageTableBase::HarvestMapping(volatile pt_entry_t* table, PageTableLevel level,
+                                      vaddr_t vaddr, vaddr_t end,
+                                      harvest_accessed_fn_t accessed_fn, void* context) {
+    DEBUG_ASSERT(table);
+
+    const size_t ps = page_size(level);
+    while (vaddr < end) {
+        const vaddr_t entry_base = ROUNDDOWN(vaddr, ps);
+        const vaddr_t entry_end = (end - entry_base > ps) ? entry_base + ps : end;
+
+        volatile pt_entry_t* e = table + vaddr_to_index(level, vaddr);
+        pt_entry_t pt_val = *e;
+        if (!IS_PAGE_PRESENT(pt_val)) {
+            vaddr = entry_end;
+            continue;
+        }
+
+        if (level != PT_L && !IS_LARGE_PAGE(pt_val)) {
+            HarvestMapping(get_next_table_from_entry(pt_val), lower_level(level), vaddr, entry_end,
+                           accessed_fn, context);
+            vaddr = entry_end;
+            continue;
+        }
+
+        // The processor sets the flag atomically, so clear it the same way to
+        // avoid losing a concurrent dirty flag update. The TLB is not
+        // flushed: until the entry is evicted, further accesses through it do
+        // not set the flag again, which only makes the page look colder.
+        pt_val = atomic_and_u64(e, ~static_cast<pt_entry_t>(X86_MMU_PG_A));
+        if (pt_val & X86_MMU_PG_A) {
+            // A large page has a single accessed flag, which is reported for
+            // every small page of it inside the range.
+            const paddr_t paddr = paddr_from_pte(level, pt_val);
+            for (vaddr_t va = vaddr; va < entry_end; va += PAGE_SIZE) {
+                accessed_fn(va, paddr + (va - entry_base), context);
+            }
+        }
+        vaddr = entry_end;
+    }
+}
+
+zx_status_t X86PageTableBase::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                              harvest_accessed_fn_t accessed_fn, void* context) {
+    canary_.Assert();
+
+    LTRACEF("aspace %p, vaddr %#" PRIxPTR " count %#zx\n", this, vaddr, count);
+
+    if (!check_vaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+    if (count == 0)
+        return ZX_OK;
+
+    fbl::AutoLock a(&lock_);
+
+    HarvestMapping(virt_, top_level(), vaddr, vaddr + count * PAGE_SIZE, accessed_fn, context);
+    return ZX_OK;
+}
+
 void X86PageTableBase::Destroy(vaddr_t base, size_t size) {
     canary_.Assert();
 
@@ -11,6 +11,7 @@
 #include <arch/user_copy.h>
 #include <arch/x86.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mem_ops.h>
 #include <arch/x86/user_copy.h>
 #include <kernel/thread.h>
 #include <lib/code_patching.h>
@@ -25,6 +26,23 @@ static const uint8_t kNopInstruction = 0x90;
 
 extern "C" {
 
+zx_status_t _x86_copy_to_or_from_user_fsrm(void*, const void*, size_t, void**);
+zx_status_t _x86_copy_to_or_from_user_erms(void*, const void*, size_t, void**);
+zx_status_t _x86_copy_to_or_from_user_quad(void*, const void*, size_t, void**);
+
+void x86_user_copy_select(const CodePatchInfo* patch) {
+    DEBUG_ASSERT(reinterpret_cast<uintptr_t>(patch->dest_addr) ==
+                 reinterpret_cast<uintptr_t>(_x86_copy_to_or_from_user));
+
+    if (x86_feature_test(X86_FEATURE_FSRM)) {
+        x86_patch_jmp(patch, reinterpret_cast<const void*>(_x86_copy_to_or_from_user_fsrm));
+    } else if (x86_feature_test(X86_FEATURE_ERMS)) {
+        x86_patch_jmp(patch, reinterpret_cast<const void*>(_x86_copy_to_or_from_user_erms));
+    } else {
+        x86_patch_jmp(patch, reinterpret_cast<const void*>(_x86_copy_to_or_from_user_quad));
+    }
+}
+
 void fill_out_stac_instruction(const CodePatchInfo* patch) {
     const size_t kSize = 3;
     DEBUG_ASSERT(patch->dest_size == kSize);
@@ -280,6 +280,27 @@ public:
      */
     zx_status_t MaskUnmaskIrq(uint irq_id, bool mask);
 
+    /**
+     * Steer the specified IRQ to a CPU.  In MSI mode all of the device's vectors
+     * share a single target address, so every IRQ of the device moves to the
+     * new CPU.
+     *
+     * @param irq_id The ID of the IRQ to steer.
+     * @param cpu The CPU which should receive the IRQ.
+     *
+     * @return A zx_status_t indicating the success or failure of the operation.
+     * Status codes may include (but are not limited to)...
+     *
+     * ++ ZX_ERR_BAD_STATE
+     *    The device is in DISABLED IRQ mode or has been unplugged.
+     * ++ ZX_ERR_INVALID_ARGS
+     *    The irq_id parameter is out of range for the currently configured mode.
+     * ++ ZX_ERR_NOT_SUPPORTED
+     *    The device is operating in legacy mode, whose IRQ lines may be shared
+     *    with other devices, or the platform cannot steer MSIs.
+     */
+    zx_status_t SetIrqAffinity(uint irq_id, cpu_num_t cpu);
+
     void SetQuirksDone() { quirks_done_ = true; }
 
     /**
@@ -411,6 +432,7 @@ private:
     zx_status_t MaskUnmaskMsiIrq(uint irq_id, bool mask);
     void        MaskAllMsiVectors();
     void        SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data);
+    zx_status_t SetMsiAffinityLocked(cpu_num_t cpu);
     void        FreeMsiBlock();
     void        SetMsiMultiMessageEnb(uint requested_irqs);
     void        LeaveMsiIrqMode();
@@ -110,6 +110,22 @@ public:
         DEBUG_ASSERT(false);
     }
 
+    /**
+     * Method used to steer a block of MSI IRQs to a specific CPU.  On success,
+     * the block's tgt_addr has been updated and the bus driver is responsible
+     * for programming it into the device.  All of the IRQs in a plain MSI block
+     * share one target address, so they all move together.
+     *
+     * @param block A pointer to a block of MSIs allocated using a platform supplied
+     *        platform_alloc_msi_block_t callback.
+     * @param cpu The CPU which should receive the block's IRQs.
+     *
+     * @return A status code indicating the success or failure of the operation.
+     */
+    virtual zx_status_t SetMsiAffinity(pcie_msi_block_t* block, cpu_num_t cpu) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     /**
      * Method used for registration of MSI handlers with the platform.
      *
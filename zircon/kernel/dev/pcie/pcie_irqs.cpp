@@ -359,6 +359,25 @@ void PcieDevice::SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data) {
     cfg_->Write(irq_.msi->data_reg(), static_cast<uint16_t>(tgt_data & 0xFFFF));
 }
 
+zx_status_t PcieDevice::SetMsiAffinityLocked(cpu_num_t cpu) {
+    DEBUG_ASSERT(irq_.msi);
+    DEBUG_ASSERT(irq_.msi->is_valid());
+    DEBUG_ASSERT(dev_lock_.IsHeld());
+
+    pcie_msi_block_t* b = &irq_.msi->irq_block_;
+    uint64_t old_addr = b->tgt_addr;
+    zx_status_t res = bus_drv_.platform().SetMsiAffinity(b, cpu);
+    if (res != ZX_OK)
+        return res;
+
+    /* Only the destination in the lower address bits may change.  The write is
+     * a single dword, so the device never observes a torn address and MSI can
+     * stay enabled while we retarget it. */
+    DEBUG_ASSERT((b->tgt_addr >> 32) == (old_addr >> 32));
+    cfg_->Write(irq_.msi->addr_reg(), static_cast<uint32_t>(b->tgt_addr & 0xFFFFFFFF));
+    return ZX_OK;
+}
+
 void PcieDevice::FreeMsiBlock() {
     /* If no block has been allocated, there is nothing to do */
     if (!irq_.msi->irq_block_.allocated)
@@ -782,6 +801,31 @@ zx_status_t PcieDevice::MaskUnmaskIrq(uint irq_id, bool mask) {
         : ZX_ERR_BAD_STATE;
 }
 
+zx_status_t PcieDevice::SetIrqAffinity(uint irq_id, cpu_num_t cpu) {
+    AutoLock dev_lock(&dev_lock_);
+
+    if (!plugged_in_ || disabled_)
+        return ZX_ERR_BAD_STATE;
+
+    if (irq_.mode == PCIE_IRQ_MODE_DISABLED)
+        return ZX_ERR_BAD_STATE;
+
+    if (irq_id >= irq_.handler_count)
+        return ZX_ERR_INVALID_ARGS;
+
+    switch (irq_.mode) {
+    case PCIE_IRQ_MODE_MSI:    return SetMsiAffinityLocked(cpu);
+    /* Legacy lines may be shared with other devices, so are never steered. */
+    case PCIE_IRQ_MODE_LEGACY: return ZX_ERR_NOT_SUPPORTED;
+    /* MSI-X vectors each have a table entry of their own, which the bus driver
+     * does not program yet. Until it does, they cannot be steered either. */
+    case PCIE_IRQ_MODE_MSI_X:  return ZX_ERR_NOT_SUPPORTED;
+    default:
+        DEBUG_ASSERT(false); /* This should be un-possible! */
+        return ZX_ERR_INTERNAL;
+    }
+}
+
 
 // Map from a device's interrupt pin ID to the proper system IRQ ID.  Follow the
 // PCIe graph up to the root, swizzling as we traverse PCIe switches,
@@ -32,6 +32,8 @@ struct pdev_interrupt_ops {
     bool (*is_valid)(unsigned int vector, uint32_t flags);
     unsigned int (*remap)(unsigned int vector);
     zx_status_t (*send_ipi)(cpu_mask_t target, mp_ipi_t ipi);
+    // optional, may be NULL if the controller cannot steer interrupts
+    zx_status_t (*set_affinity)(unsigned int vector, cpu_num_t cpu);
     void (*init_percpu_early)(void);
     void (*init_percpu)(void);
     void (*handle_irq)(iframe* frame);
@@ -133,6 +133,12 @@ unsigned int remap_interrupt(unsigned int vector) {
     return intr_ops->remap(vector);
 }
 
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if (!intr_ops->set_affinity)
+        return ZX_ERR_NOT_SUPPORTED;
+    return intr_ops->set_affinity(vector, cpu);
+}
+
 zx_status_t interrupt_send_ipi(cpu_mask_t target, mp_ipi_t ipi) {
     return intr_ops->send_ipi(target, ipi);
 }
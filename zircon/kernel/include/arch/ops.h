@@ -72,6 +72,10 @@ static void arch_spinloop_signal(void);
 /* arch optimized version of a page zero routine against a page aligned buffer */
 void arch_zero_page(void *);
 
+/* same as above, but using non-temporal stores so the zeroed page does not
+ * displace other data from the cache */
+void arch_zero_page_nontemporal(void *);
+
 /* give the specific arch a chance to override some routines */
 #include <arch/arch_ops.h>
 
@@ -13,15 +13,18 @@
 
 // Various lock guard wrappers for kernel only locks
 // NOTE: wrapper for mutex_t is in fbl/auto_lock.h
+//
+// The constructors are always inlined, so that lock profiling attributes
+// the acquisition to the code constructing the guard.
 
 class TA_SCOPED_CAP AutoSpinLockNoIrqSave {
 public:
-    explicit AutoSpinLockNoIrqSave(spin_lock_t* lock) TA_ACQ(lock)
+    __ALWAYS_INLINE explicit AutoSpinLockNoIrqSave(spin_lock_t* lock) TA_ACQ(lock)
         : spinlock_(lock) {
         DEBUG_ASSERT(lock);
         spin_lock(spinlock_);
     }
-    explicit AutoSpinLockNoIrqSave(SpinLock* lock) TA_ACQ(lock)
+    __ALWAYS_INLINE explicit AutoSpinLockNoIrqSave(SpinLock* lock) TA_ACQ(lock)
         : AutoSpinLockNoIrqSave(lock->GetInternal()) { }
     ~AutoSpinLockNoIrqSave() TA_REL() { release(); }
 
@@ -41,12 +44,12 @@ private:
 
 class TA_SCOPED_CAP AutoSpinLock {
 public:
-    explicit AutoSpinLock(spin_lock_t* lock) TA_ACQ(lock)
+    __ALWAYS_INLINE explicit AutoSpinLock(spin_lock_t* lock) TA_ACQ(lock)
         : spinlock_(lock) {
         DEBUG_ASSERT(lock);
         spin_lock_irqsave(spinlock_, state_);
     }
-    explicit AutoSpinLock(SpinLock* lock) TA_ACQ(lock)
+    __ALWAYS_INLINE explicit AutoSpinLock(SpinLock* lock) TA_ACQ(lock)
         : AutoSpinLock(lock->GetInternal()) { }
     ~AutoSpinLock() TA_REL() { release(); }
 
@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 #pragma once
 
+#include <kernel/cpu.h>
 #include <list.h>
 #include <sys/types.h>
 #include <zircon/compiler.h>
@@ -18,17 +19,18 @@ struct dpc;
 typedef void (*dpc_func_t)(struct dpc*);
 
 typedef struct dpc {
-    struct list_node node;
+    /* link in a per cpu dpc queue, 0 while the dpc is not queued */
+    volatile uintptr_t next;
 
     dpc_func_t func;
     void* arg;
 } dpc_t;
 
-#define DPC_INITIAL_VALUE                   \
-    {                                       \
-        .node = LIST_INITIAL_CLEARED_VALUE, \
-        .func = 0,                          \
-        .arg = 0,                           \
+#define DPC_INITIAL_VALUE \
+    {                     \
+        .next = 0,        \
+        .func = 0,        \
+        .arg = 0,         \
     }
 
 /* initializes dpc for the current cpu */
@@ -38,6 +40,11 @@ void dpc_init_for_cpu(void);
 /* the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY */
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule);
 
+/* queue an already filled out dpc to run in the dpc thread of the given cpu, for example
+ * the cpu that issued the I/O the dpc completes */
+/* returns ZX_ERR_INVALID_ARGS if the cpu is not online */
+zx_status_t dpc_queue_on(dpc_t* dpc, cpu_num_t cpu, bool reschedule);
+
 /* queue a dpc, but must be holding the thread lock */
 /* does not force a reschedule */
 zx_status_t dpc_queue_thread_locked(dpc_t* dpc);
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <err.h>
+#include <kernel/atomic.h>
 #include <kernel/thread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -21,19 +22,28 @@ __BEGIN_CDECLS
 
 typedef struct event {
     int magic;
-    bool signaled;
+    volatile int state;
     uint flags;
     wait_queue_t wait;
 } event_t;
 
 #define EVENT_FLAG_AUTOUNSIGNAL 1
 
-#define EVENT_INITIAL_VALUE(e, initial, _flags)     \
-    {                                               \
-        .magic = EVENT_MAGIC,                       \
-        .signaled = initial,                        \
-        .flags = _flags,                            \
-        .wait = WAIT_QUEUE_INITIAL_VALUE((e).wait), \
+/* Bits of event_t.state.
+ * SIGNALED is the signaled state of the event.
+ * WAITERS is set, under the thread lock, whenever a thread may be in the
+ * event's wait queue. While it is clear, the event can be signaled and
+ * consumed with a single atomic op without taking the thread lock.
+ */
+#define EVENT_STATE_SIGNALED 1
+#define EVENT_STATE_WAITERS 2
+
+#define EVENT_INITIAL_VALUE(e, initial, _flags)        \
+    {                                                  \
+        .magic = EVENT_MAGIC,                          \
+        .state = (initial) ? EVENT_STATE_SIGNALED : 0, \
+        .flags = _flags,                               \
+        .wait = WAIT_QUEUE_INITIAL_VALUE((e).wait),    \
     }
 
 /* Rules for Events:
@@ -81,7 +91,7 @@ static inline bool event_initialized(const event_t* e) {
 }
 
 static inline bool event_signaled(const event_t* e) {
-    return e->signaled;
+    return (atomic_load((volatile int*)&e->state) & EVENT_STATE_SIGNALED) != 0;
 }
 
 __END_CDECLS
@@ -0,0 +1,80 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+// Lock contention profiling.
+//
+// In kernels built with ENABLE_LOCK_PROFILING=true, the default for debug
+// builds, every acquisition of a mutex_t (and so fbl::Mutex) or a
+// spin_lock_t can be recorded against the code address it was made from.
+// Each acquisition site accumulates a count of acquisitions, how many of
+// them found the lock held, the total and longest time spent waiting for
+// it, and the total and longest time it was then held.
+//
+// The site is the return address of mutex_acquire() or of the profiled
+// spin lock. spin_lock() and the C++ wrappers around both kinds of lock
+// (fbl::Mutex, fbl::AutoLock, SpinLock, AutoSpinLock) are always inlined,
+// so that it is the code using the wrapper rather than the wrapper itself.
+//
+// Recording starts with kernel.lockprof=true or the "lockprof start"
+// console command. "lockprof dump" prints the sites with the most waiting,
+// and stopping a ktrace emits a TAG_LOCK_PROFILE_* record set per site,
+// which the lockstat tool turns into a report.
+
+__BEGIN_CDECLS
+
+#if WITH_LOCK_PROFILING
+
+#define LOCK_PROFILE_MUTEX 0u
+#define LOCK_PROFILE_SPIN 1u
+
+// Returned when a site can't be recorded; ignored by lock_profile_released().
+#define LOCK_PROFILE_NO_SITE 0u
+
+// Records an acquisition of |lock| made from |pc|, |wait_ticks| after it
+// was first found to be held if |contended|. Returns the site to pass to
+// lock_profile_released() when the lock is dropped.
+uint32_t lock_profile_acquired(uint32_t kind, uintptr_t pc, const void* lock,
+                               bool contended, uint64_t wait_ticks);
+
+// Records the release of a lock acquired at |site| at |acquire_ticks|.
+void lock_profile_released(uint32_t site, uint64_t acquire_ticks);
+
+// Profiled versions of arch_spin_lock() and arch_spin_unlock(), used by
+// spin_lock() and spin_unlock().
+void lock_profile_spin_lock(spin_lock_t* lock);
+void lock_profile_spin_unlock(spin_lock_t* lock);
+
+// Writes the records of every site to the ktrace buffer.
+void lock_profile_report_ktrace(void);
+
+// Starts or stops recording. Returns whether it was recording before.
+bool lock_profile_set_enabled(bool enabled);
+
+typedef struct lock_profile_stats {
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t wait_ticks;
+    uint64_t max_wait_ticks;
+    uint64_t hold_ticks;
+    uint64_t max_hold_ticks;
+} lock_profile_stats_t;
+
+// Sums the counts of every site whose most recent acquisition was of
+// |lock|; the maximums are the largest of any such site. This only
+// describes |lock| alone if no other lock is taken at the same sites, as
+// with the private locks of a test.
+void lock_profile_get_lock_stats(const void* lock, lock_profile_stats_t* stats);
+
+#endif // WITH_LOCK_PROFILING
+
+__END_CDECLS
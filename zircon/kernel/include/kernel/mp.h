@@ -87,6 +87,10 @@ struct mp_state {
 
     /* lock for serializing CPU hotplug/unplug operations */
     mutex_t hotplug_lock;
+
+    /* NUMA node of each cpu, set by the platform while booting.  Every cpu
+     * is on node 0 if the platform has no locality information. */
+    uint32_t cpu_node[SMP_MAX_CPUS];
 };
 
 extern struct mp_state mp;
@@ -94,6 +98,20 @@ extern struct mp_state mp;
 void mp_set_curr_cpu_online(bool online);
 void mp_set_curr_cpu_active(bool active);
 
+/* record the NUMA node of a cpu */
+void mp_set_cpu_node(cpu_num_t cpu, uint32_t node);
+
+/* NUMA node of a cpu, 0 for an invalid cpu number */
+static inline uint32_t mp_get_cpu_node(cpu_num_t cpu) {
+    if (!is_valid_cpu_num(cpu))
+        return 0;
+
+    return mp.cpu_node[cpu];
+}
+
+/* mask of the cpus on NUMA node |node| */
+cpu_mask_t mp_get_node_mask(uint32_t node);
+
 static inline int mp_is_cpu_active(cpu_num_t cpu) {
     return atomic_load((int*)&mp.active_cpus) & cpu_num_to_mask(cpu);
 }
@@ -29,6 +29,11 @@ typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
     uintptr_t val;
     wait_queue_t wait;
+#if WITH_LOCK_PROFILING
+    /* where and when the holder acquired it, see kernel/lock_profile.h */
+    uint32_t prof_site;
+    uint64_t prof_acquire_ticks;
+#endif
 } mutex_t;
 
 #define MUTEX_FLAG_QUEUED ((uintptr_t)1)
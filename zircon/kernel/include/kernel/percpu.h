@@ -37,8 +37,9 @@ struct percpu {
     /* kernel counters arena */
     uint64_t* counters;
 
-    /* dpc context */
-    list_node_t dpc_list;
+    /* dpc context, a lock free stack of queued dpcs pushed by any cpu and
+     * drained by this cpu's dpc thread */
+    volatile uintptr_t dpc_head;
     event_t dpc_event;
 } __CPU_ALIGN;
 
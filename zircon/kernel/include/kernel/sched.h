@@ -29,6 +29,11 @@ void sched_migrate(thread_t* t);
  */
 void sched_inheirit_priority(thread_t* t, int pri, bool* local_resched);
 
+/* set the priority a thread inheirits through priority inheritance futexes it owns.
+ * this is tracked separately from kernel mutex inheiritance; negative values remove it
+ */
+void sched_inheirit_futex_priority(thread_t* t, int pri, bool* local_resched);
+
 /* return true if the thread was placed on the current cpu's run queue */
 /* this usually means the caller should locally reschedule soon */
 bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT;
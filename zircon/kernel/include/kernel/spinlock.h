@@ -9,15 +9,21 @@
 
 #include <arch/arch_ops.h>
 #include <arch/spinlock.h>
+#include <kernel/lock_profile.h>
 #include <zircon/compiler.h>
 #include <zircon/thread_annotations.h>
 
 __BEGIN_CDECLS
 
-/* interrupts should already be disabled */
-static inline void spin_lock(spin_lock_t* lock) TA_ACQ(lock) {
+/* interrupts should already be disabled; always inlined so that lock
+ * profiling sees its caller, see kernel/lock_profile.h */
+static inline __ALWAYS_INLINE void spin_lock(spin_lock_t* lock) TA_ACQ(lock) {
     DEBUG_ASSERT(arch_ints_disabled());
+#if WITH_LOCK_PROFILING
+    lock_profile_spin_lock(lock);
+#else
     arch_spin_lock(lock);
+#endif
 }
 
 /* Returns 0 on success, non-0 on failure */
@@ -27,7 +33,11 @@ static inline int spin_trylock(spin_lock_t* lock) TA_TRY_ACQ(false, lock) {
 
 /* interrupts should already be disabled */
 static inline void spin_unlock(spin_lock_t* lock) TA_REL(lock) {
+#if WITH_LOCK_PROFILING
+    lock_profile_spin_unlock(lock);
+#else
     arch_spin_unlock(lock);
+#endif
 }
 
 static inline void spin_lock_init(spin_lock_t* lock) {
@@ -56,8 +66,9 @@ static inline uint spin_lock_holder_cpu(spin_lock_t* lock) {
 #define SPIN_LOCK_FLAG_INTERRUPTS ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS
 
 /* same as spin lock, but save disable and save interrupt state first */
-static inline void spin_lock_save(spin_lock_t* lock, spin_lock_saved_state_t* statep,
-                                  spin_lock_save_flags_t flags) TA_ACQ(lock) {
+static inline __ALWAYS_INLINE void spin_lock_save(spin_lock_t* lock,
+                                                  spin_lock_saved_state_t* statep,
+                                                  spin_lock_save_flags_t flags) TA_ACQ(lock) {
     arch_interrupt_save(statep, flags);
     spin_lock(lock);
 }
@@ -79,13 +90,13 @@ __END_CDECLS
 class TA_CAP("mutex") SpinLock {
 public:
     SpinLock() { spin_lock_init(&spinlock_); }
-    void Acquire() TA_ACQ() { spin_lock(&spinlock_); }
+    __ALWAYS_INLINE void Acquire() TA_ACQ() { spin_lock(&spinlock_); }
     bool TryAcquire() TA_TRY_ACQ(false) { return spin_trylock(&spinlock_); }
     void Release() TA_REL() { spin_unlock(&spinlock_); }
     bool IsHeld() { return spin_lock_held(&spinlock_); }
 
-    void AcquireIrqSave(spin_lock_saved_state_t& state,
-                        spin_lock_save_flags_t flags = SPIN_LOCK_FLAG_INTERRUPTS)
+    __ALWAYS_INLINE void AcquireIrqSave(spin_lock_saved_state_t& state,
+                                        spin_lock_save_flags_t flags = SPIN_LOCK_FLAG_INTERRUPTS)
             TA_ACQ() {
         spin_lock_save(&spinlock_, &state, flags);
     }
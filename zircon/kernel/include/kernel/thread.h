@@ -100,13 +100,16 @@ typedef struct thread {
      * priority_boost is a signed value that is moved around within a range by the scheduler.
      * inheirited_priority is temporarily set to >0 when inheiriting a priority from another
      * thread blocked on a locking primitive this thread holds. -1 means no inheirit.
-     * effective_priority is MAX(base_priority + priority boost, inheirited_priority) and is
-     * the working priority for run queue decisions.
+     * futex_inheirited_priority is the same, for user threads blocked on priority
+     * inheritance futexes this thread owns.
+     * effective_priority is MAX(base_priority + priority boost, inheirited_priority,
+     * futex_inheirited_priority) and is the working priority for run queue decisions.
      */
     int effec_priority;
     int base_priority;
     int priority_boost;
     int inheirited_priority;
+    int futex_inheirited_priority;
 
     /* current cpu the thread is either running on or in the ready queue, undefined otherwise */
     cpu_num_t curr_cpu;
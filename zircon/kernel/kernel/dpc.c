@@ -6,82 +6,112 @@
 
 #include <assert.h>
 #include <err.h>
-#include <list.h>
 #include <trace.h>
 
 #include <kernel/dpc.h>
 #include <kernel/event.h>
 #include <kernel/percpu.h>
+#include <kernel/atomic.h>
+#include <kernel/mp.h>
 #include <kernel/spinlock.h>
 #include <lk/init.h>
 
-static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
+// Each cpu's pending dpcs form a lock free stack rooted at percpu::dpc_head.
+// Any cpu may push onto it, only that cpu's dpc thread pops from it, and it
+// takes the whole stack at once, so no ABA problem can arise.
+//
+// A dpc's |next| field is 0 while it is not queued. Queuing claims the dpc by
+// moving |next| away from 0 before it is published; the last dpc in a stack
+// points at DPC_LIST_END rather than 0 so that it still reads as queued.
+#define DPC_LIST_END ((uintptr_t)1)
+
+static inline volatile uint64_t* dpc_head(struct percpu* cpu) {
+    return (volatile uint64_t*)&cpu->dpc_head;
+}
+
+// push the already claimed chain first..last onto the cpu's stack
+static void dpc_push(struct percpu* cpu, dpc_t* first, dpc_t* last) {
+    uint64_t head = atomic_load_u64_relaxed(dpc_head(cpu));
+    do {
+        last->next = head ? (uintptr_t)head : DPC_LIST_END;
+    } while (!atomic_cmpxchg_u64(dpc_head(cpu), &head, (uintptr_t)first));
+}
+
+static zx_status_t dpc_claim_and_push(struct percpu* cpu, dpc_t* dpc) {
+    uint64_t unqueued = 0;
+    if (!atomic_cmpxchg_u64((volatile uint64_t*)&dpc->next, &unqueued, DPC_LIST_END))
+        return ZX_ERR_ALREADY_EXISTS;
+
+    dpc_push(cpu, dpc, dpc);
+    return ZX_OK;
+}
 
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
 
-    // disable interrupts before finding lock
+    // disable interrupts so we stay on this cpu while pushing
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
-
-    if (list_in_list(&dpc->node)) {
-        spin_unlock_irqrestore(&dpc_lock, state);
-        return ZX_ERR_ALREADY_EXISTS;
-    }
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     struct percpu* cpu = get_local_percpu();
+    zx_status_t status = dpc_claim_and_push(cpu, dpc);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
-
-    spin_unlock_irqrestore(&dpc_lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    event_signal(&cpu->dpc_event, reschedule);
+    if (status == ZX_OK)
+        event_signal(&cpu->dpc_event, reschedule);
 
-    return ZX_OK;
+    return status;
 }
 
-zx_status_t dpc_queue_thread_locked(dpc_t* dpc) {
+zx_status_t dpc_queue_on(dpc_t* dpc, cpu_num_t cpu_num, bool reschedule) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
 
-    // interrupts are already disabled
-    spin_lock(&dpc_lock);
+    if (!is_valid_cpu_num(cpu_num) || !mp_is_cpu_online(cpu_num))
+        return ZX_ERR_INVALID_ARGS;
 
-    if (list_in_list(&dpc->node)) {
-        spin_unlock(&dpc_lock);
-        return ZX_ERR_ALREADY_EXISTS;
-    }
+    struct percpu* cpu = &percpu[cpu_num];
+    zx_status_t status = dpc_claim_and_push(cpu, dpc);
+    if (status == ZX_OK)
+        event_signal(&cpu->dpc_event, reschedule);
 
-    struct percpu* cpu = get_local_percpu();
+    return status;
+}
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
-    event_signal_thread_locked(&cpu->dpc_event);
+zx_status_t dpc_queue_thread_locked(dpc_t* dpc) {
+    DEBUG_ASSERT(dpc);
+    DEBUG_ASSERT(dpc->func);
 
-    spin_unlock(&dpc_lock);
+    // interrupts are already disabled
+    struct percpu* cpu = get_local_percpu();
+    zx_status_t status = dpc_claim_and_push(cpu, dpc);
+    if (status == ZX_OK)
+        event_signal_thread_locked(&cpu->dpc_event);
 
-    return ZX_OK;
+    return status;
 }
 
 void dpc_transition_off_cpu(uint cpu_id) {
     DEBUG_ASSERT(cpu_id < SMP_MAX_CPUS);
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&dpc_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     uint cur_cpu = arch_curr_cpu_num();
     DEBUG_ASSERT(cpu_id != cur_cpu);
 
-    list_node_t* src_list = &percpu[cpu_id].dpc_list;
-    list_node_t* dst_list = &percpu[cur_cpu].dpc_list;
-
-    dpc_t* dpc;
-    while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
-        list_add_tail(dst_list, &dpc->node);
+    // take the dead cpu's whole stack and splice it onto ours
+    dpc_t* first = (dpc_t*)atomic_swap_u64(dpc_head(&percpu[cpu_id]), 0);
+    if (first) {
+        dpc_t* last = first;
+        while (last->next != DPC_LIST_END)
+            last = (dpc_t*)last->next;
+        dpc_push(&percpu[cur_cpu], first, last);
     }
-    spin_unlock_irqrestore(&dpc_lock, state);
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     event_signal(&percpu[cur_cpu].dpc_event, false);
 }
@@ -94,7 +124,6 @@ static int dpc_thread(void* arg) {
 
     struct percpu* cpu = get_local_percpu();
     event_t* event = &cpu->dpc_event;
-    list_node_t* list = &cpu->dpc_list;
 
     arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
@@ -103,24 +132,34 @@ static int dpc_thread(void* arg) {
         __UNUSED zx_status_t err = event_wait(event);
         DEBUG_ASSERT(err == ZX_OK);
 
-        spin_lock_irqsave(&dpc_lock, state);
+        // unsignal before taking the stack, so a dpc pushed after the swap
+        // signals the event again and is picked up on the next pass
+        event_unsignal(event);
 
-        // pop a dpc off the list, make a local copy.
-        dpc_t* dpc = list_remove_head_type(list, dpc_t, node);
+        uintptr_t head = (uintptr_t)atomic_swap_u64(dpc_head(cpu), 0);
 
-        // if the list is now empty, unsignal the event so we block until it is
-        if (!dpc) {
-            event_unsignal(event);
-            dpc_local.func = NULL;
-        } else {
-           dpc_local = *dpc;
+        // the stack is newest first, reverse it so dpcs run in queue order
+        dpc_t* dpc = NULL;
+        while (head && head != DPC_LIST_END) {
+            dpc_t* d = (dpc_t*)head;
+            head = d->next;
+            d->next = dpc ? (uintptr_t)dpc : DPC_LIST_END;
+            dpc = d;
         }
 
-        spin_unlock_irqrestore(&dpc_lock, state);
+        while (dpc) {
+            dpc_t* next = (dpc->next == DPC_LIST_END) ? NULL : (dpc_t*)dpc->next;
+
+            // make a local copy, then release the dpc so it can be queued again
+            // (or freed) while it runs
+            dpc_local = *dpc;
+            atomic_store_u64((volatile uint64_t*)&dpc->next, 0);
 
-        // call the dpc
-        if (dpc_local.func)
+            // call the dpc
             dpc_local.func(&dpc_local);
+
+            dpc = next;
+        }
     }
 
     return 0;
@@ -130,7 +169,7 @@ void dpc_init_for_cpu(void) {
     struct percpu* cpu = get_local_percpu();
     uint cpu_num = arch_curr_cpu_num();
 
-    list_initialize(&cpu->dpc_list);
+    cpu->dpc_head = 0;
     event_init(&cpu->dpc_event, false, 0);
 
     char name[10];
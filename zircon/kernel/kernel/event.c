@@ -21,12 +21,19 @@
  * to continue immediately until the signal is manually cleared with
  * event_unsignal().
  *
+ * The signaled state lives in an atomic state word alongside a bit that
+ * records whether any thread may be blocked in the wait queue. The waiters
+ * bit is only set and cleared under the thread lock, so while it is clear
+ * signaling, unsignaling and consuming a signal are a single atomic op and
+ * never touch the thread lock.
+ *
  * @{
  */
 
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
+#include <kernel/atomic.h>
 #include <kernel/event.h>
 #include <kernel/thread.h>
 #include <sys/types.h>
@@ -56,11 +63,31 @@ void event_destroy(event_t* e) {
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
 
     e->magic = 0;
-    e->signaled = false;
+    e->state = 0;
     e->flags = 0;
     wait_queue_destroy(&e->wait);
 }
 
+// Consume the signal without the thread lock, if that can be done with a
+// single atomic op. Returns true if the caller need not block.
+static bool event_try_consume(event_t* e) {
+    int state = atomic_load(&e->state);
+
+    if (!(e->flags & EVENT_FLAG_AUTOUNSIGNAL))
+        return (state & EVENT_STATE_SIGNALED) != 0;
+
+    // An autounsignal event may only be consumed here if no thread is queued
+    // on it; otherwise the signal belongs to the first waiter.
+    return state == EVENT_STATE_SIGNALED &&
+           atomic_cmpxchg(&e->state, &state, 0);
+}
+
+// If the wait queue has drained, no signal needs to take the thread lock.
+static void event_update_waiters_locked(event_t* e) TA_REQ(thread_lock) {
+    if (e->wait.count == 0)
+        atomic_and(&e->state, ~EVENT_STATE_WAITERS);
+}
+
 static zx_status_t event_wait_worker(event_t* e, zx_time_t deadline,
                                      bool interruptable,
                                      uint signal_mask) {
@@ -70,21 +97,31 @@ static zx_status_t event_wait_worker(event_t* e, zx_time_t deadline,
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
     DEBUG_ASSERT(!arch_in_int_handler());
 
+    if (event_try_consume(e))
+        return ZX_OK;
+
     THREAD_LOCK(state);
 
     current_thread->interruptable = interruptable;
 
-    if (e->signaled) {
+    // Publish the waiters bit before deciding to block, so that any signal
+    // racing with us is forced onto the locked path.
+    int prev = atomic_or(&e->state, EVENT_STATE_WAITERS);
+    if (prev & EVENT_STATE_SIGNALED) {
         /* signaled, we're going to fall through */
         if (e->flags & EVENT_FLAG_AUTOUNSIGNAL) {
             /* autounsignal flag lets one thread fall through before unsignaling */
-            e->signaled = false;
+            atomic_and(&e->state, ~EVENT_STATE_SIGNALED);
         }
     } else {
         /* unsignaled, block here */
         ret = wait_queue_block_with_mask(&e->wait, deadline, signal_mask);
     }
 
+    // We may have left the queue without being woken by a signal, e.g. on a
+    // timeout, so the last thread out clears the waiters bit.
+    event_update_waiters_locked(e);
+
     current_thread->interruptable = false;
 
     THREAD_UNLOCK(state);
@@ -138,6 +175,15 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
                                  bool thread_lock_held) TA_NO_THREAD_SAFETY_ANALYSIS {
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
 
+    // Fast path: with nobody waiting, signaling is just setting the bit.
+    int cur = atomic_load(&e->state);
+    while (!(cur & EVENT_STATE_WAITERS)) {
+        if (cur & EVENT_STATE_SIGNALED)
+            return 0;
+        if (atomic_cmpxchg(&e->state, &cur, cur | EVENT_STATE_SIGNALED))
+            return 0;
+    }
+
     // conditionally acquire/release the thread lock
     // NOTE: using the manual spinlock grab/release instead of THREAD_LOCK because
     // the state variable needs to exit in either path.
@@ -147,7 +193,7 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
 
     int wake_count = 0;
 
-    if (!e->signaled) {
+    if (!(atomic_load(&e->state) & EVENT_STATE_SIGNALED)) {
         if (e->flags & EVENT_FLAG_AUTOUNSIGNAL) {
             /* try to release one thread and leave unsignaled if successful */
             if ((wake_count = wait_queue_wake_one(&e->wait, reschedule, wait_result)) <= 0) {
@@ -156,15 +202,17 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
                  * signaled state and let the next call to event_wait
                  * unsignal the event.
                  */
-                e->signaled = true;
+                atomic_or(&e->state, EVENT_STATE_SIGNALED);
             }
         } else {
             /* release all threads and remain signaled */
-            e->signaled = true;
+            atomic_or(&e->state, EVENT_STATE_SIGNALED);
             wake_count = wait_queue_wake_all(&e->wait, reschedule, wait_result);
         }
     }
 
+    event_update_waiters_locked(e);
+
     // conditionally THREAD_UNLOCK
     if (!thread_lock_held)
         spin_unlock_irqrestore(&thread_lock, state);
@@ -239,7 +287,7 @@ int event_signal_thread_locked(event_t* e) {
 zx_status_t event_unsignal(event_t* e) {
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
 
-    e->signaled = false;
+    atomic_and(&e->state, ~EVENT_STATE_SIGNALED);
 
     return ZX_OK;
 }
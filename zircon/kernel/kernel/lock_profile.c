@@ -0,0 +1,301 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/lock_profile.h>
+
+#include <arch/ops.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <lib/ktrace.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zircon/types.h>
+
+// Sites live in an open addressed hash table keyed by pc. A slot is claimed
+// once, with a compare and swap of its pc, and never freed, so the index
+// of a site stays valid for as long as the kernel runs. Nothing here may
+// take a lock, since it runs inside the lock code.
+#define LOCK_PROFILE_SITES 2048u
+
+typedef struct lock_profile_site {
+    volatile uint64_t pc;
+    uint32_t kind;
+    volatile uint64_t last_lock;
+    volatile uint64_t acquisitions;
+    volatile uint64_t contended;
+    volatile uint64_t wait_ticks;
+    volatile uint64_t max_wait_ticks;
+    volatile uint64_t hold_ticks;
+    volatile uint64_t max_hold_ticks;
+} lock_profile_site_t;
+
+// Slot 0 is never used, so that LOCK_PROFILE_NO_SITE can be 0.
+static lock_profile_site_t sites[LOCK_PROFILE_SITES];
+static volatile uint64_t dropped;
+
+// Spin locks have nowhere to keep the site and time of their acquisition
+// until their release, but they are never held across a change of cpu, so
+// each cpu keeps a small stack of the spin locks it holds.
+#define LOCK_PROFILE_SPIN_DEPTH 8u
+
+typedef struct lock_profile_held {
+    const spin_lock_t* lock;
+    uint32_t site;
+    uint64_t acquire_ticks;
+} lock_profile_held_t;
+
+static struct {
+    uint32_t depth;
+    lock_profile_held_t held[LOCK_PROFILE_SPIN_DEPTH];
+} spin_held[SMP_MAX_CPUS];
+
+// Off until the kernel is far enough up to use cpu numbers and ticks, and
+// then until asked for.
+static volatile int enabled;
+
+static void atomic_max_u64(volatile uint64_t* ptr, uint64_t val) {
+    uint64_t old = atomic_load_u64_relaxed(ptr);
+    while (val > old && !atomic_cmpxchg_u64(ptr, &old, val))
+        ;
+}
+
+static uint32_t lock_profile_find_site(uint32_t kind, uintptr_t pc) {
+    uint32_t start = (uint32_t)((pc * 0x9E3779B97F4A7C15ull) >> 32) % LOCK_PROFILE_SITES;
+    uint32_t i = start;
+    do {
+        if (i != LOCK_PROFILE_NO_SITE) {
+            lock_profile_site_t* site = &sites[i];
+            uint64_t cur = atomic_load_u64_relaxed(&site->pc);
+            if (cur == 0 && atomic_cmpxchg_u64(&site->pc, &cur, pc)) {
+                site->kind = kind;
+                return i;
+            }
+            if (cur == pc)
+                return i;
+        }
+        i = (i + 1) % LOCK_PROFILE_SITES;
+    } while (i != start);
+
+    atomic_add_u64_relaxed(&dropped, 1u);
+    return LOCK_PROFILE_NO_SITE;
+}
+
+uint32_t lock_profile_acquired(uint32_t kind, uintptr_t pc, const void* lock,
+                               bool contended, uint64_t wait_ticks) {
+    if (!atomic_load(&enabled))
+        return LOCK_PROFILE_NO_SITE;
+
+    uint32_t i = lock_profile_find_site(kind, pc);
+    if (i == LOCK_PROFILE_NO_SITE)
+        return i;
+
+    lock_profile_site_t* site = &sites[i];
+    atomic_add_u64_relaxed(&site->acquisitions, 1u);
+    atomic_store_u64(&site->last_lock, (uintptr_t)lock);
+    if (contended) {
+        atomic_add_u64_relaxed(&site->contended, 1u);
+        atomic_add_u64_relaxed(&site->wait_ticks, wait_ticks);
+        atomic_max_u64(&site->max_wait_ticks, wait_ticks);
+    }
+    return i;
+}
+
+void lock_profile_released(uint32_t i, uint64_t acquire_ticks) {
+    if (i == LOCK_PROFILE_NO_SITE || !atomic_load(&enabled))
+        return;
+
+    uint64_t held = current_ticks() - acquire_ticks;
+    lock_profile_site_t* site = &sites[i];
+    atomic_add_u64_relaxed(&site->hold_ticks, held);
+    atomic_max_u64(&site->max_hold_ticks, held);
+}
+
+// Interrupts are disabled by the caller, so the cpu can't change under us.
+__NO_INLINE void lock_profile_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (!atomic_load(&enabled)) {
+        arch_spin_lock(lock);
+        return;
+    }
+
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    uint64_t start = current_ticks();
+    bool contended = arch_spin_trylock(lock) != 0;
+    if (contended)
+        arch_spin_lock(lock);
+    uint64_t now = current_ticks();
+
+    uint32_t site = lock_profile_acquired(LOCK_PROFILE_SPIN, pc, lock, contended,
+                                          now - start);
+    __typeof__(spin_held[0])* cpu = &spin_held[arch_curr_cpu_num()];
+    if (site != LOCK_PROFILE_NO_SITE && cpu->depth < LOCK_PROFILE_SPIN_DEPTH) {
+        cpu->held[cpu->depth++] = (lock_profile_held_t){lock, site, now};
+    }
+}
+
+void lock_profile_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    __typeof__(spin_held[0])* cpu = &spin_held[arch_curr_cpu_num()];
+    // Usually the most recently acquired, but locks needn't be released
+    // in order. A lock taken with spin_trylock(), or before profiling was
+    // enabled, isn't there at all.
+    for (uint32_t i = cpu->depth; i-- > 0;) {
+        if (cpu->held[i].lock == lock) {
+            lock_profile_held_t held = cpu->held[i];
+            memmove(&cpu->held[i], &cpu->held[i + 1],
+                    (cpu->depth - i - 1) * sizeof(cpu->held[0]));
+            cpu->depth--;
+            arch_spin_unlock(lock);
+            lock_profile_released(held.site, held.acquire_ticks);
+            return;
+        }
+    }
+    arch_spin_unlock(lock);
+}
+
+bool lock_profile_set_enabled(bool enable) {
+    return atomic_swap(&enabled, enable ? 1 : 0) != 0;
+}
+
+void lock_profile_get_lock_stats(const void* lock, lock_profile_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (uint32_t i = 0; i < LOCK_PROFILE_SITES; i++) {
+        lock_profile_site_t* site = &sites[i];
+        if (atomic_load_u64_relaxed(&site->pc) == 0 ||
+            atomic_load_u64_relaxed(&site->last_lock) != (uintptr_t)lock)
+            continue;
+        stats->acquisitions += atomic_load_u64_relaxed(&site->acquisitions);
+        stats->contended += atomic_load_u64_relaxed(&site->contended);
+        stats->wait_ticks += atomic_load_u64_relaxed(&site->wait_ticks);
+        stats->hold_ticks += atomic_load_u64_relaxed(&site->hold_ticks);
+        uint64_t max_wait = atomic_load_u64_relaxed(&site->max_wait_ticks);
+        if (max_wait > stats->max_wait_ticks)
+            stats->max_wait_ticks = max_wait;
+        uint64_t max_hold = atomic_load_u64_relaxed(&site->max_hold_ticks);
+        if (max_hold > stats->max_hold_ticks)
+            stats->max_hold_ticks = max_hold;
+    }
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)((__uint128_t)ticks * ZX_SEC(1) / ticks_per_second());
+}
+
+static uint32_t saturate_u32(uint64_t val) {
+    return val > UINT32_MAX ? UINT32_MAX : (uint32_t)val;
+}
+
+void lock_profile_report_ktrace(void) {
+    for (uint32_t i = 0; i < LOCK_PROFILE_SITES; i++) {
+        lock_profile_site_t* site = &sites[i];
+        uint64_t pc = atomic_load_u64_relaxed(&site->pc);
+        uint64_t acquisitions = atomic_load_u64_relaxed(&site->acquisitions);
+        if (pc == 0 || acquisitions == 0)
+            continue;
+        ktrace(TAG_LOCK_PROFILE_SITE, (uint32_t)(pc >> 32), (uint32_t)pc,
+               site->kind, saturate_u32(acquisitions));
+        ktrace(TAG_LOCK_PROFILE_TIME,
+               saturate_u32(atomic_load_u64_relaxed(&site->contended)),
+               saturate_u32(ticks_to_ns(site->wait_ticks) / ZX_USEC(1)),
+               saturate_u32(ticks_to_ns(site->hold_ticks) / ZX_USEC(1)), 0);
+        ktrace(TAG_LOCK_PROFILE_MAX,
+               saturate_u32(ticks_to_ns(site->max_wait_ticks)),
+               saturate_u32(ticks_to_ns(site->max_hold_ticks)), 0, 0);
+    }
+}
+
+static void lock_profile_init(uint level) {
+    atomic_store(&enabled, cmdline_get_bool("kernel.lockprof", false));
+}
+
+LK_INIT_HOOK(lock_profile, lock_profile_init, LK_INIT_LEVEL_THREADING);
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static void lock_profile_reset(void) {
+    for (uint32_t i = 0; i < LOCK_PROFILE_SITES; i++) {
+        lock_profile_site_t* site = &sites[i];
+        atomic_store_u64(&site->acquisitions, 0);
+        atomic_store_u64(&site->contended, 0);
+        atomic_store_u64(&site->wait_ticks, 0);
+        atomic_store_u64(&site->max_wait_ticks, 0);
+        atomic_store_u64(&site->hold_ticks, 0);
+        atomic_store_u64(&site->max_hold_ticks, 0);
+    }
+    atomic_store_u64(&dropped, 0);
+}
+
+// Sorted by total wait, most first, then by acquisitions.
+static int lock_profile_compare(const void* a, const void* b) {
+    const lock_profile_site_t* x = &sites[*(const uint32_t*)a];
+    const lock_profile_site_t* y = &sites[*(const uint32_t*)b];
+    if (x->wait_ticks != y->wait_ticks)
+        return x->wait_ticks > y->wait_ticks ? -1 : 1;
+    if (x->acquisitions != y->acquisitions)
+        return x->acquisitions > y->acquisitions ? -1 : 1;
+    return 0;
+}
+
+static void lock_profile_dump(uint32_t max) {
+    static uint32_t order[LOCK_PROFILE_SITES];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < LOCK_PROFILE_SITES; i++) {
+        if (sites[i].pc != 0 && sites[i].acquisitions != 0)
+            order[count++] = i;
+    }
+    qsort(order, count, sizeof(order[0]), lock_profile_compare);
+
+    printf("%18s %4s %18s %12s %10s %12s %10s %12s %10s\n", "site", "kind", "last lock",
+           "acquired", "contended", "wait us", "max wait", "hold us", "max hold");
+    for (uint32_t n = 0; n < count && n < max; n++) {
+        const lock_profile_site_t* site = &sites[order[n]];
+        printf("%#18" PRIx64 " %4s %#18" PRIx64 " %12" PRIu64 " %10" PRIu64
+               " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 " %10" PRIu64 "\n",
+               site->pc, site->kind == LOCK_PROFILE_SPIN ? "spin" : "mtx", site->last_lock,
+               site->acquisitions, site->contended,
+               ticks_to_ns(site->wait_ticks) / ZX_USEC(1), ticks_to_ns(site->max_wait_ticks),
+               ticks_to_ns(site->hold_ticks) / ZX_USEC(1), ticks_to_ns(site->max_hold_ticks));
+    }
+    printf("%u sites (max wait and hold in ns), %" PRIu64 " acquisitions not recorded\n",
+           count, dropped);
+}
+
+static int cmd_lockprof(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    usage:
+        printf("usage:\n");
+        printf("%s dump [count]  : show the sites with the most waiting\n", argv[0].str);
+        printf("%s reset         : clear all counts\n", argv[0].str);
+        printf("%s start|stop    : enable or disable recording\n", argv[0].str);
+        printf("%s ktrace        : write the counts to the ktrace buffer\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "dump")) {
+        lock_profile_dump(argc > 2 ? (uint32_t)argv[2].u : 20u);
+    } else if (!strcmp(argv[1].str, "reset")) {
+        lock_profile_reset();
+    } else if (!strcmp(argv[1].str, "start")) {
+        lock_profile_set_enabled(true);
+    } else if (!strcmp(argv[1].str, "stop")) {
+        lock_profile_set_enabled(false);
+    } else if (!strcmp(argv[1].str, "ktrace")) {
+        lock_profile_report_ktrace();
+    } else {
+        printf("unrecognized subcommand\n");
+        goto usage;
+    }
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockprof", "lock contention profile", &cmd_lockprof)
+STATIC_COMMAND_END(lockprof);
+
+#endif // WITH_LIB_CONSOLE
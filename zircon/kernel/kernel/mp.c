@@ -392,6 +392,21 @@ void mp_set_curr_cpu_active(bool active) {
     }
 }
 
+void mp_set_cpu_node(cpu_num_t cpu, uint32_t node) {
+    DEBUG_ASSERT(is_valid_cpu_num(cpu));
+
+    mp.cpu_node[cpu] = node;
+}
+
+cpu_mask_t mp_get_node_mask(uint32_t node) {
+    cpu_mask_t mask = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (mp.cpu_node[i] == node)
+            mask |= cpu_num_to_mask(i);
+    }
+    return mask;
+}
+
 void mp_mbx_generic_irq(void) {
     DEBUG_ASSERT(arch_ints_disabled());
     const cpu_num_t local_cpu = arch_curr_cpu_num();
@@ -20,14 +20,44 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/lock_profile.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+// How long a contended acquire may spin waiting for a running holder to
+// release the mutex before it blocks. This is on the order of a context
+// switch pair, past which blocking is cheaper than burning the cpu.
+#define MUTEX_SPIN_MAX_DURATION ZX_USEC(10)
+
+// counts contended acquires, and how each of them was resolved.
+KCOUNTER(mutex_contended_count, "kernel.mutex.contended");
+KCOUNTER(mutex_spin_success_count, "kernel.mutex.spin.success");
+KCOUNTER(mutex_block_count, "kernel.mutex.block");
+
+#if WITH_LOCK_PROFILING
+// Record the acquisition of |m| from |pc|. |contended_since| is when the
+// acquirer first found it held, or 0 if it didn't.
+static void mutex_profile_acquired(mutex_t* m, uintptr_t pc, uint64_t contended_since) {
+    uint64_t now = current_ticks();
+    m->prof_site = lock_profile_acquired(LOCK_PROFILE_MUTEX, pc, m, contended_since != 0,
+                                         contended_since ? now - contended_since : 0);
+    m->prof_acquire_ticks = now;
+}
+#define MUTEX_PROFILE_NOW() current_ticks()
+#define MUTEX_PROFILE_ACQUIRED(m, contended_since) \
+    mutex_profile_acquired(m, (uintptr_t)__builtin_return_address(0), contended_since)
+#else
+#define MUTEX_PROFILE_NOW() 0
+#define MUTEX_PROFILE_ACQUIRED(m, contended_since) do {} while (0)
+#endif
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -59,6 +89,51 @@ void mutex_destroy(mutex_t* m) {
     wait_queue_destroy(&m->wait);
 }
 
+// Is |holder| running on some other cpu right now?
+//
+// |holder| may release the mutex, exit and be freed while we look at it.
+// That is benign: thread structures live in the kernel heap, which is always
+// mapped, so a stale read just makes the caller give up spinning early or
+// spin until its budget runs out.
+static bool mutex_holder_running(const thread_t* holder) {
+    return holder->state == THREAD_RUNNING &&
+           holder->curr_cpu != arch_curr_cpu_num();
+}
+
+// Spin for a bounded time waiting for the mutex to be released, as long as
+// its holder is running on another cpu and so is likely to release it soon.
+// Returns true if the mutex was acquired.
+static bool mutex_spin_acquire(mutex_t* m, thread_t* ct) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+
+    for (;;) {
+        uintptr_t val = mutex_val(m);
+        if (val == 0) {
+            uintptr_t oldval = 0;
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))
+                return true;
+            continue;
+        }
+
+        // once threads are queued the releaser hands the mutex directly to
+        // one of them, so there is nothing to be gained by spinning.
+        if (val & MUTEX_FLAG_QUEUED)
+            return false;
+
+        if (!mutex_holder_running((const thread_t*)val))
+            return false;
+
+        // only start the clock once we know we're going to spin.
+        zx_time_t now = current_time();
+        if (deadline == ZX_TIME_INFINITE)
+            deadline = now + MUTEX_SPIN_MAX_DURATION;
+        else if (now >= deadline)
+            return false;
+
+        arch_spinloop_pause();
+    }
+}
+
 /**
  * @brief  Acquire the mutex
  */
@@ -69,21 +144,41 @@ void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
 
-retry:
     // fast path: assume its unheld, try to grab it
     oldval = 0;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))) {
         // acquired it cleanly
         ct->mutexes_held++;
+        MUTEX_PROFILE_ACQUIRED(m, 0);
         return;
     }
 
+    __UNUSED uint64_t contended_since = MUTEX_PROFILE_NOW();
+
 #if LK_DEBUGLEVEL > 0
     if (unlikely(ct == mutex_holder(m)))
         panic("mutex_acquire: thread %p (%s) tried to acquire mutex %p it already owns.\n",
               ct, ct->name, m);
 #endif
 
+    kcounter_add(mutex_contended_count, 1u);
+
+    // the holder may be about to release it on another cpu
+    if (mutex_spin_acquire(m, ct)) {
+        kcounter_add(mutex_spin_success_count, 1u);
+        ct->mutexes_held++;
+        MUTEX_PROFILE_ACQUIRED(m, contended_since);
+        return;
+    }
+
+retry:
+    oldval = 0;
+    if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct)) {
+        ct->mutexes_held++;
+        MUTEX_PROFILE_ACQUIRED(m, contended_since);
+        return;
+    }
+
     // we contended with someone else, will probably need to block
     THREAD_LOCK(state);
 
@@ -107,6 +202,7 @@ retry:
     sched_inheirit_priority(mutex_holder(m), ct->effec_priority, &unused);
 
     // we have signalled that we're blocking, so drop into the wait queue
+    kcounter_add(mutex_block_count, 1u);
     zx_status_t ret = wait_queue_block(&m->wait, ZX_TIME_INFINITE);
     if (unlikely(ret < ZX_OK)) {
         // mutexes are not interruptable and cannot time out, so it
@@ -122,6 +218,8 @@ retry:
     ct->mutexes_held++;
 
     THREAD_UNLOCK(state);
+
+    MUTEX_PROFILE_ACQUIRED(m, contended_since);
 }
 
 // shared implementation of release
@@ -130,6 +228,10 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
 
+#if WITH_LOCK_PROFILING
+    lock_profile_released(m->prof_site, m->prof_acquire_ticks);
+#endif
+
     // we're going to release it, mark as such
     ct->mutexes_held--;
 
@@ -32,4 +32,8 @@ MODULE_SRCS := \
 	$(LOCAL_DIR)/timer.c \
 	$(LOCAL_DIR)/wait.c
 
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+MODULE_SRCS += $(LOCAL_DIR)/lock_profile.c
+endif
+
 include make/module.mk
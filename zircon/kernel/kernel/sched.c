@@ -59,6 +59,8 @@ static void compute_effec_priority(thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
     if (t->inheirited_priority > ep)
         ep = t->inheirited_priority;
+    if (t->futex_inheirited_priority > ep)
+        ep = t->futex_inheirited_priority;
 
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
 
@@ -152,6 +154,10 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
     /* the thread's affinity mask */
     cpu_mask_t cpu_affinity = t->cpu_affinity;
 
+    /* cpus on the same NUMA node as the last cpu, if the thread has run before */
+    cpu_mask_t last_node_cpu_mask = last_ran_cpu_mask ? mp_get_node_mask(mp_get_cpu_node(t->last_cpu))
+                                                      : 0;
+
     LTRACEF_LEVEL(2, "last %#x curr %#x aff %#x name %s\n",
                   last_ran_cpu_mask, curr_cpu_mask, cpu_affinity, t->name);
 
@@ -171,8 +177,12 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
             return last_ran_cpu_mask;
         }
 
-        /* pick an idle_cpu */
+        /* pick an idle_cpu, preferring one on the same NUMA node as the last cpu
+         * it ran on, so that it stays close to the memory it has been using */
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
+        cpu_mask_t node_idle_mask = idle_cpu_mask & last_node_cpu_mask;
+        if (node_idle_mask != 0)
+            return rand_cpu(node_idle_mask);
         return rand_cpu(idle_cpu_mask);
     }
 
@@ -193,6 +203,10 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
     if (mask == 0)
         return curr_cpu_mask; /* local cpu is the only choice */
 
+    /* stay on the last cpu's NUMA node if the affinity mask allows it */
+    if (mask & last_node_cpu_mask & active_cpu_mask)
+        mask &= last_node_cpu_mask;
+
     mask = rand_cpu(mask);
     if (mask == 0)
         return curr_cpu_mask; /* local cpu is the only choice */
@@ -254,6 +268,7 @@ void sched_init_thread(thread_t* t, int priority) {
     t->base_priority = priority;
     t->priority_boost = 0;
     t->inheirited_priority = -1;
+    t->futex_inheirited_priority = -1;
     compute_effec_priority(t);
 }
 
@@ -562,6 +577,8 @@ void sched_migrate(thread_t* t) {
     }
 }
 
+static void update_inheirited_priority(thread_t* t, bool* local_resched);
+
 /* set the priority to the higher value of what it was before and the newly inheirited value */
 /* pri < 0 disables priority inheiritance and goes back to the naturally computed values */
 void sched_inheirit_priority(thread_t* t, int pri, bool *local_resched) {
@@ -574,8 +591,31 @@ void sched_inheirit_priority(thread_t* t, int pri, bool *local_resched) {
     if (pri >= 0 && pri <= t->inheirited_priority)
         return;
 
-    // adjust the priority and remember the old value
     t->inheirited_priority = pri;
+    update_inheirited_priority(t, local_resched);
+}
+
+/* set the priority inheirited from threads blocked on priority inheritance futexes that t owns */
+/* unlike sched_inheirit_priority, pri replaces the previous value; pri < 0 removes it */
+void sched_inheirit_futex_priority(thread_t* t, int pri, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (pri > HIGHEST_PRIORITY)
+        pri = HIGHEST_PRIORITY;
+    if (pri < 0)
+        pri = -1;
+
+    if (pri == t->futex_inheirited_priority)
+        return;
+
+    t->futex_inheirited_priority = pri;
+    update_inheirited_priority(t, local_resched);
+}
+
+/* recompute the effective priority of t after one of its inheirited priorities changed */
+/* and move it to the matching run queue */
+static void update_inheirited_priority(thread_t* t, bool* local_resched) {
+    // adjust the priority and remember the old value
     int old_ep = t->effec_priority;
     compute_effec_priority(t);
     if (old_ep == t->effec_priority) {
@@ -488,7 +488,7 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread, int retcode
     /* must be put at top scope in this function to force the compiler to keep it from
      * reusing the stack before the function exits
      */
-    dpc_t free_dpc;
+    dpc_t free_dpc = DPC_INITIAL_VALUE;
 
     /* enter the dead state */
     current_thread->state = THREAD_DEATH;
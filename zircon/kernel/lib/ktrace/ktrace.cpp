@@ -12,6 +12,7 @@
 #include <arch/ops.h>
 #include <arch/user_copy.h>
 #include <kernel/cmdline.h>
+#include <kernel/lock_profile.h>
 #include <vm/vm_aspace.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
@@ -142,6 +143,10 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         ktrace_report_live_threads();
         break;
     case KTRACE_ACTION_STOP: {
+#if WITH_LOCK_PROFILING
+        // leave a snapshot of the lock profile at the end of the trace
+        lock_profile_report_ktrace();
+#endif
         atomic_store(&ks->grpmask, 0);
         uint32_t n = ks->offset;
         if (n > ks->bufsize) {
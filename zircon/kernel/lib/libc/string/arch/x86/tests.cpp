@@ -5,14 +5,17 @@
 // https://opensource.org/licenses/MIT
 
 #include <arch/x86/feature.h>
+#include <arch/x86/mem_ops.h>
 #include <assert.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <unittest.h>
 
 extern "C" {
 
 extern void* memcpy(void*, const void*, size_t);
 extern void* memcpy_erms(void*, const void*, size_t);
+extern void* memcpy_fsrm(void*, const void*, size_t);
 extern void* memcpy_quad(void*, const void*, size_t);
 
 extern void* memset(void*, int, size_t);
@@ -86,6 +89,26 @@ static bool memcpy_func_test(memcpy_func_t cpy, void* context) {
         }
     }
 
+    // Test copies around the non-temporal threshold, with a misaligned
+    // destination so the alignment prologue is exercised.
+    const size_t kLargeLen = X86_NT_COPY_THRESHOLD + 64;
+    char* large_src = static_cast<char*>(malloc(kLargeLen));
+    char* large_dst = static_cast<char*>(malloc(kLargeLen + 8));
+    REQUIRE_NONNULL(large_src, "alloc src");
+    REQUIRE_NONNULL(large_dst, "alloc dst");
+    for (size_t i = 0; i < kLargeLen; ++i) {
+        large_src[i] = static_cast<char>(i * 7 + 1);
+    }
+    for (size_t len = X86_NT_COPY_THRESHOLD - 1; len <= kLargeLen; len += 33) {
+        memset(large_dst, 0, kLargeLen + 8);
+        cpy(large_dst + 3, large_src, len);
+        EXPECT_EQ(0, large_dst[2], "overwrote before buffer");
+        EXPECT_TRUE(!memcmp(large_dst + 3, large_src, len), "buffer mismatch");
+        EXPECT_EQ(0, large_dst[len + 3], "overwrote after buffer");
+    }
+    free(large_src);
+    free(large_dst);
+
     END_TEST;
 }
 
@@ -154,6 +177,14 @@ static bool memcpy_erms_test(void* context) {
     return memcpy_func_test(memcpy_erms, context);
 }
 
+static bool memcpy_fsrm_test(void* context) {
+    if (!x86_feature_test(X86_FEATURE_FSRM)) {
+        return true;
+    }
+
+    return memcpy_func_test(memcpy_fsrm, context);
+}
+
 static bool memset_test(void* context) {
     return memset_func_test(memset, context);
 }
@@ -174,6 +205,7 @@ UNITTEST_START_TESTCASE(memops_tests)
 UNITTEST("memcpy tests", memcpy_test)
 UNITTEST("memcpy_quad tests", memcpy_quad_test)
 UNITTEST("memcpy_erms tests", memcpy_erms_test)
+UNITTEST("memcpy_fsrm tests", memcpy_fsrm_test)
 UNITTEST("memset tests", memset_test)
 UNITTEST("memset_quad tests", memset_quad_test)
 UNITTEST("memset_erms tests", memset_erms_test)
@@ -134,7 +134,8 @@ void ChannelDispatcher::OnPeerZeroHandles() {
 zx_status_t ChannelDispatcher::Read(uint32_t* msg_size,
                                     uint32_t* msg_handle_count,
                                     fbl::unique_ptr<MessagePacket>* msg,
-                                    bool may_discard) {
+                                    bool may_discard,
+                                    bool may_discard_handles) {
     canary_.Assert();
 
     auto max_size = *msg_size;
@@ -149,7 +150,7 @@ zx_status_t ChannelDispatcher::Read(uint32_t* msg_size,
     *msg_handle_count = messages_.front().num_handles();
     zx_status_t rv = ZX_OK;
     if (*msg_size > max_size || *msg_handle_count > max_handle_count) {
-        if (!may_discard)
+        if (!may_discard || (*msg_handle_count > 0 && !may_discard_handles))
             return ZX_ERR_BUFFER_TOO_SMALL;
         rv = ZX_ERR_BUFFER_TOO_SMALL;
     }
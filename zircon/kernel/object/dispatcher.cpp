@@ -33,6 +33,12 @@ KCOUNTER(dispatcher_cookie_set_count, "kernel.dispatcher.cookie.set");
 KCOUNTER(dispatcher_cookie_reset_count, "kernel.dispatcher.cookie.reset");
 
 namespace {
+
+uint64_t ApplySignalMasks(uint64_t state, zx_signals_t clear_mask, zx_signals_t set_mask) {
+    // Widen the masks first so the bits above the signals are left alone.
+    return (state & ~static_cast<uint64_t>(clear_mask)) | set_mask;
+}
+
 // The first 1K koids are reserved.
 fbl::atomic<zx_koid_t> global_koid(1024ULL);
 
@@ -91,7 +97,7 @@ private:
 Dispatcher::Dispatcher(zx_signals_t signals)
     : koid_(GenerateKernelObjectId()),
       handle_count_(0u),
-      signals_(signals) {
+      signal_state_(signals) {
 
     kcounter_add(dispatcher_create_count, 1u);
 }
@@ -181,8 +187,8 @@ StateObserver::Flags CancelWithFunc(Dispatcher::ObserverList* observers,
 
 // Since this conditionally takes the dispatcher's |lock_|, based on
 // the type of Mutex (either fbl::Mutex or fbl::NullLock), the thread
-// safety analysis is unable to prove that the accesses to |signals_|
-// and to |observers_| are always protected.
+// safety analysis is unable to prove that the accesses to |observers_|
+// are always protected.
 template <typename Mutex>
 void Dispatcher::AddObserverHelper(StateObserver* observer,
                                    const StateObserver::CountInfo* cinfo,
@@ -194,9 +200,14 @@ void Dispatcher::AddObserverHelper(StateObserver* observer,
     {
         AutoLock lock(mutex);
 
-        flags = observer->OnInitialize(signals_, cinfo);
+        // Setting kHasObservers forces any later UpdateState onto the
+        // locked path, and returns the signals as of that point.
+        auto signals = static_cast<zx_signals_t>(signal_state_.fetch_or(kHasObservers));
+        flags = observer->OnInitialize(signals, cinfo);
         if (!(flags & StateObserver::kNeedRemoval))
             observers_.push_front(observer);
+        else
+            UpdateHasObserversLocked();
     }
     if (flags & StateObserver::kNeedRemoval)
         observer->OnRemoved();
@@ -221,6 +232,7 @@ void Dispatcher::RemoveObserver(StateObserver* observer) {
     AutoLock lock(&lock_);
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
+    UpdateHasObserversLocked();
 }
 
 bool Dispatcher::Cancel(Handle* handle) {
@@ -255,25 +267,45 @@ bool Dispatcher::CancelByKey(Handle* handle, const void* port, uint64_t key) {
 
 // Since this conditionally takes the dispatcher's |lock_|, based on
 // the type of Mutex (either fbl::Mutex or fbl::NullLock), the thread
-// safety analysis is unable to prove that the accesses to |signals_|
+// safety analysis is unable to prove that the accesses to |observers_|
 // are always protected.
 template <typename Mutex>
 void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
                                    zx_signals_t set_mask,
                                    Mutex* mutex) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Fast path: nobody is observing, so there is nobody to notify.
+    uint64_t state = signal_state_.load(fbl::memory_order_relaxed);
+    while (!(state & kHasObservers)) {
+        uint64_t new_state = ApplySignalMasks(state, clear_mask, set_mask);
+        if (new_state == state)
+            return;
+        if (signal_state_.compare_exchange_strong(&state, new_state,
+                                                  fbl::memory_order_release,
+                                                  fbl::memory_order_relaxed))
+            return;
+    }
+
     StateObserver::Flags flags;
     Dispatcher::ObserverList obs_to_remove;
 
     {
         AutoLock lock(mutex);
-        auto previous_signals = signals_;
-        signals_ &= ~clear_mask;
-        signals_ |= set_mask;
-
-        if (previous_signals == signals_)
-            return;
 
-        flags = UpdateInternalLocked(&obs_to_remove, signals_);
+        // kHasObservers may have been cleared since we looked, in which case
+        // lock-free updates can still race with us, so this has to be a
+        // compare-and-swap as well.
+        uint64_t previous = signal_state_.load(fbl::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = ApplySignalMasks(previous, clear_mask, set_mask);
+            if (next == previous)
+                return;
+        } while (!signal_state_.compare_exchange_strong(&previous, next,
+                                                        fbl::memory_order_release,
+                                                        fbl::memory_order_relaxed));
+
+        flags = UpdateInternalLocked(&obs_to_remove, static_cast<zx_signals_t>(next));
+        UpdateHasObserversLocked();
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -373,3 +405,10 @@ StateObserver::Flags Dispatcher::UpdateInternalLocked(ObserverList* obs_to_remov
     // Filter out NeedRemoval flag because we processed that here
     return flags & (~StateObserver::kNeedRemoval);
 }
+
+void Dispatcher::UpdateHasObserversLocked() {
+    // Observers removed by Cancel() leave the bit set until the next update
+    // or removal, which only costs that update a trip through |lock_|.
+    if (observers_.is_empty())
+        signal_state_.fetch_and(~kHasObservers, fbl::memory_order_relaxed);
+}
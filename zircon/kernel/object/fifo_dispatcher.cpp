@@ -12,14 +12,27 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <object/handle.h>
+#include <vm/pmm.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
 
 using fbl::AutoLock;
 
+static_assert(sizeof(zx_fifo_ring_t) <= ZX_FIFO_RING_ENTRIES_OFFSET, "");
+
+// The size of one direction of a ZX_FIFO_SHARED_RING fifo.
+static uint64_t RingSize(uint32_t count, uint32_t elemsize) {
+    return ROUNDUP(ZX_FIFO_RING_ENTRIES_OFFSET + count * elemsize, PAGE_SIZE);
+}
+
 // static
 zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t options,
                                    fbl::RefPtr<Dispatcher>* dispatcher0,
                                    fbl::RefPtr<Dispatcher>* dispatcher1,
                                    zx_rights_t* rights) {
+    if (options & ~ZX_FIFO_CREATE_MASK)
+        return ZX_ERR_INVALID_ARGS;
+
     // count and elemsize must be nonzero
     // count must be a power of two
     // total size must be <= kMaxSizeBytes
@@ -30,21 +43,52 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
     }
 
     fbl::AllocChecker ac;
-    auto data0 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data0)));
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto data1 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data1)));
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
+    fbl::RefPtr<FifoDispatcher> fifo0;
+    fbl::RefPtr<FifoDispatcher> fifo1;
+
+    if (options & ZX_FIFO_SHARED_RING) {
+        // One VMO holds both rings: the ring read by |fifo0| followed by
+        // the ring read by |fifo1|.
+        const uint64_t ring_size = RingSize(count, elemsize);
+        fbl::RefPtr<VmObject> vmo;
+        zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 2 * ring_size, &vmo);
+        if (status != ZX_OK)
+            return status;
+        const char name[] = "fifo-ring";
+        vmo->set_name(name, sizeof(name));
+
+        fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, vmo,
+                                                       0u, ring_size));
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        status = fifo0->MapRing();
+        if (status != ZX_OK)
+            return status;
+
+        fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(vmo),
+                                                       ring_size, 0u));
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        status = fifo1->MapRing();
+        if (status != ZX_OK)
+            return status;
+    } else {
+        auto data0 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+
+        fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data0)));
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+
+        auto data1 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+
+        fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(options, count, elemsize, fbl::move(data1)));
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+    }
 
     fifo0->Init(fifo1);
     fifo1->Init(fifo0);
@@ -59,10 +103,62 @@ FifoDispatcher::FifoDispatcher(uint32_t /*options*/, uint32_t count, uint32_t el
                                fbl::unique_ptr<uint8_t[]> data)
     : Dispatcher(ZX_FIFO_WRITABLE),
       elem_count_(count), elem_size_(elem_size), mask_(count - 1),
-      peer_koid_(0u), head_(0u), tail_(0u), data_(fbl::move(data)) {
+      peer_koid_(0u), head_(0u), tail_(0u), data_(fbl::move(data)),
+      ring_offset_(0u), peer_ring_offset_(0u), ring_(nullptr),
+      entries_(data_.get()) {
+}
+
+FifoDispatcher::FifoDispatcher(uint32_t /*options*/, uint32_t count, uint32_t elem_size,
+                               fbl::RefPtr<VmObject> ring_vmo, uint64_t ring_offset,
+                               uint64_t peer_ring_offset)
+    : Dispatcher(ZX_FIFO_WRITABLE),
+      elem_count_(count), elem_size_(elem_size), mask_(count - 1),
+      peer_koid_(0u), head_(0u), tail_(0u),
+      ring_vmo_(fbl::move(ring_vmo)), ring_offset_(ring_offset),
+      peer_ring_offset_(peer_ring_offset), ring_(nullptr), entries_(nullptr) {
 }
 
 FifoDispatcher::~FifoDispatcher() {
+    if (ring_mapping_) {
+        ring_mapping_->Destroy();
+        ring_vmo_->Unpin(ring_offset_, RingSize(elem_count_, elem_size_));
+    }
+}
+
+// Maps the ring this end reads from into the kernel. Its pages are pinned
+// for the life of the fifo, so that userspace cannot decommit them from
+// under the kernel mapping.
+zx_status_t FifoDispatcher::MapRing() {
+    const uint64_t size = RingSize(elem_count_, elem_size_);
+
+    uint64_t committed;
+    zx_status_t status = ring_vmo_->CommitRange(ring_offset_, size, &committed);
+    if (status != ZX_OK)
+        return status;
+    status = ring_vmo_->Pin(ring_offset_, size);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0 /* ignored */, size, 0 /* align pow2 */, 0 /* vmar flags */,
+        ring_vmo_, ring_offset_, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+        "fifo-ring", &mapping);
+    if (status != ZX_OK) {
+        ring_vmo_->Unpin(ring_offset_, size);
+        return status;
+    }
+    status = mapping->MapRange(0, size, true);
+    if (status != ZX_OK) {
+        mapping->Destroy();
+        ring_vmo_->Unpin(ring_offset_, size);
+        return status;
+    }
+
+    ring_mapping_ = fbl::move(mapping);
+    ring_ = reinterpret_cast<zx_fifo_ring_t*>(ring_mapping_->base());
+    entries_ = reinterpret_cast<uint8_t*>(ring_mapping_->base()) + ZX_FIFO_RING_ENTRIES_OFFSET;
+    return ZX_OK;
 }
 
 // Thread safety analysis disabled as this happens during creation only,
@@ -138,18 +234,35 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
     canary_.Assert();
 
     size_t count = bytelen / elem_size_;
-    if (count == 0)
-        return ZX_ERR_OUT_OF_RANGE;
 
     AutoLock lock(&lock_);
 
-    uint32_t old_head = head_;
+    if (count == 0) {
+        // A zero length write rings the doorbell of a shared ring.
+        if (ring_ && bytelen == 0) {
+            SyncSharedRingLocked();
+            *actual = 0u;
+            return ZX_OK;
+        }
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    const uint32_t old_head = LoadHeadLocked();
+    const uint32_t tail = LoadTailLocked();
+    uint32_t head = old_head;
+
+    // the indices of a shared ring come from userspace
+    if ((head - tail) > elem_count_)
+        return ZX_ERR_BAD_STATE;
 
     // total number of available empty slots in the fifo
-    size_t avail = elem_count_ - (head_ - tail_);
+    size_t avail = elem_count_ - (head - tail);
 
-    if (avail == 0)
+    if (avail == 0) {
+        if (ring_)
+            SyncSharedRingLocked();
         return ZX_ERR_SHOULD_WAIT;
+    }
 
     bool was_empty = (avail == elem_count_);
 
@@ -157,7 +270,7 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (head_ & mask_);
+        uint32_t offset = (head & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -165,30 +278,36 @@ zx_status_t FifoDispatcher::WriteSelf(user_in_ptr<const uint8_t> ptr, size_t byt
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_from_user(&data_[offset * elem_size_],
+        zx_status_t status = ptr.copy_array_from_user(&entries_[offset * elem_size_],
                                                       to_copy * elem_size_);
         if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            head_ = old_head;
+            // nothing is published until the head is stored below
             return ZX_ERR_INVALID_ARGS;
         }
 
         // adjust head and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        head_ += static_cast<uint32_t>(to_copy);
+        head += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
-    // if was empty, we've become readable
-    if (was_empty)
-        UpdateState(0u, ZX_FIFO_READABLE);
+    StoreHeadLocked(head);
 
-    // if now full, we're no longer writable
-    if (elem_count_ == (head_ - tail_))
-        other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+    if (ring_) {
+        // userspace may have moved the tail since we looked
+        SyncSharedRingLocked();
+    } else {
+        // if was empty, we've become readable
+        if (was_empty)
+            UpdateState(0u, ZX_FIFO_READABLE);
 
-    *actual = (head_ - old_head);
+        // if now full, we're no longer writable
+        if (elem_count_ == (head - tail) && other_)
+            other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+    }
+
+    *actual = (head - old_head);
     return ZX_OK;
 }
 
@@ -196,18 +315,35 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
     canary_.Assert();
 
     size_t count = bytelen / elem_size_;
-    if (count == 0)
-        return ZX_ERR_OUT_OF_RANGE;
 
     AutoLock lock(&lock_);
 
-    uint32_t old_tail = tail_;
+    if (count == 0) {
+        // A zero length read rings the doorbell of a shared ring.
+        if (ring_ && bytelen == 0) {
+            SyncSharedRingLocked();
+            *actual = 0u;
+            return ZX_OK;
+        }
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    const uint32_t head = LoadHeadLocked();
+    const uint32_t old_tail = LoadTailLocked();
+    uint32_t tail = old_tail;
+
+    // the indices of a shared ring come from userspace
+    if ((head - tail) > elem_count_)
+        return ZX_ERR_BAD_STATE;
 
     // total number of available entries to read from the fifo
-    size_t avail = (head_ - tail_);
+    size_t avail = (head - tail);
 
-    if (avail == 0)
+    if (avail == 0) {
+        if (ring_)
+            SyncSharedRingLocked();
         return ZX_ERR_SHOULD_WAIT;
+    }
 
     bool was_full = (avail == elem_count_);
 
@@ -215,7 +351,7 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (tail_ & mask_);
+        uint32_t offset = (tail & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -223,29 +359,98 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_to_user(&data_[offset * elem_size_],
+        zx_status_t status = ptr.copy_array_to_user(&entries_[offset * elem_size_],
                                                     to_copy * elem_size_);
         if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            tail_ = old_tail;
+            // nothing is consumed until the tail is stored below
             return ZX_ERR_INVALID_ARGS;
         }
 
         // adjust tail and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        tail_ += static_cast<uint32_t>(to_copy);
+        tail += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
-    // if we were full, we have become writable
-    if (was_full && other_)
-        other_->UpdateState(0u, ZX_FIFO_WRITABLE);
+    StoreTailLocked(tail);
+
+    if (ring_) {
+        // userspace may have moved the head since we looked
+        SyncSharedRingLocked();
+    } else {
+        // if we were full, we have become writable
+        if (was_full && other_)
+            other_->UpdateState(0u, ZX_FIFO_WRITABLE);
+
+        // if we've become empty, we're no longer readable
+        if ((head - tail) == 0)
+            UpdateState(ZX_FIFO_READABLE, 0u);
+    }
+
+    *actual = (tail - old_tail);
+    return ZX_OK;
+}
+
+uint32_t FifoDispatcher::LoadHeadLocked() const {
+    return ring_ ? __atomic_load_n(&ring_->head, __ATOMIC_ACQUIRE) : head_;
+}
+
+uint32_t FifoDispatcher::LoadTailLocked() const {
+    return ring_ ? __atomic_load_n(&ring_->tail, __ATOMIC_ACQUIRE) : tail_;
+}
+
+void FifoDispatcher::StoreHeadLocked(uint32_t head) {
+    if (ring_) {
+        __atomic_store_n(&ring_->head, head, __ATOMIC_RELEASE);
+    } else {
+        head_ = head;
+    }
+}
+
+void FifoDispatcher::StoreTailLocked(uint32_t tail) {
+    if (ring_) {
+        __atomic_store_n(&ring_->tail, tail, __ATOMIC_RELEASE);
+    } else {
+        tail_ = tail;
+    }
+}
+
+void FifoDispatcher::SyncSharedRingLocked() {
+    DEBUG_ASSERT(ring_);
 
-    // if we've become empty, we're no longer readable
-    if ((head_ - tail_) == 0)
+    // A corrupt ring counts as readable and not writable, so that both ends
+    // go and look at it.
+    uint32_t used = LoadHeadLocked() - LoadTailLocked();
+    bool readable = (used != 0);
+    bool writable = (used < elem_count_);
+
+    if (readable) {
+        UpdateState(0u, ZX_FIFO_READABLE);
+    } else {
         UpdateState(ZX_FIFO_READABLE, 0u);
+    }
+
+    if (other_) {
+        if (writable) {
+            other_->UpdateState(0u, ZX_FIFO_WRITABLE);
+        } else {
+            other_->UpdateState(ZX_FIFO_WRITABLE, 0u);
+        }
+    }
+}
+
+zx_status_t FifoDispatcher::GetRing(fbl::RefPtr<VmObject>* vmo, zx_fifo_ring_info_t* info) {
+    canary_.Assert();
+
+    if (!ring_vmo_)
+        return ZX_ERR_NOT_SUPPORTED;
 
-    *actual = (tail_ - old_tail);
+    *vmo = ring_vmo_;
+    info->vmo_size = ring_vmo_->size();
+    info->read_ring_offset = ring_offset_;
+    info->write_ring_offset = peer_ring_offset_;
+    info->elem_count = elem_count_;
+    info->elem_size = elem_size_;
     return ZX_OK;
 }
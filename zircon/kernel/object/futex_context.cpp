@@ -8,7 +8,9 @@
 
 #include <assert.h>
 #include <lib/user_copy/user_ptr.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_lock.h>
+#include <object/process_dispatcher.h>
 #include <object/thread_dispatcher.h>
 #include <trace.h>
 #include <zircon/types.h>
@@ -27,6 +29,7 @@ FutexContext::~FutexContext() {
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
     DEBUG_ASSERT(futex_table_.is_empty());
+    DEBUG_ASSERT(!pi_release_head_);
 }
 
 zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
@@ -202,6 +205,211 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
     return ZX_OK;
 }
 
+zx_status_t FutexContext::FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                                      zx_time_t deadline) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    // Look up the owner before taking lock_, since the handle table has its
+    // own lock.  If the owner changes before lock_ is taken, the value check
+    // below fails.
+    zx_handle_t owner_handle = static_cast<zx_handle_t>(current_value & ~ZX_FUTEX_PI_WAITERS);
+    if (owner_handle == ZX_HANDLE_INVALID)
+        return ZX_ERR_INVALID_ARGS;
+
+    ProcessDispatcher* up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<ThreadDispatcher> owner;
+    zx_status_t result = up->GetDispatcher(owner_handle, &owner);
+    if (result != ZX_OK)
+        return result;
+
+    // Waiting on a futex we own would never return, and only threads that
+    // share the address space can own it.
+    ThreadDispatcher* thread = ThreadDispatcher::GetCurrent();
+    if (owner.get() == thread || owner->process() != up)
+        return ZX_ERR_INVALID_ARGS;
+
+    FutexNode* node = thread->futex_node();
+
+    // As in FutexWait(), checking the value and blocking must together be
+    // atomic with respect to FutexWakePi().
+    lock_.Acquire();
+
+    int value;
+    result = value_ptr.copy_from_user(&value);
+    if (result != ZX_OK) {
+        lock_.Release();
+        return result;
+    }
+    if (value != current_value) {
+        lock_.Release();
+        return ZX_ERR_BAD_STATE;
+    }
+
+    node->set_hash_key(futex_key);
+    node->SetAsSingletonList();
+    QueueNodesLocked(node);
+
+    // The value names the thread that owns the futex now, which need not be
+    // the one the other waiters lend their priority to: a thread may have
+    // taken the futex without waiting after the last FutexWakePi().
+    ThreadDispatcher* owner_ptr = owner.get();
+    FutexNode* head = futex_table_.find(futex_key).CopyPointer();
+    DEBUG_ASSERT(head != nullptr);
+    RetargetPiWaitersLocked(head, owner_ptr);
+
+    // Lend our priority to the owner.  The owner's boost is normally
+    // computed from the waiters blocked on their wait queues, and we are not
+    // blocked yet, so account for the current thread explicitly.  There is
+    // no need to reschedule, since we are about to block.
+    node->SetPiOwner(thread, fbl::move(owner));
+    owner_ptr->InheritFutexPriority(fbl::max(get_current_thread()->effec_priority,
+                                             owner_ptr->futex_node()->MaxPiWaiterPriority()));
+
+    // Block current thread.  This releases lock_ and does not reacquire it.
+    result = node->BlockThread(&lock_, deadline);
+
+    // Unlike FutexWait(), the lock is needed on every path, to stop lending
+    // our priority to the owner.  If FutexWakePi() woke us, it has already
+    // done that.
+    fbl::RefPtr<ThreadDispatcher> old_owner;
+    bool resched = false;
+    {
+        AutoLock lock(&lock_);
+        old_owner = node->TakePiOwner();
+        if (old_owner)
+            resched = UpdatePiPriorityLocked(old_owner.get());
+
+        // As in FutexWait(), a wakeup that raced with a timeout counts as a
+        // wakeup.
+        if (result != ZX_OK && !UnqueueNodeLocked(node))
+            result = ZX_OK;
+    }
+    DEBUG_ASSERT(!node->IsInQueue());
+
+    // Drop the references to former owners without holding lock_, in case
+    // they are the last ones.
+    old_owner.reset();
+    ReleasePiOwners();
+    if (resched)
+        thread_reschedule();
+
+    return result;
+}
+
+zx_status_t FutexContext::FutexWakePi(user_in_ptr<const int> value_ptr) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    ThreadDispatcher* thread = ThreadDispatcher::GetCurrent();
+
+    AutoLock lock(&lock_);
+
+    FutexNode* head = futex_table_.erase(futex_key);
+    if (!head) {
+        // nothing blocked on this futex if we can't find it
+        return ZX_OK;
+    }
+    DEBUG_ASSERT(head->GetKey() == futex_key);
+
+    // Wake the highest priority waiter.  It normally claims the futex next,
+    // so all the other waiters now lend it their priority, whoever they
+    // lent it to before.  Waiters that got here through FutexRequeue()
+    // rather than FutexWaitPi() have no owner, and do not lend their
+    // priority to anyone.
+    FutexNode* woken = FutexNode::FindHighestPriority(head);
+    ThreadDispatcher* new_owner = woken->pi_thread();
+
+    // The woken waiter stops lending its priority now, rather than when it
+    // runs.  Its owner is normally the current thread.
+    fbl::RefPtr<ThreadDispatcher> old_owner = woken->TakePiOwner();
+
+    bool any_woken = false;
+    head = FutexNode::WakeNode(head, woken, &any_woken);
+
+    bool resched = false;
+    if (head) {
+        resched |= RetargetPiWaitersLocked(head, new_owner);
+        DEBUG_ASSERT(head->GetKey() == futex_key);
+        futex_table_.insert(head);
+    }
+
+    resched |= UpdatePiPriorityLocked(thread);
+    if (new_owner)
+        resched |= UpdatePiPriorityLocked(new_owner);
+    if (old_owner && old_owner.get() != thread) {
+        resched |= UpdatePiPriorityLocked(old_owner.get());
+        DeferPiOwnerReleaseLocked(fbl::move(old_owner));
+    }
+
+    // Drop references without holding lock_, in case they are the last ones.
+    lock.release();
+    old_owner.reset();
+    ReleasePiOwners();
+
+    if (any_woken || resched)
+        thread_reschedule();
+
+    return ZX_OK;
+}
+
+bool FutexContext::UpdatePiPriorityLocked(ThreadDispatcher* thread) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    return thread->InheritFutexPriority(thread->futex_node()->MaxPiWaiterPriority());
+}
+
+bool FutexContext::RetargetPiWaitersLocked(FutexNode* head, ThreadDispatcher* owner) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    bool resched = false;
+    FutexNode::ForEach(head, [this, owner, &resched](FutexNode* node) {
+        ThreadDispatcher* waiter = node->pi_thread();
+        if (waiter == nullptr || node->pi_owner() == owner)
+            return;
+        fbl::RefPtr<ThreadDispatcher> old_owner = node->TakePiOwner();
+        // A thread never lends its priority to itself.
+        if (owner != nullptr && owner != waiter)
+            node->SetPiOwner(waiter, fbl::WrapRefPtr(owner));
+        resched |= UpdatePiPriorityLocked(old_owner.get());
+        DeferPiOwnerReleaseLocked(fbl::move(old_owner));
+    });
+    return resched;
+}
+
+void FutexContext::DeferPiOwnerReleaseLocked(fbl::RefPtr<ThreadDispatcher> owner) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // If the owner is queued already, the queued reference keeps it alive,
+    // so this one is dropped here, and is not the last.
+    FutexNode* node = owner->futex_node();
+    if (node->pi_release_queued())
+        return;
+    node->QueuePiRelease(fbl::move(pi_release_head_));
+    pi_release_head_ = fbl::move(owner);
+}
+
+void FutexContext::ReleasePiOwners() {
+    // Take the references one at a time, so that each is dropped without
+    // lock_ held.
+    for (;;) {
+        fbl::RefPtr<ThreadDispatcher> owner;
+        {
+            AutoLock lock(&lock_);
+            if (!pi_release_head_)
+                return;
+            owner = fbl::move(pi_release_head_);
+            pi_release_head_ = owner->futex_node()->TakePiReleaseNext();
+        }
+    }
+}
+
 void FutexContext::QueueNodesLocked(FutexNode* head) {
     DEBUG_ASSERT(lock_.IsHeld());
 
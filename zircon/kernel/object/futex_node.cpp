@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/mutex.h>
+#include <object/thread_dispatcher.h>
 #include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
@@ -25,6 +26,9 @@ FutexNode::~FutexNode() {
     LTRACE_ENTRY;
 
     DEBUG_ASSERT(!IsInQueue());
+    DEBUG_ASSERT(!pi_owner_);
+    DEBUG_ASSERT(pi_waiters_.is_empty());
+    DEBUG_ASSERT(!pi_release_queued_);
 
     wait_queue_destroy(&wait_queue_);
 }
@@ -146,6 +150,36 @@ FutexNode* FutexNode::RemoveFromHead(FutexNode* list_head, uint32_t count,
     return node;
 }
 
+FutexNode* FutexNode::WakeNode(FutexNode* list_head, FutexNode* node,
+                               bool* out_any_woken) {
+    list_head = RemoveNodeFromList(list_head, node);
+    node->set_hash_key(0);
+    // This call can cause |node| to be freed, so we must not dereference
+    // |node| after this.
+    if (node->WakeThread())
+        *out_any_woken = true;
+    return list_head;
+}
+
+FutexNode* FutexNode::FindHighestPriority(FutexNode* list_head) {
+    ASSERT(list_head);
+
+    // Every thread in the list is blocked on its node's wait queue, unless
+    // it has timed out and is waiting for the FutexContext lock, in which
+    // case the wait queue is empty and reports -1.
+    AutoThreadLock lock;
+    FutexNode* best = list_head;
+    int best_priority = wait_queue_blocked_priority(&list_head->wait_queue_);
+    for (FutexNode* node = list_head->queue_next_; node != list_head; node = node->queue_next_) {
+        int priority = wait_queue_blocked_priority(&node->wait_queue_);
+        if (priority > best_priority) {
+            best = node;
+            best_priority = priority;
+        }
+    }
+    return best;
+}
+
 // This blocks the current thread.  This releases the given mutex (which
 // must be held when BlockThread() is called).  To reduce contention, it
 // does not reclaim the mutex on return.
@@ -221,3 +255,44 @@ void FutexNode::MarkAsNotInQueue() {
     // only required by the assertion in IsInQueue().
     queue_prev_ = nullptr;
 }
+
+void FutexNode::SetPiOwner(ThreadDispatcher* thread, fbl::RefPtr<ThreadDispatcher> owner) {
+    DEBUG_ASSERT(!pi_owner_);
+    DEBUG_ASSERT(owner);
+
+    pi_thread_ = thread;
+    owner->futex_node()->pi_waiters_.push_back(this);
+    pi_owner_ = fbl::move(owner);
+}
+
+fbl::RefPtr<ThreadDispatcher> FutexNode::TakePiOwner() {
+    if (pi_owner_)
+        pi_owner_->futex_node()->pi_waiters_.erase(*this);
+    pi_thread_ = nullptr;
+    return fbl::move(pi_owner_);
+}
+
+void FutexNode::QueuePiRelease(fbl::RefPtr<ThreadDispatcher> next) {
+    DEBUG_ASSERT(!pi_release_queued_);
+
+    pi_release_next_ = fbl::move(next);
+    pi_release_queued_ = true;
+}
+
+fbl::RefPtr<ThreadDispatcher> FutexNode::TakePiReleaseNext() {
+    DEBUG_ASSERT(pi_release_queued_);
+
+    pi_release_queued_ = false;
+    return fbl::move(pi_release_next_);
+}
+
+int FutexNode::MaxPiWaiterPriority() {
+    int priority = -1;
+    AutoThreadLock lock;
+    for (auto& waiter : pi_waiters_) {
+        int waiter_priority = wait_queue_blocked_priority(&waiter.wait_queue_);
+        if (waiter_priority > priority)
+            priority = waiter_priority;
+    }
+    return priority;
+}
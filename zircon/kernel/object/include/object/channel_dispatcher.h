@@ -39,11 +39,13 @@ public:
     // |msg_size| and |msg_handle_count| are in-out parameters. As input, they specify the maximum
     // size and handle count, respectively. On ZX_OK or ZX_ERR_BUFFER_TOO_SMALL, they specify the
     // actual size and handle count of the next message. The next message is returned in |*msg| on
-    // ZX_OK and also on ZX_ERR_BUFFER_TOO_SMALL when |may_discard| is set.
+    // ZX_OK and also on ZX_ERR_BUFFER_TOO_SMALL when |may_discard| is set, unless it carries
+    // handles and |may_discard_handles| is not set.
     zx_status_t Read(uint32_t* msg_size,
                      uint32_t* msg_handle_count,
                      fbl::unique_ptr<MessagePacket>* msg,
-                     bool may_disard);
+                     bool may_disard,
+                     bool may_discard_handles = true);
 
     // Write to the opposing endpoint's message queue.
     zx_status_t Write(fbl::unique_ptr<MessagePacket> msg);
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdint.h>
 
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_single_list.h>
@@ -157,7 +158,7 @@ protected:
 
     zx_signals_t GetSignalsState() const {
         ZX_DEBUG_ASSERT(has_state_tracker());
-        return signals_;
+        return static_cast<zx_signals_t>(signal_state_.load(fbl::memory_order_acquire));
     }
 
     // Dispatcher subtypes should use this lock to protect their internal state.
@@ -180,17 +181,22 @@ private:
     // Returns flag kHandled if one of the observers have been signaled.
     StateObserver::Flags UpdateInternalLocked(ObserverList* obs_to_remove, zx_signals_t signals) TA_REQ(lock_);
 
+    // Clears kHasObservers in |signal_state_| once |observers_| is empty.
+    void UpdateHasObserversLocked() TA_REQ(lock_);
+
+    // Set in |signal_state_| while |observers_| may be non-empty. It lives in
+    // the same word as the signals so that an observer being added and a
+    // lock-free signal update are totally ordered.
+    static constexpr uint64_t kHasObservers = 1ull << 32;
+
     const zx_koid_t koid_;
     uint32_t handle_count_;
 
-    // TODO(kulakowski) Make signals_ TA_GUARDED(lock_).
-    // Right now, signals_ is almost entirely accessed under the
-    // common dispatcher lock_. Once we migrate the per-object locks
-    // to instead use the common dispatcher lock_, all of the unlocked
-    // accesses (all of which go via GetSignalsState) will be
-    // statically under this lock_, rather than maybe under this lock
-    // or the more specific object lock.
-    zx_signals_t signals_;
+    // The low 32 bits are the asserted signals; see kHasObservers for the
+    // rest. kHasObservers is only set or cleared under |lock_|. While it is
+    // clear, UpdateState changes the signals with a single compare-and-swap
+    // and does not take |lock_|.
+    fbl::atomic<uint64_t> signal_state_;
 
     // Active observers are elements in |observers_|.
     ObserverList observers_ TA_GUARDED(lock_);
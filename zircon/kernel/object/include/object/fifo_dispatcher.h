@@ -10,11 +10,14 @@
 
 #include <object/dispatcher.h>
 
+#include <zircon/syscalls/fifo.h>
 #include <zircon/types.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <lib/user_copy/user_ptr.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_object.h>
 
 class FifoDispatcher final : public Dispatcher {
 public:
@@ -34,13 +37,31 @@ public:
     zx_status_t WriteFromUser(user_in_ptr<const uint8_t> src, size_t len, uint32_t* actual);
     zx_status_t ReadToUser(user_out_ptr<uint8_t> dst, size_t len, uint32_t* actual);
 
+    // Returns the VMO backing a ZX_FIFO_SHARED_RING fifo.
+    zx_status_t GetRing(fbl::RefPtr<VmObject>* vmo, zx_fifo_ring_info_t* info);
+
 private:
     FifoDispatcher(uint32_t options, uint32_t elem_count, uint32_t elem_size,
                    fbl::unique_ptr<uint8_t[]> data);
+    FifoDispatcher(uint32_t options, uint32_t elem_count, uint32_t elem_size,
+                   fbl::RefPtr<VmObject> ring_vmo, uint64_t ring_offset,
+                   uint64_t peer_ring_offset);
     void Init(fbl::RefPtr<FifoDispatcher> other);
+    zx_status_t MapRing();
     zx_status_t WriteSelf(user_in_ptr<const uint8_t> ptr, size_t len, uint32_t* actual);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
 
+    // The ring indices. For a shared ring they live in the ring header,
+    // where userspace may change them at any time.
+    uint32_t LoadHeadLocked() const TA_REQ(lock_);
+    uint32_t LoadTailLocked() const TA_REQ(lock_);
+    void StoreHeadLocked(uint32_t head) TA_REQ(lock_);
+    void StoreTailLocked(uint32_t tail) TA_REQ(lock_);
+
+    // Recomputes READABLE on this end and WRITABLE on the peer from the
+    // indices of a shared ring.
+    void SyncSharedRingLocked() TA_REQ(lock_);
+
     void OnPeerZeroHandles();
 
     fbl::Canary<fbl::magic("FIFO")> canary_;
@@ -55,5 +76,15 @@ private:
     uint32_t tail_ TA_GUARDED(lock_);
     fbl::unique_ptr<uint8_t[]> data_ TA_GUARDED(lock_);
 
+    // For ZX_FIFO_SHARED_RING, |ring_vmo_| holds the rings of both ends. The
+    // ring this end reads from is mapped into the kernel at |ring_|, and
+    // |entries_| points at its entries, or at |data_| otherwise.
+    fbl::RefPtr<VmObject> ring_vmo_;
+    const uint64_t ring_offset_;
+    const uint64_t peer_ring_offset_;
+    fbl::RefPtr<VmMapping> ring_mapping_;
+    zx_fifo_ring_t* ring_;
+    uint8_t* entries_;
+
     static constexpr uint32_t kMaxSizeBytes = PAGE_SIZE;
 };
@@ -47,6 +47,20 @@ public:
     zx_status_t FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
                              user_in_ptr<const int> requeue_ptr, uint32_t requeue_count);
 
+    // FutexWaitPi is FutexWait for priority inheritance futexes, whose value
+    // is the handle of the thread that owns them, possibly with
+    // ZX_FUTEX_PI_WAITERS set.  While the current thread is blocked, the
+    // owner named by |current_value| runs with at least its priority.
+    zx_status_t FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                            zx_time_t deadline);
+
+    // FutexWakePi is called by the owner of a priority inheritance futex
+    // after releasing it.  It wakes the highest priority thread blocked on
+    // |value_ptr|, and the remaining waiters lend their priority to that
+    // thread, which is expected to take the futex next, instead of the
+    // current thread.
+    zx_status_t FutexWakePi(user_in_ptr<const int> value_ptr);
+
 private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
@@ -55,10 +69,35 @@ private:
 
     bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
 
+    // Recomputes the priority |thread| inherits from its priority
+    // inheritance waiters.  Returns true if the caller should reschedule.
+    bool UpdatePiPriorityLocked(ThreadDispatcher* thread) TA_REQ(lock_);
+
+    // Makes the priority inheritance waiters in the queue starting at |head|
+    // lend their priority to |owner|, or to nobody if it is null, whichever
+    // thread they lent it to before.  The owner is resolved again each time
+    // the futex is waited on or woken, since a thread may have taken it
+    // without waiting.  Updates the priority of the threads the waiters stop
+    // lending to, and returns true if the caller should reschedule.  It does
+    // not update |owner|'s priority.
+    bool RetargetPiWaitersLocked(FutexNode* head, ThreadDispatcher* owner) TA_REQ(lock_);
+
+    // Queues a reference to a former owner to be dropped by ReleasePiOwners(),
+    // since dropping the last one destroys the thread, which cannot be done
+    // with lock_ held.
+    void DeferPiOwnerReleaseLocked(fbl::RefPtr<ThreadDispatcher> owner) TA_REQ(lock_);
+
+    // Drops the references queued by DeferPiOwnerReleaseLocked().
+    void ReleasePiOwners() TA_EXCL(lock_);
+
     // protects futex_table_
     fbl::Mutex lock_;
 
     // Hash table for futexes in this context.
     // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
     FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+
+    // Former owners of priority inheritance futexes, linked through their
+    // FutexNodes, whose references are waiting to be dropped.
+    fbl::RefPtr<ThreadDispatcher> pi_release_head_ TA_GUARDED(lock_);
 };
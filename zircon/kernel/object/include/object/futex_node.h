@@ -10,8 +10,12 @@
 #include <kernel/wait.h>
 #include <list.h>
 #include <zircon/types.h>
+#include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+
+class ThreadDispatcher;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
@@ -19,6 +23,14 @@ class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
     using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
 
+    // Traits to belong in the owner's list of priority inheritance waiters.
+    struct PiWaiterListTraits {
+        static fbl::DoublyLinkedListNodeState<FutexNode*>& node_state(FutexNode& node) {
+            return node.pi_waiter_node_;
+        }
+    };
+    using PiWaiterList = fbl::DoublyLinkedList<FutexNode*, PiWaiterListTraits>;
+
     FutexNode();
     ~FutexNode();
 
@@ -41,9 +53,55 @@ public:
                                      uintptr_t old_hash_key,
                                      uintptr_t new_hash_key);
 
+    // Removes |node| from the list |list_head| and wakes its thread.  Returns
+    // the new list head, which may be null.
+    static FutexNode* WakeNode(FutexNode* list_head, FutexNode* node,
+                               bool* out_any_woken);
+
+    // Returns the node in the list |list_head| whose thread has the highest
+    // priority.  Of nodes with equal priority, the one queued first wins.
+    static FutexNode* FindHighestPriority(FutexNode* list_head);
+
+    // Calls |func| on each node in the list |list_head|.
+    template <typename Func>
+    static void ForEach(FutexNode* list_head, Func func) {
+        FutexNode* node = list_head;
+        do {
+            FutexNode* next = node->queue_next_;
+            func(node);
+            node = next;
+        } while (node != list_head);
+    }
+
     // This must be called with |mutex| held and returns without |mutex| held.
     zx_status_t BlockThread(fbl::Mutex* mutex, zx_time_t deadline) TA_REL(mutex);
 
+    // Priority inheritance.  These are only called with the FutexContext lock
+    // held.  A node has an owner only while its thread is blocked in
+    // FutexContext::FutexWaitPi(), and lends that thread's priority to it.
+
+    // Sets the thread that owns the futex this node's |thread| waits on.
+    void SetPiOwner(ThreadDispatcher* thread, fbl::RefPtr<ThreadDispatcher> owner);
+
+    // Stops lending priority to the owner, and returns it.  The caller
+    // should drop the reference without the FutexContext lock held.
+    fbl::RefPtr<ThreadDispatcher> TakePiOwner();
+
+    ThreadDispatcher* pi_thread() const { return pi_thread_; }
+    ThreadDispatcher* pi_owner() const { return pi_owner_.get(); }
+
+    // Returns the highest priority among the threads lending their priority
+    // to this node's thread, or -1 if there are none.
+    int MaxPiWaiterPriority();
+
+    // Links this node's thread into FutexContext's list of owners whose
+    // references are dropped once its lock is released.  |next| is the
+    // rest of the list.
+    void QueuePiRelease(fbl::RefPtr<ThreadDispatcher> next);
+    // Unlinks this node's thread from that list, and returns the rest of it.
+    fbl::RefPtr<ThreadDispatcher> TakePiReleaseNext();
+    bool pi_release_queued() const { return pi_release_queued_; }
+
     void set_hash_key(uintptr_t key) {
         hash_key_ = key;
     }
@@ -78,4 +136,17 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // The thread this node belongs to, and the thread it lends its priority
+    // to, while it waits in FutexWaitPi().
+    ThreadDispatcher* pi_thread_ = nullptr;
+    fbl::RefPtr<ThreadDispatcher> pi_owner_;
+    fbl::DoublyLinkedListNodeState<FutexNode*> pi_waiter_node_;
+
+    // The nodes of the threads lending their priority to this node's thread.
+    PiWaiterList pi_waiters_;
+
+    // The next owner in FutexContext's list of references to drop.
+    fbl::RefPtr<ThreadDispatcher> pi_release_next_;
+    bool pi_release_queued_ = false;
 };
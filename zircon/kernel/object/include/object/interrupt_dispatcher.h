@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <kernel/event.h>
 #include <zircon/types.h>
 #include <fbl/atomic.h>
@@ -31,11 +32,18 @@ public:
     zx_status_t WaitForInterrupt(uint64_t* out_slots);
     zx_status_t GetTimeStamp(uint32_t slot, zx_time_t* out_timestamp);
 
+    // Steer the hardware interrupts bound to this dispatcher, and any bound
+    // later, to |cpu|.
+    zx_status_t SetAffinity(cpu_num_t cpu);
+    // Returns INVALID_CPU if no affinity has been set.
+    cpu_num_t GetAffinity();
+
 protected:
     virtual void MaskInterrupt(uint32_t vector) = 0;
     virtual void UnmaskInterrupt(uint32_t vector) = 0;
     virtual zx_status_t RegisterInterruptHandler(uint32_t vector, void* data) = 0;
     virtual void UnregisterInterruptHandler(uint32_t vector) = 0;
+    virtual zx_status_t SetInterruptAffinity(uint32_t vector, cpu_num_t cpu) = 0;
 
     zx_status_t AddSlot(uint32_t slot, uint32_t vector, uint32_t flags) TA_REQ(lock_);
 
@@ -71,6 +79,9 @@ private:
     // interrupts bound to this dispatcher
     fbl::Vector<Interrupt> interrupts_;
 
+    // cpu the hardware interrupts are steered to, or INVALID_CPU
+    cpu_num_t affinity_ TA_GUARDED(lock_) = INVALID_CPU;
+
     // slot to interrupts_ index map
     uint8_t slot_map_[ZX_INTERRUPT_MAX_SLOTS + 1];
 
@@ -108,6 +108,12 @@ public:
     ProcessDispatcher* process() const { return process_.get(); }
 
     FutexNode* futex_node() { return &futex_node_; }
+
+    // Sets the priority this thread inherits from threads blocked on
+    // priority inheritance futexes that it owns, or removes it if negative.
+    // Returns true if the caller should reschedule.
+    bool InheritFutexPriority(int priority);
+
     zx_status_t set_name(const char* name, size_t len) final;
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final;
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
@@ -213,7 +219,7 @@ private:
         EVENT_INITIAL_VALUE(exception_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
 
     // cleanup dpc structure
-    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr};
+    dpc_t cleanup_dpc_ = {0, nullptr, nullptr};
 
     // Used to protect thread name read/writes
     mutable SpinLock name_lock_;
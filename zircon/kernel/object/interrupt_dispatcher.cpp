@@ -7,6 +7,8 @@
 #include <object/interrupt_dispatcher.h>
 
 #include <fbl/auto_lock.h>
+#include <kernel/mp.h>
+#include <platform.h>
 
 InterruptDispatcher::InterruptDispatcher() : signals_(0) {
     event_init(&event_, false, EVENT_FLAG_AUTOUNSIGNAL);
@@ -45,6 +47,15 @@ zx_status_t InterruptDispatcher::AddSlot(uint32_t slot, uint32_t vector, uint32_
             interrupts_.erase(index);
             return status;
         }
+
+        if (affinity_ != INVALID_CPU) {
+            status = SetInterruptAffinity(vector, affinity_);
+            if (status != ZX_OK) {
+                UnregisterInterruptHandler(vector);
+                interrupts_.erase(index);
+                return status;
+            }
+        }
     }
 
     slot_map_[slot] = static_cast<uint8_t>(index);
@@ -103,6 +114,38 @@ zx_status_t InterruptDispatcher::GetTimeStamp(uint32_t slot, zx_time_t* out_time
     }
 }
 
+zx_status_t InterruptDispatcher::SetAffinity(cpu_num_t cpu) {
+    if (!is_valid_cpu_num(cpu) || !mp_is_cpu_online(cpu))
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock lock(&lock_);
+
+    // If a vector can't be moved, put back the ones already moved so that a
+    // failed call leaves all of them where they were. Until an affinity is set
+    // the platform delivers interrupts to the boot cpu.
+    const cpu_num_t previous = (affinity_ != INVALID_CPU) ? affinity_ : BOOT_CPU_ID;
+    for (size_t i = 0; i < interrupts_.size(); i++) {
+        if (interrupts_[i].flags & INTERRUPT_VIRTUAL)
+            continue;
+        zx_status_t status = SetInterruptAffinity(interrupts_[i].vector, cpu);
+        if (status != ZX_OK) {
+            while (i-- > 0) {
+                if (!(interrupts_[i].flags & INTERRUPT_VIRTUAL))
+                    SetInterruptAffinity(interrupts_[i].vector, previous);
+            }
+            return status;
+        }
+    }
+
+    affinity_ = cpu;
+    return ZX_OK;
+}
+
+cpu_num_t InterruptDispatcher::GetAffinity() {
+    fbl::AutoLock lock(&lock_);
+    return affinity_;
+}
+
 zx_status_t InterruptDispatcher::UserSignal(uint32_t slot, zx_time_t timestamp) {
     if (slot > ZX_INTERRUPT_MAX_SLOTS)
         return ZX_ERR_INVALID_ARGS;
@@ -117,4 +117,8 @@ void PciInterruptDispatcher::UnregisterInterruptHandler(uint32_t vector) {
     device_->RegisterIrqHandler(vector, nullptr, nullptr);
 }
 
+zx_status_t PciInterruptDispatcher::SetInterruptAffinity(uint32_t vector, cpu_num_t cpu) {
+    return device_->SetIrqAffinity(vector, cpu);
+}
+
 #endif  // if WITH_DEV_PCIE
@@ -30,6 +30,12 @@ public:
         Cancel(/* handle= */ nullptr);
         CancelByKey(/* handle= */ nullptr, /* port= */ nullptr, /* key= */ 2u);
     }
+
+    // Helpers: Expose the signal state.
+    void CallUpdateState(zx_signals_t clear_mask, zx_signals_t set_mask) {
+        UpdateState(clear_mask, set_mask);
+    }
+    zx_signals_t signals() const { return GetSignalsState(); }
 };
 
 } // namespace
@@ -181,6 +187,84 @@ bool on_cancel_by_key(void* context) {
 
 } // namespace removal
 
+// Tests for signal updates with and without observers
+namespace signals {
+
+class RecordingObserver : public StateObserver {
+public:
+    RecordingObserver() = default;
+
+    zx_signals_t initial() const { return initial_; }
+    zx_signals_t last() const { return last_; }
+    int changes() const { return changes_; }
+
+private:
+    Flags OnInitialize(zx_signals_t initial_state,
+                       const StateObserver::CountInfo* cinfo) override {
+        initial_ = initial_state;
+        return 0;
+    }
+    Flags OnStateChange(zx_signals_t new_state) override {
+        last_ = new_state;
+        changes_++;
+        return 0;
+    }
+    Flags OnCancel(const Handle* handle) override { return 0; }
+    Flags OnCancelByKey(const Handle* handle, const void* port, uint64_t key)
+        override { return 0; }
+
+    zx_signals_t initial_ = 0;
+    zx_signals_t last_ = 0;
+    int changes_ = 0;
+};
+
+bool update_without_observers(void* context) {
+    BEGIN_TEST;
+
+    TestDispatcher st;
+    st.CallUpdateState(0, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1);
+    EXPECT_EQ(ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1, st.signals(), "");
+    st.CallUpdateState(ZX_USER_SIGNAL_0, 0);
+    EXPECT_EQ(ZX_USER_SIGNAL_1, st.signals(), "");
+
+    // All 32 bits are signals; none of them may leak into other state.
+    st.CallUpdateState(0, ~0u);
+    EXPECT_EQ(~0u, st.signals(), "");
+    st.CallUpdateState(~0u, 0);
+    EXPECT_EQ(0u, st.signals(), "");
+
+    END_TEST;
+}
+
+bool observer_sees_lock_free_updates(void* context) {
+    BEGIN_TEST;
+
+    TestDispatcher st;
+    st.CallUpdateState(0, ZX_USER_SIGNAL_0);
+
+    RecordingObserver obs;
+    st.AddObserver(&obs, nullptr);
+    EXPECT_EQ(ZX_USER_SIGNAL_0, obs.initial(), "");
+
+    st.CallUpdateState(0, ZX_USER_SIGNAL_2);
+    EXPECT_EQ(1, obs.changes(), "");
+    EXPECT_EQ(ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_2, obs.last(), "");
+
+    // A no-op update is not reported.
+    st.CallUpdateState(0, ZX_USER_SIGNAL_2);
+    EXPECT_EQ(1, obs.changes(), "");
+
+    // Once the observer is gone, updates are no longer delivered to it.
+    st.RemoveObserver(&obs);
+    st.CallUpdateState(ZX_USER_SIGNAL_0, 0);
+    EXPECT_EQ(1, obs.changes(), "");
+    EXPECT_EQ(ZX_USER_SIGNAL_2, st.signals(), "");
+
+    END_TEST;
+}
+
+} // namespace signals
+
 #define ST_UNITTEST(fname) UNITTEST(#fname, fname)
 
 UNITTEST_START_TESTCASE(state_tracker_tests)
@@ -189,6 +273,8 @@ ST_UNITTEST(removal::on_initialize)
 ST_UNITTEST(removal::on_state_change_via_update_state)
 ST_UNITTEST(removal::on_cancel)
 ST_UNITTEST(removal::on_cancel_by_key)
+ST_UNITTEST(signals::update_without_observers)
+ST_UNITTEST(signals::observer_sees_lock_free_updates)
 
 UNITTEST_END_TESTCASE(
     state_tracker_tests, "statetracker", "StateTracker test", nullptr, nullptr);
@@ -16,6 +16,7 @@
 #include <arch/debugger.h>
 #include <arch/exception.h>
 
+#include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
@@ -241,6 +242,15 @@ zx_status_t ThreadDispatcher::Initialize(const char* name, size_t len) {
     return ZX_OK;
 }
 
+bool ThreadDispatcher::InheritFutexPriority(int priority) {
+    canary_.Assert();
+
+    AutoThreadLock lock;
+    bool local_resched = false;
+    sched_inheirit_futex_priority(&thread_, priority, &local_resched);
+    return local_resched;
+}
+
 zx_status_t ThreadDispatcher::set_name(const char* name, size_t len) {
     canary_.Assert();
 
@@ -855,6 +865,11 @@ zx_status_t ThreadDispatcher::GetInfoForUserspace(zx_info_thread_t* info) {
         break;
     }
 
+    {
+        AutoThreadLock lock;
+        info->effective_priority = thread_.effec_priority;
+    }
+
     return ZX_OK;
 }
 
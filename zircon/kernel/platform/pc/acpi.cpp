@@ -272,6 +272,155 @@ zx_status_t platform_enumerate_interrupt_source_overrides(
     return ZX_OK;
 }
 
+static zx_status_t acpi_get_srat_record_limits(uintptr_t* start, uintptr_t* end) {
+    ACPI_TABLE_HEADER* table = NULL;
+    ACPI_STATUS status = AcpiGetTable((char*)ACPI_SIG_SRAT, 1, &table);
+    if (status != AE_OK) {
+        LTRACEF("could not find SRAT\n");
+        return ZX_ERR_NOT_FOUND;
+    }
+    ACPI_TABLE_SRAT* srat = (ACPI_TABLE_SRAT*)table;
+    uintptr_t records_start = ((uintptr_t)srat) + sizeof(*srat);
+    uintptr_t records_end = ((uintptr_t)srat) + srat->Header.Length;
+    if (records_start > records_end) {
+        TRACEF("SRAT wraps around address space\n");
+        return ZX_ERR_INTERNAL;
+    }
+    *start = records_start;
+    *end = records_end;
+    return ZX_OK;
+}
+
+/* @brief Enumerate the NUMA node of every enabled CPU
+ *
+ * If cpus is NULL, just returns the number of entries via num_cpus.
+ *
+ * @param cpus Array to populate affinities into.
+ * @param len Length of cpus.
+ * @param num_cpus Number of entries found.
+ *
+ * @return ZX_OK on success, ZX_ERR_NOT_FOUND if there is no SRAT. Note that
+ *         if len < *num_cpus, not all entries will be returned.
+ */
+zx_status_t platform_enumerate_cpu_affinity(
+    struct acpi_cpu_affinity* cpus,
+    uint32_t len,
+    uint32_t* num_cpus) {
+    if (num_cpus == NULL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    uintptr_t records_start, records_end;
+    zx_status_t status = acpi_get_srat_record_limits(&records_start, &records_end);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    uint32_t count = 0;
+    uintptr_t addr;
+    for (addr = records_start; addr < records_end;) {
+        ACPI_SUBTABLE_HEADER* record_hdr = (ACPI_SUBTABLE_HEADER*)addr;
+        if (record_hdr->Length == 0) {
+            break;
+        }
+        switch (record_hdr->Type) {
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            ACPI_SRAT_CPU_AFFINITY* cpu = (ACPI_SRAT_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED)) {
+                break;
+            }
+            if (cpus != NULL && count < len) {
+                cpus[count].apic_id = cpu->ApicId;
+                cpus[count].node = cpu->ProximityDomainLo |
+                                   (uint32_t)cpu->ProximityDomainHi[0] << 8 |
+                                   (uint32_t)cpu->ProximityDomainHi[1] << 16 |
+                                   (uint32_t)cpu->ProximityDomainHi[2] << 24;
+            }
+            count++;
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            ACPI_SRAT_X2APIC_CPU_AFFINITY* cpu = (ACPI_SRAT_X2APIC_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED)) {
+                break;
+            }
+            if (cpus != NULL && count < len) {
+                cpus[count].apic_id = cpu->ApicId;
+                cpus[count].node = cpu->ProximityDomain;
+            }
+            count++;
+            break;
+        }
+        }
+
+        addr += record_hdr->Length;
+    }
+    if (addr != records_end) {
+        TRACEF("malformed SRAT\n");
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *num_cpus = count;
+    return ZX_OK;
+}
+
+/* @brief Enumerate the NUMA node of every enabled memory range
+ *
+ * If ranges is NULL, just returns the number of ranges via num_ranges.
+ *
+ * @param ranges Array to populate affinities into.
+ * @param len Length of ranges.
+ * @param num_ranges Number of ranges found.
+ *
+ * @return ZX_OK on success, ZX_ERR_NOT_FOUND if there is no SRAT. Note that
+ *         if len < *num_ranges, not all ranges will be returned.
+ */
+zx_status_t platform_enumerate_memory_affinity(
+    struct acpi_memory_affinity* ranges,
+    uint32_t len,
+    uint32_t* num_ranges) {
+    if (num_ranges == NULL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    uintptr_t records_start, records_end;
+    zx_status_t status = acpi_get_srat_record_limits(&records_start, &records_end);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    uint32_t count = 0;
+    uintptr_t addr;
+    for (addr = records_start; addr < records_end;) {
+        ACPI_SUBTABLE_HEADER* record_hdr = (ACPI_SUBTABLE_HEADER*)addr;
+        if (record_hdr->Length == 0) {
+            break;
+        }
+        switch (record_hdr->Type) {
+        case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+            ACPI_SRAT_MEM_AFFINITY* mem = (ACPI_SRAT_MEM_AFFINITY*)record_hdr;
+            if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED) || mem->Length == 0) {
+                break;
+            }
+            if (ranges != NULL && count < len) {
+                ranges[count].base = mem->BaseAddress;
+                ranges[count].size = mem->Length;
+                ranges[count].node = mem->ProximityDomain;
+            }
+            count++;
+            break;
+        }
+        }
+
+        addr += record_hdr->Length;
+    }
+    if (addr != records_end) {
+        TRACEF("malformed SRAT\n");
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *num_ranges = count;
+    return ZX_OK;
+}
+
 /* @brief Return information about the High Precision Event Timer, if present.
  *
  * @param hpet Descriptor to populate
@@ -21,6 +21,19 @@ struct acpi_hpet_descriptor {
     uint8_t sequence;
 };
 
+// NUMA node of a cpu, from the SRAT.
+struct acpi_cpu_affinity {
+    uint32_t apic_id;
+    uint32_t node;
+};
+
+// NUMA node of a physical memory range, from the SRAT.
+struct acpi_memory_affinity {
+    uint64_t base;
+    uint64_t size;
+    uint32_t node;
+};
+
 void platform_init_acpi_tables(uint levels);
 void platform_init_acpi(void);
 zx_status_t platform_enumerate_cpus(
@@ -35,6 +48,14 @@ zx_status_t platform_enumerate_interrupt_source_overrides(
     struct io_apic_isa_override* isos,
     uint32_t len,
     uint32_t* num_isos);
+zx_status_t platform_enumerate_cpu_affinity(
+    struct acpi_cpu_affinity* cpus,
+    uint32_t len,
+    uint32_t* num_cpus);
+zx_status_t platform_enumerate_memory_affinity(
+    struct acpi_memory_affinity* ranges,
+    uint32_t len,
+    uint32_t* num_ranges);
 zx_status_t platform_find_hpet(struct acpi_hpet_descriptor* hpet);
 
 __END_CDECLS
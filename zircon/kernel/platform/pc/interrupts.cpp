@@ -10,6 +10,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/interrupts.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <dev/interrupt.h>
@@ -247,6 +248,35 @@ zx_status_t register_int_handler(unsigned int vector, int_handler handler, void*
     return ZX_OK;
 }
 
+// Resolve the physical destination ID used to target |cpu| from an IO APIC
+// redirection entry or an MSI address.  Both formats only have room for an 8
+// bit ID; reaching cpus with larger (x2APIC) IDs would need interrupt
+// remapping.
+static zx_status_t x86_interrupt_dst_for_cpu(cpu_num_t cpu, uint8_t* out_dst) {
+    uint32_t apic_id = x86_cpu_num_to_apic_id(cpu);
+    if (apic_id == INVALID_APIC_ID)
+        return ZX_ERR_INVALID_ARGS;
+    if (apic_id > UINT8_MAX)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *out_dst = static_cast<uint8_t>(apic_id);
+    return ZX_OK;
+}
+
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if (!is_valid_interrupt(vector, 0))
+        return ZX_ERR_INVALID_ARGS;
+
+    uint8_t dst;
+    zx_status_t status = x86_interrupt_dst_for_cpu(cpu, &dst);
+    if (status != ZX_OK)
+        return status;
+
+    AutoSpinLock guard(&lock);
+    apic_io_configure_irq_dst(vector, DST_MODE_PHYSICAL, dst);
+    return ZX_OK;
+}
+
 bool is_valid_interrupt(unsigned int vector, uint32_t flags) {
     return apic_io_is_valid_irq(vector);
 }
@@ -263,6 +293,17 @@ void shutdown_interrupts(void) {
 }
 
 #ifdef WITH_DEV_PCIE
+// Compute the MSI target address which delivers to the local APIC with the
+// given ID.  See section 10.11.1 of the Intel 64 and IA-32 Architectures
+// Software Developer's Manual Volume 3A.
+static uint32_t x86_msi_tgt_addr(uint8_t dst_apic_id) {
+    uint32_t tgt_addr = 0xFEE00000;              // base addr
+    tgt_addr |= ((uint32_t)dst_apic_id) << 12;   // Dest ID
+    tgt_addr |= 0x08;                            // Redir hint == 1
+    tgt_addr &= ~0x04;                           // Dest Mode == Physical
+    return tgt_addr;
+}
+
 zx_status_t x86_alloc_msi_block(uint requested_irqs,
                                 bool can_target_64bit,
                                 bool is_msix,
@@ -282,19 +323,9 @@ zx_status_t x86_alloc_msi_block(uint requested_irqs,
 
     res = p2ra_allocate_range(&x86_irq_vector_allocator, alloc_size, &alloc_start);
     if (res == ZX_OK) {
-        // Compute the target address.
-        // See section 10.11.1 of the Intel 64 and IA-32 Architectures Software
-        // Developer's Manual Volume 3A.
-        //
-        // TODO(johngro) : don't just bind this block to the Local APIC of the
-        // processor which is active when calling alloc_msi_block.  Instead,
-        // there should either be a system policy (like, always send to any
-        // processor, or just processor 0, or something), or the decision of
-        // which CPUs to bind to should be left to the caller.
-        uint32_t tgt_addr = 0xFEE00000;              // base addr
-        tgt_addr |= ((uint32_t)apic_bsp_id()) << 12; // Dest ID == the BSP APIC ID
-        tgt_addr |= 0x08;                            // Redir hint == 1
-        tgt_addr &= ~0x04;                           // Dest Mode == Physical
+        // Target the BSP to start with.  Callers may move the block to
+        // another cpu later with x86_set_msi_affinity.
+        uint32_t tgt_addr = x86_msi_tgt_addr(apic_bsp_id());
 
         // Compute the target data.
         // See section 10.11.2 of the Intel 64 and IA-32 Architectures Software
@@ -326,6 +357,19 @@ void x86_free_msi_block(pcie_msi_block_t* block) {
     memset(block, 0, sizeof(*block));
 }
 
+zx_status_t x86_set_msi_affinity(pcie_msi_block_t* block, cpu_num_t cpu) {
+    DEBUG_ASSERT(block);
+    DEBUG_ASSERT(block->allocated);
+
+    uint8_t dst;
+    zx_status_t status = x86_interrupt_dst_for_cpu(cpu, &dst);
+    if (status != ZX_OK)
+        return status;
+
+    block->tgt_addr = x86_msi_tgt_addr(dst);
+    return ZX_OK;
+}
+
 void x86_register_msi_handler(const pcie_msi_block_t* block,
                               uint msi_id,
                               int_handler handler,
@@ -15,12 +15,15 @@
 #include <arch/x86/apic.h>
 #include <arch/x86/cpu_topology.h>
 #include <arch/x86/mmu.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <dev/pcie_bus_driver.h>
 #include <dev/uart.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
+#include <inttypes.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <lk/init.h>
 #include <mexec.h>
 #include <platform.h>
@@ -783,6 +786,69 @@ void platform_early_init(void) {
     boot_reserve_wire();
 }
 
+// Tag PMM arenas with the NUMA node of the memory they cover. This cannot be
+// done when the arenas are added in pc_mem_init, since the ACPI tables are
+// only available once the VM is up.
+static void platform_init_numa_memory(uint level) {
+    uint32_t num_ranges = 0;
+    zx_status_t status = platform_enumerate_memory_affinity(NULL, 0, &num_ranges);
+    if (status != ZX_OK || num_ranges == 0) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<acpi_memory_affinity[]> ranges(new (&ac) acpi_memory_affinity[num_ranges]);
+    if (!ac.check()) {
+        TRACEF("failed to allocate memory affinity table\n");
+        return;
+    }
+    status = platform_enumerate_memory_affinity(ranges.get(), num_ranges, &num_ranges);
+    if (status != ZX_OK) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_ranges; ++i) {
+        dprintf(INFO, "numa: memory %#" PRIx64 " - %#" PRIx64 " node %u\n",
+                ranges[i].base, ranges[i].base + ranges[i].size, ranges[i].node);
+        status = pmm_set_node_range(ranges[i].base, ranges[i].size, ranges[i].node);
+        if (status != ZX_OK) {
+            TRACEF("failed to set node of memory range, status %d\n", status);
+        }
+    }
+}
+
+LK_INIT_HOOK(numa_memory, &platform_init_numa_memory, LK_INIT_LEVEL_VM + 2);
+
+// Record the NUMA node of every cpu. Must be called after cpu numbers have
+// been assigned to apic ids.
+static void platform_init_numa_cpus(void) {
+    uint32_t num_cpus = 0;
+    zx_status_t status = platform_enumerate_cpu_affinity(NULL, 0, &num_cpus);
+    if (status != ZX_OK || num_cpus == 0) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<acpi_cpu_affinity[]> cpus(new (&ac) acpi_cpu_affinity[num_cpus]);
+    if (!ac.check()) {
+        TRACEF("failed to allocate cpu affinity table\n");
+        return;
+    }
+    status = platform_enumerate_cpu_affinity(cpus.get(), num_cpus, &num_cpus);
+    if (status != ZX_OK) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        int cpu = x86_apic_id_to_cpu_num(cpus[i].apic_id);
+        if (cpu < 0) {
+            // not a cpu we are using
+            continue;
+        }
+        mp_set_cpu_node(cpu, cpus[i].node);
+    }
+}
+
 static void platform_init_smp(void) {
     uint32_t num_cpus = 0;
 
@@ -872,6 +938,8 @@ static void platform_init_smp(void) {
 
     x86_init_smp(apic_ids.get(), num_cpus);
 
+    platform_init_numa_cpus();
+
     // trim the boot cpu out of the apic id list before passing to the AP booting routine
     for (uint i = 0; i < num_cpus - 1; ++i) {
         if (apic_ids[i] == bsp_apic_id) {
@@ -40,6 +40,7 @@ void pc_suspend_debug(void);
 zx_status_t x86_alloc_msi_block(uint requested_irqs, bool can_target_64bit,
                                 bool is_msix, pcie_msi_block_t* out_block);
 void x86_free_msi_block(pcie_msi_block_t* block);
+zx_status_t x86_set_msi_affinity(pcie_msi_block_t* block, cpu_num_t cpu);
 void x86_register_msi_handler(const pcie_msi_block_t* block,
                               uint msi_id,
                               int_handler handler,
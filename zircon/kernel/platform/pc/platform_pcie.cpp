@@ -37,6 +37,10 @@ public:
         x86_free_msi_block(block);
     }
 
+    zx_status_t SetMsiAffinity(pcie_msi_block_t* block, cpu_num_t cpu) override {
+        return x86_set_msi_affinity(block, cpu);
+    }
+
     void RegisterMsiHandler(const pcie_msi_block_t* block,
                             uint msi_id,
                             int_handler handler,
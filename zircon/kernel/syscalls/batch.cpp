@@ -0,0 +1,353 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <trace.h>
+
+#include <lib/counters.h>
+#include <lib/user_copy/user_ptr.h>
+#include <object/channel_dispatcher.h>
+#include <object/fifo_dispatcher.h>
+#include <object/message_packet.h>
+#include <object/port_dispatcher.h>
+#include <object/process_dispatcher.h>
+#include <object/socket_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <zircon/syscalls/batch.h>
+#include <fbl/algorithm.h>
+#include <fbl/ref_ptr.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+// zx_batch_execute() runs a vector of I/O operations on existing handles in
+// a single kernel entry. Each operation behaves like the corresponding
+// syscall, except that it cannot transfer handles.
+
+KCOUNTER(batch_execute_count, "kernel.batch.execute");
+KCOUNTER(batch_op_count, "kernel.batch.op");
+
+namespace {
+
+// Operations are copied in and results copied out this many at a time.
+constexpr size_t kChunkSize = 16;
+
+// Force map the range, even if it crosses multiple mappings.
+// TODO(ZX-730): The same workaround as in sys_vmo_read and sys_vmo_write.
+zx_status_t PrefaultUserRange(user_out_ptr<uint8_t> data, size_t len) {
+    uint8_t byte = 0;
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        zx_status_t status = data.copy_array_to_user(&byte, 1, i);
+        if (status != ZX_OK)
+            return status;
+    }
+    if (len > 0)
+        return data.copy_array_to_user(&byte, 1, len - 1);
+    return ZX_OK;
+}
+
+zx_status_t PrefaultUserRange(user_in_ptr<const uint8_t> data, size_t len) {
+    uint8_t byte = 0;
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        zx_status_t status = data.copy_array_from_user(&byte, 1, i);
+        if (status != ZX_OK)
+            return status;
+    }
+    if (len > 0)
+        return data.copy_array_from_user(&byte, 1, len - 1);
+    return ZX_OK;
+}
+
+zx_status_t ChannelRead(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_READ, &channel);
+    if (status != ZX_OK)
+        return status;
+
+    if (op.options & ~ZX_CHANNEL_READ_MAY_DISCARD)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    // Handles can't be returned, so a message carrying them never fits. It is left in the
+    // channel, even with ZX_CHANNEL_READ_MAY_DISCARD, for a read that can take them.
+    uint32_t num_bytes = static_cast<uint32_t>(fbl::min<size_t>(op.size, UINT32_MAX));
+    uint32_t num_handles = 0u;
+    fbl::unique_ptr<MessagePacket> msg;
+    status = channel->Read(&num_bytes, &num_handles, &msg,
+                           op.options & ZX_CHANNEL_READ_MAY_DISCARD, false);
+    if (status != ZX_OK && status != ZX_ERR_BUFFER_TOO_SMALL)
+        return status;
+
+    *actual = num_bytes;
+    if (status != ZX_OK)
+        return status;
+
+    if (num_bytes > 0u) {
+        if (msg->CopyDataTo(make_user_out_ptr(op.buffer)) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+zx_status_t ChannelWrite(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.options)
+        return ZX_ERR_INVALID_ARGS;
+    if (op.size > UINT32_MAX)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_WRITE, &channel);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::unique_ptr<MessagePacket> msg;
+    status = MessagePacket::Create(make_user_in_ptr(static_cast<const void*>(op.buffer)),
+                                   static_cast<uint32_t>(op.size), 0u, &msg);
+    if (status != ZX_OK)
+        return status;
+
+    status = channel->Write(fbl::move(msg));
+    if (status != ZX_OK)
+        return status;
+
+    *actual = op.size;
+    return ZX_OK;
+}
+
+zx_status_t SocketRead(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (!op.buffer && op.size > 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_READ, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    auto buffer = make_user_out_ptr(op.buffer);
+    size_t nread;
+    switch (op.options) {
+    case 0:
+        status = socket->Read(buffer, op.size, &nread);
+        break;
+    case ZX_SOCKET_CONTROL:
+        status = socket->ReadControl(buffer, op.size, &nread);
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if (status == ZX_OK)
+        *actual = nread;
+    return status;
+}
+
+zx_status_t SocketWrite(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (!op.buffer && op.size > 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_WRITE, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    auto buffer = make_user_in_ptr(static_cast<const void*>(op.buffer));
+    size_t nwritten;
+    switch (op.options) {
+    case 0:
+        status = socket->Write(buffer, op.size, &nwritten);
+        break;
+    case ZX_SOCKET_CONTROL:
+        status = socket->WriteControl(buffer, op.size);
+        nwritten = op.size;
+        break;
+    default:
+        // Shutdown is not an I/O operation.
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if (status == ZX_OK)
+        *actual = nwritten;
+    return status;
+}
+
+zx_status_t FifoRead(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.options)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_READ, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    uint32_t count;
+    status = fifo->ReadToUser(make_user_out_ptr(static_cast<uint8_t*>(op.buffer)),
+                              op.size, &count);
+    if (status == ZX_OK)
+        *actual = count;
+    return status;
+}
+
+zx_status_t FifoWrite(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.options)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_WRITE, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    uint32_t count;
+    status = fifo->WriteFromUser(make_user_in_ptr(static_cast<const uint8_t*>(op.buffer)),
+                                 op.size, &count);
+    if (status == ZX_OK)
+        *actual = count;
+    return status;
+}
+
+zx_status_t VmoRead(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.options)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_READ, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    auto data = make_user_out_ptr(op.buffer);
+    status = PrefaultUserRange(data.reinterpret<uint8_t>(), op.size);
+    if (status != ZX_OK)
+        return status;
+
+    size_t nread;
+    status = vmo->Read(data, op.size, op.offset, &nread);
+    if (status == ZX_OK)
+        *actual = nread;
+    return status;
+}
+
+zx_status_t VmoWrite(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.options)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    zx_status_t status = up->GetDispatcherWithRights(op.handle, ZX_RIGHT_WRITE, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    auto data = make_user_in_ptr(static_cast<const void*>(op.buffer));
+    status = PrefaultUserRange(data.reinterpret<const uint8_t>(), op.size);
+    if (status != ZX_OK)
+        return status;
+
+    size_t nwritten;
+    status = vmo->Write(data, op.size, op.offset, &nwritten);
+    if (status == ZX_OK)
+        *actual = nwritten;
+    return status;
+}
+
+zx_status_t ExecuteOp(ProcessDispatcher* up, const zx_batch_op_t& op, uint64_t* actual) {
+    if (op.reserved)
+        return ZX_ERR_INVALID_ARGS;
+    if (op.offset && op.op != ZX_BATCH_OP_VMO_READ && op.op != ZX_BATCH_OP_VMO_WRITE)
+        return ZX_ERR_INVALID_ARGS;
+
+    switch (op.op) {
+    case ZX_BATCH_OP_CHANNEL_READ:
+        return ChannelRead(up, op, actual);
+    case ZX_BATCH_OP_CHANNEL_WRITE:
+        return ChannelWrite(up, op, actual);
+    case ZX_BATCH_OP_SOCKET_READ:
+        return SocketRead(up, op, actual);
+    case ZX_BATCH_OP_SOCKET_WRITE:
+        return SocketWrite(up, op, actual);
+    case ZX_BATCH_OP_FIFO_READ:
+        return FifoRead(up, op, actual);
+    case ZX_BATCH_OP_FIFO_WRITE:
+        return FifoWrite(up, op, actual);
+    case ZX_BATCH_OP_VMO_READ:
+        return VmoRead(up, op, actual);
+    case ZX_BATCH_OP_VMO_WRITE:
+        return VmoWrite(up, op, actual);
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
+} // namespace
+
+zx_status_t sys_batch_execute(user_in_ptr<const zx_batch_op_t> user_ops, size_t num_ops,
+                              user_out_ptr<zx_batch_result_t> user_results,
+                              zx_handle_t port_handle, uint64_t key) {
+    LTRACEF("ops %p num_ops %zu port %x\n", user_ops.get(), num_ops, port_handle);
+
+    if (num_ops > ZX_BATCH_MAX_OPS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // Look up the port first, so that a bad handle fails the call before any
+    // operation has had side effects.
+    fbl::RefPtr<PortDispatcher> port;
+    if (port_handle != ZX_HANDLE_INVALID) {
+        zx_status_t status = up->GetDispatcherWithRights(port_handle, ZX_RIGHT_WRITE, &port);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    // Likewise check that every operation can be read and every result written.
+    zx_status_t status = PrefaultUserRange(user_ops.reinterpret<const uint8_t>(),
+                                           num_ops * sizeof(zx_batch_op_t));
+    if (status == ZX_OK) {
+        status = PrefaultUserRange(user_results.reinterpret<uint8_t>(),
+                                   num_ops * sizeof(zx_batch_result_t));
+    }
+    if (status != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    kcounter_add(batch_execute_count, 1u);
+    kcounter_add(batch_op_count, num_ops);
+
+    uint64_t failed = 0u;
+    zx_batch_op_t ops[kChunkSize];
+    zx_batch_result_t results[kChunkSize];
+    for (size_t base = 0; base < num_ops; base += kChunkSize) {
+        const size_t count = fbl::min(num_ops - base, kChunkSize);
+
+        // The buffers can only have gone away since they were checked if another
+        // thread unmapped them, by which time some operations may have run.
+        status = user_ops.copy_array_from_user(ops, count, base);
+        if (status != ZX_OK)
+            return ZX_ERR_IO_DATA_LOSS;
+
+        for (size_t i = 0; i < count; i++) {
+            results[i] = {};
+            results[i].status = ExecuteOp(up, ops[i], &results[i].actual);
+            if (results[i].status != ZX_OK)
+                failed++;
+        }
+
+        status = user_results.copy_array_to_user(results, count, base);
+        if (status != ZX_OK)
+            return ZX_ERR_IO_DATA_LOSS;
+    }
+
+    // Completion notification, for event loops that reap results from a
+    // port rather than from the return of this call.
+    if (port) {
+        zx_port_packet_t packet = {};
+        packet.key = key;
+        packet.status = ZX_OK;
+        packet.user.u64[0] = num_ops;
+        packet.user.u64[1] = failed;
+        return port->QueueUser(packet);
+    }
+
+    return ZX_OK;
+}
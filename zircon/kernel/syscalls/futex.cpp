@@ -37,3 +37,17 @@ zx_status_t sys_futex_requeue(user_in_ptr<const zx_futex_t> wake_ptr, uint32_t w
         wake_ptr, wake_count, current_value,
         requeue_ptr, requeue_count);
 }
+
+zx_status_t sys_futex_wait_pi(user_in_ptr<const zx_futex_t> value_ptr, int current_value,
+                              zx_time_t deadline) {
+    LTRACEF("futex %p current %d\n", value_ptr.get(), current_value);
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWaitPi(
+        value_ptr, current_value, deadline);
+}
+
+zx_status_t sys_futex_wake_pi(user_in_ptr<const zx_futex_t> value_ptr) {
+    LTRACEF("futex %p\n", value_ptr.get());
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakePi(value_ptr);
+}
@@ -10,20 +10,25 @@
 
 #include <kernel/mp.h>
 #include <kernel/stats.h>
+#include <vm/page_age.h>
 #include <vm/pmm.h>
+#include <vm/vm_object.h>
 #include <lib/heap.h>
 #include <platform.h>
 #include <zircon/types.h>
 
 #include <object/diagnostics.h>
 #include <object/handle.h>
+#include <object/interrupt_dispatcher.h>
 #include <object/job_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
 #include <object/resources.h>
 #include <object/thread_dispatcher.h>
 #include <object/vm_address_region_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/ref_ptr.h>
 
 #include "priv.h"
@@ -541,6 +546,21 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_VMO_WORKING_SET: {
+            fbl::RefPtr<VmObjectDispatcher> vmo;
+            auto status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &vmo);
+            if (status != ZX_OK)
+                return status;
+
+            zx_info_vmo_working_set_t info = {};
+            info.scan_period = page_age_scan_period();
+            status = vmo->vmo()->GetPageAges(info.pages_by_age, fbl::count_of(info.pages_by_age));
+            if (status != ZX_OK)
+                return status;
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
 
         default:
             return ZX_ERR_NOT_SUPPORTED;
@@ -607,6 +627,28 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
                 return status;
             return ZX_OK;
         }
+        case ZX_PROP_VMO_NUMA_NODE: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value;
+            zx_status_t status = vmo->vmo()->GetPreferredNode(&value);
+            if (status != ZX_OK)
+                return status;
+            return _value.reinterpret<uint32_t>().copy_to_user(value);
+        }
+        case ZX_PROP_INTERRUPT_AFFINITY: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto interrupt = DownCastDispatcher<InterruptDispatcher>(&dispatcher);
+            if (!interrupt)
+                return ZX_ERR_WRONG_TYPE;
+            static_assert(ZX_INTERRUPT_AFFINITY_DEFAULT == INVALID_CPU, "");
+            uint32_t value = interrupt->GetAffinity();
+            return _value.reinterpret<uint32_t>().copy_to_user(value);
+        }
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -687,6 +729,31 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return job->set_importance(
                 static_cast<zx_job_importance_t>(value));
         }
+        case ZX_PROP_VMO_NUMA_NODE: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value = 0;
+            zx_status_t status = _value.reinterpret<const uint32_t>().copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            static_assert(ZX_VMO_NUMA_NODE_LOCAL == PMM_NODE_LOCAL, "");
+            return vmo->vmo()->SetPreferredNode(value);
+        }
+        case ZX_PROP_INTERRUPT_AFFINITY: {
+            if (size < sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto interrupt = DownCastDispatcher<InterruptDispatcher>(&dispatcher);
+            if (!interrupt)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value = 0;
+            zx_status_t status = _value.reinterpret<const uint32_t>().copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            return interrupt->SetAffinity(value);
+        }
     }
 
     return ZX_ERR_INVALID_ARGS;
@@ -9,6 +9,7 @@
 
 #include <arch/ops.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
@@ -172,6 +173,45 @@ __NO_INLINE static void bench_memcpy() {
     free(buf);
 }
 
+// Report memcpy and memset throughput per size class, so that the small,
+// bulk and non-temporal paths of the arch implementations can be compared.
+__NO_INLINE static void bench_memops_by_size() {
+    static const size_t kSizes[] = {
+        8, 16, 32, 64, 128, 256, 512, 1024, 4096, 16384, 65536, 262144,
+        1024 * 1024, 4 * 1024 * 1024,
+    };
+    uint8_t* buf = (uint8_t*)memalign(PAGE_SIZE, BUFSIZE);
+
+    for (size_t size : kSizes) {
+        // Copy a total of at least 64MB, but no less than 4096 times, per size.
+        const size_t iter = fbl::max(64 * 1024 * 1024 / size, (size_t)4096);
+
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+        uint64_t count = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++) {
+            memcpy(buf, buf + BUFSIZE / 2, size);
+        }
+        uint64_t copy_count = arch_cycle_count() - count;
+
+        count = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++) {
+            memset(buf, 0, size);
+        }
+        uint64_t set_count = arch_cycle_count() - count;
+        arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+        uint64_t copy_bytes_cycle = (size * iter * 1000ULL) / fbl::max(copy_count, (uint64_t)1);
+        uint64_t set_bytes_cycle = (size * iter * 1000ULL) / fbl::max(set_count, (uint64_t)1);
+        printf("size %8zu: memcpy %" PRIu64 " cycles per, %llu.%03llu bytes/cycle; "
+               "memset %" PRIu64 " cycles per, %llu.%03llu bytes/cycle\n",
+               size, copy_count / iter, copy_bytes_cycle / 1000, copy_bytes_cycle % 1000,
+               set_count / iter, set_bytes_cycle / 1000, set_bytes_cycle % 1000);
+    }
+
+    free(buf);
+}
+
 __NO_INLINE static void bench_spinlock() {
     spin_lock_saved_state_t state;
     spin_lock_saved_state_t state2;
@@ -235,10 +275,79 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+namespace {
+
+struct MutexContentionArgs {
+    mutex_t* m;
+    uint iterations;
+};
+
+int mutex_contention_thread(void* arg) {
+    auto args = static_cast<MutexContentionArgs*>(arg);
+    for (uint i = 0; i < args->iterations; i++) {
+        mutex_acquire(args->m);
+        // a short critical section, typical of the vm and object layers
+        for (int j = 0; j < 64; j++) {
+            __asm__ volatile("");
+        }
+        mutex_release(args->m);
+    }
+    return 0;
+}
+
+} // namespace
+
+// Run the same short critical section on up to 4 cpus at once, to measure
+// the cost of contended acquires. The kernel.mutex.* counters show how many
+// of them were satisfied by spinning rather than blocking.
+__NO_INLINE static void bench_mutex_contended() {
+    static const uint kMaxThreads = 4;
+    static const uint kIterations = 256 * 1024;
+
+    const uint num_threads = fbl::min<uint>(kMaxThreads,
+                                           __builtin_popcount(mp_get_online_mask()));
+    if (num_threads < 2) {
+        printf("skipping contended mutex benchmark, only one cpu online\n");
+        return;
+    }
+
+    mutex_t m;
+    mutex_init(&m);
+    MutexContentionArgs args = {&m, kIterations};
+
+    // pin each thread to a different online cpu
+    thread_t* threads[kMaxThreads];
+    cpu_mask_t online = mp_get_online_mask();
+    for (uint i = 0; i < num_threads; i++) {
+        cpu_num_t cpu = __builtin_ctz(online);
+        online &= ~cpu_num_to_mask(cpu);
+        threads[i] = thread_create("mutex contender", &mutex_contention_thread, &args,
+                                   DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        thread_set_cpu_affinity(threads[i], cpu_num_to_mask(cpu));
+    }
+
+    zx_time_t t = current_time();
+    for (uint i = 0; i < num_threads; i++) {
+        thread_resume(threads[i]);
+    }
+    for (uint i = 0; i < num_threads; i++) {
+        thread_join(threads[i], NULL, ZX_TIME_INFINITE);
+    }
+    t = current_time() - t;
+
+    mutex_destroy(&m);
+
+    const uint64_t total = (uint64_t)num_threads * kIterations;
+    printf("%" PRIu64 " ns to acquire/release mutex contended by %u threads %" PRIu64
+           " times (%" PRIu64 " ns per)\n",
+           t, num_threads, total, t / total);
+}
+
 void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
     bench_memset();
+    bench_memops_by_size();
 
     bench_memset_per_page();
     bench_zero_page();
@@ -251,4 +360,5 @@ void benchmarks() {
 
     bench_spinlock();
     bench_mutex();
+    bench_mutex_contended();
 }
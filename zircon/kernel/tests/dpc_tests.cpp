@@ -0,0 +1,106 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+#include <arch/ops.h>
+#include <kernel/atomic.h>
+#include <kernel/dpc.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <unittest.h>
+#include <zircon/types.h>
+
+namespace {
+
+struct DpcContext {
+    event_t done;
+    volatile int runs;
+    volatile cpu_num_t cpu;
+};
+
+void record_dpc(dpc_t* dpc) {
+    auto context = static_cast<DpcContext*>(dpc->arg);
+    context->cpu = arch_curr_cpu_num();
+    atomic_add(&context->runs, 1);
+    event_signal(&context->done, false);
+}
+
+bool dpc_queue_twice(void* context) {
+    BEGIN_TEST;
+
+    DpcContext dpc_context = {};
+    event_init(&dpc_context.done, false, 0);
+    dpc_t dpc = DPC_INITIAL_VALUE;
+    dpc.func = record_dpc;
+    dpc.arg = &dpc_context;
+
+    // the local dpc thread can't run while we hold the thread lock, so the
+    // second queue always finds the dpc still pending
+    THREAD_LOCK(state);
+    zx_status_t first = dpc_queue_thread_locked(&dpc);
+    zx_status_t second = dpc_queue_thread_locked(&dpc);
+    THREAD_UNLOCK(state);
+
+    EXPECT_EQ(ZX_OK, first, "");
+    EXPECT_EQ(ZX_ERR_ALREADY_EXISTS, second, "");
+
+    EXPECT_EQ(ZX_OK, event_wait(&dpc_context.done), "");
+    EXPECT_EQ(1, dpc_context.runs, "");
+
+    // once it has run it can be queued again
+    event_unsignal(&dpc_context.done);
+    EXPECT_EQ(ZX_OK, dpc_queue(&dpc, false), "");
+    EXPECT_EQ(ZX_OK, event_wait(&dpc_context.done), "");
+    EXPECT_EQ(2, dpc_context.runs, "");
+
+    event_destroy(&dpc_context.done);
+    END_TEST;
+}
+
+bool dpc_queue_on_each_cpu(void* context) {
+    BEGIN_TEST;
+
+    for (cpu_num_t cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+        if (!mp_is_cpu_online(cpu))
+            continue;
+
+        DpcContext dpc_context = {};
+        dpc_context.cpu = INVALID_CPU;
+        event_init(&dpc_context.done, false, 0);
+        dpc_t dpc = DPC_INITIAL_VALUE;
+        dpc.func = record_dpc;
+        dpc.arg = &dpc_context;
+
+        EXPECT_EQ(ZX_OK, dpc_queue_on(&dpc, cpu, false), "");
+        EXPECT_EQ(ZX_OK, event_wait(&dpc_context.done), "");
+        EXPECT_EQ(cpu, dpc_context.cpu, "dpc ran on the wrong cpu");
+
+        event_destroy(&dpc_context.done);
+    }
+
+    END_TEST;
+}
+
+bool dpc_queue_on_bad_cpu(void* context) {
+    BEGIN_TEST;
+
+    dpc_t dpc = DPC_INITIAL_VALUE;
+    dpc.func = record_dpc;
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, dpc_queue_on(&dpc, INVALID_CPU, false), "");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, dpc_queue_on(&dpc, SMP_MAX_CPUS, false), "");
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(dpc_tests)
+UNITTEST("queue a pending dpc twice", dpc_queue_twice)
+UNITTEST("queue a dpc on each cpu", dpc_queue_on_each_cpu)
+UNITTEST("queue a dpc on a bad cpu", dpc_queue_on_bad_cpu)
+UNITTEST_END_TESTCASE(dpc_tests, "dpc", "Tests for deferred procedure calls", nullptr, nullptr);
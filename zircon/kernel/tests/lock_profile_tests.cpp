@@ -0,0 +1,207 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+#include <arch/ops.h>
+#include <kernel/atomic.h>
+#include <kernel/lock_profile.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <platform.h>
+#include <unittest.h>
+#include <zircon/types.h>
+
+#if WITH_LOCK_PROFILING
+
+namespace {
+
+// Only these tests take these locks, so the sites which last acquired them
+// account for every acquisition the tests make.
+mutex_t test_mutex = MUTEX_INITIAL_VALUE(test_mutex);
+spin_lock_t test_spinlock = SPIN_LOCK_INITIAL_VALUE;
+
+// Runs |test| with recording on, and returns the change in the counts of
+// |lock| across it.
+template <typename F>
+lock_profile_stats_t profile(const void* lock, F test) {
+    bool was_enabled = lock_profile_set_enabled(true);
+    lock_profile_stats_t before;
+    lock_profile_get_lock_stats(lock, &before);
+    test();
+    lock_profile_stats_t after;
+    lock_profile_get_lock_stats(lock, &after);
+    lock_profile_set_enabled(was_enabled);
+
+    after.acquisitions -= before.acquisitions;
+    after.contended -= before.contended;
+    after.wait_ticks -= before.wait_ticks;
+    after.hold_ticks -= before.hold_ticks;
+    return after;
+}
+
+bool mutex_uncontended(void* context) {
+    BEGIN_TEST;
+
+    lock_profile_stats_t stats = profile(&test_mutex, [] {
+        for (int i = 0; i < 10; i++) {
+            mutex_acquire(&test_mutex);
+            mutex_release(&test_mutex);
+        }
+    });
+    EXPECT_EQ(10u, stats.acquisitions, "");
+    EXPECT_EQ(0u, stats.contended, "");
+    EXPECT_EQ(0u, stats.wait_ticks, "");
+
+    END_TEST;
+}
+
+bool not_recording(void* context) {
+    BEGIN_TEST;
+
+    bool was_enabled = lock_profile_set_enabled(false);
+    lock_profile_stats_t before;
+    lock_profile_get_lock_stats(&test_mutex, &before);
+    mutex_acquire(&test_mutex);
+    mutex_release(&test_mutex);
+    lock_profile_stats_t after;
+    lock_profile_get_lock_stats(&test_mutex, &after);
+    lock_profile_set_enabled(was_enabled);
+
+    EXPECT_EQ(before.acquisitions, after.acquisitions, "");
+
+    END_TEST;
+}
+
+int mutex_contender(void* arg) {
+    mutex_acquire(&test_mutex);
+    mutex_release(&test_mutex);
+    return 0;
+}
+
+bool mutex_contended(void* context) {
+    BEGIN_TEST;
+
+    zx_status_t join_status = ZX_ERR_INTERNAL;
+    lock_profile_stats_t stats = profile(&test_mutex, [&join_status] {
+        mutex_acquire(&test_mutex);
+        thread_t* t = thread_create("lockprof mutex contender", mutex_contender, nullptr,
+                                    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        thread_resume(t);
+        // Hold the mutex until the contender has blocked on it.
+        while ((mutex_val(&test_mutex) & MUTEX_FLAG_QUEUED) == 0) {
+            thread_sleep_relative(ZX_MSEC(1));
+        }
+        mutex_release(&test_mutex);
+        join_status = thread_join(t, nullptr, ZX_TIME_INFINITE);
+    });
+    EXPECT_EQ(ZX_OK, join_status, "");
+
+    EXPECT_EQ(2u, stats.acquisitions, "");
+    EXPECT_EQ(1u, stats.contended, "");
+    EXPECT_GT(stats.wait_ticks, 0u, "");
+    EXPECT_GT(stats.max_wait_ticks, 0u, "");
+    EXPECT_GT(stats.hold_ticks, 0u, "");
+    EXPECT_GT(stats.max_hold_ticks, 0u, "");
+
+    END_TEST;
+}
+
+struct SpinContender {
+    volatile int held;
+    volatile int trying;
+};
+
+int spin_contender(void* arg) {
+    auto contender = static_cast<SpinContender*>(arg);
+    while (!atomic_load(&contender->held)) {
+        arch_spinloop_pause();
+    }
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    atomic_store(&contender->trying, 1);
+    spin_lock(&test_spinlock);
+    spin_unlock(&test_spinlock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return 0;
+}
+
+bool spinlock_contended(void* context) {
+    BEGIN_TEST;
+
+    // The contender has to spin on one cpu while the lock is held on another.
+    cpu_num_t cpus[2];
+    size_t count = 0;
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS && count < 2; cpu++) {
+        if (mp_is_cpu_online(cpu)) {
+            cpus[count++] = cpu;
+        }
+    }
+    if (count < 2) {
+        unittest_printf("only one cpu online, skipping\n");
+        END_TEST;
+    }
+
+    cpu_mask_t old_affinity = get_current_thread()->cpu_affinity;
+    thread_set_cpu_affinity(get_current_thread(), cpu_num_to_mask(cpus[0]));
+    mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(cpus[0]), 0);
+    thread_yield();
+
+    SpinContender contender = {};
+    bool contended = false;
+    zx_status_t join_status = ZX_ERR_INTERNAL;
+    lock_profile_stats_t stats = profile(&test_spinlock, [&] {
+        thread_t* t = thread_create("lockprof spin contender", spin_contender, &contender,
+                                    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        thread_set_cpu_affinity(t, cpu_num_to_mask(cpus[1]));
+        thread_resume(t);
+
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&test_spinlock, state);
+        atomic_store(&contender.held, 1);
+        zx_time_t deadline = current_time() + ZX_SEC(5);
+        while (!atomic_load(&contender.trying) && current_time() < deadline) {
+            arch_spinloop_pause();
+        }
+        contended = atomic_load(&contender.trying) != 0;
+        // Give the contender time to reach the lock.
+        deadline = current_time() + ZX_USEC(100);
+        while (current_time() < deadline) {
+            arch_spinloop_pause();
+        }
+        spin_unlock_irqrestore(&test_spinlock, state);
+        join_status = thread_join(t, nullptr, ZX_TIME_INFINITE);
+    });
+
+    thread_set_cpu_affinity(get_current_thread(), old_affinity);
+    mp_reschedule(MP_IPI_TARGET_ALL_BUT_LOCAL, 0, 0);
+    thread_yield();
+
+    REQUIRE_TRUE(contended, "contender never ran");
+    EXPECT_EQ(ZX_OK, join_status, "");
+
+    EXPECT_EQ(2u, stats.acquisitions, "");
+    EXPECT_EQ(1u, stats.contended, "");
+    EXPECT_GT(stats.wait_ticks, 0u, "");
+    EXPECT_GT(stats.max_wait_ticks, 0u, "");
+    EXPECT_GT(stats.hold_ticks, 0u, "");
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(lock_profile_tests)
+UNITTEST("uncontended mutex", mutex_uncontended)
+UNITTEST("nothing recorded while stopped", not_recording)
+UNITTEST("contended mutex", mutex_contended)
+UNITTEST("contended spin lock", spinlock_contended)
+UNITTEST_END_TESTCASE(lock_profile_tests, "lockprof", "Tests for lock contention profiling",
+                      nullptr, nullptr);
+
+#endif // WITH_LOCK_PROFILING
@@ -29,6 +29,10 @@ const uint ARCH_MMU_FLAG_INVALID = (1u << 7); // Indicates that flags are not sp
 const uint ARCH_ASPACE_FLAG_KERNEL = (1u << 0);
 const uint ARCH_ASPACE_FLAG_GUEST = (1u << 1);
 
+// Called by ArchVmAspaceInterface::HarvestAccessed() for every page that has
+// been accessed, with the page's virtual and physical address.
+typedef void (*harvest_accessed_fn_t)(vaddr_t vaddr, paddr_t paddr, void* context);
+
 // per arch base class api to encapsulate the mmu routines on an aspace
 class ArchVmAspaceInterface {
 public:
@@ -58,6 +62,14 @@ public:
 
     virtual zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) = 0;
 
+    // Test and clear the accessed flag of every page mapped in the given
+    // virtual address range, calling |accessed_fn| for each page whose flag
+    // was set. |accessed_fn| is called with the page table lock held, so the
+    // page cannot be unmapped while it runs. Returns ZX_ERR_NOT_SUPPORTED if
+    // the hardware does not track accesses.
+    virtual zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                        harvest_accessed_fn_t accessed_fn, void* context) = 0;
+
     virtual vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                              vaddr_t end, uint next_region_mmu_flags,
                              vaddr_t align, size_t size, uint mmu_flags) = 0;
@@ -39,6 +39,10 @@ typedef struct vm_page {
             // If true, one pin slot is used by the VmObject to keep a run
             // contiguous.
             bool contiguous_pin : 1;
+
+            // The page age scanner generation in which the page was last
+            // seen accessed through a mapping. See vm/page_age.h.
+            uint32_t access_gen;
         } object;
 
         uint8_t pad[24]; // pad out to 32 bytes
@@ -0,0 +1,32 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <vm/page.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+// The page age scanner periodically harvests the accessed flags of every user
+// mapping. Each pass starts a new generation, and every page found accessed
+// records that generation in its vm_page_t. The age of a page is the number
+// of generations since it was last seen accessed.
+
+__BEGIN_CDECLS
+
+// Interval between scanner passes, or 0 if the scanner is disabled.
+zx_duration_t page_age_scan_period(void);
+
+// The current scanner generation.
+uint32_t page_age_generation(void);
+
+// Record that |page| was accessed during the current generation.
+void page_age_mark_accessed(vm_page_t* page);
+
+// Number of generations since |page| was last seen accessed.
+uint32_t page_age(const vm_page_t* page);
+
+__END_CDECLS
@@ -32,6 +32,25 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 #define PMM_ALLOC_FLAG_ANY (0x0)  // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_KMAP (0x1) // allocate only from arenas marked KMAP
 
+// Preferred-node argument for the *_node allocation routines below, meaning the
+// NUMA node of the calling cpu.
+#define PMM_NODE_LOCAL (UINT32_MAX)
+
+// Record that the physical range [base, base + size) is on NUMA node |node|,
+// splitting arenas that straddle the range. Called by the platform during
+// boot, before secondary cpus are started. Allocations prefer memory on the
+// node of the requesting cpu.
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint32_t node);
+
+// Returns the NUMA node of the calling cpu.
+uint32_t pmm_local_node(void);
+
+// Returns true if any arena holds memory on NUMA node |node|.
+bool pmm_node_has_memory(uint32_t node);
+
+// Returns the NUMA node of the memory backing |page|.
+uint32_t pmm_page_node(const vm_page_t* page);
+
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
 // Returns the number of pages allocated.
@@ -40,6 +59,18 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) _
 // Allocate a single page of physical memory.
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa);
 
+// Same as the two above, but preferring memory on NUMA node |node| rather than
+// the node of the calling cpu. Memory on other nodes is used if |node| has none.
+size_t pmm_alloc_pages_node(size_t count, uint alloc_flags, uint32_t node,
+                            struct list_node* list) __NONNULL((4));
+vm_page_t* pmm_alloc_page_node(uint alloc_flags, uint32_t node, paddr_t* pa);
+
+// Allocate a single page of physical memory whose contents are zero.
+// Pages come from a per-cpu pool that is zeroed in the background when
+// possible, and are zeroed synchronously otherwise. The pools only hold
+// memory local to their cpu, so they are bypassed when |node| is remote.
+vm_page_t* pmm_alloc_zeroed_page(uint alloc_flags, uint32_t node, paddr_t* pa);
+
 // Allocate a specific range of physical pages, adding to the tail of the passed list.
 // Returns the number of pages allocated.
 size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list);
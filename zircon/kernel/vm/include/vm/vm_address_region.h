@@ -434,6 +434,11 @@ public:
     void Dump(uint depth, bool verbose) const override;
     zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
 
+    // Test and clear the accessed flags of the pages mapped by this mapping,
+    // marking the ones that were set as accessed. Must be called with the
+    // aspace lock held.
+    void HarvestAccessedLocked() const;
+
 protected:
     ~VmMapping() override;
     friend fbl::RefPtr<VmMapping>;
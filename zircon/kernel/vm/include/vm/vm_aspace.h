@@ -215,6 +215,10 @@ private:
 
 void DumpAllAspaces(bool verbose);
 
+// Harvest the accessed flags of every mapping in every user address space,
+// recording the pages found accessed. See vm/page_age.h.
+void HarvestAllUserAspacesAccessed();
+
 // hack to convert from vmm_aspace_t to VmAspace
 static VmAspace* vmm_aspace_to_obj(vmm_aspace_t* aspace) {
     return reinterpret_cast<VmAspace*>(aspace);
@@ -50,6 +50,13 @@ public:
     virtual size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const {
         return 0;
     }
+
+    // Count the pages committed to this object by age, as defined in
+    // vm/page_age.h. Pages of age |num_ages| - 1 or older are all counted in
+    // the last entry of |pages_by_age|.
+    virtual zx_status_t GetPageAges(uint64_t* pages_by_age, size_t num_ages) const {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
     // Returns the number of physical pages currently allocated to the object.
     size_t AllocatedPages() const {
         return AllocatedPagesInRange(0, size());
@@ -156,6 +163,17 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // NUMA node that newly committed pages are preferably allocated from, or
+    // PMM_NODE_LOCAL for the node of the cpu committing them. Setting a node
+    // that has no memory fails with ZX_ERR_INVALID_ARGS.
+    virtual zx_status_t GetPreferredNode(uint32_t* node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    virtual zx_status_t SetPreferredNode(uint32_t node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // create a copy-on-write clone vmo at the page-aligned offset and length
     // note: it's okay to start or extend past the size of the parent
     virtual zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
@@ -41,6 +41,8 @@ public:
 
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
 
+    zx_status_t GetPageAges(uint64_t* pages_by_age, size_t num_ages) const override;
+
     zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) override;
     zx_status_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint64_t* committed,
                                       uint8_t alignment_log2) override;
@@ -69,6 +71,9 @@ public:
     zx_status_t CleanInvalidateCache(const uint64_t offset, const uint64_t len) override;
     zx_status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
+    zx_status_t GetPreferredNode(uint32_t* node) override;
+    zx_status_t SetPreferredNode(uint32_t node) override;
+
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                               vm_page_t**, paddr_t*) override
         // Calls a Locked method of the parent, which confuses analysis.
@@ -128,6 +133,7 @@ private:
     uint64_t size_ TA_GUARDED(lock_) = 0;
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
+    uint32_t preferred_node_ TA_GUARDED(lock_) = PMM_NODE_LOCAL;
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
@@ -0,0 +1,85 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_age.h>
+
+#include <assert.h>
+#include <err.h>
+#include <fbl/atomic.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/vm_aspace.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(page_age_scans, "kernel.vm.page_age.scans");
+KCOUNTER(page_age_accessed, "kernel.vm.page_age.accessed");
+
+namespace {
+
+constexpr uint32_t kDefaultScanMs = 1000;
+
+zx_duration_t scan_period;
+fbl::atomic<uint32_t> generation;
+
+int page_age_scanner(void* arg) {
+    for (;;) {
+        thread_sleep_relative(scan_period);
+
+        // Pages seen accessed from here on were used during the period that
+        // just ended, so they start the new generation at age zero.
+        generation.fetch_add(1);
+        HarvestAllUserAspacesAccessed();
+        kcounter_add(page_age_scans, 1);
+    }
+    return 0;
+}
+
+void page_age_init(uint level) {
+    const uint32_t scan_ms = cmdline_get_uint32("kernel.page-age.scan-ms", kDefaultScanMs);
+    if (scan_ms == 0) {
+        return;
+    }
+
+    scan_period = ZX_MSEC(scan_ms);
+    thread_t* t = thread_create("page-age", &page_age_scanner, nullptr, LOW_PRIORITY,
+                                DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("VM: failed to create page age scanner thread\n");
+        scan_period = 0;
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+zx_duration_t page_age_scan_period() {
+    return scan_period;
+}
+
+uint32_t page_age_generation() {
+    return generation.load();
+}
+
+void page_age_mark_accessed(vm_page_t* page) {
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_OBJECT);
+    page->object.access_gen = page_age_generation();
+    kcounter_add(page_age_accessed, 1);
+}
+
+uint32_t page_age(const vm_page_t* page) {
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_OBJECT);
+    // Unsigned arithmetic keeps this correct when the generation wraps.
+    return page_age_generation() - page->object.access_gen;
+}
+
+LK_INIT_HOOK(page_age, page_age_init, LK_INIT_LEVEL_USER);
@@ -26,6 +26,7 @@
 #include "pmm_arena.h"
 #include "vm_priv.h"
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -119,21 +120,126 @@ done_add:
     return ZX_OK;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint32_t node) {
+    const paddr_t end = ROUNDDOWN(base + size, PAGE_SIZE);
+    base = ROUNDUP(base, PAGE_SIZE);
+    if (end <= base)
+        return ZX_ERR_INVALID_ARGS;
+
     AutoLock al(&arena_lock);
 
-    /* walk the arenas in order until we find one with a free page */
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+    for (auto iter = arena_list.begin(); iter != arena_list.end(); ++iter) {
+        PmmArena& a = *iter;
+        const paddr_t arena_end = a.base() + a.size();
+
+        // split off the part of the arena below the range, the next pass of
+        // the loop will handle the part above
+        paddr_t split = 0;
+        if (a.base() < base && base < arena_end) {
+            split = base;
+        } else if (a.base() >= base && a.base() < end) {
+            a.set_node(node);
+            if (end < arena_end)
+                split = end;
+        }
+        if (split == 0)
+            continue;
+
+        fbl::AllocChecker ac;
+        PmmArena* tail = new (&ac) PmmArena();
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        a.SplitAt(split, tail);
+        arena_list.insert_after(iter, tail);
+
+        LTRACEF("split arena at %#" PRIxPTR ", node %u\n", split, a.node());
+    }
+
+    return ZX_OK;
+}
+
+uint32_t pmm_local_node() {
+    return mp_get_cpu_node(arch_curr_cpu_num());
+}
+
+bool pmm_node_has_memory(uint32_t node) {
+    AutoLock al(&arena_lock);
+
+    for (const auto& a : arena_list) {
+        if (a.node() == node)
+            return true;
+    }
+    return false;
+}
+
+uint32_t pmm_page_node(const vm_page_t* page) {
+    AutoLock al(&arena_lock);
+
+    for (const auto& a : arena_list) {
+        if (a.page_belongs_to_arena(page))
+            return a.node();
+    }
+    return 0;
+}
+
+// Call |func| on every arena usable for |alloc_flags|, starting with the ones
+// on |node|, until it returns true.
+template <typename F>
+static void pmm_for_each_arena_by_node(uint alloc_flags, uint32_t node, F func) TA_REQ(arena_lock) {
+    if (node == PMM_NODE_LOCAL)
+        node = pmm_local_node();
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto& a : arena_list) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            /* the first pass only looks at the preferred node, the second at every other */
+            if ((a.node() == node) != (pass == 0))
                 continue;
+
+            if (func(a))
+                return;
         }
+    }
+}
+
+static vm_page_t* pmm_alloc_page_locked(uint alloc_flags, uint32_t node,
+                                        paddr_t* pa) TA_REQ(arena_lock) {
+    vm_page_t* page = nullptr;
 
+    /* walk the arenas in order until we find one with a free page */
+    pmm_for_each_arena_by_node(alloc_flags, node, [&](PmmArena& a) {
         // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
-            return page;
+        page = a.AllocPage(pa);
+        return page != nullptr;
+    });
+
+    return page;
+}
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    return pmm_alloc_page_node(alloc_flags, PMM_NODE_LOCAL, pa);
+}
+
+vm_page_t* pmm_alloc_page_node(uint alloc_flags, uint32_t node, paddr_t* pa) {
+    vm_page_t* page;
+    {
+        AutoLock al(&arena_lock);
+        page = pmm_alloc_page_locked(alloc_flags, node, pa);
+    }
+    if (page)
+        return page;
+
+    // pre-zeroed pages are always from KMAP arenas, so they satisfy any flags
+    page = pmm_zero_pool_reclaim_page();
+    if (page) {
+        if (pa)
+            *pa = vm_page_to_paddr(page);
+        return page;
     }
 
     LTRACEF("failed to allocate page\n");
@@ -141,7 +247,11 @@ vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
-    LTRACEF("count %zu\n", count);
+    return pmm_alloc_pages_node(count, alloc_flags, PMM_NODE_LOCAL, list);
+}
+
+size_t pmm_alloc_pages_node(size_t count, uint alloc_flags, uint32_t node, struct list_node* list) {
+    LTRACEF("count %zu, node %u\n", count, node);
 
     /* list must be initialized prior to calling this */
     DEBUG_ASSERT(list);
@@ -153,21 +263,14 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
 
     /* walk the arenas in order, allocating as many pages as we can from each */
     size_t allocated = 0;
-    for (auto& a : arena_list) {
+    pmm_for_each_arena_by_node(alloc_flags, node, [&](PmmArena& a) {
         DEBUG_ASSERT(count > allocated);
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
-
         // ask the arena to allocate some pages
         allocated += a.AllocPages(count - allocated, list);
         DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
-    }
+        return allocated == count;
+    });
 
     return allocated;
 }
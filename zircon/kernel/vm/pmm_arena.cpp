@@ -104,6 +104,18 @@ zx_status_t PmmArena::Init(const pmm_arena_info_t* info) {
     return ZX_OK;
 }
 
+void PmmArena::InitForTest(const pmm_arena_info_t* info, vm_page_t* page_array) {
+    info_ = *info;
+    page_array_ = page_array;
+
+    for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
+        auto& p = page_array_[i];
+        p.state = VM_PAGE_STATE_FREE;
+        list_add_tail(&free_list_, &p.free.node);
+        free_count_++;
+    }
+}
+
 vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
     if (!page)
@@ -267,6 +279,36 @@ zx_status_t PmmArena::FreePage(vm_page_t* page) {
     return ZX_OK;
 }
 
+void PmmArena::SplitAt(paddr_t address, PmmArena* tail) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(address));
+    DEBUG_ASSERT(address > base() && address < base() + size());
+
+    const size_t split_index = (address - base()) / PAGE_SIZE;
+    const size_t page_count = size() / PAGE_SIZE;
+
+    tail->info_ = info_;
+    tail->info_.base = address;
+    tail->info_.size = size() - split_index * PAGE_SIZE;
+    tail->page_array_ = &page_array_[split_index];
+    tail->node_ = node_;
+#if PMM_ENABLE_FREE_FILL
+    tail->enforce_fill_ = enforce_fill_;
+#endif
+
+    // Move the free pages above the split point to the tail's free list.
+    for (size_t i = split_index; i < page_count; i++) {
+        vm_page_t* page = &page_array_[i];
+        if (page_is_free(page)) {
+            list_delete(&page->free.node);
+            free_count_--;
+            list_add_tail(&tail->free_list_, &page->free.node);
+            tail->free_count_++;
+        }
+    }
+
+    info_.size = split_index * PAGE_SIZE;
+}
+
 void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
     for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
         state_count[page_array_[i].state]++;
@@ -275,8 +317,8 @@ void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
 
 void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
     char pbuf[16];
-    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x\n", this, name(), base(),
-           format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
+    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x node %u\n", this, name(),
+           base(), format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags(), node());
     printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
 
     /* dump all of the pages */
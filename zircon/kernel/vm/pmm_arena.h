@@ -25,6 +25,10 @@ public:
     // initialize the arena and allocate memory for internal data structures
     zx_status_t Init(const pmm_arena_info_t* info);
 
+    // initialize the arena over a caller-owned |page_array| with every page free,
+    // for unit tests that cannot carve the array out of boot memory like Init()
+    void InitForTest(const pmm_arena_info_t* info, vm_page_t* page_array);
+
 #if PMM_ENABLE_FREE_FILL
     void EnforceFill();
 #endif
@@ -40,6 +44,10 @@ public:
     unsigned int priority() const { return info_.priority; }
     size_t free_count() const { return free_count_; };
 
+    // NUMA node of the memory in this arena.
+    uint32_t node() const { return node_; }
+    void set_node(uint32_t node) { node_ = node; }
+
     // Counts the number of pages in every state. For each page in the arena,
     // increments the corresponding VM_PAGE_STATE_*-indexed entry of
     // |state_count|. Does not zero out the entries first.
@@ -54,6 +62,11 @@ public:
     size_t AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list);
     zx_status_t FreePage(vm_page_t* page);
 
+    // Move the pages at and above |address| into the uninitialized arena
+    // |tail|, which shares this arena's page array. |address| must be page
+    // aligned and strictly inside the arena.
+    void SplitAt(paddr_t address, PmmArena* tail);
+
     // helpers
     bool page_belongs_to_arena(const vm_page* page) const {
         uintptr_t page_addr = reinterpret_cast<uintptr_t>(page);
@@ -86,6 +99,8 @@ private:
     size_t free_count_ = 0;
     list_node free_list_ = LIST_INITIAL_VALUE(free_list_);
 
+    uint32_t node_ = 0;
+
 #if PMM_ENABLE_FREE_FILL
     bool enforce_fill_ = false;
 #endif
@@ -0,0 +1,225 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/pmm.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/auto_lock.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <stdio.h>
+#include <trace.h>
+#include <vm/physmap.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// Each CPU runs a low priority thread that keeps a small pool of pages which
+// have already been zeroed, so that allocating a fresh anonymous page on a
+// fault does not have to pay for zeroing it. Pages are zeroed with
+// non-temporal stores, since a pooled page may sit unused for a long time.
+
+// The depth counter is raised and lowered on whichever CPU fills or drains a
+// pool, so only its sum across CPUs is meaningful.
+KCOUNTER(zero_pool_depth, "kernel.vm.zero_pool.depth");
+KCOUNTER(zero_pool_hit, "kernel.vm.zero_pool.hit");
+KCOUNTER(zero_pool_miss, "kernel.vm.zero_pool.miss");
+
+namespace {
+
+// Number of pre-zeroed pages each CPU tries to keep on hand.
+constexpr size_t kPoolTarget = 64;
+
+// The refill thread is woken when a page is wanted from a pool at or below
+// this depth, even if the pool is empty, so a pool the thread stopped filling
+// for lack of free memory is filled again once memory is available.
+constexpr size_t kPoolLowWater = kPoolTarget / 2;
+
+// Pools are not refilled while the PMM has fewer free pages than this, so
+// pre-zeroing never competes with real allocations for the last free memory.
+constexpr size_t kMinFreePages = 4096;
+
+struct ZeroPool {
+    SpinLock lock;
+    list_node pages TA_GUARDED(lock);
+    size_t count TA_GUARDED(lock);
+    // Set while the refill thread waits for |refill| to be signaled, so that
+    // only the first page taken below the low water mark signals it.
+    bool idle TA_GUARDED(lock);
+    event_t refill;
+};
+
+ZeroPool pools[SMP_MAX_CPUS];
+
+// Removes a page from |pool|, or returns nullptr if it is empty. Signals the
+// refill thread if it is idle and the pool is at or below the low water mark.
+vm_page_t* TakeFromPool(ZeroPool* pool) {
+    vm_page_t* page = nullptr;
+    bool refill;
+    {
+        AutoSpinLock guard(&pool->lock);
+        // Check the count before touching the list, since pools are only
+        // initialized once their CPU has started. Until then, |idle| is clear.
+        if (pool->count > 0) {
+            page = list_remove_head_type(&pool->pages, vm_page_t, free.node);
+            DEBUG_ASSERT(page);
+            pool->count--;
+        }
+        refill = pool->idle && pool->count <= kPoolLowWater;
+        if (refill) {
+            pool->idle = false;
+        }
+    }
+
+    if (page) {
+        kcounter_add(zero_pool_depth, -1);
+    }
+    if (refill) {
+        event_signal(&pool->refill, false);
+    }
+    return page;
+}
+
+int zero_pool_thread(void* arg) {
+    ZeroPool* pool = static_cast<ZeroPool*>(arg);
+
+    for (;;) {
+        __UNUSED zx_status_t status = event_wait(&pool->refill);
+        DEBUG_ASSERT(status == ZX_OK);
+
+        for (;;) {
+            {
+                AutoSpinLock guard(&pool->lock);
+                if (pool->count >= kPoolTarget) {
+                    break;
+                }
+            }
+            if (pmm_count_free_pages() < kMinFreePages) {
+                break;
+            }
+
+            // Pages must be in the physmap so they can be zeroed here and
+            // handed to KMAP allocations later.
+            paddr_t pa;
+            vm_page_t* page = pmm_alloc_page(PMM_ALLOC_FLAG_KMAP, &pa);
+            if (!page) {
+                break;
+            }
+            void* ptr = paddr_to_physmap(pa);
+            DEBUG_ASSERT(ptr);
+            arch_zero_page_nontemporal(ptr);
+
+            {
+                AutoSpinLock guard(&pool->lock);
+                list_add_tail(&pool->pages, &page->free.node);
+                pool->count++;
+            }
+            kcounter_add(zero_pool_depth, 1);
+        }
+
+        AutoSpinLock guard(&pool->lock);
+        pool->idle = true;
+    }
+
+    return 0;
+}
+
+void zero_pool_init(uint level) {
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    ZeroPool* pool = &pools[cpu];
+
+    {
+        AutoSpinLock guard(&pool->lock);
+        list_initialize(&pool->pages);
+        pool->count = 0;
+        pool->idle = false;
+    }
+    // The pool starts out empty, so the refill thread is woken at once.
+    event_init(&pool->refill, true, EVENT_FLAG_AUTOUNSIGNAL);
+
+    char name[16];
+    snprintf(name, sizeof(name), "zero-pool-%u", cpu);
+    thread_t* t = thread_create(name, &zero_pool_thread, pool, LOWEST_PRIORITY + 1,
+                                DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("PMM: failed to create zero pool thread for cpu %u\n", cpu);
+        return;
+    }
+    thread_set_cpu_affinity(t, cpu_num_to_mask(cpu));
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+vm_page_t* pmm_alloc_zeroed_page(uint alloc_flags, uint32_t node, paddr_t* pa) {
+    if (node == PMM_NODE_LOCAL || node == pmm_local_node()) {
+        vm_page_t* page = TakeFromPool(&pools[arch_curr_cpu_num()]);
+        if (page) {
+            kcounter_add(zero_pool_hit, 1);
+            if (pa) {
+                *pa = vm_page_to_paddr(page);
+            }
+            return page;
+        }
+        kcounter_add(zero_pool_miss, 1);
+    }
+
+    paddr_t page_pa;
+    vm_page_t* page = pmm_alloc_page_node(alloc_flags, node, &page_pa);
+    if (!page) {
+        return nullptr;
+    }
+    void* ptr = paddr_to_physmap(page_pa);
+    DEBUG_ASSERT(ptr);
+    arch_zero_page(ptr);
+
+    if (pa) {
+        *pa = page_pa;
+    }
+    return page;
+}
+
+vm_page_t* pmm_zero_pool_reclaim_page() {
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        vm_page_t* page = TakeFromPool(&pools[cpu]);
+        if (page) {
+            return page;
+        }
+    }
+    return nullptr;
+}
+
+static int cmd_zero_pool(int argc, const cmd_args* argv, uint32_t flags) {
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!mp_is_cpu_online(cpu)) {
+            continue;
+        }
+        ZeroPool* pool = &pools[cpu];
+        size_t count;
+        {
+            AutoSpinLock guard(&pool->lock);
+            count = pool->count;
+        }
+        printf("cpu %2u: %zu/%zu zeroed pages\n", cpu, count, kPoolTarget);
+    }
+    return ZX_OK;
+}
+
+LK_INIT_HOOK_FLAGS(pmm_zero_pool, zero_pool_init, LK_INIT_LEVEL_USER, LK_INIT_FLAG_ALL_CPUS);
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("zero_pool", "dump per-cpu pre-zeroed page pools", &cmd_zero_pool)
+#endif
+STATIC_COMMAND_END(zero_pool);
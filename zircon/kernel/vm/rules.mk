@@ -19,8 +19,10 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/bootalloc.cpp \
     $(LOCAL_DIR)/bootreserve.cpp \
     $(LOCAL_DIR)/page.cpp \
+    $(LOCAL_DIR)/page_age.cpp \
     $(LOCAL_DIR)/pmm.cpp \
     $(LOCAL_DIR)/pmm_arena.cpp \
+    $(LOCAL_DIR)/pmm_zero_pool.cpp \
     $(LOCAL_DIR)/vm.cpp \
     $(LOCAL_DIR)/vm_address_region.cpp \
     $(LOCAL_DIR)/vm_address_region_or_mapping.cpp \
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/array.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
@@ -585,6 +586,61 @@ void DumpAllAspaces(bool verbose) {
         a.Dump(verbose);
 }
 
+namespace {
+
+class AccessedHarvester final : public VmEnumerator {
+public:
+    bool OnVmMapping(const VmMapping* map, const VmAddressRegion* vmar,
+                     uint depth) final {
+        map->HarvestAccessedLocked();
+        return true;
+    }
+};
+
+} // namespace
+
+void HarvestAllUserAspacesAccessed() {
+    // Take references to the user aspaces under the list lock and walk them
+    // after dropping it, so that creating and destroying aspaces does not
+    // wait on the page table walks. The references are released outside the
+    // lock as well, since dropping the last one takes the lock to unlink.
+    fbl::Array<fbl::RefPtr<VmAspace>> refs;
+    {
+        AutoLock a(&aspace_list_lock);
+
+        size_t count = 0;
+        for (const auto& aspace : aspaces) {
+            if (aspace.is_user())
+                count++;
+        }
+        if (count == 0)
+            return;
+
+        fbl::AllocChecker ac;
+        refs.reset(new (&ac) fbl::RefPtr<VmAspace>[count], count);
+        if (!ac.check())
+            return;
+
+        size_t ix = 0;
+        for (auto& aspace : aspaces) {
+            if (!aspace.is_user())
+                continue;
+            // an aspace with no references left is blocked in its destructor
+            // on aspace_list_lock and is skipped
+            auto ref = fbl::internal::MakeRefPtrUpgradeFromRaw(&aspace, aspace_list_lock);
+            if (ref)
+                refs[ix++] = fbl::move(ref);
+        }
+    }
+
+    for (const auto& aspace : refs) {
+        if (!aspace)
+            continue;
+        AccessedHarvester harvester;
+        aspace->EnumerateChildren(&harvester);
+    }
+}
+
 VmAspace* VmAspace::vaddr_to_aspace(uintptr_t address) {
     if (is_kernel_address(address)) {
         return kernel_aspace();
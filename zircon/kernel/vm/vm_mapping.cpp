@@ -16,6 +16,8 @@
 #include <safeint/safe_math.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_age.h>
+#include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
@@ -51,6 +53,30 @@ size_t VmMapping::AllocatedPagesLocked() const {
     return object_->AllocatedPagesInRange(object_offset_, size_);
 }
 
+void VmMapping::HarvestAccessedLocked() const {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    if (state_ != LifeCycleState::ALIVE || !object_->is_paged()) {
+        return;
+    }
+
+    // The callback runs under the page table lock, so the page cannot be
+    // unmapped and freed underneath it. Pages not owned by a VMO, such as
+    // the shared zero page, have no age.
+    auto accessed_fn = [](vaddr_t vaddr, paddr_t paddr, void* context) {
+        vm_page_t* page = paddr_to_vm_page(paddr);
+        if (page && page->state == VM_PAGE_STATE_OBJECT) {
+            page_age_mark_accessed(page);
+        }
+    };
+    zx_status_t status = aspace_->arch_aspace().HarvestAccessed(base_, size_ / PAGE_SIZE,
+                                                                accessed_fn, nullptr);
+    if (status != ZX_OK && status != ZX_ERR_NOT_SUPPORTED) {
+        TRACEF("failed to harvest accessed flags of mapping %p, status %d\n", this, status);
+    }
+}
+
 void VmMapping::Dump(uint depth, bool verbose) const {
     canary_.Assert();
     for (uint i = 0; i < depth; ++i) {
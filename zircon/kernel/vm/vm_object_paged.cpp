@@ -20,6 +20,7 @@
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_age.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -48,6 +49,7 @@ void InitializeVmPage(vm_page_t* p) {
     p->state = VM_PAGE_STATE_OBJECT;
     p->object.pin_count = 0;
     p->object.contiguous_pin = 0;
+    p->object.access_gen = page_age_generation();
 }
 
 // round up the size to the next page size boundary and make sure we dont wrap
@@ -134,6 +136,9 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
     if (copy_name)
         vmo->name_ = name_;
 
+    // pages copied into the clone come from the same node as ours
+    vmo->preferred_node_ = preferred_node_;
+
     *clone_vmo = fbl::move(vmo);
 
     return ZX_OK;
@@ -192,6 +197,26 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     return count;
 }
 
+zx_status_t VmObjectPaged::GetPageAges(uint64_t* pages_by_age, size_t num_ages) const {
+    canary_.Assert();
+    DEBUG_ASSERT(num_ages > 0);
+
+    for (size_t i = 0; i < num_ages; i++) {
+        pages_by_age[i] = 0;
+    }
+
+    AutoLock a(&lock_);
+    // As with AllocatedPagesInRange(), pages still shared with our parent are
+    // counted against the parent.
+    page_list_.ForEveryPage(
+        [pages_by_age, num_ages](const auto p, uint64_t off) {
+            const size_t age = fbl::min<size_t>(page_age(p), num_ages - 1);
+            pages_by_age[age]++;
+            return ZX_ERR_NEXT;
+        });
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::AddPage(vm_page_t* p, uint64_t offset) {
     AutoLock a(&lock_);
 
@@ -335,7 +360,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
                 }
             }
             if (!p_clone) {
-                p_clone = pmm_alloc_page(pmm_alloc_flags_, &pa_clone);
+                p_clone = pmm_alloc_page_node(pmm_alloc_flags_, preferred_node_, &pa_clone);
             }
             if (!p_clone) {
                 return ZX_ERR_NO_MEMORY;
@@ -382,15 +407,17 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
-    // allocate a page
+    // allocate a page, preferring one that has already been zeroed
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page_t, free.node);
         if (p) {
             pa = vm_page_to_paddr(p);
+            // TODO: remove once pmm returns zeroed pages
+            ZeroPage(pa);
         }
     }
     if (!p) {
-        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        p = pmm_alloc_zeroed_page(pmm_alloc_flags_, preferred_node_, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -398,9 +425,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
     zx_status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == ZX_OK);
 
@@ -463,7 +487,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    size_t allocated = pmm_alloc_pages_node(count, pmm_alloc_flags_, preferred_node_, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
@@ -1048,6 +1072,26 @@ zx_status_t VmObjectPaged::SyncCache(const uint64_t offset, const uint64_t len)
     return CacheOp(offset, len, CacheOpType::Sync);
 }
 
+zx_status_t VmObjectPaged::GetPreferredNode(uint32_t* node) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    *node = preferred_node_;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SetPreferredNode(uint32_t node) {
+    canary_.Assert();
+
+    // a node with no memory would silently fall back to some other node
+    if (node != PMM_NODE_LOCAL && !pmm_node_has_memory(node))
+        return ZX_ERR_INVALID_ARGS;
+
+    AutoLock a(&lock_);
+    preferred_node_ = node;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t len,
                                    const CacheOpType type) {
     canary_.Assert();
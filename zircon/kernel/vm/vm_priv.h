@@ -117,6 +117,10 @@ static inline bool GetIntersect(O offset1, L len1, O offset2, L len2, O* offset_
     return true;
 }
 
+// Take a page back from the pre-zeroed page pools, for use when the PMM is
+// otherwise out of memory. Returns nullptr if every pool is empty.
+vm_page_t* pmm_zero_pool_reclaim_page();
+
 // return a pointer to the zero page
 static inline vm_page_t* vm_get_zero_page(void) {
     extern vm_page_t* zero_page;
@@ -8,6 +8,8 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <kernel/mp.h>
+#include <string.h>
 #include <unittest.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -17,6 +19,8 @@
 #include <vm/vm_object_physical.h>
 #include <zircon/types.h>
 
+#include "pmm_arena.h"
+
 static const uint kArchRwFlags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
 
 // Allocates a single page, translates it to a vm_page_t and frees it.
@@ -36,6 +40,119 @@ static bool pmm_smoke_test(void* context) {
     END_TEST;
 }
 
+// Splits an arena over a fake page array and checks that each half ends up
+// with its own pages.
+static bool pmm_arena_split_test(void* context) {
+    BEGIN_TEST;
+    static const size_t page_count = 8;
+    static const size_t split_index = 3;
+    static const paddr_t base = 0x10000000;
+
+    fbl::AllocChecker ac;
+    fbl::Array<vm_page_t> pages(new (&ac) vm_page_t[page_count](), page_count);
+    REQUIRE_TRUE(ac.check(), "");
+
+    pmm_arena_info_t info = {};
+    strlcpy(info.name, "test", sizeof(info.name));
+    info.base = base;
+    info.size = page_count * PAGE_SIZE;
+
+    PmmArena head;
+    head.InitForTest(&info, pages.get());
+    head.set_node(1);
+
+    // take one page out on each side of the split
+    vm_page_t* low = head.AllocSpecific(base);
+    vm_page_t* high = head.AllocSpecific(base + (page_count - 1) * PAGE_SIZE);
+    REQUIRE_NONNULL(low, "");
+    REQUIRE_NONNULL(high, "");
+
+    PmmArena tail;
+    head.SplitAt(base + split_index * PAGE_SIZE, &tail);
+
+    EXPECT_EQ(base, head.base(), "");
+    EXPECT_EQ(split_index * PAGE_SIZE, head.size(), "");
+    EXPECT_EQ(split_index - 1, head.free_count(), "");
+    EXPECT_EQ(base + split_index * PAGE_SIZE, tail.base(), "");
+    EXPECT_EQ((page_count - split_index) * PAGE_SIZE, tail.size(), "");
+    EXPECT_EQ(page_count - split_index - 1, tail.free_count(), "");
+    EXPECT_EQ(1u, tail.node(), "tail keeps the node");
+
+    EXPECT_TRUE(head.page_belongs_to_arena(&pages[split_index - 1]), "");
+    EXPECT_FALSE(head.page_belongs_to_arena(&pages[split_index]), "");
+    EXPECT_TRUE(tail.page_belongs_to_arena(&pages[split_index]), "");
+    EXPECT_FALSE(tail.page_belongs_to_arena(&pages[split_index - 1]), "");
+    EXPECT_EQ(base + (page_count - 1) * PAGE_SIZE, tail.page_address_from_arena(high), "");
+
+    // each half only hands out its own pages
+    for (size_t i = 0; i < split_index - 1; i++) {
+        paddr_t pa;
+        EXPECT_NONNULL(head.AllocPage(&pa), "");
+        EXPECT_TRUE(head.address_in_arena(pa), "");
+    }
+    EXPECT_NULL(head.AllocPage(nullptr), "head is empty");
+    for (size_t i = 0; i < page_count - split_index - 1; i++) {
+        paddr_t pa;
+        EXPECT_NONNULL(tail.AllocPage(&pa), "");
+        EXPECT_TRUE(tail.address_in_arena(pa), "");
+    }
+    EXPECT_NULL(tail.AllocPage(nullptr), "tail is empty");
+
+    // frees go back to the half that owns the page
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, head.FreePage(high), "");
+    EXPECT_EQ(ZX_OK, tail.FreePage(high), "");
+    EXPECT_EQ(1u, tail.free_count(), "");
+    EXPECT_EQ(ZX_OK, head.FreePage(low), "");
+    EXPECT_EQ(1u, head.free_count(), "");
+
+    END_TEST;
+}
+
+// Allocates from every node that has memory and checks that the pages come
+// from the requested node.
+static bool pmm_node_alloc_test(void* context) {
+    BEGIN_TEST;
+
+    for (cpu_num_t cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+        uint32_t node = mp_get_cpu_node(cpu);
+        if (!pmm_node_has_memory(node))
+            continue;
+
+        paddr_t pa;
+        vm_page_t* page = pmm_alloc_page_node(PMM_ALLOC_FLAG_ANY, node, &pa);
+        REQUIRE_NONNULL(page, "pmm_alloc_page_node");
+        EXPECT_EQ(node, pmm_page_node(page), "page from preferred node");
+        pmm_free_page(page);
+
+        list_node list = LIST_INITIAL_VALUE(list);
+        size_t count = pmm_alloc_pages_node(4, PMM_ALLOC_FLAG_ANY, node, &list);
+        EXPECT_EQ(4u, count, "pmm_alloc_pages_node");
+        list_for_every_entry (&list, page, vm_page_t, free.node) {
+            EXPECT_EQ(node, pmm_page_node(page), "page from preferred node");
+        }
+        pmm_free(&list);
+    }
+
+    // the local node is used when it has memory
+    uint32_t local = pmm_local_node();
+    if (pmm_node_has_memory(local)) {
+        vm_page_t* page = pmm_alloc_page_node(PMM_ALLOC_FLAG_ANY, PMM_NODE_LOCAL, nullptr);
+        REQUIRE_NONNULL(page, "pmm_alloc_page_node");
+        EXPECT_EQ(local, pmm_page_node(page), "page from local node");
+        pmm_free_page(page);
+    }
+
+    // a node without memory falls back to the others
+    static const uint32_t kNoMemoryNode = PMM_NODE_LOCAL - 1;
+    EXPECT_FALSE(pmm_node_has_memory(kNoMemoryNode), "");
+    vm_page_t* page = pmm_alloc_page_node(PMM_ALLOC_FLAG_ANY, kNoMemoryNode, nullptr);
+    EXPECT_NONNULL(page, "fallback allocation");
+    if (page)
+        pmm_free_page(page);
+
+    END_TEST;
+}
+
 // Allocates a bunch of pages then frees them.
 static bool pmm_large_alloc_test(void* context) {
     BEGIN_TEST;
@@ -964,11 +1081,72 @@ static bool arch_noncontiguous_map(void* context) {
     END_TEST;
 }
 
+// Touches one page of a mapping and checks that only it is reported accessed,
+// and only once.
+static bool arch_harvest_accessed(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+
+    auto ka = VmAspace::kernel_aspace();
+    uint8_t* ptr;
+    status = ka->MapObjectInternal(vmo, "test", 0, alloc_size, (void**)&ptr,
+                                   0, VmAspace::VMM_FLAG_COMMIT, kArchRwFlags);
+    REQUIRE_EQ(ZX_OK, status, "mapping object");
+
+    struct Accessed {
+        vaddr_t vaddrs[4];
+        size_t count;
+    };
+    auto accessed_fn = [](vaddr_t vaddr, paddr_t paddr, void* context) {
+        auto accessed = static_cast<Accessed*>(context);
+        if (accessed->count < fbl::count_of(accessed->vaddrs)) {
+            accessed->vaddrs[accessed->count] = vaddr;
+        }
+        accessed->count++;
+    };
+
+    // Clear whatever committing the pages left behind.
+    Accessed accessed = {};
+    status = ka->arch_aspace().HarvestAccessed(reinterpret_cast<vaddr_t>(ptr),
+                                               alloc_size / PAGE_SIZE, accessed_fn, &accessed);
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        unittest_printf("accessed flags not supported, skipping\n");
+    } else {
+        EXPECT_EQ(ZX_OK, status, "harvest");
+
+        ptr[PAGE_SIZE * 2] = 1;
+
+        accessed = {};
+        status = ka->arch_aspace().HarvestAccessed(reinterpret_cast<vaddr_t>(ptr),
+                                                   alloc_size / PAGE_SIZE, accessed_fn, &accessed);
+        EXPECT_EQ(ZX_OK, status, "harvest");
+        EXPECT_EQ(1u, accessed.count, "accessed count");
+        EXPECT_EQ(reinterpret_cast<vaddr_t>(ptr) + PAGE_SIZE * 2, accessed.vaddrs[0],
+                  "accessed vaddr");
+
+        // The flag was cleared by the previous harvest.
+        accessed = {};
+        status = ka->arch_aspace().HarvestAccessed(reinterpret_cast<vaddr_t>(ptr),
+                                                   alloc_size / PAGE_SIZE, accessed_fn, &accessed);
+        EXPECT_EQ(ZX_OK, status, "harvest");
+        EXPECT_EQ(0u, accessed.count, "accessed count");
+    }
+
+    status = ka->FreeRegion(reinterpret_cast<vaddr_t>(ptr));
+    EXPECT_EQ(ZX_OK, status, "unmapping object");
+    END_TEST;
+}
+
 // Use the function name as the test name
 #define VM_UNITTEST(fname) UNITTEST(#fname, fname)
 
 UNITTEST_START_TESTCASE(vm_tests)
 VM_UNITTEST(pmm_smoke_test)
+VM_UNITTEST(pmm_arena_split_test)
+VM_UNITTEST(pmm_node_alloc_test)
 // runs the system out of memory, uncomment for debugging
 //VM_UNITTEST(pmm_large_alloc_test)
 //VM_UNITTEST(pmm_oversized_alloc_test)
@@ -996,6 +1174,7 @@ VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
 VM_UNITTEST(arch_noncontiguous_map)
+VM_UNITTEST(arch_harvest_accessed)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
 UNITTEST_END_TESTCASE(vm_tests, "vmtests", "Virtual memory tests", nullptr, nullptr);
@@ -40,6 +40,7 @@ THINLTO_CACHE_DIR ?= $(BUILDDIR)/thinlto-cache
 LKNAME ?= zircon
 CLANG_TARGET_FUCHSIA ?= false
 USE_LINKER_GC ?= true
+ENABLE_LOCK_PROFILING ?= $(call TOBOOL,$(DEBUG))
 HOST_USE_ASAN ?= false
 
 ifeq ($(call TOBOOL,$(ENABLE_ULIB_ONLY)),true)
@@ -374,6 +375,13 @@ MDI_INCLUDES := system/public/zircon/mdi/zircon.mdi
 KERNEL_DEFINES += WITH_PANIC_BACKTRACE=1 WITH_FRAME_POINTERS=1
 KERNEL_COMPILEFLAGS += $(KEEP_FRAME_POINTER_COMPILEFLAGS)
 
+# Record per acquisition site contention of kernel mutexes and spin locks.
+# Debug builds include it, but only record once asked to.
+# See kernel/include/kernel/lock_profile.h.
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+KERNEL_DEFINES += WITH_LOCK_PROFILING=1
+endif
+
 # userspace boot file system generated by the build system
 USER_BOOTDATA := $(BUILDDIR)/bootdata.bin
 USER_FS := $(BUILDDIR)/user.fs
@@ -394,6 +394,9 @@ int main(int argc, char** argv) {
             // switch from bootfs-loader to system-loader
             zx_handle_close(dl_set_loader_service(svc));
         }
+        // Load the libraries nearly every process needs up front, so
+        // that starting processes doesn't have to read them each time.
+        loader_service_prewarm_from_file("/boot/config/loader-prewarm");
     }
 
     if (bootdata_ramdisk_list != NULL) {
@@ -18,6 +18,7 @@ MODULE_SRCS := \
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
+    third_party/ulib/lz4.hostlib \
     system/ulib/blobstore.hostlib \
     system/ulib/digest.hostlib \
     system/ulib/fbl.hostlib \
@@ -88,6 +88,15 @@
 #define IOCTL_VFS_GET_DEVICE_PATH \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 9)
 
+// Returns counters blobstore keeps of the blobs it has read.
+#define IOCTL_VFS_GET_BLOBSTORE_METRICS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 10)
+
+// Returns the number of extents of a file: the runs of blocks which are
+// contiguous both within the file and on disk.
+#define IOCTL_VFS_GET_EXTENT_COUNT \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 11)
+
 typedef struct {
     zx_handle_t channel; // Channel to which watch events will be sent
     uint32_t mask;       // Bitmask of desired events (1 << WATCH_EVT_*)
@@ -164,6 +173,18 @@ typedef struct vfs_query_info {
 // ssize_t ioctl_vfs_query_fs(int fd, vfs_query_info_t* out, size_t out_len);
 IOCTL_WRAPPER_VAROUT(ioctl_vfs_query_fs, IOCTL_VFS_QUERY_FS, vfs_query_info_t);
 
+typedef struct vfs_blobstore_metrics {
+    uint64_t chunks_decompressed; // LZ4 chunks of compressed blobs decompressed.
+    uint64_t decompress_ns;       // Time spent decompressing them.
+} vfs_blobstore_metrics_t;
+
+// ssize_t ioctl_vfs_get_blobstore_metrics(int fd, vfs_blobstore_metrics_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_get_blobstore_metrics, IOCTL_VFS_GET_BLOBSTORE_METRICS,
+                  vfs_blobstore_metrics_t);
+
+// ssize_t ioctl_vfs_get_extent_count(int fd, uint32_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_get_extent_count, IOCTL_VFS_GET_EXTENT_COUNT, uint32_t);
+
 // ssize_t ioctl_vfs_get_token(int fd, zx_handle_t* out);
 IOCTL_WRAPPER_OUT(ioctl_vfs_get_token, IOCTL_VFS_GET_TOKEN, zx_handle_t);
 
@@ -56,6 +56,11 @@ KTRACE_DEF(0x160,32B,KWAIT_BLOCK,SCHEDULER) // queue_hi, queue_hi
 KTRACE_DEF(0x161,32B,KWAIT_WAKE,SCHEDULER) // queue_hi, queue_hi, is_mutex
 KTRACE_DEF(0x162,32B,KWAIT_UNBLOCK,SCHEDULER) // queue_hi, queue_hi, blocked_status
 
+// lock profiling kernels emit one of each per acquisition site when tracing stops
+KTRACE_DEF(0x170,32B,LOCK_PROFILE_SITE,LOCK) // pc_hi, pc_lo, kind (0 mutex, 1 spin), acquisitions
+KTRACE_DEF(0x171,32B,LOCK_PROFILE_TIME,LOCK) // contended, wait_us, hold_us
+KTRACE_DEF(0x172,32B,LOCK_PROFILE_MAX,LOCK) // max_wait_ns, max_hold_ns
+
 // events from 0x200-0x2ff are for arch-specific needs
 
 #ifdef __x86_64__
@@ -26,7 +26,7 @@
     (ZX_RIGHTS_BASIC | ZX_RIGHT_WRITE)
 
 #define ZX_DEFAULT_INTERRUPT_RIGHTS \
-    (ZX_RIGHT_TRANSFER | ZX_RIGHT_WAIT | ZX_RIGHTS_IO)
+    (ZX_RIGHT_TRANSFER | ZX_RIGHT_WAIT | ZX_RIGHTS_IO | ZX_RIGHTS_PROPERTY)
 
 #define ZX_DEFAULT_IO_MAPPING_RIGHTS \
     (ZX_RIGHT_READ)
@@ -43,7 +43,7 @@
     (ZX_RIGHTS_BASIC | ZX_RIGHTS_IO)
 
 #define ZX_DEFAULT_PCI_INTERRUPT_RIGHTS \
-    (ZX_RIGHT_TRANSFER | ZX_RIGHT_WAIT | ZX_RIGHTS_IO)
+    (ZX_RIGHT_TRANSFER | ZX_RIGHT_WAIT | ZX_RIGHTS_IO | ZX_RIGHTS_PROPERTY)
 
 #define ZX_DEFAULT_PORT_RIGHTS \
     (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHTS_IO)
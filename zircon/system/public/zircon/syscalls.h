@@ -7,6 +7,8 @@
 #include <zircon/types.h>
 #include <zircon/syscalls/types.h>
 
+#include <zircon/syscalls/batch.h>
+#include <zircon/syscalls/fifo.h>
 #include <zircon/syscalls/pci.h>
 #include <zircon/syscalls/object.h>
 
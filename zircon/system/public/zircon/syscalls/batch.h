@@ -0,0 +1,52 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+// ask clang format not to mess up the indentation:
+// clang-format off
+
+__BEGIN_CDECLS
+
+// Defines and structures for zx_batch_execute()
+
+// Operations. Each one behaves like the syscall it is named after.
+#define ZX_BATCH_OP_CHANNEL_READ    ((uint32_t)1u)
+#define ZX_BATCH_OP_CHANNEL_WRITE   ((uint32_t)2u)
+#define ZX_BATCH_OP_SOCKET_READ     ((uint32_t)3u)
+#define ZX_BATCH_OP_SOCKET_WRITE    ((uint32_t)4u)
+#define ZX_BATCH_OP_FIFO_READ       ((uint32_t)5u)
+#define ZX_BATCH_OP_FIFO_WRITE      ((uint32_t)6u)
+#define ZX_BATCH_OP_VMO_READ        ((uint32_t)7u)
+#define ZX_BATCH_OP_VMO_WRITE       ((uint32_t)8u)
+
+// The most operations a single zx_batch_execute() call accepts.
+#define ZX_BATCH_MAX_OPS            64u
+
+typedef struct zx_batch_op {
+    // ZX_BATCH_OP_*
+    uint32_t op;
+    zx_handle_t handle;
+    // Passed as the options of the corresponding syscall.
+    uint32_t options;
+    uint32_t reserved;
+    // Byte offset for the vmo operations; must be 0 otherwise.
+    uint64_t offset;
+    void* buffer;
+    // Size of |buffer| in bytes.
+    size_t size;
+} zx_batch_op_t;
+
+typedef struct zx_batch_result {
+    zx_status_t status;
+    uint32_t reserved;
+    // Bytes transferred, or fifo elements for the fifo operations. For a
+    // channel read that fails with ZX_ERR_BUFFER_TOO_SMALL, the size of the
+    // pending message.
+    uint64_t actual;
+} zx_batch_result_t;
+
+__END_CDECLS
@@ -0,0 +1,69 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+// ask clang format not to mess up the indentation:
+// clang-format off
+
+__BEGIN_CDECLS
+
+// Defines and structures for fifos created with ZX_FIFO_SHARED_RING.
+//
+// Each direction of such a fifo is a ring in a VMO that both peers map; see
+// zx_fifo_get_ring(). A ring starts with a zx_fifo_ring_t header, and its
+// elem_count entries of elem_size bytes follow at ZX_FIFO_RING_ENTRIES_OFFSET.
+// The entry for index i is at (i & (elem_count - 1)).
+//
+// |head| and |tail| are free-running: the ring holds (head - tail) entries.
+// The producer fills entries and then publishes them by advancing |head| with
+// a release store. The consumer reads entries and then frees them by
+// advancing |tail| with a release store. Each side loads the other's index
+// with an acquire load.
+//
+// The kernel is not involved in moving entries. It only keeps the
+// ZX_FIFO_READABLE and ZX_FIFO_WRITABLE signals up to date. Either side can
+// ring the doorbell with a zero length zx_fifo_read() or zx_fifo_write(),
+// which makes the kernel recompute both signals for the ring being read or
+// written from its current indices.
+//
+// A side that finds the ring empty (consumer) or full (producer) sets its bit
+// in |waiters|, checks the indices again, then rings the doorbell and waits
+// for the signal. After advancing its own index, a side that finds the
+// other side's bit set clears it and rings the doorbell. Both sides use
+// sequentially consistent atomics for |waiters| and the index it pairs with.
+typedef struct zx_fifo_ring {
+    // Written only by the producer.
+    uint32_t head;
+    uint32_t reserved0[15];
+    // Written only by the consumer.
+    uint32_t tail;
+    uint32_t reserved1[15];
+    // ZX_FIFO_RING_* bits.
+    uint32_t waiters;
+    uint32_t reserved2[15];
+} zx_fifo_ring_t;
+
+// The consumer is waiting for ZX_FIFO_READABLE.
+#define ZX_FIFO_RING_CONSUMER_WAITING   ((uint32_t)1u << 0)
+// The producer is waiting for ZX_FIFO_WRITABLE.
+#define ZX_FIFO_RING_PRODUCER_WAITING   ((uint32_t)1u << 1)
+
+#define ZX_FIFO_RING_ENTRIES_OFFSET     256u
+
+// Describes the VMO returned by zx_fifo_get_ring().
+typedef struct zx_fifo_ring_info {
+    // Size of the VMO.
+    uint64_t vmo_size;
+    // Offset of the ring this handle reads from.
+    uint64_t read_ring_offset;
+    // Offset of the ring this handle writes to.
+    uint64_t write_ring_offset;
+    uint32_t elem_count;
+    uint32_t elem_size;
+} zx_fifo_ring_info_t;
+
+__END_CDECLS
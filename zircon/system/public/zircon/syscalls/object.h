@@ -31,6 +31,7 @@ typedef enum {
     ZX_INFO_KMEM_STATS                 = 17, // zx_info_kmem_stats_t[1]
     ZX_INFO_RESOURCE                   = 18, // zx_info_resource_t[1]
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
+    ZX_INFO_VMO_WORKING_SET            = 20, // zx_info_vmo_working_set_t[1]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -116,6 +117,10 @@ typedef struct zx_info_thread {
     // Note: If the thread is waiting for an exception response then |state|
     // will have the value ZX_THREAD_STATE_BLOCKED.
     uint32_t wait_exception_port_type;
+
+    // The priority the thread is scheduled at, including any it inherits
+    // from threads waiting for priority inheritance futexes it owns.
+    int32_t effective_priority;
 } zx_info_thread_t;
 
 typedef struct zx_info_thread_stats {
@@ -344,6 +349,24 @@ typedef struct zx_info_kmem_stats {
     uint64_t other_bytes;
 } zx_info_kmem_stats_t;
 
+// Number of entries in zx_info_vmo_working_set_t.pages_by_age.
+#define ZX_INFO_VMO_WORKING_SET_AGES        8
+
+// Describes how recently the pages of a VMO were used.
+typedef struct zx_info_vmo_working_set {
+    // How often the kernel samples whether pages were accessed through a
+    // mapping, in nanoseconds. Zero if sampling is disabled, in which case
+    // every page is reported as age zero.
+    zx_duration_t scan_period;
+
+    // The number of pages committed to the VMO, indexed by the number of
+    // scan periods since each page was last accessed. Pages not accessed for
+    // ZX_INFO_VMO_WORKING_SET_AGES - 1 or more periods are counted in the
+    // last entry. Pages a clone still shares with its parent are counted
+    // against the parent.
+    uint64_t pages_by_age[ZX_INFO_VMO_WORKING_SET_AGES];
+} zx_info_vmo_working_set_t;
+
 typedef struct zx_info_resource {
     // The resource kind, one of:
     // {ZX_RSRC_KIND_ROOT, ZX_RSRC_KIND_MMIO, ZX_RSRC_KIND_IOPORT, ZX_RSRC_KIND_IRQ}
@@ -377,6 +400,22 @@ typedef struct zx_info_resource {
 // Argument is an zx_job_importance_t value.
 #define ZX_PROP_JOB_IMPORTANCE             7u
 
+// Argument is a uint32_t: the NUMA node that pages committed to a VMO are
+// preferably allocated from, or ZX_VMO_NUMA_NODE_LOCAL.
+#define ZX_PROP_VMO_NUMA_NODE               8u
+
+// Allocate VMO pages on the node of the cpu that commits them. This is the
+// default.
+#define ZX_VMO_NUMA_NODE_LOCAL              ((uint32_t)-1)
+
+// Argument is a uint32_t: the cpu that an interrupt object's hardware
+// interrupts are delivered to, or ZX_INTERRUPT_AFFINITY_DEFAULT.
+#define ZX_PROP_INTERRUPT_AFFINITY          9u
+
+// The interrupt is delivered wherever the platform routes it by default.
+// Only reported by get; set requires a cpu number.
+#define ZX_INTERRUPT_AFFINITY_DEFAULT       ((uint32_t)-1)
+
 // Describes how important a job is.
 typedef int32_t zx_job_importance_t;
 
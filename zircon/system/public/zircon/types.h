@@ -287,6 +287,11 @@ typedef uint64_t zx_off_t;
 #define ZX_CHANNEL_MAX_MSG_BYTES            65536u
 #define ZX_CHANNEL_MAX_MSG_HANDLES          64u
 
+// Fifo options.
+// These can be passed to zx_fifo_create()
+#define ZX_FIFO_SHARED_RING                 (1u << 0)
+#define ZX_FIFO_CREATE_MASK                 (ZX_FIFO_SHARED_RING)
+
 // Socket options and limits.
 // These options can be passed to zx_socket_write()
 #define ZX_SOCKET_SHUTDOWN_WRITE            (1u << 0)
@@ -324,6 +329,12 @@ typedef enum {
 #define ZX_TIMER_SLACK_LATE         2u
 
 
+// For priority inheritance futexes (see zx_futex_wait_pi()), the futex value
+// is the owning thread's handle, or 0 when the futex is not owned.  Handle
+// values never have this bit set, so it is free to mark owned futexes that
+// may have waiters.
+#define ZX_FUTEX_PI_WAITERS ((int)0x80000000)
+
 #ifdef __cplusplus
 // We cannot use <stdatomic.h> with C++ code as _Atomic qualifier defined by
 // C11 is not valid in C++11. There is not a single standard name that can
@@ -0,0 +1,280 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zircon/device/ktrace.h>
+#include <zircon/ktrace.h>
+#include <zircon/syscalls.h>
+
+// Reports kernel lock contention from the TAG_LOCK_PROFILE_* records that
+// lock profiling kernels write when a trace stops. See
+// kernel/include/kernel/lock_profile.h.
+
+#define KTRACE_DEV "/dev/misc/ktrace"
+
+typedef struct site {
+    uint64_t pc;
+    uint32_t kind;
+    uint32_t acquisitions;
+    uint32_t contended;
+    uint32_t wait_us;
+    uint32_t hold_us;
+    uint32_t max_wait_ns;
+    uint32_t max_hold_ns;
+} site_t;
+
+typedef struct profile {
+    site_t* sites;
+    size_t count;
+    size_t capacity;
+} profile_t;
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: lockstat [options] [trace]\n"
+        "\n"
+        "Reports the kernel lock acquisition sites with the most waiting, from\n"
+        "a trace file, or else from a snapshot taken with " KTRACE_DEV ",\n"
+        "which stops any trace in progress.\n"
+        "\n"
+        "options: -n <count>  show this many sites (default 20)\n"
+        "         -t <secs>   report the contention over this many seconds\n"
+        "         -h          show help\n");
+}
+
+static site_t* profile_find(profile_t* p, uint64_t pc) {
+    for (size_t i = 0; i < p->count; i++) {
+        if (p->sites[i].pc == pc)
+            return &p->sites[i];
+    }
+    return NULL;
+}
+
+// A trace may hold more than one snapshot; the last of each site wins.
+static site_t* profile_add(profile_t* p, uint64_t pc) {
+    site_t* site = profile_find(p, pc);
+    if (site == NULL) {
+        if (p->count == p->capacity) {
+            size_t capacity = p->capacity ? p->capacity * 2 : 256;
+            site_t* sites = realloc(p->sites, capacity * sizeof(site_t));
+            if (sites == NULL)
+                return NULL;
+            p->sites = sites;
+            p->capacity = capacity;
+        }
+        site = &p->sites[p->count++];
+    }
+    memset(site, 0, sizeof(*site));
+    site->pc = pc;
+    return site;
+}
+
+static int parse_trace(const uint8_t* buf, size_t len, profile_t* p) {
+    // The kernel writes the records of a site one after another.
+    site_t* site = NULL;
+    for (size_t off = 0; off + KTRACE_HDRSIZE <= len;) {
+        uint32_t tag;
+        memcpy(&tag, buf + off, sizeof(tag));
+        size_t reclen = KTRACE_LEN(tag);
+        if (reclen == 0 || off + reclen > len)
+            break;
+
+        ktrace_rec_32b_t rec;
+        if (reclen == sizeof(rec))
+            memcpy(&rec, buf + off, sizeof(rec));
+        switch (reclen == sizeof(rec) ? tag : 0) {
+        case TAG_LOCK_PROFILE_SITE:
+            site = profile_add(p, ((uint64_t)rec.a << 32) | rec.b);
+            if (site == NULL)
+                return -1;
+            site->kind = rec.c;
+            site->acquisitions = rec.d;
+            break;
+        case TAG_LOCK_PROFILE_TIME:
+            if (site != NULL) {
+                site->contended = rec.a;
+                site->wait_us = rec.b;
+                site->hold_us = rec.c;
+            }
+            break;
+        case TAG_LOCK_PROFILE_MAX:
+            if (site != NULL) {
+                site->max_wait_ns = rec.a;
+                site->max_hold_ns = rec.b;
+            }
+            site = NULL;
+            break;
+        }
+        off += reclen;
+    }
+    return 0;
+}
+
+static int read_trace(const char* path, profile_t* p) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "lockstat: cannot open '%s'\n", path);
+        return -1;
+    }
+
+    size_t len = 0;
+    size_t capacity = 1024 * 1024;
+    uint8_t* buf = malloc(capacity);
+    for (;;) {
+        if (buf == NULL) {
+            fprintf(stderr, "lockstat: out of memory\n");
+            close(fd);
+            return -1;
+        }
+        ssize_t r = read(fd, buf + len, capacity - len);
+        if (r < 0) {
+            fprintf(stderr, "lockstat: cannot read '%s'\n", path);
+            free(buf);
+            close(fd);
+            return -1;
+        } else if (r == 0) {
+            break;
+        }
+        len += r;
+        if (len == capacity) {
+            capacity *= 2;
+            uint8_t* grown = realloc(buf, capacity);
+            if (grown == NULL)
+                free(buf);
+            buf = grown;
+        }
+    }
+    close(fd);
+
+    int status = parse_trace(buf, len, p);
+    free(buf);
+    if (status < 0)
+        fprintf(stderr, "lockstat: out of memory\n");
+    return status;
+}
+
+// Stopping a trace makes the kernel write the records of every site.
+static int snapshot(profile_t* p) {
+    int fd = open(KTRACE_DEV, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "lockstat: cannot open " KTRACE_DEV "\n");
+        return -1;
+    }
+    uint32_t group_mask = KTRACE_GRP_LOCK;
+    ssize_t r = ioctl_ktrace_stop(fd);
+    if (r >= 0)
+        r = ioctl_ktrace_start(fd, &group_mask);
+    if (r >= 0)
+        r = ioctl_ktrace_stop(fd);
+    close(fd);
+    if (r < 0) {
+        fprintf(stderr, "lockstat: cannot take a ktrace snapshot: %zd\n", r);
+        return -1;
+    }
+    return read_trace(KTRACE_DEV, p);
+}
+
+// Leaves in |after| what happened since |before|. The maximums can't be
+// separated out, so they stay those since recording began.
+static void profile_subtract(profile_t* after, profile_t* before) {
+    for (size_t i = 0; i < after->count; i++) {
+        site_t* site = &after->sites[i];
+        const site_t* old = profile_find(before, site->pc);
+        if (old == NULL || old->acquisitions > site->acquisitions)
+            continue;
+        site->acquisitions -= old->acquisitions;
+        site->contended -= old->contended;
+        site->wait_us -= old->wait_us;
+        site->hold_us -= old->hold_us;
+    }
+}
+
+// Sorted by total wait, most first, then by acquisitions.
+static int site_compare(const void* a, const void* b) {
+    const site_t* x = a;
+    const site_t* y = b;
+    if (x->wait_us != y->wait_us)
+        return x->wait_us > y->wait_us ? -1 : 1;
+    if (x->acquisitions != y->acquisitions)
+        return x->acquisitions > y->acquisitions ? -1 : 1;
+    return 0;
+}
+
+static void profile_print(profile_t* p, size_t max) {
+    qsort(p->sites, p->count, sizeof(site_t), site_compare);
+
+    printf("%18s %4s %10s %10s %12s %12s %12s %12s\n", "site", "kind", "acquired",
+           "contended", "wait us", "hold us", "max wait ns", "max hold ns");
+    size_t shown = 0;
+    for (size_t i = 0; i < p->count && shown < max; i++) {
+        const site_t* site = &p->sites[i];
+        if (site->acquisitions == 0)
+            continue;
+        printf("%#18" PRIx64 " %4s %10u %10u %12u %12u %12u %12u\n", site->pc,
+               site->kind == 1 ? "spin" : "mtx", site->acquisitions, site->contended,
+               site->wait_us, site->hold_us, site->max_wait_ns, site->max_hold_ns);
+        shown++;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t max = 20;
+    uint32_t seconds = 0;
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h")) {
+            usage();
+            return 0;
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            max = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            seconds = strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage();
+            return -1;
+        }
+    }
+    if (path != NULL && seconds != 0) {
+        fprintf(stderr, "lockstat: -t takes snapshots, so it can't read a trace file\n");
+        return -1;
+    }
+
+    profile_t profile = {};
+    if (path != NULL) {
+        if (read_trace(path, &profile) < 0)
+            return -1;
+    } else if (seconds != 0) {
+        profile_t before = {};
+        if (snapshot(&before) < 0)
+            return -1;
+        zx_nanosleep(zx_deadline_after(ZX_SEC(seconds)));
+        if (snapshot(&profile) < 0)
+            return -1;
+        profile_subtract(&profile, &before);
+        free(before.sites);
+    } else if (snapshot(&profile) < 0) {
+        return -1;
+    }
+
+    if (profile.count == 0) {
+        fprintf(stderr,
+                "lockstat: no lock profile records; the kernel must be built with\n"
+                "ENABLE_LOCK_PROFILING=true and be recording (kernel.lockprof=true\n"
+                "or \"k lockprof start\")\n");
+        return -1;
+    }
+    profile_print(&profile, max);
+    free(profile.sites);
+    return 0;
+}
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,6 +25,7 @@
 #define ZXDEBUG 0
 
 #include <blobstore/blobstore.h>
+#include <blobstore/lz4.h>
 
 using digest::Digest;
 using digest::MerkleTree;
@@ -106,6 +108,35 @@ zx_status_t CheckFvmConsistency(const blobstore_info_t* info, int block_fd) {
     return ZX_OK;
 }
 
+// Enqueues reads of the blocks in [start, end) which are not set in |loaded|, as one
+// request per run. Block n is read from |dev_start| + n into |vmo_start| + n of the VMO.
+void EnqueueMissing(ReadTxn* txn, vmoid_t vmoid, const bitmap::RleBitmap& loaded,
+                    uint64_t vmo_start, uint64_t dev_start, uint64_t start, uint64_t end) {
+    for (uint64_t n = start; n < end;) {
+        if (loaded.Get(n, n + 1)) {
+            n++;
+            continue;
+        }
+        uint64_t run_end = n + 1;
+        while (run_end < end && !loaded.Get(run_end, run_end + 1)) {
+            run_end++;
+        }
+        txn->Enqueue(vmoid, vmo_start + n, dev_start + n, run_end - n);
+        n = run_end;
+    }
+}
+
+// Marks a slot of the node index which holds no node.
+constexpr uint32_t kNodeIndexEmpty = UINT32_MAX;
+constexpr size_t kNodeIndexMinSlots = 64;
+
+// Merkle roots are already uniformly distributed, so any part of one serves as its hash.
+size_t NodeIndexHash(const uint8_t* key) {
+    uint64_t hash;
+    memcpy(&hash, key, sizeof(hash));
+    return static_cast<size_t>(hash);
+}
+
 }  // namespace
 
 
@@ -118,10 +149,6 @@ zx_status_t VnodeBlob::Verify() const {
     ZX_DEBUG_ASSERT(blob_ != nullptr);
 
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest d;
     d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     return MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
@@ -151,14 +178,211 @@ zx_status_t VnodeBlob::InitVmos() {
         return status;
     }
 
+    if (inode->flags & kBlobstoreInodeFlagLZ4) {
+        const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+        if (inode->num_blocks <= merkle_blocks) {
+            BlobCloseHandles();
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        const uint64_t compressed_blocks = inode->num_blocks - merkle_blocks;
+        if ((status = MappedVmo::Create(compressed_blocks * kBlobstoreBlockSize, "blob-lz4",
+                                        &compressed_)) != ZX_OK) {
+            FS_TRACE_ERROR("Failed to initialize vmo; error: %d\n", status);
+            BlobCloseHandles();
+            return status;
+        }
+        if ((status = blobstore_->AttachVmo(compressed_->GetVmo(), &compressed_vmoid_)) != ZX_OK) {
+            FS_TRACE_ERROR("Failed to attach VMO to block device; error: %d\n", status);
+            BlobCloseHandles();
+            return status;
+        }
+    }
+
+    // Nothing is read up front: each read brings in the data it touches, along
+    // with the nodes of the Merkle Tree needed to verify that data.
+    data_loaded_.ClearAll();
+    merkle_loaded_.ClearAll();
+    compressed_loaded_.ClearAll();
+    return ZX_OK;
+}
+
+void VnodeBlob::EnqueueMerkle(ReadTxn* txn, uint64_t start, uint64_t end) {
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_);
+    constexpr uint64_t kDigestsPerNode = kBlobstoreBlockSize / Digest::kLength;
+
+    // Walk up the levels of the tree as MerkleTree::Verify does. The nodes [start, end)
+    // of each level are checked against the digests held in the level above, up to
+    // the single node of the top level, which is checked against the root.
+    uint64_t level_len = inode->blob_size;
+    uint64_t level_off = 0;
+    while (level_len > kBlobstoreBlockSize) {
+        const uint64_t next_len = fbl::round_up(
+            fbl::round_up(level_len, kBlobstoreBlockSize) / kDigestsPerNode, kBlobstoreBlockSize);
+        const uint64_t first = start * Digest::kLength;
+        const uint64_t last = end * Digest::kLength;
+        start = (level_off + first) / kBlobstoreBlockSize;
+        end = fbl::round_up(level_off + last, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+        EnqueueMissing(txn, vmoid_, merkle_loaded_, 0, dev_start, start, end);
+        merkle_loaded_.Set(start, end);
+
+        // The nodes of the next level up are counted from its own start.
+        start = first / kBlobstoreBlockSize;
+        end = fbl::round_up(last, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+        level_off += next_len;
+        level_len = next_len;
+    }
+}
+
+zx_status_t VnodeBlob::ChunkFrame(uint64_t n, uint64_t* out_start, uint64_t* out_end) const {
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    zx_status_t status = BlobChunkFrame(*inode, compressed_->GetData(), compressed_->GetSize(),
+                                        n, out_start, out_end);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Bad frame for chunk %" PRIu64 "\n", n);
+    }
+    return status;
+}
+
+zx_status_t VnodeBlob::EnqueueCompressed(ReadTxn* txn, uint64_t start, uint64_t end) {
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_) +
+                               MerkleTreeBlocks(*inode);
+    const uint64_t table_blocks = fbl::round_up(BlobChunkTableSize(*inode),
+                                                kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    if (table_blocks * kBlobstoreBlockSize > compressed_->GetSize()) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    // The table locates the frames, so it is read ahead of them.
+    zx_status_t status;
+    if (!compressed_loaded_.Get(0, table_blocks)) {
+        ReadTxn table_txn(blobstore_.get());
+        EnqueueMissing(&table_txn, compressed_vmoid_, compressed_loaded_, 0, dev_start, 0,
+                       table_blocks);
+        if ((status = table_txn.Flush()) != ZX_OK) {
+            return status;
+        }
+        compressed_loaded_.Set(0, table_blocks);
+    }
+
+    // Frames are stored back to back, so the chunks covering [start, end) lie in a
+    // single range of the compressed blocks.
+    uint64_t first_chunk = start / kBlobstoreChunkBlocks;
+    uint64_t last_chunk = fbl::round_up(end, kBlobstoreChunkBlocks) / kBlobstoreChunkBlocks;
+    uint64_t frames_start = 0;
+    uint64_t frames_end = 0;
+    for (uint64_t n = first_chunk; n < last_chunk; n++) {
+        uint64_t frame_start;
+        if ((status = ChunkFrame(n, &frame_start, &frames_end)) != ZX_OK) {
+            return status;
+        } else if (n == first_chunk) {
+            frames_start = frame_start;
+        }
+    }
+    const uint64_t block_start = frames_start / kBlobstoreBlockSize;
+    const uint64_t block_end = fbl::round_up(frames_end, kBlobstoreBlockSize) /
+                               kBlobstoreBlockSize;
+    EnqueueMissing(txn, compressed_vmoid_, compressed_loaded_, 0, dev_start, block_start,
+                   block_end);
+    compressed_loaded_.Set(block_start, block_end);
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::DecompressChunks(uint64_t start, uint64_t end) {
+    TRACE_DURATION("blobstore", "Blobstore::DecompressChunks", "start", start, "end", end);
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint8_t* compressed = static_cast<const uint8_t*>(compressed_->GetData());
+    uint8_t* data = static_cast<uint8_t*>(GetData());
+
+    uint64_t last_chunk = fbl::round_up(end, kBlobstoreChunkBlocks) / kBlobstoreChunkBlocks;
+    for (uint64_t n = start / kBlobstoreChunkBlocks; n < last_chunk; n++) {
+        if (data_loaded_.Get(n * kBlobstoreChunkBlocks, n * kBlobstoreChunkBlocks + 1)) {
+            continue;
+        }
+        zx_status_t status;
+        uint64_t frame_start, frame_end;
+        if ((status = ChunkFrame(n, &frame_start, &frame_end)) != ZX_OK) {
+            return status;
+        }
+        const uint64_t off = n * kBlobstoreChunkSize;
+        const uint64_t len = fbl::min(inode->blob_size - off, kBlobstoreChunkSize);
+        const zx_time_t start_ticks = zx_ticks_get();
+        status = BlobDecompressChunk(data + off, len, compressed + frame_start,
+                                     frame_end - frame_start);
+        blobstore_->decompress_ticks_ += zx_ticks_get() - start_ticks;
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Failed to decompress chunk %" PRIu64 "\n", n);
+            return status;
+        }
+        blobstore_->chunks_decompressed_++;
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadData(uint64_t start, uint64_t end) {
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    end = fbl::min(end, BlobDataBlocks(*inode));
+    size_t first_unloaded;
+    if (start >= end || data_loaded_.Get(start, end, &first_unloaded)) {
+        return ZX_OK;
+    }
+    start = first_unloaded;
+    const bool compressed = inode->flags & kBlobstoreInodeFlagLZ4;
+    if (compressed) {
+        // Chunks are decompressed, and so loaded, whole.
+        start = fbl::round_down(start, kBlobstoreChunkBlocks);
+        end = fbl::min(fbl::round_up(end, kBlobstoreChunkBlocks), BlobDataBlocks(*inode));
+    }
+    TRACE_DURATION("blobstore", "Blobstore::LoadData", "start", start, "end", end);
+
+    // Read each run of missing blocks as a single request, along with whichever
+    // parts of the Merkle Tree are not yet in memory.
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_) +
+                               merkle_blocks;
     ReadTxn txn(blobstore_.get());
-    txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
-                BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode));
+    zx_status_t status;
+    if (!compressed) {
+        EnqueueMissing(&txn, vmoid_, data_loaded_, merkle_blocks, dev_start, start, end);
+    } else if ((status = EnqueueCompressed(&txn, start, end)) != ZX_OK) {
+        return status;
+    }
+    EnqueueMerkle(&txn, start, end);
     if ((status = txn.Flush()) != ZX_OK) {
+        // Which blocks made it into memory is unknown.
+        merkle_loaded_.ClearAll();
+        compressed_loaded_.ClearAll();
+        return status;
+    }
+    if (compressed && (status = DecompressChunks(start, end)) != ZX_OK) {
         return status;
     }
 
-    return Verify();
+    // Blocks are the size of the tree's leaves, so the range is verified
+    // independently of the rest of the blob.
+    Digest d;
+    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
+    const uint64_t off = start * kBlobstoreBlockSize;
+    const uint64_t len = fbl::min(end * kBlobstoreBlockSize, inode->blob_size) - off;
+    if ((status = MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
+                                     MerkleTree::GetTreeLength(inode->blob_size), off, len,
+                                     d)) != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to verify blocks [%" PRIu64 ", %" PRIu64 ")\n",
+                       start, end);
+        return status;
+    }
+    if ((status = data_loaded_.Set(start, end)) != ZX_OK) {
+        return status;
+    }
+    if (compressed && data_loaded_.Get(0, BlobDataBlocks(*inode))) {
+        // Every chunk has been decompressed, so nothing more is read from the
+        // compressed blocks.
+        blobstore_->DetachVmo(compressed_vmoid_);
+        compressed_ = nullptr;
+        compressed_loaded_.ClearAll();
+    }
+    return ZX_OK;
 }
 
 uint64_t VnodeBlob::SizeData() const {
@@ -181,6 +405,7 @@ VnodeBlob::VnodeBlob(fbl::RefPtr<Blobstore> bs)
 
 void VnodeBlob::BlobCloseHandles() {
     blob_ = nullptr;
+    compressed_ = nullptr;
     readable_event_.reset();
 }
 
@@ -287,6 +512,7 @@ zx_status_t VnodeBlob::WriteMetadata() {
 
     // Update the on-disk hash
     memcpy(inode->merkle_root_hash, &digest_[0], Digest::kLength);
+    blobstore_->IndexNode(map_index_);
 
     // Write back the blob node
     if (blobstore_->WriteNode(&txn, map_index_)) {
@@ -362,6 +588,13 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
+        // Everything written has been verified.
+        if ((status = data_loaded_.Set(0, BlobDataBlocks(*inode))) != ZX_OK ||
+            (status = merkle_loaded_.Set(0, MerkleTreeBlocks(*inode))) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
+
         // No more data to write. Flush to disk.
         if ((status = WriteMetadata()) != ZX_OK) {
             SetState(kBlobStateError);
@@ -392,8 +625,8 @@ zx_status_t VnodeBlob::GetReadableEvent(zx_handle_t* out) {
     return sizeof(zx_handle_t);
 }
 
-zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
-    TRACE_DURATION("blobstore", "Blobstore::CopyVmo", "rights", rights, "out", out);
+zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, size_t len, size_t* off, zx_handle_t* out) {
+    TRACE_DURATION("blobstore", "Blobstore::CopyVmo", "rights", rights, "len", len);
     if (GetState() != kBlobStateReadable) {
         return ZX_ERR_BAD_STATE;
     }
@@ -403,12 +636,25 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
     }
 
     auto inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
+    if (*off >= inode->blob_size || len == 0 || *off + len < *off) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // Only the pages which are to be mapped are read and verified, and only they
+    // are cloned; the rest of the blob stays on disk.
+    const size_t clone_offset = fbl::round_down(*off, static_cast<size_t>(PAGE_SIZE));
+    const size_t clone_length = fbl::round_up(*off + len, static_cast<size_t>(PAGE_SIZE)) -
+                                clone_offset;
+    const uint64_t start = clone_offset / kBlobstoreBlockSize;
+    const uint64_t end = fbl::round_up(clone_offset + clone_length, kBlobstoreBlockSize) /
+                         kBlobstoreBlockSize;
+    if ((status = LoadData(start, end)) != ZX_OK) {
+        return status;
+    }
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     zx_handle_t clone;
     if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
-                               data_start, inode->blob_size, &clone)) != ZX_OK) {
+                               data_start + clone_offset, clone_length, &clone)) != ZX_OK) {
         return status;
     }
 
@@ -416,6 +662,7 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
         zx_handle_close(clone);
         return status;
     }
+    *off -= clone_offset;
     return ZX_OK;
 }
 
@@ -442,6 +689,15 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode->blob_size - off;
     }
 
+    const uint64_t start = off / kBlobstoreBlockSize;
+    const uint64_t end = fbl::round_up(off + len, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    const uint32_t readahead = readahead_.Update(off, len);
+    TRACE_COUNTER("blobstore", "readahead", map_index_, "window", readahead,
+                  "sequential_reads", readahead_.sequential_reads());
+    if ((status = LoadData(start, end + readahead)) != ZX_OK) {
+        return status;
+    }
+
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     return zx_vmo_read(blob_->GetVmo(), data, data_start + off, len, actual);
 }
@@ -482,40 +738,129 @@ void Blobstore::FreeBlocks(size_t nblocks, size_t blkno) {
 // Allocates a node IN MEMORY
 zx_status_t Blobstore::AllocateNode(size_t* node_index_out) {
     TRACE_DURATION("blobstore", "Blobstore::AllocateNode");
+    size_t i;
+    if (node_alloc_map_.Find(false, node_alloc_hint_, node_alloc_map_.size(), 1, &i) != ZX_OK) {
+        // If we didn't find any free inodes, try adding more via FVM.
+        size_t old_inode_count = info_.inode_count;
+        if (AddInodes() != ZX_OK) {
+            return ZX_ERR_NO_SPACE;
+        } else if (node_alloc_map_.Find(false, old_inode_count, node_alloc_map_.size(), 1,
+                                        &i) != ZX_OK) {
+            return ZX_ERR_NO_SPACE;
+        }
+    }
+
+    // Found a free node. Mark it as reserved so no one else can allocate it.
+    ZX_DEBUG_ASSERT(GetNode(i)->start_block == kStartBlockFree);
+    zx_status_t status = node_alloc_map_.Set(i, i + 1);
+    ZX_DEBUG_ASSERT(status == ZX_OK);
+    node_alloc_hint_ = i + 1;
+    GetNode(i)->start_block = kStartBlockReserved;
+    info_.alloc_inode_count++;
+    *node_index_out = i;
+    return ZX_OK;
+}
+
+// Frees a node IN MEMORY
+void Blobstore::FreeNode(size_t node_index) {
+    TRACE_DURATION("blobstore", "Blobstore::FreeNode", "node_index", node_index);
+    UnindexNode(node_index);
+    memset(GetNode(node_index), 0, sizeof(blobstore_inode_t));
+    zx_status_t status = node_alloc_map_.Clear(node_index, node_index + 1);
+    ZX_DEBUG_ASSERT(status == ZX_OK);
+    node_alloc_hint_ = fbl::min(node_alloc_hint_, node_index);
+    info_.alloc_inode_count--;
+}
+
+zx_status_t Blobstore::LoadNodeIndex() {
+    TRACE_DURATION("blobstore", "Blobstore::LoadNodeIndex");
+    zx_status_t status;
+    if ((status = node_alloc_map_.Reset(fbl::round_up(info_.inode_count,
+                                                      kBlobstoreBlockBits))) != ZX_OK ||
+        (status = node_alloc_map_.Shrink(info_.inode_count)) != ZX_OK ||
+        (status = ResizeNodeIndex(info_.inode_count)) != ZX_OK) {
+        return status;
+    }
+
+    node_alloc_hint_ = info_.inode_count;
     for (size_t i = 0; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block == kStartBlockFree) {
-            // Found a free node. Mark it as reserved so no one else can allocate it.
-            GetNode(i)->start_block = kStartBlockReserved;
-            info_.alloc_inode_count++;
-            *node_index_out = i;
-            return ZX_OK;
+        const blobstore_inode_t* inode = GetNode(i);
+        if (inode->start_block == kStartBlockFree) {
+            node_alloc_hint_ = fbl::min(node_alloc_hint_, i);
+            continue;
         }
+        node_alloc_map_.Set(i, i + 1);
+        if (inode->start_block >= kStartBlockMinimum) {
+            IndexNode(i);
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Blobstore::ResizeNodeIndex(size_t node_count) {
+    size_t slots = kNodeIndexMinSlots;
+    while (slots < node_count * 2) {
+        slots *= 2;
+    }
+    if (slots <= node_index_.size()) {
+        return ZX_OK;
     }
 
-    // If we didn't find any free inodes, try adding more via FVM.
-    size_t old_inode_count = info_.inode_count;
-    if (AddInodes() != ZX_OK) {
-        return ZX_ERR_NO_SPACE;
+    fbl::AllocChecker ac;
+    fbl::Array<uint32_t> index(new (&ac) uint32_t[slots], slots);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < slots; i++) {
+        index[i] = kNodeIndexEmpty;
     }
 
-    for (size_t i = old_inode_count; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block == kStartBlockFree) {
-            // Found a free node. Mark it as reserved so no one else can allocate it.
-            GetNode(i)->start_block = kStartBlockReserved;
-            info_.alloc_inode_count++;
-            *node_index_out = i;
-            return ZX_OK;
+    // Nodes must be placed anew, since their slots depend on the size of the index.
+    node_index_.swap(index);
+    for (size_t i = 0; i < index.size(); i++) {
+        if (index[i] != kNodeIndexEmpty) {
+            IndexNode(index[i]);
         }
     }
+    return ZX_OK;
+}
 
-    return ZX_ERR_NO_SPACE;
+size_t Blobstore::NodeIndexSlot(const uint8_t* key) const {
+    const size_t mask = node_index_.size() - 1;
+    size_t slot = NodeIndexHash(key) & mask;
+    while (node_index_[slot] != kNodeIndexEmpty &&
+           memcmp(GetNode(node_index_[slot])->merkle_root_hash, key, Digest::kLength) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
 }
 
-// Frees a node IN MEMORY
-void Blobstore::FreeNode(size_t node_index) {
-    TRACE_DURATION("blobstore", "Blobstore::FreeNode", "node_index", node_index);
-    memset(GetNode(node_index), 0, sizeof(blobstore_inode_t));
-    info_.alloc_inode_count--;
+void Blobstore::IndexNode(size_t node_index) {
+    const size_t slot = NodeIndexSlot(GetNode(node_index)->merkle_root_hash);
+    if (node_index_[slot] == kNodeIndexEmpty) {
+        node_index_[slot] = static_cast<uint32_t>(node_index);
+    }
+}
+
+void Blobstore::UnindexNode(size_t node_index) {
+    const size_t mask = node_index_.size() - 1;
+    size_t hole = NodeIndexSlot(GetNode(node_index)->merkle_root_hash);
+    if (node_index_[hole] != node_index) {
+        // The node was never named, such as a blob which failed while being written.
+        return;
+    }
+
+    // Move back any later node in the same run which would otherwise no longer be
+    // reachable from the slot its probe starts at.
+    for (size_t slot = (hole + 1) & mask; node_index_[slot] != kNodeIndexEmpty;
+         slot = (slot + 1) & mask) {
+        const size_t home = NodeIndexHash(GetNode(node_index_[slot])->merkle_root_hash) & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            node_index_[hole] = node_index_[slot];
+            hole = slot;
+        }
+    }
+    node_index_[hole] = kNodeIndexEmpty;
 }
 
 zx_status_t Blobstore::Unmount() {
@@ -685,29 +1030,27 @@ zx_status_t Blobstore::LookupBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>*
         return ZX_OK;
     }
 
-    // Look up blob in the slow map
-    for (size_t i = 0; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block >= kStartBlockMinimum) {
-            if (digest == GetNode(i)->merkle_root_hash) {
-                if (out != nullptr) {
-                    // Found it. Attempt to wrap the blob in a vnode.
-                    fbl::AllocChecker ac;
-                    fbl::RefPtr<VnodeBlob> vn =
-                        fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
-                    if (!ac.check()) {
-                        return ZX_ERR_NO_MEMORY;
-                    }
-                    vn->SetState(kBlobStateReadable);
-                    vn->SetMapIndex(i);
-                    // Delay reading any data from disk until read.
-                    hash_.insert(vn.get());
-                    *out = fbl::move(vn);
-                }
-                return ZX_OK;
-            }
+    // Look up blob in the index of the node map
+    const uint32_t node_index = node_index_[NodeIndexSlot(digest.AcquireBytes())];
+    digest.ReleaseBytes();
+    if (node_index == kNodeIndexEmpty) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    if (out != nullptr) {
+        // Found it. Attempt to wrap the blob in a vnode.
+        fbl::AllocChecker ac;
+        fbl::RefPtr<VnodeBlob> vn =
+            fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
         }
+        vn->SetState(kBlobStateReadable);
+        vn->SetMapIndex(node_index);
+        // Delay reading any data from disk until read.
+        hash_.insert(vn.get());
+        *out = fbl::move(vn);
     }
-    return ZX_ERR_NOT_FOUND;
+    return ZX_OK;
 }
 
 zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
@@ -724,6 +1067,14 @@ zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
     return ZX_OK;
 }
 
+void Blobstore::DetachVmo(vmoid_t vmoid) {
+    block_fifo_request_t request;
+    request.txnid = TxnId();
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    Txn(&request, 1);
+}
+
 zx_status_t Blobstore::AddInodes() {
     TRACE_DURATION("blobstore", "Blobstore::AddInodes");
 
@@ -753,7 +1104,12 @@ zx_status_t Blobstore::AddInodes() {
 
     if (node_map_->Grow(inoblks * kBlobstoreBlockSize) != ZX_OK) {
         return ZX_ERR_NO_SPACE;
+    } else if (node_alloc_map_.Grow(fbl::round_up(inodes, kBlobstoreBlockBits)) != ZX_OK) {
+        return ZX_ERR_NO_SPACE;
+    } else if (ResizeNodeIndex(inodes) != ZX_OK) {
+        return ZX_ERR_NO_SPACE;
     }
+    node_alloc_map_.Shrink(inodes);
 
     info_.vslice_count += request.length;
     info_.ino_slices += static_cast<uint32_t>(request.length);
@@ -894,6 +1250,9 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
     } else if ((status = fs->LoadBitmaps()) < 0) {
         fprintf(stderr, "blobstore: Failed to load bitmaps: %d\n", status);
         return status;
+    } else if ((status = fs->LoadNodeIndex()) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to index nodes: %d\n", status);
+        return status;
     } else if ((status = MappedVmo::Create(kBlobstoreBlockSize, "blobstore-superblock",
                                            &fs->info_vmo_)) != ZX_OK) {
         fprintf(stderr, "blobstore: Failed to create info vmo: %d\n", status);
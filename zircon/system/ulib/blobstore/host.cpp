@@ -26,6 +26,7 @@
 #include <blobstore/format.h>
 #include <blobstore/fsck.h>
 #include <blobstore/host.h>
+#include <blobstore/lz4.h>
 
 using digest::Digest;
 using digest::MerkleTree;
@@ -149,7 +150,7 @@ zx_status_t blobstore_create_sparse(fbl::RefPtr<Blobstore>* out, fbl::unique_fd
 
 std::mutex add_blob_mutex_;
 
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, bool compress) {
     // Mmap user-provided file, create the corresponding merkle tree
     struct stat s;
     if (fstat(data_fd, &s) < 0) {
@@ -176,6 +177,24 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
         return status;
     }
 
+    // The blob is only kept compressed if that saves at least one block.
+    fbl::unique_ptr<uint8_t[]> compressed;
+    size_t compressed_size = 0;
+    if (compress) {
+        const size_t len = fbl::round_up(BlobCompressBound(s.st_size), kBlobstoreBlockSize);
+        compressed.reset(new (&ac) uint8_t[len]());
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        } else if ((status = BlobCompress(blob_data, s.st_size, compressed.get(),
+                                          &compressed_size)) != ZX_OK) {
+            return status;
+        }
+        if (fbl::round_up(compressed_size, kBlobstoreBlockSize) >=
+            fbl::round_up(static_cast<size_t>(s.st_size), kBlobstoreBlockSize)) {
+            compressed.reset();
+        }
+    }
+
     std::lock_guard<std::mutex> lock(add_blob_mutex_);
     fbl::unique_ptr<InodeBlock> inode_block;
     if ((status = bs->NewBlob(digest, &inode_block)) < 0) {
@@ -187,13 +206,17 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
     }
 
     inode_block->SetSize(s.st_size);
+    if (compressed != nullptr) {
+        inode_block->SetCompressedSize(compressed_size);
+    }
     blobstore_inode_t* inode = inode_block->GetInode();
+    void* data = compressed != nullptr ? compressed.get() : blob_data;
 
     if ((status = bs->AllocateBlocks(inode->num_blocks,
                                      reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
         fprintf(stderr, "error: No blocks available\n");
         return status;
-    } else if ((status = bs->WriteData(inode, merkle_tree.get(), blob_data)) != ZX_OK) {
+    } else if ((status = bs->WriteData(inode, merkle_tree.get(), data)) != ZX_OK) {
         return status;
     } else if ((status = bs->WriteBitmap(inode->num_blocks, inode->start_block)) != ZX_OK) {
         return status;
@@ -222,6 +245,11 @@ zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
 void InodeBlock::SetSize(size_t size) {
     inode_->blob_size = size;
     inode_->num_blocks = MerkleTreeBlocks(*inode_) + BlobDataBlocks(*inode_);
+    inode_->flags = 0;
+}
+
+void InodeBlock::SetCompressedSize(size_t compressed_size) {
+    BlobSetCompressedSize(inode_, compressed_size);
 }
 
 Blobstore::Blobstore(fbl::unique_fd fd, off_t offset, const info_block_t& info_block,
@@ -394,17 +422,20 @@ zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, vo
         }
     }
 
-    for (size_t n = 0; n < BlobDataBlocks(*inode); n++) {
+    const uint64_t data_blocks = inode->num_blocks - MerkleTreeBlocks(*inode);
+    const uint64_t data_size = (inode->flags & kBlobstoreInodeFlagLZ4) ?
+                               data_blocks * kBlobstoreBlockSize : inode->blob_size;
+    for (size_t n = 0; n < data_blocks; n++) {
         const void* data = fs::GetBlock<kBlobstoreBlockSize>(blob_data, n);
 
         // If we try to write a block, will it be reaching beyond the end of the
         // mapped file?
         size_t off = n * kBlobstoreBlockSize;
         uint8_t last_data[kBlobstoreBlockSize];
-        if (inode->blob_size < off + kBlobstoreBlockSize) {
+        if (data_size < off + kBlobstoreBlockSize) {
             // Read the partial block from a block-sized buffer which zero-pads the data.
             memset(last_data, 0, kBlobstoreBlockSize);
-            memcpy(last_data, data, inode->blob_size - off);
+            memcpy(last_data, data, data_size - off);
             data = last_data;
         }
 
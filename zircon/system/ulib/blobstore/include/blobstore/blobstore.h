@@ -12,8 +12,10 @@
 #endif
 
 #include <bitmap/raw-bitmap.h>
+#include <bitmap/rle-bitmap.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
@@ -22,6 +24,7 @@
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
 #include <fs/block-txn.h>
+#include <fs/readahead.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
 #include <fs/vnode.h>
@@ -69,6 +72,11 @@ constexpr BlobFlags kBlobOtherMask        = 0x0000FF00;
 
 // clang-format on
 
+// Bounds on the number of blocks past the end of a sequential read which are
+// read (and verified) along with it.
+constexpr uint32_t kBlobstoreReadaheadMin = 4;
+constexpr uint32_t kBlobstoreReadaheadMax = 128;
+
 class VnodeBlob final : public fs::Vnode {
 public:
     // Intrusive methods and structures
@@ -127,7 +135,9 @@ private:
     // Otherwise, returns size of the handle.
     zx_status_t GetReadableEvent(zx_handle_t* out);
 
-    zx_status_t CopyVmo(zx_rights_t rights, zx_handle_t* out);
+    // Returns a clone of the pages of the blob which hold [*off, *off + len), having
+    // read and verified them, and updates |off| to be relative to the clone.
+    zx_status_t CopyVmo(zx_rights_t rights, size_t len, size_t* off, zx_handle_t* out);
 
     void QueueUnlink();
 
@@ -163,16 +173,37 @@ private:
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
     void Sync(SyncCallback closure) final;
 
-    // Read both VMOs into memory, if we haven't already.
+    // Create the blob's VMO, if we haven't already. Nothing is read into it yet.
     //
     // TODO(ZX-1481): When we have can register the Blob Store as a pager
     // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // then the kernel can ask for the data as it is used. Until then, the
+    // data is read in by LoadData as it is read.
     zx_status_t InitVmos();
 
-    // Verify the integrity of the in-memory Blob.
-    // InitVmos() must have already been called for this blob.
+    // Read and verify the data blocks in [start, end) which are not yet in memory.
+    // Blocks past the end of the blob are ignored.
+    zx_status_t LoadData(uint64_t start, uint64_t end);
+
+    // Enqueues reads of the blocks of the Merkle Tree which are needed to verify
+    // the data blocks [start, end), and which are not yet in memory.
+    void EnqueueMerkle(ReadTxn* txn, uint64_t start, uint64_t end);
+
+    // Enqueues reads of the compressed blocks which hold the chunks of a compressed
+    // blob covering the data blocks [start, end), and which are not yet in memory.
+    // The table of chunks is read first, if needed, to locate them.
+    zx_status_t EnqueueCompressed(ReadTxn* txn, uint64_t start, uint64_t end);
+
+    // Decompresses the chunks covering the data blocks [start, end) which are not
+    // yet loaded, once their compressed blocks are in memory.
+    zx_status_t DecompressChunks(uint64_t start, uint64_t end);
+
+    // Looks up where the frame of chunk |n| lies within the compressed blocks, checking
+    // that the table of chunks holds a sane range for it.
+    zx_status_t ChunkFrame(uint64_t n, uint64_t* out_start, uint64_t* out_end) const;
+
+    // Verify the integrity of the whole in-memory Blob.
+    // All of its data must already be in memory.
     zx_status_t Verify() const;
 
     zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block);
@@ -194,6 +225,17 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobstoreBlockSize
     fbl::unique_ptr<MappedVmo> blob_{};
     vmoid_t vmoid_{};
+    // Data blocks of blob_ which have been read and verified, and blocks of its
+    // Merkle Tree which have been read.
+    bitmap::RleBitmap data_loaded_{};
+    bitmap::RleBitmap merkle_loaded_{};
+    // For blobs stored compressed, the blocks holding their table of chunks and
+    // LZ4 frames, which are decompressed into blob_ as they are read. They are
+    // released once every chunk has been decompressed.
+    fbl::unique_ptr<MappedVmo> compressed_{};
+    vmoid_t compressed_vmoid_{};
+    bitmap::RleBitmap compressed_loaded_{};
+    fs::ReadaheadState readahead_{kBlobstoreReadaheadMin, kBlobstoreReadaheadMax};
 
     zx::event readable_event_{};
     uint64_t bytes_written_{};
@@ -253,6 +295,8 @@ public:
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
+    // Detaches a VMO attached with AttachVmo from the block device.
+    void DetachVmo(vmoid_t vmoid);
     zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
         TRACE_DURATION("blobstore", "Blobstore::Txn", "count", count);
         return block_fifo_txn(fifo_client_, requests, count);
@@ -282,6 +326,22 @@ private:
     Blobstore(fbl::unique_fd fd, const blobstore_info_t* info);
     zx_status_t LoadBitmaps();
 
+    // Builds the in-memory indices of the node map, once it has been read from disk.
+    zx_status_t LoadNodeIndex();
+
+    // Reallocates the index by Merkle root to hold up to |node_count| nodes, keeping
+    // the nodes already indexed.
+    zx_status_t ResizeNodeIndex(size_t node_count);
+
+    // Returns the slot of the index by Merkle root which holds the node named |key|,
+    // or the empty slot where it would be inserted.
+    size_t NodeIndexSlot(const uint8_t* key) const;
+
+    // Adds a node to, or removes it from, the index by Merkle root. A node may only
+    // be indexed once its Merkle root is known, and must be removed before it is freed.
+    void IndexNode(size_t node_index);
+    void UnindexNode(size_t node_index);
+
     // Finds space for a block in memory. Does not update disk.
     zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
     void FreeBlocks(size_t nblocks, size_t blkno);
@@ -323,9 +383,21 @@ private:
     vmoid_t block_map_vmoid_{};
     fbl::unique_ptr<MappedVmo> node_map_{};
     vmoid_t node_map_vmoid_{};
+    // Nodes which are allocated, including those reserved by blobs still being
+    // written. Every node below node_alloc_hint_ is allocated.
+    RawBitmap node_alloc_map_{};
+    size_t node_alloc_hint_{};
+    // Open-addressed table of allocated node indices, keyed by the Merkle root
+    // stored in each node, so that blobs which are not open are found without
+    // scanning the node map. It is kept at most half full.
+    fbl::Array<uint32_t> node_index_{};
     fbl::unique_ptr<MappedVmo> info_vmo_{};
     vmoid_t info_vmoid_{};
     uint64_t fs_id_{};
+    // Chunks of compressed blobs decompressed so far, and the ticks spent doing so,
+    // reported by IOCTL_VFS_GET_BLOBSTORE_METRICS.
+    uint64_t chunks_decompressed_{};
+    zx_time_t decompress_ticks_{};
 };
 
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd);
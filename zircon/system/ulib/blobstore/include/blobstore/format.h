@@ -114,7 +114,8 @@ typedef struct {
     uint64_t start_block;
     uint64_t num_blocks;
     uint64_t blob_size;
-    uint64_t reserved;
+    uint32_t flags;
+    uint32_t reserved;
 } blobstore_inode_t;
 
 static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
@@ -127,4 +128,29 @@ constexpr uint64_t BlobDataBlocks(const blobstore_inode_t& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
+// Flags of a blob's inode:
+// The blob's data is stored compressed with LZ4, as described below.
+constexpr uint32_t kBlobstoreInodeFlagLZ4 = 1;
+
+// A compressed blob is split into chunks of kBlobstoreChunkSize bytes, each stored as
+// an LZ4 frame of its own, so that any part of the blob can be read without decompressing
+// what comes before it. Its data blocks begin with a table holding, for each chunk, the
+// offset (from the start of the data blocks) at which the chunk's frame ends. The frames
+// follow the table back to back. The Merkle Tree is built over the uncompressed blob.
+constexpr uint64_t kBlobstoreChunkSize      = 32768;
+constexpr uint64_t kBlobstoreChunkBlocks    = (kBlobstoreChunkSize / kBlobstoreBlockSize);
+
+static_assert(kBlobstoreChunkSize % kBlobstoreBlockSize == 0,
+              "Blobstore chunks should hold a whole number of blocks");
+
+// Number of chunks a compressed blob is split into
+constexpr uint64_t BlobChunks(const blobstore_inode_t& blobNode) {
+    return fbl::round_up(blobNode.blob_size, kBlobstoreChunkSize) / kBlobstoreChunkSize;
+}
+
+// Size, in bytes, of the table of chunks at the start of a compressed blob
+constexpr uint64_t BlobChunkTableSize(const blobstore_inode_t& blobNode) {
+    return BlobChunks(blobNode) * sizeof(uint64_t);
+}
+
 } // namespace blobstore
@@ -57,6 +57,10 @@ public:
 
     void SetSize(size_t size);
 
+    // Marks the blob as stored compressed, in |compressed_size| bytes.
+    // Must follow SetSize.
+    void SetCompressedSize(size_t compressed_size);
+
 private:
     size_t bno_;
     blobstore_inode_t* inode_;
@@ -80,6 +84,8 @@ public:
     // Allocate |nblocks| starting at |*blkno_out| in memory
     zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
 
+    // Writes the Merkle Tree and data of the blob at |inode|. The data of a compressed
+    // blob must be padded to a whole number of blocks.
     zx_status_t WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data);
     zx_status_t WriteBitmap(size_t nblocks, size_t start_block);
     zx_status_t WriteNode(fbl::unique_ptr<InodeBlock> ino_block);
@@ -137,7 +143,9 @@ zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd
 
 // blobstore_add_blob may be called by multiple threads to gain concurrent
 // merkle tree generation. No other methods are thread safe.
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd);
+//
+// If |compress| is set, the blob is stored compressed whenever that saves space.
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, bool compress = false);
 zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
                            const fbl::Vector<size_t>& extent_lengths);
 
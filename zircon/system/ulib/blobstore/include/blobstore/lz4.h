@@ -0,0 +1,45 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains the compression of blobs, shared between host
+// and target implementations of Blobstore.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+#include <blobstore/format.h>
+
+namespace blobstore {
+
+// Returns the largest size the compressed form of a blob of |blob_size| bytes may take,
+// including its table of chunks.
+size_t BlobCompressBound(uint64_t blob_size);
+
+// Compresses the |blob_size| bytes at |data| into |out|, which must hold at least
+// BlobCompressBound(blob_size) bytes, in the layout of a blob flagged with
+// kBlobstoreInodeFlagLZ4. On success, the size of the compressed blob is returned
+// in |out_size|.
+zx_status_t BlobCompress(const void* data, uint64_t blob_size, void* out, size_t* out_size);
+
+// Marks |node|, whose blob_size is already set, as holding its data compressed in
+// |compressed_size| bytes, and sizes it to match.
+void BlobSetCompressedSize(blobstore_inode_t* node, size_t compressed_size);
+
+// Looks up where the frame of chunk |n| of the compressed blob |node| lies, given the
+// |compressed_len| bytes of its data blocks at |compressed|, which start with its table of
+// chunks. The table is not covered by the Merkle Tree, so this fails unless it holds a
+// range for the frame which lies between the end of the table and |compressed_len|.
+zx_status_t BlobChunkFrame(const blobstore_inode_t& node, const void* compressed,
+                           size_t compressed_len, uint64_t n, uint64_t* out_start,
+                           uint64_t* out_end);
+
+// Decompresses the LZ4 frame of one chunk, |src_len| bytes at |src|, into |dst|.
+// Fails unless the frame holds exactly |dst_len| bytes.
+zx_status_t BlobDecompressChunk(void* dst, size_t dst_len, const void* src, size_t src_len);
+
+} // namespace blobstore
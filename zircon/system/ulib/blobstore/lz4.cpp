@@ -0,0 +1,128 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <digest/merkle-tree.h>
+#include <fbl/algorithm.h>
+#include <lz4/lz4frame.h>
+
+#include <blobstore/lz4.h>
+
+namespace blobstore {
+namespace {
+
+// Blobs are compressed once, when an image is built, so a slower level which
+// compresses further costs nothing when they are read back.
+constexpr int kCompressionLevel = 9;
+
+void ChunkPreferences(uint64_t chunk_len, LZ4F_preferences_t* prefs) {
+    memset(prefs, 0, sizeof(*prefs));
+    prefs->frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs->frameInfo.blockMode = LZ4F_blockIndependent;
+    prefs->frameInfo.contentSize = chunk_len;
+    prefs->compressionLevel = kCompressionLevel;
+}
+
+} // namespace
+
+size_t BlobCompressBound(uint64_t blob_size) {
+    blobstore_inode_t node;
+    node.blob_size = blob_size;
+    LZ4F_preferences_t prefs;
+    ChunkPreferences(kBlobstoreChunkSize, &prefs);
+    return BlobChunkTableSize(node) +
+           BlobChunks(node) * LZ4F_compressFrameBound(kBlobstoreChunkSize, &prefs);
+}
+
+zx_status_t BlobCompress(const void* data, uint64_t blob_size, void* out, size_t* out_size) {
+    blobstore_inode_t node;
+    node.blob_size = blob_size;
+    const size_t bound = BlobCompressBound(blob_size);
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    uint8_t* dst = static_cast<uint8_t*>(out);
+
+    size_t end = BlobChunkTableSize(node);
+    for (uint64_t n = 0; n < BlobChunks(node); n++) {
+        const uint64_t off = n * kBlobstoreChunkSize;
+        const uint64_t len = fbl::min(blob_size - off, kBlobstoreChunkSize);
+        LZ4F_preferences_t prefs;
+        ChunkPreferences(len, &prefs);
+        size_t r = LZ4F_compressFrame(dst + end, bound - end, src + off, len, &prefs);
+        if (LZ4F_isError(r)) {
+            return ZX_ERR_INTERNAL;
+        }
+        end += r;
+        const uint64_t chunk_end = end;
+        memcpy(dst + n * sizeof(uint64_t), &chunk_end, sizeof(chunk_end));
+    }
+
+    *out_size = end;
+    return ZX_OK;
+}
+
+void BlobSetCompressedSize(blobstore_inode_t* node, size_t compressed_size) {
+    const size_t merkle_size = digest::MerkleTree::GetTreeLength(node->blob_size);
+    node->num_blocks = fbl::round_up(merkle_size, kBlobstoreBlockSize) / kBlobstoreBlockSize +
+                       fbl::round_up(compressed_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    node->flags |= kBlobstoreInodeFlagLZ4;
+}
+
+zx_status_t BlobChunkFrame(const blobstore_inode_t& node, const void* compressed,
+                           size_t compressed_len, uint64_t n, uint64_t* out_start,
+                           uint64_t* out_end) {
+    const uint64_t table_size = BlobChunkTableSize(node);
+    if (n >= BlobChunks(node) || table_size > compressed_len) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const uint8_t* table = static_cast<const uint8_t*>(compressed);
+    uint64_t start = table_size;
+    if (n > 0) {
+        memcpy(&start, table + (n - 1) * sizeof(uint64_t), sizeof(start));
+    }
+    uint64_t end;
+    memcpy(&end, table + n * sizeof(uint64_t), sizeof(end));
+    if (start < table_size || start > end || end > compressed_len) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    *out_start = start;
+    *out_end = end;
+    return ZX_OK;
+}
+
+zx_status_t BlobDecompressChunk(void* dst, size_t dst_len, const void* src, size_t src_len) {
+    LZ4F_decompressionContext_t ctx;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // The whole chunk is decompressed in place, so the decoder needs no buffers of its own.
+    LZ4F_decompressOptions_t options;
+    memset(&options, 0, sizeof(options));
+    options.stableDst = 1;
+
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    size_t out_len = 0;
+    size_t next = 1;
+    while (next != 0 && src_len > 0) {
+        size_t dst_size = dst_len - out_len;
+        size_t src_size = src_len;
+        next = LZ4F_decompress(ctx, out + out_len, &dst_size, in, &src_size, &options);
+        if (LZ4F_isError(next) || (dst_size == 0 && src_size == 0)) {
+            break;
+        }
+        out_len += dst_size;
+        in += src_size;
+        src_len -= src_size;
+    }
+    LZ4F_freeDecompressionContext(ctx);
+
+    if (next != 0 || out_len != dst_len) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+} // namespace blobstore
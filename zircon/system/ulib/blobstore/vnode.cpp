@@ -32,11 +32,10 @@ namespace blobstore {
 VnodeBlob::~VnodeBlob() {
     blobstore_->ReleaseBlob(this);
     if (blob_ != nullptr) {
-        block_fifo_request_t request;
-        request.txnid = blobstore_->TxnId();
-        request.vmoid = vmoid_;
-        request.opcode = BLOCKIO_CLOSE_VMO;
-        blobstore_->Txn(&request, 1);
+        blobstore_->DetachVmo(vmoid_);
+    }
+    if (compressed_ != nullptr) {
+        blobstore_->DetachVmo(compressed_vmoid_);
     }
 }
 
@@ -188,6 +187,19 @@ zx_status_t VnodeBlob::Ioctl(uint32_t op, const void* in_buf, size_t in_len, voi
         *out_actual = 0;
         return blobstore_->Unmount();
     }
+    case IOCTL_VFS_GET_BLOBSTORE_METRICS: {
+        if (out_len < sizeof(vfs_blobstore_metrics_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        vfs_blobstore_metrics_t* metrics = static_cast<vfs_blobstore_metrics_t*>(out_buf);
+        const zx_time_t ticks = blobstore_->decompress_ticks_;
+        const zx_time_t ticks_per_sec = zx_ticks_per_second();
+        metrics->chunks_decompressed = blobstore_->chunks_decompressed_;
+        metrics->decompress_ns = (ticks / ticks_per_sec) * ZX_SEC(1) +
+                                 (ticks % ticks_per_sec) * ZX_SEC(1) / ticks_per_sec;
+        *out_actual = sizeof(vfs_blobstore_metrics_t);
+        return ZX_OK;
+    }
 #ifdef __Fuchsia__
     case IOCTL_VFS_GET_DEVICE_PATH: {
         ssize_t len = ioctl_device_get_topo_path(blobstore_->Fd(), static_cast<char*>(out_buf), out_len);
@@ -251,7 +263,7 @@ zx_status_t VnodeBlob::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out
     zx_rights_t rights = ZX_RIGHT_TRANSFER | ZX_RIGHT_MAP;
     rights |= (flags & FDIO_MMAP_FLAG_READ) ? ZX_RIGHT_READ : 0;
     rights |= (flags & FDIO_MMAP_FLAG_EXEC) ? ZX_RIGHT_EXECUTE : 0;
-    return CopyVmo(rights, out);
+    return CopyVmo(rights, len, off, out);
 }
 
 void VnodeBlob::Sync(SyncCallback closure) {
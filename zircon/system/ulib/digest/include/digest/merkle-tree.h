@@ -55,9 +55,18 @@ public:
 
     // Writes a Merkle tree for the given data and saves its root digest.
     // |tree_len| must be at least as much as returned by GetTreeLength().
+    // Large trees are built with the nodes of each level hashed on several
+    // threads; the result is the same as that of CreateInit/Update/Final.
     static zx_status_t Create(const void* data, size_t data_len, void* tree,
                               size_t tree_len, Digest* digest);
 
+    // See Create.  This builds the tree one level at a time rather than as the
+    // data is consumed, hashing the nodes of each level on up to |max_threads|
+    // threads, however many CPUs there are.  Create uses it, with one thread
+    // per CPU, for trees large enough to benefit.
+    static zx_status_t CreateParallel(const void* data, size_t data_len, void* tree,
+                                      size_t tree_len, Digest* digest, size_t max_threads);
+
     // Checks the integrity of a the region of data given by the offset and
     // length.  It checks integrity using the given Merkle tree and trusted root
     // digest. |tree_len| must be at least as much as returned by
@@ -4,8 +4,10 @@
 
 #include <digest/merkle-tree.h>
 
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
@@ -94,6 +96,104 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+////////
+// Helper functions for creating a tree one level at a time, with the nodes of
+// each level hashed in parallel.
+
+// Each thread hashes at least this many nodes; below that, starting a thread
+// costs more than it saves.
+constexpr size_t kMinNodesPerThread = 32;
+
+// Bound on the threads used to create a single tree.
+constexpr size_t kMaxThreads = 8;
+
+// Hashes the node at |offset| in a level of |length| bytes at |in|, leaving the
+// node's digest in |digest|.
+zx_status_t HashNode(Digest* digest, const uint8_t* in, size_t offset, size_t length,
+                     uint64_t level) {
+    zx_status_t rc;
+    if ((rc = DigestInit(digest, offset | level, length - offset)) != ZX_OK) {
+        return rc;
+    }
+    offset += DigestUpdate(digest, in + offset, offset, length - offset);
+    DigestFinal(digest, offset);
+    return ZX_OK;
+}
+
+// The shard of a level hashed by one thread: the nodes [first, last) of the
+// |length| bytes at |in|, whose digests are written to |out|.
+struct HashShard {
+    const uint8_t* in;
+    size_t length;
+    uint64_t level;
+    uint8_t* out;
+    size_t first;
+    size_t last;
+    zx_status_t rc;
+};
+
+void* HashNodes(void* arg) {
+    HashShard* shard = static_cast<HashShard*>(arg);
+    Digest digest;
+    shard->rc = ZX_OK;
+    for (size_t n = shard->first; n < shard->last && shard->rc == ZX_OK; n++) {
+        uint8_t* out = shard->out + n * Digest::kLength;
+        if ((shard->rc = HashNode(&digest, shard->in, n * MerkleTree::kNodeSize, shard->length,
+                                  shard->level)) == ZX_OK) {
+            shard->rc = digest.CopyTo(out, Digest::kLength);
+        }
+    }
+    return nullptr;
+}
+
+// Returns the number of CPUs which may hash nodes.
+size_t OnlineCpus() {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? static_cast<size_t>(online) : 1;
+}
+
+// Returns the number of threads, up to |max_threads|, to hash a level of
+// |nodes| nodes with.
+size_t HashThreads(size_t nodes, size_t max_threads) {
+    size_t threads = fbl::min(fbl::min(max_threads, kMaxThreads), nodes / kMinNodesPerThread);
+    return fbl::max(threads, static_cast<size_t>(1));
+}
+
+// Writes the digests of every node of the level of |length| bytes at |in| to
+// |out|. The calling thread hashes the first shard of nodes, and as many others
+// as can be started, up to |max_threads| in all, hash the rest.
+zx_status_t HashLevel(const uint8_t* in, size_t length, uint64_t level, uint8_t* out,
+                      size_t max_threads) {
+    const size_t nodes = fbl::round_up(length, MerkleTree::kNodeSize) / MerkleTree::kNodeSize;
+    const size_t threads = HashThreads(nodes, max_threads);
+    HashShard shards[kMaxThreads];
+    for (size_t i = 0; i < threads; i++) {
+        shards[i] = {in, length, level, out, nodes * i / threads, nodes * (i + 1) / threads,
+                     ZX_OK};
+    }
+
+    pthread_t workers[kMaxThreads];
+    size_t started = 1;
+    while (started < threads &&
+           pthread_create(&workers[started], nullptr, HashNodes, &shards[started]) == 0) {
+        started++;
+    }
+    HashNodes(&shards[0]);
+    for (size_t i = started; i < threads; i++) {
+        HashNodes(&shards[i]);
+    }
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(workers[i], nullptr);
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        if (shards[i].rc != ZX_OK) {
+            return shards[i].rc;
+        }
+    }
+    return ZX_OK;
+}
+
 } // namespace
 
 ////////
@@ -107,6 +207,10 @@ size_t MerkleTree::GetTreeLength(size_t data_len) {
 zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, size_t tree_len,
                                Digest* digest) {
     zx_status_t rc;
+    const size_t cpus = OnlineCpus();
+    if (HashThreads(fbl::round_up(data_len, kNodeSize) / kNodeSize, cpus) > 1) {
+        return CreateParallel(data, data_len, tree, tree_len, digest, cpus);
+    }
     MerkleTree mt;
     if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
         (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
@@ -116,6 +220,36 @@ zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, si
     return ZX_OK;
 }
 
+zx_status_t MerkleTree::CreateParallel(const void* data, size_t data_len, void* tree,
+                                       size_t tree_len, Digest* digest, size_t max_threads) {
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    } else if (!data || !tree || !digest) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // Each level is laid out, and padded, exactly as CreateUpdate writes it: the
+    // digests of a level fill the nodes of the next level up, and the remainder
+    // of the last of those nodes is zeroed.
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    uint8_t* out = static_cast<uint8_t*>(tree);
+    uint64_t level = 0;
+    zx_status_t rc;
+    while (data_len > kNodeSize) {
+        const size_t next_len = NextAligned(data_len);
+        const size_t digests_len = NextLength(data_len);
+        memset(out + digests_len, 0, next_len - digests_len);
+        if ((rc = HashLevel(in, data_len, level, out, max_threads)) != ZX_OK) {
+            return rc;
+        }
+        in = out;
+        out += next_len;
+        data_len = next_len;
+        level++;
+    }
+    return HashNode(digest, in, 0, data_len, level);
+}
+
 MerkleTree::MerkleTree() : initialized_(false), next_(nullptr), level_(0), offset_(0), length_(0) {}
 
 MerkleTree::~MerkleTree() {}
@@ -254,7 +388,12 @@ zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tr
         if ((rc = VerifyLevel(data, data_len, tree, offset, length, level)) != ZX_OK) {
             return rc;
         }
-        // Ascend to the next level up.
+        // Ascend to the next level up, where the digests of every node just
+        // verified must be verified in turn. Dividing the length alone would
+        // skip them once the range is shorter than |kDigestsPerNode| bytes.
+        const size_t finish = fbl::round_up(offset + length, kNodeSize) / kDigestsPerNode;
+        offset = (offset - offset % kNodeSize) / kDigestsPerNode;
+        length = finish - offset;
         data = tree;
         root_len = NextLength(data_len);
         data_len = NextAligned(data_len);
@@ -263,8 +402,6 @@ zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tr
             return ZX_ERR_BUFFER_TOO_SMALL;
         }
         tree_len -= data_len;
-        offset /= kDigestsPerNode;
-        length /= kDigestsPerNode;
         ++level;
     }
     return VerifyRoot(data, root_len, level, root);
@@ -24,14 +24,16 @@ namespace fbl {
 #define fbl_mutex_release mtx_unlock
 #endif
 
+// The constructors are always inlined, so that kernel lock profiling
+// attributes the acquisition to the code constructing the AutoLock.
 class __TA_SCOPED_CAPABILITY AutoLock {
 public:
-    explicit AutoLock(fbl_mutex_t* mutex) __TA_ACQUIRE(mutex)
+    __ALWAYS_INLINE explicit AutoLock(fbl_mutex_t* mutex) __TA_ACQUIRE(mutex)
         :   mutex_(mutex) {
         fbl_mutex_acquire(mutex_);
     }
 
-    explicit AutoLock(Mutex* mutex) __TA_ACQUIRE(mutex)
+    __ALWAYS_INLINE explicit AutoLock(Mutex* mutex) __TA_ACQUIRE(mutex)
         :   AutoLock(mutex->GetInternal()) {}
 
     explicit AutoLock(fbl::NullLock* mutex) __TA_ACQUIRE(mutex)
@@ -25,7 +25,8 @@ class __TA_CAPABILITY("mutex") Mutex {
 public:
     constexpr Mutex() : mutex_(MUTEX_INITIAL_VALUE(mutex_)) { }
     ~Mutex() { mutex_destroy(&mutex_); }
-    void Acquire() __TA_ACQUIRE() { mutex_acquire(&mutex_); }
+    // Always inlined so that lock profiling sees the caller.
+    __ALWAYS_INLINE void Acquire() __TA_ACQUIRE() { mutex_acquire(&mutex_); }
     void Release() __TA_RELEASE() { mutex_release(&mutex_); }
 
     bool IsHeld() const {
@@ -0,0 +1,66 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <fbl/algorithm.h>
+
+namespace fs {
+
+// Tracks the reads of a single file to size the readahead which should
+// accompany each one.
+//
+// A read which picks up where the previous read left off continues a
+// sequential stream, and doubles the readahead window, from |min_blocks| up
+// to |max_blocks|. Any other read is treated as random access: it closes the
+// window, so that only the requested blocks are read until a new stream
+// is seen. The first read of a file is sequential if it starts at zero.
+//
+// Not thread-safe; callers serialize reads of the file.
+class ReadaheadState {
+public:
+    constexpr ReadaheadState(uint32_t min_blocks, uint32_t max_blocks)
+        : min_blocks_(min_blocks), max_blocks_(max_blocks) {}
+
+    // Records a read of |len| bytes at |off|, and returns the number of blocks
+    // past its end which should be read along with it.
+    uint32_t Update(uint64_t off, uint64_t len) {
+        if (off >= start_ && off <= end_ && off + len > end_) {
+            window_ = fbl::clamp(window_ * 2, min_blocks_, max_blocks_);
+            sequential_reads_++;
+        } else if (off + len <= start_ || off > end_) {
+            window_ = 0;
+            sequential_reads_ = 0;
+        }
+        start_ = off;
+        end_ = off + len;
+        return window_;
+    }
+
+    // Forgets the access pattern, as if the file had not been read.
+    void Reset() {
+        start_ = 0;
+        end_ = 0;
+        window_ = 0;
+        sequential_reads_ = 0;
+    }
+
+    uint32_t window() const { return window_; }
+    uint32_t sequential_reads() const { return sequential_reads_; }
+
+private:
+    const uint32_t min_blocks_;
+    const uint32_t max_blocks_;
+
+    // The byte range of the previous read.
+    uint64_t start_ = 0;
+    uint64_t end_ = 0;
+
+    uint32_t window_ = 0;
+    uint32_t sequential_reads_ = 0;
+};
+
+} // namespace fs
@@ -14,6 +14,8 @@
 //
 // Redefine tracing macros as no-ops for host-side tools
 #define TRACE_DURATION(args...)
+#define TRACE_INSTANT(args...)
+#define TRACE_COUNTER(args...)
 #define TRACE_FLOW_BEGIN(args...)
 #define TRACE_FLOW_STEP(args...)
 #define TRACE_FLOW_END(args...)
@@ -492,8 +492,9 @@ zx_status_t Vfs::Ioctl(fbl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, s
     case IOCTL_VFS_UNMOUNT_FS: {
         Vfs::UninstallAll(ZX_TIME_INFINITE);
         *out_actual = 0;
-        vn->Ioctl(op, in_buf, in_len, out_buf, out_len, out_actual);
-        return ZX_OK;
+        // Filesystems which have nothing to tear down need not handle the ioctl.
+        zx_status_t s = vn->Ioctl(op, in_buf, in_len, out_buf, out_len, out_actual);
+        return (s == ZX_ERR_NOT_SUPPORTED) ? ZX_OK : s;
     }
 #endif
     default:
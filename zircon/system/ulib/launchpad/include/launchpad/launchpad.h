@@ -133,6 +133,40 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd);
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo);
 
 
+// LOADING FROM A TEMPLATE
+// A template captures the work launchpad_load_from_vmo() does before it
+// touches the new process: following #! lines, parsing ELF headers,
+// fetching the PT_INTERP file from the loader service, and locating the
+// vDSO.  Loading from a template only maps the cached images into the new
+// process (with copy-on-write clones for writable segments), which makes
+// it much cheaper to start many processes running the same binary.
+// A template is immutable once created and may be shared by threads.
+// -------------------------------------------------------------------
+
+typedef struct launchpad_template launchpad_template_t;
+
+// Create a template for the executable in |vmo|.  Takes ownership of |vmo|.
+// The #! and PT_INTERP files are looked up through |loader_svc|, which is
+// borrowed, or through the default loader service if it is
+// ZX_HANDLE_INVALID.
+zx_status_t launchpad_template_create(zx_handle_t vmo, zx_handle_t loader_svc,
+                                      launchpad_template_t** result);
+zx_status_t launchpad_template_create_from_file(const char* path,
+                                                zx_handle_t loader_svc,
+                                                launchpad_template_t** result);
+void launchpad_template_destroy(launchpad_template_t* tmpl);
+
+// Equivalent to launchpad_load_from_vmo() with the template's executable.
+// The template is not consumed and can be used for any number of launchpads.
+// The dynamic linker in the template came from the loader service the
+// template was created with, so |lp| should use that same service (see
+// launchpad_use_loader_service()) for the libraries to match.
+// If launchpad_set_vdso_vmo() has changed the vDSO since the template was
+// created, the new vDSO is loaded as launchpad_load_vdso() would.
+zx_status_t launchpad_clone_template(launchpad_t* lp,
+                                     const launchpad_template_t* tmpl);
+
+
 // ADDING ARGUMENTS, ENVIRONMENT, AND HANDLES
 // These functions setup arguments, environment, or handles to be
 // passed to the new process via the processargs protocol.
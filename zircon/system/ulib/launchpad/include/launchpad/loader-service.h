@@ -50,6 +50,25 @@ typedef struct loader_service loader_service_t;
 // any number of clients.
 zx_status_t loader_service_create_fs(const char* name, loader_service_t** out);
 
+// The file-system backed loader services (the default in-process one and
+// those made by loader_service_create_fs()) share a per-process cache of
+// the VMOs they have loaded, keyed by path. A cache hit returns a read-only
+// copy-on-write clone of the cached VMO instead of reading the file again.
+// An entry is discarded when the file's inode, size or modification time
+// no longer match those it was cached with.
+
+// Load each of the |count| libraries named in |names| into the cache, as
+// LOADER_SVC_OP_LOAD_OBJECT would. Returns the last failure, if any; the
+// remaining names are still loaded.
+zx_status_t loader_service_prewarm(const char* const* names, size_t count);
+
+// Same as loader_service_prewarm() with the names read from |path|, one
+// per line. Blank lines and lines starting with '#' are ignored.
+zx_status_t loader_service_prewarm_from_file(const char* path);
+
+// Drop every entry from the cache.
+void loader_service_cache_flush(void);
+
 // Returns a new dl_set_loader_service-compatible loader service channel.
 zx_status_t loader_service_connect(loader_service_t* svc, zx_handle_t* out);
 
@@ -11,6 +11,7 @@
 #include <zircon/processargs.h>
 #include <zircon/stack.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 #include <launchpad/loader-service.h>
 #include <fdio/io.h>
 #include <assert.h>
@@ -658,25 +659,29 @@ static zx_status_t parse_interp_spec(char *line, char **interp_start,
     return ZX_OK;
 }
 
-zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
-    if (vmo == ZX_HANDLE_INVALID)
-        return lp_error(lp, ZX_ERR_INVALID_ARGS, "file_load: invalid vmo");
-
+static void reset_script_args(launchpad_t* lp) {
     if (lp->script_args != NULL) {
         free(lp->script_args);
         lp->script_args = NULL;
     }
     lp->script_args_len = 0;
     lp->num_script_args = 0;
+}
 
+// Follow #! lines from *vmo until reaching a file that is not a script,
+// accumulating the interpreter arguments in lp->script_args.  On success
+// *vmo is that file and first_line holds the first chars_read bytes of it.
+// On failure *vmo has been consumed.
+static zx_status_t resolve_script(launchpad_t* lp, zx_handle_t* vmo,
+                                  char first_line[LP_MAX_INTERP_LINE_LEN + 1],
+                                  size_t* out_chars_read) {
     size_t script_nest_level = 0;
     zx_status_t status;
-    char first_line[LP_MAX_INTERP_LINE_LEN + 1];
     size_t chars_read;
 
     while (1) {
         // Read enough to get the interpreter specification of a script
-        status = zx_vmo_read(vmo, first_line, 0, sizeof(first_line),
+        status = zx_vmo_read(*vmo, first_line, 0, LP_MAX_INTERP_LINE_LEN + 1,
                              &chars_read);
 
         // This is not a script -- load as an ELF file
@@ -684,7 +689,8 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
             && (chars_read < 2 || first_line[0] != '#' || first_line[1] != '!'))
             break;
 
-        zx_handle_close(vmo);
+        zx_handle_close(*vmo);
+        *vmo = ZX_HANDLE_INVALID;
 
         if (status != ZX_OK)
             return lp_error(lp, status, "file_load: zx_vmo_read() failed");
@@ -700,7 +706,7 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
         char* newline_pos = memchr(first_line, '\n', chars_read);
         if (newline_pos)
             *newline_pos = '\0';
-        else if (chars_read == sizeof(first_line))
+        else if (chars_read == LP_MAX_INTERP_LINE_LEN + 1)
             return lp_error(lp, ZX_ERR_OUT_OF_RANGE,
                             "file_load: first line of script too long");
         else
@@ -749,11 +755,27 @@ zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
 
         status = loader_svc_rpc(lp->special_handles[HND_LOADER_SVC],
                              LOADER_SVC_OP_LOAD_SCRIPT_INTERP,
-                             interp_start, interp_len, &vmo);
+                             interp_start, interp_len, vmo);
         if (status != ZX_OK)
             return lp_error(lp, status, "file_load: loader_svc_rpc() failed");
     }
 
+    *out_chars_read = chars_read;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_file_load(launchpad_t* lp, zx_handle_t vmo) {
+    if (vmo == ZX_HANDLE_INVALID)
+        return lp_error(lp, ZX_ERR_INVALID_ARGS, "file_load: invalid vmo");
+
+    reset_script_args(lp);
+
+    char first_line[LP_MAX_INTERP_LINE_LEN + 1];
+    size_t chars_read;
+    zx_status_t status = resolve_script(lp, &vmo, first_line, &chars_read);
+    if (status != ZX_OK)
+        return status;
+
     // Finally, load the interpreter itself
     status = launchpad_elf_load_body(lp, first_line, chars_read, vmo);
 
@@ -1311,3 +1333,231 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd) {
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo) {
     return launchpad_file_load_with_vdso(lp, vmo);
 }
+
+// A launchpad_template_t holds everything launchpad_load_from_vmo() works
+// out before it touches the new process: the resolved #! chain, the parsed
+// ELF headers, the PT_INTERP file fetched from the loader service, and the
+// vDSO.  Loading from a template only has to map the segments, which
+// elf_load_finish() does with copy-on-write clones of the cached VMOs.
+struct launchpad_template {
+    char* script_args;
+    size_t script_args_len;
+    size_t num_script_args;
+
+    // The ELF file itself.  Its headers are kept only if it has no PT_INTERP.
+    zx_handle_t exec_vmo;
+    elf_load_info_t* exec_elf;
+    size_t stack_size;
+
+    // The PT_INTERP file, if any.
+    zx_handle_t interp_vmo;
+    elf_load_info_t* interp_elf;
+
+    // The vDSO current when the template was made.  If
+    // launchpad_set_vdso_vmo() installs another one later, clones load
+    // that instead.
+    zx_handle_t vdso_vmo;
+    zx_koid_t vdso_koid;
+    elf_load_info_t* vdso_elf;
+};
+
+static zx_koid_t get_koid(zx_handle_t handle) {
+    zx_info_handle_basic_t info;
+    zx_status_t status = zx_object_get_info(handle, ZX_INFO_HANDLE_BASIC,
+                                            &info, sizeof(info), NULL, NULL);
+    return status == ZX_OK ? info.koid : ZX_KOID_INVALID;
+}
+
+void launchpad_template_destroy(launchpad_template_t* tmpl) {
+    if (tmpl == NULL)
+        return;
+    free(tmpl->script_args);
+    if (tmpl->exec_elf != NULL)
+        elf_load_destroy(tmpl->exec_elf);
+    if (tmpl->interp_elf != NULL)
+        elf_load_destroy(tmpl->interp_elf);
+    if (tmpl->vdso_elf != NULL)
+        elf_load_destroy(tmpl->vdso_elf);
+    close_handles(&tmpl->exec_vmo, 1);
+    close_handles(&tmpl->interp_vmo, 1);
+    close_handles(&tmpl->vdso_vmo, 1);
+    free(tmpl);
+}
+
+// Fill in |tmpl| from |vmo|, using |lp| only for its loader service and
+// script argument bookkeeping; it never gets a process.  The #! and
+// PT_INTERP lookups go through the loader service installed in |lp|.
+static zx_status_t template_fill(launchpad_t* lp, launchpad_template_t* tmpl,
+                                 zx_handle_t vmo) {
+    char first_line[LP_MAX_INTERP_LINE_LEN + 1];
+    size_t chars_read;
+    zx_status_t status = resolve_script(lp, &vmo, first_line, &chars_read);
+    if (status != ZX_OK)
+        return status;
+    tmpl->exec_vmo = vmo;
+
+    status = elf_load_start(vmo, first_line, chars_read, &tmpl->exec_elf);
+    if (status != ZX_OK)
+        return status;
+
+    char* interp;
+    size_t interp_len;
+    status = elf_load_get_interp(tmpl->exec_elf, vmo, &interp, &interp_len);
+    if (status != ZX_OK)
+        return status;
+
+    if (interp == NULL) {
+        tmpl->stack_size = elf_load_get_stack_size(tmpl->exec_elf);
+    } else {
+        status = setup_loader_svc(lp);
+        if (status == ZX_OK)
+            status = loader_svc_rpc(
+                lp->special_handles[HND_LOADER_SVC], LOADER_SVC_OP_LOAD_OBJECT,
+                interp, interp_len, &tmpl->interp_vmo);
+        free(interp);
+        if (status == ZX_OK)
+            status = elf_load_start(tmpl->interp_vmo, NULL, 0,
+                                    &tmpl->interp_elf);
+        if (status != ZX_OK)
+            return status;
+
+        // Only the dynamic linker gets mapped; it reads the executable.
+        elf_load_destroy(tmpl->exec_elf);
+        tmpl->exec_elf = NULL;
+    }
+
+    status = launchpad_get_vdso_vmo(&tmpl->vdso_vmo);
+    if (status != ZX_OK)
+        return status;
+    status = elf_load_start(tmpl->vdso_vmo, NULL, 0, &tmpl->vdso_elf);
+    if (status != ZX_OK)
+        return status;
+    tmpl->vdso_koid = get_koid(tmpl->vdso_vmo);
+
+    tmpl->script_args = lp->script_args;
+    tmpl->script_args_len = lp->script_args_len;
+    tmpl->num_script_args = lp->num_script_args;
+    lp->script_args = NULL;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_template_create(zx_handle_t vmo, zx_handle_t loader_svc,
+                                      launchpad_template_t** result) {
+    if (vmo == ZX_HANDLE_INVALID)
+        return ZX_ERR_INVALID_ARGS;
+
+    launchpad_template_t* tmpl = calloc(1, sizeof(*tmpl));
+    launchpad_t* lp = calloc(1, sizeof(*lp));
+    if (tmpl == NULL || lp == NULL) {
+        free(tmpl);
+        free(lp);
+        zx_handle_close(vmo);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Borrow the caller's loader service, if any, rather than having
+    // setup_loader_svc() connect to the default one.
+    lp->special_handles[HND_LOADER_SVC] = loader_svc;
+    zx_status_t status = template_fill(lp, tmpl, vmo);
+    if (loader_svc != ZX_HANDLE_INVALID)
+        lp->special_handles[HND_LOADER_SVC] = ZX_HANDLE_INVALID;
+    launchpad_destroy(lp);
+
+    if (status != ZX_OK) {
+        launchpad_template_destroy(tmpl);
+        return status;
+    }
+
+    *result = tmpl;
+    return ZX_OK;
+}
+
+zx_status_t launchpad_template_create_from_file(const char* path,
+                                                zx_handle_t loader_svc,
+                                                launchpad_template_t** result) {
+    zx_handle_t vmo;
+    zx_status_t status = launchpad_vmo_from_file(path, &vmo);
+    if (status != ZX_OK)
+        return status;
+    return launchpad_template_create(vmo, loader_svc, result);
+}
+
+zx_status_t launchpad_clone_template(launchpad_t* lp,
+                                     const launchpad_template_t* tmpl) {
+    if (lp->error)
+        return lp->error;
+
+    reset_script_args(lp);
+    if (tmpl->script_args_len > 0) {
+        lp->script_args = malloc(tmpl->script_args_len);
+        if (lp->script_args == NULL)
+            return lp_error(lp, ZX_ERR_NO_MEMORY, "clone_template: out of memory");
+        memcpy(lp->script_args, tmpl->script_args, tmpl->script_args_len);
+        lp->script_args_len = tmpl->script_args_len;
+        lp->num_script_args = tmpl->num_script_args;
+    }
+
+    zx_handle_t segments_vmar;
+    zx_status_t status;
+    if (tmpl->interp_elf == NULL) {
+        status = elf_load_finish(lp_vmar(lp), tmpl->exec_elf, tmpl->exec_vmo,
+                                 &segments_vmar, &lp->base, &lp->entry);
+        if (status != ZX_OK)
+            return lp_error(lp, status, "clone_template: elf_load_finish() failed");
+        if (tmpl->stack_size > 0)
+            launchpad_set_stack_size(lp, tmpl->stack_size);
+        lp->loader_message = false;
+        launchpad_add_handle(lp, segments_vmar, PA_HND(PA_VMAR_LOADED, 0));
+    } else {
+        status = setup_loader_svc(lp);
+        if (status != ZX_OK)
+            return lp_error(lp, status, "clone_template: setup_loader_svc() failed");
+        if (lp->fresh_process) {
+            status = reserve_low_address_space(lp);
+            if (status != ZX_OK)
+                return status;
+        }
+
+        zx_handle_t exec_vmo;
+        status = zx_handle_duplicate(tmpl->exec_vmo, ZX_RIGHT_SAME_RIGHTS,
+                                     &exec_vmo);
+        if (status != ZX_OK)
+            return lp_error(lp, status, "clone_template: cannot duplicate vmo");
+
+        status = elf_load_finish(lp_vmar(lp), tmpl->interp_elf,
+                                 tmpl->interp_vmo, &segments_vmar,
+                                 &lp->base, &lp->entry);
+        if (status != ZX_OK) {
+            zx_handle_close(exec_vmo);
+            return lp_error(lp, status, "clone_template: elf_load_finish() failed");
+        }
+
+        close_handles(&lp->special_handles[HND_EXEC_VMO], 1);
+        lp->special_handles[HND_EXEC_VMO] = exec_vmo;
+        close_handles(&lp->special_handles[HND_SEGMENTS_VMAR], 1);
+        lp->special_handles[HND_SEGMENTS_VMAR] = segments_vmar;
+        lp->loader_message = true;
+    }
+
+    vdso_lock();
+    bool same_vdso = get_koid(vdso_get_vmo()) == tmpl->vdso_koid;
+    vdso_unlock();
+    if (!same_vdso) {
+        // The cached headers are stale; load the current vDSO the slow way.
+        status = launchpad_load_vdso(lp, ZX_HANDLE_INVALID);
+        if (status != ZX_OK)
+            return status;
+        return launchpad_add_vdso_vmo(lp);
+    }
+
+    status = elf_load_finish(lp_vmar(lp), tmpl->vdso_elf, tmpl->vdso_vmo,
+                             NULL, &lp->vdso_base, NULL);
+    if (status != ZX_OK)
+        return lp_error(lp, status, "clone_template: cannot map vDSO");
+
+    zx_handle_t vdso;
+    status = zx_handle_duplicate(tmpl->vdso_vmo, ZX_RIGHT_SAME_RIGHTS, &vdso);
+    if (status != ZX_OK)
+        return lp_error(lp, status, "clone_template: cannot duplicate vDSO");
+    return launchpad_add_handle(lp, vdso, PA_HND(PA_VMO_VDSO, 0));
+}
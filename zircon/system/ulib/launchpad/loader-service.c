@@ -8,6 +8,7 @@
 #include <fdio/dispatcher.h>
 #include <fdio/io.h>
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
@@ -134,39 +135,249 @@ zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle
 
 
 // When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* fn) {
+// The path that was opened is left in |path|.
+static int open_from_libpath(const char* fn, char* path, size_t len) {
     int fd = -1;
     for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
+        snprintf(path, len, "%s/%s", libpaths[n], fn);
         fd = open(path, O_RDONLY);
     }
     return fd;
 }
 
-// Always consumes the fd.
-static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
-    zx_status_t status = fdio_get_vmo(fd, out);
-    close(fd);
-    if (status == ZX_OK)
-        zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
+// The file-system backed loader services keep the VMO of every file
+// they hand out, keyed by the path it was opened by. Later requests for
+// the same path get a copy-on-write clone of the cached VMO rather than
+// another copy of the file, as long as the file still has the inode,
+// size and modification time it had when it was cached.
+#define VMO_CACHE_MAX 128
+
+typedef struct vmo_cache_entry vmo_cache_entry_t;
+struct vmo_cache_entry {
+    vmo_cache_entry_t* next;
+    uint32_t hash;
+    char* path;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    zx_handle_t vmo;
+};
+
+static mtx_t vmo_cache_lock = MTX_INIT;
+// Most recently inserted first.
+static vmo_cache_entry_t* vmo_cache;
+static size_t vmo_cache_count;
+
+// Rights of the VMOs we hand out; the same as fdio_get_vmo() gives.
+#define VMO_CACHE_RIGHTS (ZX_RIGHTS_BASIC | ZX_RIGHTS_PROPERTY | \
+                          ZX_RIGHT_READ | ZX_RIGHT_EXECUTE | ZX_RIGHT_MAP)
+
+static uint32_t path_hash(const char* path) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*path != '\0') {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool vmo_cache_entry_current(const vmo_cache_entry_t* entry,
+                                    const struct stat* st) {
+    return entry->ino == st->st_ino && entry->size == st->st_size &&
+        entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+        entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void vmo_cache_entry_free(vmo_cache_entry_t* entry) {
+    zx_handle_close(entry->vmo);
+    free(entry->path);
+    free(entry);
+}
+
+static zx_status_t vmo_cache_clone(zx_handle_t vmo, zx_handle_t* out) {
+    uint64_t size;
+    zx_status_t status = zx_vmo_get_size(vmo, &size);
+    if (status != ZX_OK)
+        return status;
+    zx_handle_t clone;
+    status = zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone);
+    if (status != ZX_OK)
+        return status;
+    return zx_handle_replace(clone, VMO_CACHE_RIGHTS, out);
+}
+
+// Looks up |path| and, if the cached VMO is still current for the file
+// described by |st|, returns a clone of it. A stale entry is dropped.
+static zx_status_t vmo_cache_lookup(const char* path, uint32_t hash,
+                                    const struct stat* st, zx_handle_t* out) {
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    mtx_lock(&vmo_cache_lock);
+    for (vmo_cache_entry_t** p = &vmo_cache; *p != NULL; p = &(*p)->next) {
+        vmo_cache_entry_t* entry = *p;
+        if (entry->hash != hash || strcmp(entry->path, path) != 0)
+            continue;
+        if (vmo_cache_entry_current(entry, st)) {
+            status = vmo_cache_clone(entry->vmo, out);
+        } else {
+            *p = entry->next;
+            --vmo_cache_count;
+            vmo_cache_entry_free(entry);
+        }
+        break;
+    }
+    mtx_unlock(&vmo_cache_lock);
     return status;
 }
 
+// Keeps |vmo| as the cached contents of |path|, and returns a clone of it
+// in |*out|. Always consumes |vmo|.
+static zx_status_t vmo_cache_insert(const char* path, uint32_t hash,
+                                    const struct stat* st, zx_handle_t vmo,
+                                    zx_handle_t* out) {
+    zx_status_t status = vmo_cache_clone(vmo, out);
+    if (status != ZX_OK) {
+        zx_handle_close(vmo);
+        return status;
+    }
+
+    vmo_cache_entry_t* entry = calloc(1, sizeof(*entry));
+    if (entry == NULL || (entry->path = strdup(path)) == NULL) {
+        // We still have something to hand out; just don't cache it.
+        free(entry);
+        zx_handle_close(vmo);
+        return ZX_OK;
+    }
+    entry->hash = hash;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+    entry->vmo = vmo;
+
+    mtx_lock(&vmo_cache_lock);
+    // Another thread may have loaded the same file meanwhile; replace it.
+    vmo_cache_entry_t** p = &vmo_cache;
+    while (*p != NULL) {
+        vmo_cache_entry_t* old = *p;
+        if (old->hash == hash && strcmp(old->path, path) == 0) {
+            *p = old->next;
+            --vmo_cache_count;
+            vmo_cache_entry_free(old);
+            break;
+        }
+        p = &old->next;
+    }
+    entry->next = vmo_cache;
+    vmo_cache = entry;
+    if (++vmo_cache_count > VMO_CACHE_MAX) {
+        // Evict the oldest entry.
+        p = &vmo_cache;
+        while ((*p)->next != NULL)
+            p = &(*p)->next;
+        vmo_cache_entry_free(*p);
+        *p = NULL;
+        --vmo_cache_count;
+    }
+    mtx_unlock(&vmo_cache_lock);
+    return ZX_OK;
+}
+
+void loader_service_cache_flush(void) {
+    mtx_lock(&vmo_cache_lock);
+    vmo_cache_entry_t* entry = vmo_cache;
+    vmo_cache = NULL;
+    vmo_cache_count = 0;
+    mtx_unlock(&vmo_cache_lock);
+
+    while (entry != NULL) {
+        vmo_cache_entry_t* next = entry->next;
+        vmo_cache_entry_free(entry);
+        entry = next;
+    }
+}
+
+// Always consumes the fd.
+static zx_handle_t load_object_fd(int fd, const char* path, const char* fn,
+                                  zx_handle_t* out) {
+    struct stat st;
+    uint32_t hash = path_hash(path);
+    bool cacheable = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (cacheable && vmo_cache_lookup(path, hash, &st, out) == ZX_OK) {
+        close(fd);
+    } else {
+        zx_handle_t vmo;
+        zx_status_t status = fdio_get_vmo(fd, &vmo);
+        close(fd);
+        if (status != ZX_OK)
+            return status;
+        if (cacheable) {
+            if ((status = vmo_cache_insert(path, hash, &st, vmo, out)) != ZX_OK)
+                return status;
+        } else {
+            *out = vmo;
+        }
+    }
+    zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
+    return ZX_OK;
+}
+
 static zx_status_t fs_load_object(void *ctx, const char* name, zx_handle_t* out) {
-    int fd = open_from_libpath(name);
+    char path[PATH_MAX];
+    int fd = open_from_libpath(name, path, sizeof(path));
     if (fd >= 0)
-        return load_object_fd(fd, name, out);
+        return load_object_fd(fd, path, name, out);
     return ZX_ERR_NOT_FOUND;
 }
 
 static zx_status_t fs_load_abspath(void *ctx, const char* path, zx_handle_t* out) {
     int fd = open(path, O_RDONLY);
     if (fd >= 0)
-        return load_object_fd(fd, path, out);
+        return load_object_fd(fd, path, path, out);
     return ZX_ERR_NOT_FOUND;
 }
 
+zx_status_t loader_service_prewarm(const char* const* names, size_t count) {
+    zx_status_t result = ZX_OK;
+    for (size_t i = 0; i < count; ++i) {
+        zx_handle_t vmo;
+        zx_status_t status = fs_load_object(NULL, names[i], &vmo);
+        if (status == ZX_OK) {
+            zx_handle_close(vmo);
+        } else {
+            fprintf(stderr, "dlsvc: cannot prewarm '%s': %s\n",
+                    names[i], zx_status_get_string(status));
+            result = status;
+        }
+    }
+    return result;
+}
+
+zx_status_t loader_service_prewarm_from_file(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+        return ZX_ERR_NOT_FOUND;
+
+    zx_status_t result = ZX_OK;
+    char line[NAME_MAX + 2];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char* name = line;
+        while (isspace(*name))
+            ++name;
+        char* end = name + strlen(name);
+        while (end > name && isspace(end[-1]))
+            --end;
+        *end = '\0';
+        if (name[0] == '\0' || name[0] == '#')
+            continue;
+        const char* names[] = { name };
+        zx_status_t status = loader_service_prewarm(names, 1);
+        if (status != ZX_OK)
+            result = status;
+    }
+    fclose(f);
+    return result;
+}
+
 // For now, just publish data-sink VMOs as files under /tmp/<sink-name>/.
 // The individual file is named by its VMO's name.
 static zx_status_t fs_publish_data_sink(void* ctx, const char* name, zx_handle_t vmo) {
@@ -25,6 +25,7 @@ public:
     MinfsChecker();
     zx_status_t Init(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info);
     zx_status_t CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot);
+    zx_status_t CheckJournal();
     zx_status_t CheckForUnusedBlocks() const;
     zx_status_t CheckForUnusedInodes() const;
     zx_status_t CheckLinkCounts() const;
@@ -50,6 +51,8 @@ private:
                                ino_t parent, uint32_t flags);
     const char* CheckDataBlock(blk_t bno);
     zx_status_t CheckFile(minfs_inode_t* inode, ino_t ino);
+    zx_status_t CheckExtents(minfs_inode_t* inode, ino_t ino);
+    zx_status_t CheckDirIndex(minfs_inode_t* inode, ino_t ino);
 
     fbl::RefPtr<Minfs> fs_;
     RawBitmap checked_inodes_;
@@ -290,6 +293,123 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
     return ZX_OK;
 }
 
+// Verifies that the index of a directory holds exactly its live dirents.
+zx_status_t MinfsChecker::CheckDirIndex(minfs_inode_t* inode, ino_t ino) {
+    minfs_inode_t index_inode;
+    zx_status_t status;
+    if ((status = GetInode(&index_inode, inode->dir_index)) < 0) {
+        FS_TRACE_ERROR("check: ino#%u: directory index ino#%u not readable\n",
+                       ino, inode->dir_index);
+        return status;
+    }
+    if (index_inode.magic != kMinfsMagicFile) {
+        FS_TRACE_ERROR("check: ino#%u: directory index ino#%u is not a file\n",
+                       ino, inode->dir_index);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    // The index is linked from its directory alone.
+    if ((status = CheckInode(inode->dir_index, ino, false)) < 0) {
+        return status;
+    }
+
+    fbl::RefPtr<VnodeMinfs> vn;
+    if ((status = VnodeMinfs::Recreate(fs_.get(), ino, inode, &vn)) != ZX_OK) {
+        return status;
+    }
+    if ((status = vn->DirIndexLoad()) == ZX_ERR_IO_DATA_INTEGRITY) {
+        FS_TRACE_WARN("check: ino#%u: directory index is out of date\n", ino);
+        conforming_ = false;
+        return ZX_OK;
+    } else if (status != ZX_OK) {
+        FS_TRACE_ERROR("check: ino#%u: unreadable directory index: %d\n", ino, status);
+        return status;
+    }
+
+    // Mark the offset of every live dirent; each must be claimed by exactly one entry.
+    RawBitmap dirents;
+    if ((status = dirents.Reset(kMinfsMaxDirectorySize / 4)) != ZX_OK) {
+        return status;
+    }
+    size_t off = 0;
+    while (true) {
+        uint32_t data[DirentSize(NAME_MAX)];
+        size_t actual;
+        if ((status = vn->ReadInternal(data, sizeof(data), off, &actual)) != ZX_OK) {
+            return status;
+        } else if (actual < MINFS_DIRENT_SIZE) {
+            return ZX_ERR_IO;
+        }
+        minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(data);
+        if (de->ino != 0) {
+            dirents.Set(off / 4, off / 4 + 1);
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+
+    const minfs_dir_index_root_t* root = vn->dir_index_root_.get();
+    if (root->tail != off) {
+        FS_TRACE_WARN("check: ino#%u: directory index tail %u, actual tail %zu\n",
+                      ino, root->tail, off);
+        conforming_ = false;
+    }
+    uint32_t entry_count = 0;
+    for (uint32_t n = 0; n < root->leaf_count; n++) {
+        minfs_dir_index_leaf_t leaf;
+        if ((status = vn->DirIndexReadLeaf(root->leaves[n].block, &leaf)) != ZX_OK) {
+            FS_TRACE_ERROR("check: ino#%u: unreadable directory index leaf %u\n", ino, n);
+            return status;
+        }
+        const uint32_t min_hash = root->leaves[n].hash;
+        const uint64_t max_hash = (n + 1 < root->leaf_count) ? root->leaves[n + 1].hash :
+                                  (1ull << 32);
+        for (uint32_t i = 0; i < leaf.count; i++) {
+            const minfs_dir_index_entry_t& entry = leaf.entries[i];
+            if (entry.hash < min_hash || entry.hash >= max_hash ||
+                (i > 0 && entry.hash < leaf.entries[i - 1].hash)) {
+                FS_TRACE_WARN("check: ino#%u: directory index leaf %u: misplaced hash %#x\n",
+                              ino, n, entry.hash);
+                conforming_ = false;
+            }
+            if ((entry.off & 3) || (entry.off >= kMinfsMaxDirectorySize) ||
+                !dirents.Get(entry.off / 4, entry.off / 4 + 1)) {
+                FS_TRACE_WARN("check: ino#%u: directory index holds no dirent at %u\n",
+                              ino, entry.off);
+                conforming_ = false;
+                continue;
+            }
+            // Clear the dirent, so that a second entry for it is caught.
+            dirents.Clear(entry.off / 4, entry.off / 4 + 1);
+
+            uint32_t data[DirentSize(NAME_MAX)];
+            size_t actual;
+            if ((status = vn->ReadInternal(data, sizeof(data), entry.off, &actual)) != ZX_OK) {
+                return status;
+            }
+            const minfs_dirent_t* de = reinterpret_cast<const minfs_dirent_t*>(data);
+            if (MinfsDirIndexHash(de->name, de->namelen) != entry.hash) {
+                FS_TRACE_WARN("check: ino#%u: directory index has bad hash for '%.*s'\n",
+                              ino, de->namelen, de->name);
+                conforming_ = false;
+            }
+            entry_count++;
+        }
+    }
+    size_t unindexed;
+    if (dirents.Find(true, 0, dirents.size(), 1, &unindexed) == ZX_OK) {
+        FS_TRACE_WARN("check: ino#%u: dirent at %zu is not indexed\n", ino, unindexed * 4);
+        conforming_ = false;
+    }
+    if (entry_count != root->entry_count) {
+        FS_TRACE_WARN("check: ino#%u: directory index holds %u entries, not %u\n",
+                      ino, entry_count, root->entry_count);
+        conforming_ = false;
+    }
+    return ZX_OK;
+}
+
 const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     if (bno == 0) {
         return "reserved bno";
@@ -308,7 +428,73 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     return nullptr;
 }
 
+zx_status_t MinfsChecker::CheckExtents(minfs_inode_t* inode, ino_t ino) {
+    zx_status_t status;
+    fbl::RefPtr<VnodeMinfs> vn;
+    if ((status = VnodeMinfs::Recreate(fs_.get(), ino, inode, &vn)) != ZX_OK) {
+        return status;
+    }
+    if ((status = vn->LoadExtents()) != ZX_OK) {
+        FS_TRACE_ERROR("check: ino#%u: unreadable extents: %d\n", ino, status);
+        return status;
+    }
+
+    uint32_t block_count = 0;
+    const char* msg;
+
+    // count and sanity-check the blocks holding the extents
+    const minfs_extent_map_t* map = MinfsExtentMap(inode);
+    if (map->tree) {
+        if ((msg = CheckDataBlock(map->tree)) != nullptr) {
+            FS_TRACE_WARN("check: ino#%u: extent index block (@%u): %s\n", ino, map->tree, msg);
+            conforming_ = false;
+        }
+        block_count++;
+    }
+    for (size_t n = 0; n < vn->extent_leaves_.size(); n++) {
+        if ((msg = CheckDataBlock(vn->extent_leaves_[n])) != nullptr) {
+            FS_TRACE_WARN("check: ino#%u: extent leaf %zu(@%u): %s\n",
+                          ino, n, vn->extent_leaves_[n], msg);
+            conforming_ = false;
+        }
+        block_count++;
+    }
+
+    // count and sanity-check data blocks
+    unsigned next_blk = 0;
+    for (const minfs_extent_t& extent : vn->extents_) {
+        xprintf("Extent: %u -> %u, %u blocks\n", extent.file_block, extent.start, extent.length);
+        for (blk_t n = 0; n < extent.length; n++) {
+            if ((msg = CheckDataBlock(extent.start + n)) != nullptr) {
+                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n",
+                              ino, extent.file_block + n, extent.start + n, msg);
+                conforming_ = false;
+            }
+            block_count++;
+        }
+        next_blk = extent.file_block + extent.length;
+    }
+
+    if (next_blk) {
+        unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
+        if (next_blk > max_blocks) {
+            FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
+            conforming_ = false;
+        }
+    }
+    if (block_count != inode->block_count) {
+        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
+             ino, inode->block_count, block_count);
+        conforming_ = false;
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        return CheckExtents(inode, ino);
+    }
+
     xprintf("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         xprintf(" %d,", inode->dnum[n]);
@@ -451,6 +637,9 @@ zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot
         if ((status = CheckDirectory(&inode, ino, parent, CD_RECURSE)) < 0) {
             return status;
         }
+        if (inode.dir_index != 0 && (status = CheckDirIndex(&inode, ino)) < 0) {
+            return status;
+        }
     } else {
         xprintf("ino#%u: FILE blks=%u links=%u size=%u\n", ino, inode.block_count, inode.link_count,
                 inode.size);
@@ -461,6 +650,26 @@ zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot
     return ZX_OK;
 }
 
+zx_status_t MinfsChecker::CheckJournal() {
+    const minfs_info_t& info = fs_->info_;
+    if (info.journal_blocks == 0) {
+        return ZX_OK;
+    }
+    xprintf("journal: blks=%u @ %u\n", info.journal_blocks, info.journal_start);
+    if (info.journal_start + info.journal_blocks > info.block_count) {
+        FS_TRACE_ERROR("check: journal (@%u) lies outside of the volume\n", info.journal_start);
+        return ZX_ERR_BAD_STATE;
+    }
+    for (blk_t n = 0; n < info.journal_blocks; n++) {
+        const char* msg;
+        if ((msg = CheckDataBlock(info.journal_start + n)) != nullptr) {
+            FS_TRACE_WARN("check: journal block %u(@%u): %s\n", n, info.journal_start + n, msg);
+            conforming_ = false;
+        }
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckForUnusedBlocks() const {
     unsigned missing = 0;
     for (unsigned n = fs_->info_.dat_block; n < fs_->info_.block_count; n++) {
@@ -563,7 +772,11 @@ zx_status_t minfs_check(fbl::unique_ptr<Bcache> bc) {
         FS_TRACE_ERROR("minfs: could not read info block\n");
         return ZX_ERR_IO;
     }
-    const minfs_info_t* info = reinterpret_cast<const minfs_info_t*>(data);
+    minfs_info_t* info = reinterpret_cast<minfs_info_t*>(data);
+    if ((status = minfs_journal_replay(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs_check: could not replay journal: %d\n", status);
+        return status;
+    }
     minfs_dump_info(info);
     if ((status = minfs_check_info(info, bc.get())) != ZX_OK) {
         FS_TRACE_ERROR("minfs_check: check_info failure: %d\n", status);
@@ -582,6 +795,11 @@ zx_status_t minfs_check(fbl::unique_ptr<Bcache> bc) {
         return status;
     }
 
+    if ((status = chk.CheckJournal()) != ZX_OK) {
+        FS_TRACE_ERROR("minfs_check: CheckJournal failure: %d\n", status);
+        return status;
+    }
+
     zx_status_t r;
 
     // Save an error if it occurs, but check for subsequent errors
@@ -7,6 +7,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -412,6 +413,37 @@ int emu_mkdir(const char* path, mode_t mode) {
     }
 }
 
+int emu_unlink(const char* path) {
+    ZX_DEBUG_ASSERT_MSG(!host_path(path), "'emu_' functions can only operate on target paths");
+    path += PREFIX_SIZE;
+    fbl::RefPtr<fs::Vnode> parent = fake_root;
+    const char* name = strrchr(path, '/');
+    if (name == nullptr) {
+        name = path;
+    } else {
+        // Walking a path reads up to its terminator, so the parent is copied out.
+        char buf[PATH_MAX];
+        const size_t len = name - path;
+        if (len >= sizeof(buf)) {
+            FAIL(ENAMETOOLONG);
+        }
+        memcpy(buf, path, len);
+        buf[len] = 0;
+        fbl::StringPiece dir(buf);
+        zx_status_t status = fake_vfs.Open(fake_root, &parent, dir, &dir, O_RDONLY, 0);
+        if (status != ZX_OK) {
+            STATUS(status);
+        }
+        name++;
+    }
+
+    zx_status_t status = fake_vfs.Unlink(parent, fbl::StringPiece(name));
+    if (parent != fake_root) {
+        parent->Close();
+    }
+    STATUS(status);
+}
+
 DIR* emu_opendir(const char* name) {
     ZX_DEBUG_ASSERT_MSG(!host_path(name), "'emu_' functions can only operate on target paths");
     fbl::RefPtr<fs::Vnode> vn;
@@ -35,7 +35,12 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000005;
+constexpr uint32_t kMinfsVersion        = 0x00000008;
+// The oldest version which may still be mounted. Version 5 images hold only
+// block mapped inodes, version 6 images have no directory indexes, and
+// version 7 images have no metadata journal; all are upgraded to the current
+// version on mount.
+constexpr uint32_t kMinfsVersionBlockMap = 0x00000005;
 
 constexpr ino_t kMinfsRootIno           = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -96,6 +101,9 @@ typedef struct {
     uint32_t abm_slices;    // Slices allocated to block bitmap
     uint32_t ino_slices;    // Slices allocated to inode table
     uint32_t dat_slices;    // Slices allocated to file data section
+    // The following fields are only valid with (version >= 8):
+    blk_t journal_start;    // first data block of the metadata journal
+    uint32_t journal_blocks; // blocks in the metadata journal, or 0 if none
 } minfs_info_t;
 
 // Notes:
@@ -111,6 +119,18 @@ typedef struct {
 //     ino_block + ino / kMinfsInodesPerBlock
 //   at offset: ino % kMinfsInodesPerBlock
 // - inode 0 is never used, should be marked allocated but ignored
+// - an inode with kMinfsInodeFlagExtents set stores a minfs_extent_map_t in
+//   place of its block pointers. The first kMinfsInlineExtents extents, sorted
+//   by file_block, live in the inode; the remainder fill the leaves listed in
+//   the index block |tree|, each but the last holding kMinfsExtentsPerLeaf.
+//   Index and leaf blocks count towards the inode's block_count, as
+//   indirect blocks do.
+// - a directory with a nonzero dir_index also indexes its dirents by name hash
+//   in that inode, a regular file which is not linked from any directory. The
+//   dirents remain authoritative; see minfs_dir_index_root_t.
+// - the metadata journal occupies journal_blocks data blocks, starting at
+//   journal_start, which are marked allocated but belong to no inode; see
+//   minfs_journal_info_t.
 
 typedef struct {
     uint32_t magic;
@@ -122,7 +142,9 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;          // for directories
-    uint32_t rsvd[5];
+    uint32_t flags;                 // kMinfsInodeFlag*
+    ino_t dir_index;                // for directories: inode of the hash index, or 0
+    uint32_t rsvd[3];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -131,6 +153,62 @@ typedef struct {
 static_assert(sizeof(minfs_inode_t) == kMinfsInodeSize,
               "minfs inode size is wrong");
 
+// The inode maps its blocks with extents rather than block pointers.
+constexpr uint32_t kMinfsInodeFlagExtents = 0x00000001;
+
+// A run of blocks, contiguous both within the file and on disk.
+typedef struct {
+    blk_t file_block;               // first block of the run, relative to the file
+    blk_t start;                    // first block of the run on disk
+    uint32_t length;                // number of blocks in the run
+} minfs_extent_t;
+
+constexpr uint32_t kMinfsInlineExtents = 15;
+
+// Overlays dnum, inum and dinum of an inode with kMinfsInodeFlagExtents set.
+typedef struct {
+    uint32_t count;                 // total number of extents
+    blk_t tree;                     // extent index block, if count > kMinfsInlineExtents
+    uint32_t rsvd;
+    minfs_extent_t extents[kMinfsInlineExtents];
+} minfs_extent_map_t;
+
+static_assert(sizeof(minfs_extent_map_t) ==
+              sizeof(blk_t) * (kMinfsDirect + kMinfsIndirect + kMinfsDoublyIndirect),
+              "minfs extent map must overlay the block pointers exactly");
+
+// An entry of the extent index block, which points to one leaf block of extents.
+typedef struct {
+    blk_t file_block;               // first file block mapped by the leaf
+    blk_t bno;                      // the leaf block
+} minfs_extent_index_t;
+
+constexpr uint32_t kMinfsExtentLeavesPerIndex = kMinfsBlockSize / sizeof(minfs_extent_index_t);
+
+// A leaf block of extents.
+constexpr uint32_t kMinfsExtentsPerLeaf = (kMinfsBlockSize - 2 * sizeof(uint32_t)) /
+                                          sizeof(minfs_extent_t);
+
+typedef struct {
+    uint32_t count;                 // number of extents in this leaf
+    uint32_t rsvd;
+    minfs_extent_t extents[kMinfsExtentsPerLeaf];
+} minfs_extent_leaf_t;
+
+static_assert(sizeof(minfs_extent_leaf_t) <= kMinfsBlockSize,
+              "minfs extent leaf must fit in a block");
+
+static_assert(kMinfsInlineExtents + kMinfsExtentLeavesPerIndex * kMinfsExtentsPerLeaf >=
+              kMinfsMaxFileBlock, "minfs extent tree must be able to map every block of a file");
+
+inline minfs_extent_map_t* MinfsExtentMap(minfs_inode_t* inode) {
+    return reinterpret_cast<minfs_extent_map_t*>(inode->dnum);
+}
+
+inline const minfs_extent_map_t* MinfsExtentMap(const minfs_inode_t* inode) {
+    return reinterpret_cast<const minfs_extent_map_t*>(inode->dnum);
+}
+
 typedef struct {
     ino_t ino;                      // inode number
     uint32_t reclen;                // Low 28 bits: Length of record
@@ -176,6 +254,123 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   record starts. If the MAX_DIR_SIZE is increased, this 'last' record will
 //   also increase in size.
 
+// Directory index.
+//
+// Block 0 of a directory's index file is a minfs_dir_index_root_t, which
+// splits the range of name hashes among the leaf blocks which follow it. Each
+// leaf holds the (hash, offset) of every live dirent whose name hashes into
+// its range, sorted by hash; dirents of equal hash always share a leaf.
+//
+// The index is only valid while its seq_num matches that of the directory;
+// an index which does not match is discarded and rebuilt from the dirents.
+
+constexpr uint64_t kMinfsDirIndexMagic = 0x786564496e694d21ULL;
+
+// Directories are indexed once they grow to this size.
+constexpr uint32_t kMinfsDirIndexMinSize = 2 * kMinfsBlockSize;
+
+inline uint32_t MinfsDirIndexHash(const char* name, size_t len) {
+    return fnv1a32(name, len);
+}
+
+typedef struct {
+    uint32_t hash;                  // MinfsDirIndexHash of the dirent's name
+    uint32_t off;                   // offset of the dirent within the directory
+} minfs_dir_index_entry_t;
+
+constexpr uint32_t kMinfsDirIndexEntriesPerLeaf = (kMinfsBlockSize - 2 * sizeof(uint32_t)) /
+                                                  sizeof(minfs_dir_index_entry_t);
+
+typedef struct {
+    uint32_t count;                 // number of entries in this leaf
+    uint32_t rsvd;
+    minfs_dir_index_entry_t entries[kMinfsDirIndexEntriesPerLeaf];
+} minfs_dir_index_leaf_t;
+
+typedef struct {
+    uint32_t hash;                  // lowest hash held by the leaf
+    blk_t block;                    // the leaf, relative to the start of the index
+} minfs_dir_index_node_t;
+
+constexpr uint32_t kMinfsDirIndexMaxLeaves = (kMinfsBlockSize - 32) /
+                                             sizeof(minfs_dir_index_node_t);
+
+typedef struct {
+    uint64_t magic;
+    uint32_t seq_num;               // seq_num of the directory as of the last update
+    uint32_t entry_count;           // equal to the dirent_count of the directory
+    uint32_t tail;                  // offset of the last record of the directory
+    uint32_t leaf_count;
+    uint32_t rsvd[2];
+    minfs_dir_index_node_t leaves[kMinfsDirIndexMaxLeaves]; // sorted by hash
+} minfs_dir_index_root_t;
+
+static_assert(sizeof(minfs_dir_index_root_t) == kMinfsBlockSize,
+              "minfs directory index root must fill a block");
+static_assert(sizeof(minfs_dir_index_leaf_t) <= kMinfsBlockSize,
+              "minfs directory index leaf must fit in a block");
+// Leaves are split in half once full, so the index has room for even the
+// largest directory.
+static_assert(kMinfsDirIndexMaxLeaves * (kMinfsDirIndexEntriesPerLeaf / 2) >=
+              kMinfsMaxDirectorySize / DirentSize(1),
+              "minfs directory index must be able to hold every dirent");
+
+// Metadata journal.
+//
+// Block 0 of the journal is a minfs_journal_info_t; the remaining blocks form
+// a ring of entries. Each entry is a minfs_journal_header_t, a copy of every
+// block it updates, in the order listed by the header, and a
+// minfs_journal_commit_t. Entries carry consecutive sequence numbers, and
+// the ring is replayed on mount from |start| up to the first entry which is
+// incomplete or out of sequence. File data is never journaled; it is written
+// in place before the entry which refers to it is committed.
+
+constexpr uint64_t kMinfsJournalMagic       = 0x6c6e724a6e694d21ULL;
+constexpr uint64_t kMinfsJournalHeaderMagic = 0x7264684a6e694d21ULL;
+constexpr uint64_t kMinfsJournalCommitMagic = 0x746d634a6e694d21ULL;
+
+// The size of the journal created by mkfs, or on upgrade, where the volume has
+// room for it. Smaller volumes get proportionally smaller journals, and the
+// smallest go without.
+constexpr uint32_t kMinfsJournalBlocks      = 256;
+constexpr uint32_t kMinfsJournalMinBlocks   = 16;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sequence;              // sequence number of the entry at |start|
+    uint32_t start;                 // ring offset of the oldest entry to replay
+    uint32_t rsvd[3];
+} minfs_journal_info_t;
+
+constexpr uint32_t kMinfsJournalEntryMax = (kMinfsBlockSize - 32) / sizeof(blk_t);
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sequence;
+    uint32_t count;                 // number of blocks updated by the entry
+    uint32_t rsvd[3];
+    blk_t target[kMinfsJournalEntryMax]; // device block updated by each copy
+} minfs_journal_header_t;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sequence;
+    uint32_t checksum;              // MinfsJournalChecksum of header and copies
+    uint32_t rsvd[3];
+} minfs_journal_commit_t;
+
+static_assert(sizeof(minfs_journal_header_t) == kMinfsBlockSize,
+              "minfs journal header must fill a block");
+
+// Extends |checksum| by |len| bytes of |data|. Checksums start from
+// FNV32_OFFSET_BASIS.
+inline uint32_t MinfsJournalChecksum(uint32_t checksum, const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (len-- > 0) {
+        checksum = (checksum ^ *bytes++) * FNV32_PRIME;
+    }
+    return checksum;
+}
 
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
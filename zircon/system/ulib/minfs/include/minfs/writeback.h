@@ -11,6 +11,7 @@
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
@@ -39,8 +40,10 @@ typedef struct {
     size_t vmo_offset;
     size_t dev_offset;
     size_t length;
+    bool data; // File data, which is written in place rather than journaled.
 } write_request_t;
 
+class Journal;
 class WritebackBuffer;
 
 // A transaction consisting of enqueued VMOs to be written
@@ -59,10 +62,24 @@ public:
 
     // Identify that a block should be written to disk
     // as a later point in time.
-    void Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks);
+    void Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks) {
+        EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, false);
+    }
+
+    // Identify that blocks of file data should be written to disk. Unlike metadata,
+    // these bypass the journal, and are written in place before the metadata which
+    // refers to them is committed.
+    void EnqueueData(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                     uint64_t nblocks) {
+        EnqueueRequest(vmo, vmo_offset, dev_offset, nblocks, true);
+    }
+
     size_t Count() const { return count_; }
     write_request_t* Requests() { return &requests_[0]; }
 
+    // Drops the enqueued requests, once they have been written out by the journal.
+    void Clear() { count_ = 0; }
+
     // Activate the transaction, writing it out to disk.
     //
     // Each transaction uses the |vmo| / |vmoid| pair supplied, since the
@@ -73,6 +90,9 @@ public:
 
 private:
     friend class WritebackBuffer;
+    void EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                        uint64_t nblocks, bool data);
+
     Bcache* bc_;
     size_t count_ = 0;
     write_request_t requests_[MAX_TXN_MESSAGES];
@@ -113,6 +133,11 @@ public:
     // Only one closure may be set for each WritebackWork unit.
     using SyncCallback = fs::Vnode::SyncCallback;
     void SetClosure(SyncCallback closure);
+
+    // Signals the closure, if one was set, with the |status| of the transaction. Used in
+    // place of Complete when the transaction is written by the journal; the Vnodes stay
+    // pinned until the WritebackWork is Reset.
+    void SignalClosure(zx_status_t status);
 #else
     void Complete();
 #endif
@@ -136,12 +161,115 @@ private:
 
 #ifdef __Fuchsia__
 
+// The metadata journal of a volume, through which the writeback thread writes
+// WritebackWork out to disk.
+//
+// Work is committed in groups. The file data of every work in a group is
+// written in place first; then the metadata they update is gathered into a
+// single entry, holding only the latest copy of each block, which is written
+// to the journal sequentially. Entries are checkpointed (written to their
+// home blocks) later, once the journal fills or writeback falls idle, so that
+// metadata updated by many operations is written in place once.
+//
+// Only the writeback thread uses the Journal.
+class Journal {
+public:
+    using WorkQueue = Queue<fbl::unique_ptr<WritebackWork>>;
+
+    // Opens the journal of the volume described by |info|, which must have
+    // one, and have been replayed.
+    static zx_status_t Create(Bcache* bc, const minfs_info_t* info,
+                              fbl::unique_ptr<Journal>* out);
+    ~Journal();
+
+    // Commits |works|, whose transactions have been copied to |buffer|, which
+    // the block device knows as |vmoid|. Each work's closure is signalled once
+    // it is committed, but the work, and the Vnodes it pins, are held until
+    // the entry which holds it is checkpointed, so that nothing is read back
+    // from disk before it is written in place.
+    void Commit(WorkQueue* works, MappedVmo* buffer, vmoid_t vmoid);
+
+    // Writes every committed entry to its home blocks, emptying the journal.
+    // If that fails, the entries are left for replay and the journal fails
+    // every later commit and checkpoint with the same error.
+    zx_status_t Checkpoint();
+
+    // Returns true if committed work is waiting to be checkpointed.
+    bool HasCommitted() const { return !checkpoint_works_.is_empty() && status_ == ZX_OK; }
+
+private:
+    Journal(Bcache* bc, blk_t start, uint32_t ring, fbl::unique_ptr<MappedVmo> buffer);
+
+    // A block to be written to |target| from block |source| of a buffer.
+    // |order| ranks the updates of each target.
+    struct Update {
+        blk_t target;
+        uint32_t source;
+        uint32_t order;
+    };
+
+    // Sorts |updates| by target, keeping only the last update of each.
+    static int CompareUpdates(const void* a, const void* b);
+    static size_t Coalesce(Update* updates, size_t count);
+
+    // Writes the group's data, then its entry, and signals its works.
+    void CommitGroup();
+
+    // Returns true if metadata which has yet to be written in place would be
+    // written over any of |length| blocks at |dev_offset|.
+    bool Overlaps(size_t dev_offset, size_t length) const;
+
+    // Returns block |offset| of the copy of the ring.
+    uint8_t* RingBlock(uint32_t offset) const;
+
+    // Writes |length| blocks from |vmoid| to disk, merging the request with
+    // the last where they are contiguous. Requests are sent as the block fifo
+    // fills, or by FlushWrites.
+    void EnqueueWrite(vmoid_t vmoid, size_t vmo_offset, size_t dev_offset, size_t length);
+    zx_status_t FlushWrites();
+
+    Bcache* bc_;
+    // The device block of the journal info, which the ring follows.
+    const blk_t start_;
+    const uint32_t ring_;
+    // Blocks which fit in one entry, along with its header and commit block.
+    const uint32_t entry_max_;
+    // The journal info, followed by a copy of the ring.
+    fbl::unique_ptr<MappedVmo> buffer_{};
+    vmoid_t vmoid_ = VMOID_INVALID;
+
+    // Entries from |tail_| up to |head_|, |used_| blocks of the ring, have yet
+    // to be checkpointed. |sequence_| is that of the next entry.
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+    uint32_t used_ = 0;
+    uint64_t sequence_ = 0;
+    // The error which stopped a checkpoint, after which nothing more is written.
+    zx_status_t status_ = ZX_OK;
+
+    // The metadata of the group being committed, in the writeback buffer.
+    fbl::Array<Update> group_{};
+    size_t group_count_ = 0;
+    WorkQueue group_works_{};
+    MappedVmo* group_buffer_ = nullptr;
+    // Updates gathered from every entry on checkpoint.
+    fbl::Array<Update> checkpoint_{};
+    WorkQueue checkpoint_works_{};
+
+    block_fifo_request_t writes_[MAX_TXN_MESSAGES];
+    size_t write_count_ = 0;
+    zx_status_t write_status_ = ZX_OK;
+};
+
 // WritebackBuffer which manages a writeback buffer (and background thread,
 // which flushes this buffer out to disk).
 class WritebackBuffer {
 public:
-    // Calls constructor, return an error if anything goes wrong.
+    // Calls constructor, return an error if anything goes wrong. Metadata is
+    // committed through the journal of the volume described by |info|, if it
+    // has one, and otherwise written in place.
     static zx_status_t Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffer,
+                              const minfs_info_t* info,
                               fbl::unique_ptr<WritebackBuffer>* out);
     ~WritebackBuffer();
 
@@ -206,6 +334,8 @@ private:
     bool unmounting_ __TA_GUARDED(writeback_lock_){false};
     fbl::unique_ptr<MappedVmo> buffer_{};
     vmoid_t buffer_vmoid_ = VMOID_INVALID;
+    // Used only by the writeback thread, if the volume has a journal.
+    fbl::unique_ptr<Journal> journal_{};
     // The units of all the following are "MinFS blocks".
     size_t start_ __TA_GUARDED(writeback_lock_){};
     size_t len_ __TA_GUARDED(writeback_lock_){};
@@ -0,0 +1,175 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/trace.h>
+
+#include <minfs/format.h>
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+// Returns the device block holding |offset| within the ring of the journal.
+blk_t JournalRingBlock(const minfs_info_t* info, uint32_t offset) {
+    const uint32_t ring = info->journal_blocks - 1;
+    return info->dat_block + info->journal_start + 1 + offset % ring;
+}
+
+// Returns true if replaying a copy to |target| cannot damage the filesystem: it must lie
+// within the volume, and not within the journal itself.
+bool JournalTargetValid(const minfs_info_t* info, blk_t target) {
+    const blk_t journal = info->dat_block + info->journal_start;
+    if (target >= info->dat_block + info->block_count) {
+        return false;
+    }
+    return target < journal || target >= journal + info->journal_blocks;
+}
+
+// Reads the entry at |offset| of the ring into |header|, returning ZX_OK only if it carries
+// |sequence| and was committed in full.
+zx_status_t JournalReadEntry(Bcache* bc, const minfs_info_t* info, uint32_t offset,
+                             uint64_t sequence, minfs_journal_header_t* header) {
+    zx_status_t status;
+    if ((status = bc->Readblk(JournalRingBlock(info, offset), header)) != ZX_OK) {
+        return status;
+    }
+    if (header->magic != kMinfsJournalHeaderMagic || header->sequence != sequence ||
+        header->count == 0 || header->count > kMinfsJournalEntryMax ||
+        header->count + 2 > info->journal_blocks - 1) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    uint8_t blk[kMinfsBlockSize];
+    uint32_t checksum = MinfsJournalChecksum(FNV32_OFFSET_BASIS, header, kMinfsBlockSize);
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (!JournalTargetValid(info, header->target[i])) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        if ((status = bc->Readblk(JournalRingBlock(info, offset + 1 + i), blk)) != ZX_OK) {
+            return status;
+        }
+        checksum = MinfsJournalChecksum(checksum, blk, kMinfsBlockSize);
+    }
+
+    if ((status = bc->Readblk(JournalRingBlock(info, offset + 1 + header->count), blk)) !=
+        ZX_OK) {
+        return status;
+    }
+    const minfs_journal_commit_t* commit = reinterpret_cast<minfs_journal_commit_t*>(blk);
+    if (commit->magic != kMinfsJournalCommitMagic || commit->sequence != sequence ||
+        commit->checksum != checksum) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+uint32_t minfs_journal_size(uint32_t block_count) {
+    const uint32_t blocks = fbl::min(block_count / 16, kMinfsJournalBlocks);
+    return blocks < kMinfsJournalMinBlocks ? 0 : blocks;
+}
+
+zx_status_t minfs_journal_format(Bcache* bc, const minfs_info_t* info) {
+    const blk_t start = info->dat_block + info->journal_start;
+    uint8_t blk[kMinfsBlockSize];
+    memset(blk, 0, sizeof(blk));
+
+    // Whatever the blocks held before cannot be mistaken for an entry once zeroed.
+    zx_status_t status;
+    for (blk_t n = 1; n < info->journal_blocks; n++) {
+        if ((status = bc->Writeblk(start + n, blk)) != ZX_OK) {
+            return status;
+        }
+    }
+
+    minfs_journal_info_t* journal = reinterpret_cast<minfs_journal_info_t*>(blk);
+    journal->magic = kMinfsJournalMagic;
+    journal->sequence = 1;
+    journal->start = 0;
+    return bc->Writeblk(start, blk);
+}
+
+zx_status_t minfs_journal_replay(Bcache* bc, minfs_info_t* info) {
+    if (info->magic0 != kMinfsMagic0 || info->magic1 != kMinfsMagic1 ||
+        info->version < kMinfsVersion || info->journal_blocks == 0) {
+        // Superblocks which are not valid are left for minfs_check_info to reject.
+        return ZX_OK;
+    }
+#ifndef __Fuchsia__
+    if (bc->extent_lengths_.size() > 0) {
+        // Sparse images are only written by host tools, which update metadata in place.
+        return ZX_OK;
+    }
+#endif
+    if (info->journal_blocks < kMinfsJournalMinBlocks || info->journal_start == 0 ||
+        info->journal_start + info->journal_blocks > info->block_count) {
+        FS_TRACE_ERROR("minfs: journal lies outside of the volume\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    const blk_t start = info->dat_block + info->journal_start;
+    uint8_t blk[kMinfsBlockSize];
+    zx_status_t status;
+    if ((status = bc->Readblk(start, blk)) != ZX_OK) {
+        return status;
+    }
+    minfs_journal_info_t journal;
+    memcpy(&journal, blk, sizeof(journal));
+    if (journal.magic != kMinfsJournalMagic || journal.start >= info->journal_blocks - 1) {
+        FS_TRACE_ERROR("minfs: bad journal info\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<minfs_journal_header_t> header(new (&ac) minfs_journal_header_t);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Entries are written in place in the order they were committed, so that where several
+    // update a block, the last wins.
+    uint32_t replayed = 0;
+    while ((status = JournalReadEntry(bc, info, journal.start, journal.sequence,
+                                      header.get())) == ZX_OK) {
+        for (uint32_t i = 0; i < header->count; i++) {
+            if ((status = bc->Readblk(JournalRingBlock(info, journal.start + 1 + i),
+                                      blk)) != ZX_OK ||
+                (status = bc->Writeblk(header->target[i], blk)) != ZX_OK) {
+                return status;
+            }
+        }
+        journal.start = (journal.start + header->count + 2) % (info->journal_blocks - 1);
+        journal.sequence++;
+        replayed++;
+    }
+    if (status != ZX_ERR_NOT_FOUND) {
+        return status;
+    }
+    if (replayed == 0) {
+        return ZX_OK;
+    }
+
+    FS_TRACE_WARN("minfs: replayed %u journal entries\n", replayed);
+    memset(blk, 0, sizeof(blk));
+    memcpy(blk, &journal, sizeof(journal));
+    if ((status = bc->Writeblk(start, blk)) != ZX_OK) {
+        return status;
+    }
+    bc->Sync();
+
+    // The superblock may have been among the blocks replayed.
+    if ((status = bc->Readblk(0, blk)) != ZX_OK) {
+        return status;
+    }
+    memcpy(info, blk, sizeof(*info));
+    return ZX_OK;
+}
+
+} // namespace minfs
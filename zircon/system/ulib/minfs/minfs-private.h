@@ -10,6 +10,7 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
+#include <bitmap/rle-bitmap.h>
 #include <fbl/auto_lock.h>
 #include <fs/remote.h>
 #include <fs/watcher.h>
@@ -23,9 +24,11 @@
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 
 #include <fs/block-txn.h>
 #include <fs/mapped-vmo.h>
+#include <fs/readahead.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
 #include <fs/vnode.h>
@@ -78,6 +81,34 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// Bounds on the number of blocks past the end of a sequential read which are
+// brought into the file's VMO along with it.
+constexpr uint32_t kMinfsReadaheadMin = 4;
+constexpr uint32_t kMinfsReadaheadMax = 128;
+
+// Bounds on the free run sought when a file mapped by extents starts a new extent.
+// The run wanted grows with the file, on the assumption that a file which has been
+// written to block n is likely to be written as far again.
+constexpr blk_t kMinfsExtentRunMin = 8;
+constexpr blk_t kMinfsExtentRunMax = 256;
+
+// Data written to a file mapped by extents stays in its VMO until this many of its blocks
+// are dirty, when they are allocated and written back together. It also bounds the blocks
+// written back by a single WritebackWork.
+constexpr blk_t kMinfsDirtyBlocksMax = 1024;
+
+// Requests a transaction may hold before writeback of dirty blocks sends it and starts
+// another, leaving room for those which allocating the next run adds.
+constexpr size_t kMinfsFlushRequestsMax = MAX_TXN_MESSAGES / 2;
+
+// Metadata committed to the journal is written in place once writeback has been idle
+// this long, or the journal is half full.
+constexpr long kMinfsCheckpointDelayMs = 100;
+
+// Leaves of a new directory index are filled this far, leaving room for the dirents
+// added after it is built.
+constexpr uint32_t kMinfsDirIndexBuildFill = kMinfsDirIndexEntriesPerLeaf * 3 / 4;
+
 // Used by fsck
 class MinfsChecker;
 class VnodeMinfs;
@@ -95,6 +126,10 @@ public:
 
     zx_status_t Unmount();
 
+    // Upgrades a filesystem formatted by an older version of minfs which this version can
+    // still mount, such as kMinfsVersionBlockMap, to kMinfsVersion.
+    zx_status_t UpgradeVersion();
+
     // instantiate a vnode from an inode
     // the inode must exist in the file system
     zx_status_t VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino);
@@ -110,6 +145,24 @@ public:
     // Allocate a new data block.
     zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno);
 
+    // Allocate a new data block for a file mapped by extents. |hint| is taken if it is
+    // free, so that an extent can be extended. Otherwise, the block which starts a free
+    // run of |run| blocks is preferred, so that the new extent has room to grow.
+    zx_status_t BlockNewRun(WriteTxn* txn, blk_t hint, blk_t run, blk_t* out_bno);
+
+    // Allocate up to |count| contiguous data blocks, taken from those set aside by
+    // BlockReserve. The run begins at |goal| if it is free, so that the extent which ends
+    // there may be extended. Returns the first block in |*out_bno| and the length of the
+    // run, which is shorter than |count| only if no free run is long enough, in |*out_count|.
+    zx_status_t BlockNewRange(WriteTxn* txn, blk_t goal, blk_t count, blk_t* out_bno,
+                              blk_t* out_count);
+
+    // Set aside |count| free data blocks, for data which will be allocated by a later
+    // BlockNewRange. Other allocations cannot take them.
+    zx_status_t BlockReserve(blk_t count);
+    void BlockUnreserve(blk_t count);
+    blk_t ReservedBlockCount() const { return reserved_blocks_; }
+
     // free block in block bitmap
     zx_status_t BlockFree(WriteTxn* txn, blk_t bno);
 
@@ -141,6 +194,9 @@ public:
     // (1) A sync probe has entered and exited the writeback queue, and
     // (2) The block cache has sync'd with the underlying block device.
     void Sync(SyncCallback closure);
+
+    // Writes back the dirty blocks of every file.
+    zx_status_t FlushDirtyVnodes();
 #endif
 
     // The following methods are used to read one block from the specified extent,
@@ -171,6 +227,13 @@ private:
     zx_status_t InoNew(WriteTxn* txn, const minfs_inode_t* inode,
                        ino_t* ino_out);
 
+    // Marks the |count| free blocks from bitmap offset |bitoff| allocated.
+    zx_status_t BlockClaim(WriteTxn* txn, size_t bitoff, blk_t count, blk_t* out_bno);
+
+    // Returns ZX_OK if |count| blocks may be allocated without taking any which are
+    // reserved, growing the partition if needed.
+    zx_status_t EnsureBlocksFree(blk_t count);
+
     // Enqueues an update for allocated inode/block counts
     zx_status_t CountUpdate(WriteTxn* txn);
 
@@ -182,6 +245,12 @@ private:
     // "construction".
     zx_status_t CreateFsId();
 
+#ifdef __Fuchsia__
+    // Creates the writeback buffer, which commits metadata through the journal if the
+    // volume has one.
+    zx_status_t CreateWriteback();
+#endif
+
 #ifndef __Fuchsia__
     zx_status_t ReadBlk(blk_t bno, blk_t start, blk_t soft_max, blk_t hard_max, void* data);
 #endif
@@ -191,6 +260,8 @@ private:
     uint32_t inoblks_{};
     RawBitmap inode_map_{};
     RawBitmap block_map_{};
+    // Free blocks set aside by BlockReserve.
+    blk_t reserved_blocks_{};
 
     // Vnodes exist in the hash table as long as one or more reference exists;
     // when the Vnode is deleted, it is immediately removed from the map.
@@ -257,6 +328,7 @@ public:
                                 fbl::RefPtr<VnodeMinfs>* out);
 
     bool IsDirectory() const { return inode_.magic == kMinfsMagicDir; }
+    bool UsesExtents() const { return (inode_.flags & kMinfsInodeFlagExtents) != 0; }
     bool IsUnlinked() const { return inode_.link_count == 0; }
     zx_status_t CanUnlink() const;
 
@@ -270,6 +342,15 @@ public:
     // fbl::Recyclable interface.
     void fbl_recycle() final;
 
+#ifdef __Fuchsia__
+    // Returns true if the file has data in its VMO which has not been written back.
+    bool HasDirtyBlocks() const { return vmo_dirty_.num_ranges() != 0; }
+
+    // Writes back the dirty blocks of the file, allocating each run of those which are not
+    // yet on disk at once.
+    zx_status_t FlushDirtyBlocks();
+#endif
+
     // TODO(rvargas): Make private.
     fbl::RefPtr<Minfs> fs_;
 
@@ -327,6 +408,55 @@ private:
     // Enumerates directories.
     zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
 
+    // Calls |func| on the dirent named |args->name|, which is found through the directory
+    // index if there is one, and by ForEachDirent otherwise.
+    zx_status_t FindDirent(DirArgs* args, const DirentCallback func);
+
+    // Adds the dirent described by |args| to the directory. An indexed directory has it
+    // placed in the last record if it fits there.
+    zx_status_t AppendDirent(DirArgs* args);
+
+    // Records a change to the dirents, made by a callback returning DIR_CB_SAVE_SYNC.
+    void SyncDirents(WritebackWork* wb);
+
+    // Directory index.
+    //
+    // Once a directory reaches kMinfsDirIndexMinSize, its dirents are indexed by name hash in
+    // the file inode_.dir_index, so that a name is found by reading a single leaf of the index
+    // rather than the whole directory. The index is updated along with the dirents; one which
+    // is out of date, or cannot be updated, is dropped and rebuilt as the directory next grows.
+
+    // Reads the root of the index, if it has not been read already. Returns ZX_ERR_NOT_FOUND
+    // if the directory has no index, and ZX_ERR_IO_DATA_INTEGRITY if the index does not match
+    // the directory.
+    zx_status_t DirIndexLoad();
+
+    // Indexes every dirent of the directory in a new index file.
+    zx_status_t DirIndexBuild(WritebackWork* wb);
+
+    // Frees the index file, if any, leaving the directory unindexed.
+    void DirIndexDrop(WriteTxn* txn);
+
+    // Returns the index, within the root, of the leaf which holds |hash|.
+    size_t DirIndexFindLeaf(uint32_t hash) const;
+
+    zx_status_t DirIndexReadLeaf(blk_t block, minfs_dir_index_leaf_t* leaf);
+    zx_status_t DirIndexWriteLeaf(WritebackWork* wb, blk_t block,
+                                  const minfs_dir_index_leaf_t* leaf);
+
+    // Adds or removes the dirent |name| at |off| in the index, if the directory has one.
+    // The index is dropped if it cannot be updated.
+    void DirIndexInsert(WritebackWork* wb, fbl::StringPiece name, size_t off);
+    void DirIndexRemove(WritebackWork* wb, fbl::StringPiece name, size_t off);
+    zx_status_t DirIndexInsertEntry(WritebackWork* wb, minfs_dir_index_entry_t entry);
+    zx_status_t DirIndexRemoveEntry(WritebackWork* wb, minfs_dir_index_entry_t entry);
+
+    // Records that the last record of the directory is at |off|.
+    void DirIndexSetTail(size_t off);
+
+    // Stamps the index with the directory's seq_num, and writes back its root.
+    void DirIndexSync(WritebackWork* wb);
+
     // Directory callback functions.
     //
     // The following functions are passable to |ForEachDirent|, which reads the parent directory,
@@ -414,10 +544,45 @@ private:
                                      uint32_t dib_vmo_offset, uint32_t ib_vmo_offset,
                                      blk_t* dibno, blk_t* bno, bool* dirty);
 
+    // Get the disk block 'bno' corresponding to the 'nth' block of a file mapped by extents.
+    // Allocate the block if requested with a non-null "txn", extending the extent before it
+    // where possible.
+    zx_status_t GetBnoExtent(WriteTxn* txn, blk_t n, blk_t* bno);
+
+    // Reads the extents of the file into |extents_|, if they have not been read already.
+    // Returns ZX_ERR_IO_DATA_INTEGRITY if the extents on disk are malformed.
+    zx_status_t LoadExtents();
+
+    // Writes back the extents of the file from the first one modified, allocating or freeing
+    // extent blocks as the number of extents changes, and syncs the inode.
+    zx_status_t SyncExtents(WriteTxn* txn);
+
+    // Writes the extent index or leaf block |data| to |bno|. On Fuchsia, it is staged at
+    // |offset| within vmo_indirect_.
+    zx_status_t WriteExtentBlock(WriteTxn* txn, uint32_t offset, blk_t bno, const void* data);
+
+    // Returns the index of the first extent which starts after the file block |n|.
+    size_t ExtentUpperBound(blk_t n) const;
+
+    void MarkExtentsDirty(size_t index) { extents_dirty_ = fbl::min(extents_dirty_, index); }
+
+    // Returns the length of the run of file blocks from |n|, stopping at |end|, which are
+    // either all mapped to consecutive disk blocks or all unmapped, and the disk block of |n|,
+    // or 0 if it is unmapped, in |*bno|.
+    blk_t ExtentRun(blk_t n, blk_t end, blk_t* bno) const;
+
+    // Maps the |count| file blocks from |n|, none of which are mapped, to the disk blocks
+    // from |bno|, extending or joining the extents on either side where they are contiguous.
+    // |i| is ExtentUpperBound(n).
+    zx_status_t ExtentInsert(size_t i, blk_t n, blk_t bno, blk_t count);
+
     // Deletes all blocks (relative to a file) from "start" (inclusive) to the end
     // of the file. Does not update mtime/atime.
     zx_status_t BlocksShrink(WriteTxn* txn, blk_t start);
 
+    // BlocksShrink for a file mapped by extents.
+    zx_status_t BlocksShrinkExtents(WriteTxn* txn, blk_t start);
+
     // Shrink |count| direct blocks from the |barray| array of direct blocks. Sets |*dirty| to
     // true if anything is deleted.
     zx_status_t BlocksShrinkDirect(WriteTxn *txn, size_t count, blk_t* barray, bool* dirty);
@@ -465,19 +630,39 @@ private:
     zx_status_t InitVmo();
     zx_status_t InitIndirectVmo();
 
-    // Loads indirect blocks up to and including the doubly indirect block at |index|.
-    zx_status_t LoadIndirectWithinDoublyIndirect(uint32_t index);
+    // Reads any blocks of the file in [|start|, |end|) which are not yet in the VMO.
+    // Blocks past the end of the file are ignored.
+    zx_status_t LoadVmoBlocks(blk_t start, blk_t end);
+
+    // Writes to a file mapped by extents. The data is written to the VMO alone and its
+    // blocks are marked dirty, with space reserved for those which are not yet on disk;
+    // FlushDirtyBlocks allocates and writes them later.
+    zx_status_t WriteDelayed(const void* data, size_t len, size_t off, size_t* actual);
 
-    // Initializes the indirect VMO, grows it to |size| bytes, and reads |count| indirect
-    // blocks from |iarray| into the indirect VMO, starting at block offset |offset|.
-    zx_status_t LoadIndirectBlocks(blk_t* iarray, uint32_t count, uint32_t offset,
-                                   uint64_t size);
+    blk_t DirtyBlockCount() const;
 
-    // Reads the block at |offset| in memory.
-    void ReadIndirectVmoBlock(uint32_t offset, uint32_t** entry);
+    // Returns the size to record in the inode on disk. While delayed writes extend the
+    // file, it only grows past |size_synced_| as far as their blocks have been allocated,
+    // so that the file never claims blocks it does not have on disk.
+    uint32_t DurableSize() const;
+
+    // Enqueues |count| blocks of the VMO from block |n|, which lie at |bno| on disk. The
+    // contents of a directory are metadata, and pass through the journal; those of a file
+    // are written in place.
+    void EnqueueVmoBlocks(WriteTxn* txn, blk_t n, blk_t bno, blk_t count);
+
+    // Forgets the dirty blocks of the file from |start| onward, releasing the space reserved
+    // for them.
+    zx_status_t DiscardDirtyBlocks(blk_t start);
+
+    // Initializes the indirect VMO, if needed, and grows it to hold the block at |offset|.
+    zx_status_t GrowIndirectVmo(uint32_t offset);
+
+    // Returns the block at |offset| in memory, reading it from |bno| on disk on first use.
+    zx_status_t ReadIndirectVmoBlock(uint32_t offset, blk_t bno, uint32_t** entry);
 
     // Clears the block at |offset| in memory.
-    void ClearIndirectVmoBlock(uint32_t offset);
+    zx_status_t ClearIndirectVmoBlock(uint32_t offset);
 
     // The following functionality interacts with handles directly, and are not applicable outside
     // Fuchsia (since there is no "handle-equivalent" in host-side tools).
@@ -503,17 +688,30 @@ private:
 
 #ifdef __Fuchsia__
     // TODO(smklein): When we have can register MinFS as a pager service, and
-    // it can properly handle pages faults on a vnode's contents, then we can
-    // avoid reading the entire file up-front. Until then, read the contents of
-    // a VMO into memory when it is read/written.
+    // it can properly handle pages faults on a vnode's contents, then the kernel
+    // can fill in vmo_ itself. Until then, blocks are read into it as they are
+    // read/written, and |vmo_loaded_| tracks which blocks hold the file's contents.
     zx::vmo vmo_{};
+    bitmap::RleBitmap vmo_loaded_{};
+    // Blocks of vmo_ which have been written since they were last written back, and the
+    // number of them which have no block on disk yet, for which space is reserved.
+    bitmap::RleBitmap vmo_dirty_{};
+    blk_t vmo_reserved_{};
+    // The size last written to the inode on disk.
+    uint32_t size_synced_{};
+    fs::ReadaheadState readahead_{kMinfsReadaheadMin, kMinfsReadaheadMax};
 
     // vmo_indirect_ contains all indirect and doubly indirect blocks in the following order:
     // First kMinfsIndirect blocks                                - initial set of indirect blocks
     // Next kMinfsDoublyIndirect blocks                           - doubly indirect blocks
     // Next kMinfsDoublyIndirect * kMinfsDirectPerIndirect blocks - indirect blocks pointed to
     //                                                              by doubly indirect blocks
+    //
+    // For a file mapped by extents, it instead holds the extent index block, followed by
+    // the extent leaf blocks in order.
     fbl::unique_ptr<MappedVmo> vmo_indirect_{};
+    // Blocks of vmo_indirect_ which have been read from disk or cleared.
+    bitmap::RleBitmap indirect_loaded_{};
 
     vmoid_t vmoid_{};
     vmoid_t vmoid_indirect_{};
@@ -525,6 +723,18 @@ private:
     ino_t ino_{};
     minfs_inode_t inode_{};
 
+    // For a file mapped by extents, every extent, sorted by file block, and the blocks of
+    // the leaves beyond the inode which hold them. Read by LoadExtents on first use.
+    fbl::Vector<minfs_extent_t> extents_{};
+    fbl::Vector<blk_t> extent_leaves_{};
+    bool extents_loaded_{};
+    // Index of the first extent which has changed since the last SyncExtents.
+    size_t extents_dirty_ = SIZE_MAX;
+
+    // For an indexed directory, the index file and its root, once read by DirIndexLoad.
+    fbl::RefPtr<VnodeMinfs> dir_index_{};
+    fbl::unique_ptr<minfs_dir_index_root_t> dir_index_root_{};
+
     // This field tracks the current number of file descriptors with
     // an open reference to this Vnode. Notably, this is distinct from the
     // VnodeMinfs's own refcount, since there may still be filesystem
@@ -544,6 +754,18 @@ constexpr size_t GetVmoSizeForIndirect(uint32_t dibindex) {
     return GetVmoOffsetForIndirect(dibindex + 1) * kMinfsBlockSize;
 }
 
+// Return the number of leaf blocks needed to hold |count| extents
+constexpr uint32_t GetExtentLeafCount(uint32_t count) {
+    return count <= kMinfsInlineExtents ? 0 :
+           (count - kMinfsInlineExtents + kMinfsExtentsPerLeaf - 1) / kMinfsExtentsPerLeaf;
+}
+
+// Return the block offset in vmo_indirect_ of the extent leaf |leaf|, which follows the
+// extent index block
+constexpr uint32_t GetVmoOffsetForExtentLeaf(uint32_t leaf) {
+    return 1 + leaf;
+}
+
 // Return the block offset of doubly indirect blocks in vmo_indirect_
 constexpr uint32_t GetVmoOffsetForDoublyIndirect(uint32_t dibindex) {
     ZX_DEBUG_ASSERT(dibindex < kMinfsDoublyIndirect);
@@ -561,6 +783,17 @@ void minfs_dump_info(const minfs_info_t* info);
 void minfs_dump_inode(const minfs_inode_t* inode, ino_t ino);
 void minfs_dir_init(void* bdata, ino_t ino_self, ino_t ino_parent);
 
+// Returns the number of blocks given to the metadata journal of a volume with
+// |block_count| data blocks, or 0 if the volume is too small to have one.
+uint32_t minfs_journal_size(uint32_t block_count);
+
+// Writes an empty metadata journal over the blocks which |info| gives it.
+zx_status_t minfs_journal_format(Bcache* bc, const minfs_info_t* info);
+
+// Writes every complete entry of the metadata journal of the volume described by |info|
+// to its home blocks, and reloads |info|, which may have been among them.
+zx_status_t minfs_journal_replay(Bcache* bc, minfs_info_t* info);
+
 // Given an input bcache, initialize the filesystem and return a reference to the
 // root node.
 zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* root_out);
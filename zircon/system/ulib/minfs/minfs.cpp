@@ -98,7 +98,7 @@ zx_status_t minfs_check_info(const minfs_info_t* info, Bcache* bc) {
         FS_TRACE_ERROR("minfs: bad magic\n");
         return ZX_ERR_INVALID_ARGS;
     }
-    if (info->version != kMinfsVersion) {
+    if (info->version < kMinfsVersionBlockMap || info->version > kMinfsVersion) {
         FS_TRACE_ERROR("minfs: FS Version: %08x. Driver version: %08x\n", info->version,
               kMinfsVersion);
         return ZX_ERR_INVALID_ARGS;
@@ -260,10 +260,42 @@ zx_status_t Minfs::InodeSync(WriteTxn* txn, ino_t ino, const minfs_inode_t* inod
 
 #ifdef __Fuchsia__
 void Minfs::Sync(SyncCallback closure) {
+    zx_status_t status;
+    if ((status = FlushDirtyVnodes()) != ZX_OK) {
+        closure(status);
+        return;
+    }
     fbl::unique_ptr<WritebackWork> wb(new WritebackWork(bc_.get()));
     wb->SetClosure(fbl::move(closure));
     EnqueueWork(fbl::move(wb));
 }
+
+zx_status_t Minfs::FlushDirtyVnodes() {
+    // Vnodes are written back outside the lock, since writeback may look up others.
+    fbl::Vector<ino_t> dirty;
+    {
+        fbl::AutoLock lock(&hash_lock_);
+        for (auto& vn : vnode_hash_) {
+            if (vn.HasDirtyBlocks()) {
+                fbl::AllocChecker ac;
+                dirty.push_back(vn.GetKey(), &ac);
+                if (!ac.check()) {
+                    return ZX_ERR_NO_MEMORY;
+                }
+            }
+        }
+    }
+
+    zx_status_t result = ZX_OK;
+    for (ino_t ino : dirty) {
+        fbl::RefPtr<VnodeMinfs> vn = VnodeLookup(ino);
+        zx_status_t status;
+        if (vn != nullptr && (status = vn->FlushDirtyBlocks()) != ZX_OK) {
+            result = status;
+        }
+    }
+    return result;
+}
 #endif
 
 Minfs::Minfs(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info) : bc_(fbl::move(bc)) {
@@ -315,6 +347,35 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
     txn->Enqueue(ibm_id, bitbno, info_.ibm_block + bitbno, 1);
     uint32_t block_count = vn->inode_.block_count;
 
+    if (vn->UsesExtents()) {
+        zx_status_t status;
+        if ((status = vn->LoadExtents()) != ZX_OK) {
+            return status;
+        }
+
+        // release the extents, then the blocks which held them
+        for (const minfs_extent_t& extent : vn->extents_) {
+            for (blk_t n = 0; n < extent.length; n++) {
+                block_count--;
+                BlockFree(txn, extent.start + n);
+            }
+        }
+        for (blk_t leaf : vn->extent_leaves_) {
+            block_count--;
+            BlockFree(txn, leaf);
+        }
+        const minfs_extent_map_t* map = MinfsExtentMap(&vn->inode_);
+        if (map->tree != 0) {
+            block_count--;
+            BlockFree(txn, map->tree);
+        }
+
+        CountUpdate(txn);
+        ZX_DEBUG_ASSERT(block_count == 0);
+        ZX_DEBUG_ASSERT(vn->IsUnlinked());
+        return ZX_OK;
+    }
+
     // release all direct blocks
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         if (vn->inode_.dnum[n] == 0) {
@@ -334,12 +395,10 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
 
 #ifdef __Fuchsia__
         zx_status_t status;
-        if ((status = vn->InitIndirectVmo()) != ZX_OK) {
+        uint32_t* entry;
+        if ((status = vn->ReadIndirectVmoBlock(n, vn->inode_.inum[n], &entry)) != ZX_OK) {
             return status;
         }
-
-        uint32_t* entry;
-        vn->ReadIndirectVmoBlock(n, &entry);
 #else
         uint32_t entry[kMinfsBlockSize];
         vn->ReadIndirectBlock(vn->inode_.inum[n], entry);
@@ -365,12 +424,11 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
         }
 #ifdef __Fuchsia__
         zx_status_t status;
-        if ((status = vn->InitIndirectVmo()) != ZX_OK) {
+        uint32_t* dentry;
+        if ((status = vn->ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(n),
+                                               vn->inode_.dinum[n], &dentry)) != ZX_OK) {
             return status;
         }
-
-        uint32_t* dentry;
-        vn->ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(n), &dentry);
 #else
         uint32_t dentry[kMinfsBlockSize];
         vn->ReadIndirectBlock(vn->inode_.dinum[n], dentry);
@@ -382,13 +440,11 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
             }
 
 #ifdef __Fuchsia__
-            if ((status = vn->LoadIndirectWithinDoublyIndirect(n)) != ZX_OK) {
+            uint32_t* entry;
+            if ((status = vn->ReadIndirectVmoBlock(GetVmoOffsetForIndirect(n) + m, dentry[m],
+                                                   &entry)) != ZX_OK) {
                 return status;
             }
-
-            uint32_t* entry;
-            vn->ReadIndirectVmoBlock(GetVmoOffsetForIndirect(n) + m, &entry);
-
 #else
             uint32_t entry[kMinfsBlockSize];
             vn->ReadIndirectBlock(dentry[m], entry);
@@ -744,7 +800,10 @@ zx_status_t Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
 zx_status_t Minfs::BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
     size_t bitoff_start;
     zx_status_t status;
-    if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != ZX_OK) {
+    if ((status = EnsureBlocksFree(1)) != ZX_OK) {
+        return status;
+    } else if ((status = block_map_.Find(false, hint, block_map_.size(), 1,
+                                         &bitoff_start)) != ZX_OK) {
         if ((status = block_map_.Find(false, 0, hint, 1, &bitoff_start)) != ZX_OK) {
             size_t old_size = block_map_.size();
             if ((status = AddBlocks()) != ZX_OK) {
@@ -756,22 +815,106 @@ zx_status_t Minfs::BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
         }
     }
 
-    status = block_map_.Set(bitoff_start, bitoff_start + 1);
+    return BlockClaim(txn, bitoff_start, 1, out_bno);
+}
+
+zx_status_t Minfs::BlockNewRun(WriteTxn* txn, blk_t hint, blk_t run, blk_t* out_bno) {
+    zx_status_t status;
+    if ((status = EnsureBlocksFree(1)) != ZX_OK) {
+        return status;
+    } else if (hint >= block_map_.size()) {
+        hint = 0;
+    } else if (hint != 0 && !block_map_.Get(hint, hint + 1)) {
+        return BlockClaim(txn, hint, 1, out_bno);
+    }
+
+    // Search from the hint first, so that the file's extents stay close together.
+    size_t bitoff_start;
+    if (block_map_.Find(false, hint, block_map_.size(), run, &bitoff_start) == ZX_OK ||
+        block_map_.Find(false, 0, hint, run, &bitoff_start) == ZX_OK) {
+        return BlockClaim(txn, bitoff_start, 1, out_bno);
+    }
+
+    // No run is free; settle for any block.
+    return BlockNew(txn, hint, out_bno);
+}
+
+zx_status_t Minfs::BlockNewRange(WriteTxn* txn, blk_t goal, blk_t count, blk_t* out_bno,
+                                 blk_t* out_count) {
+    ZX_DEBUG_ASSERT(count > 0);
+    ZX_DEBUG_ASSERT(count <= reserved_blocks_);
+    if (goal >= block_map_.size()) {
+        goal = 0;
+    }
+
+    // Continue from the goal if it is free. Otherwise take the first run long enough to
+    // hold every block, or failing that, the first free block and as many as follow it.
+    size_t bitoff_start;
+    if (goal == 0 || block_map_.Get(goal, goal + 1)) {
+        if (block_map_.Find(false, goal, block_map_.size(), count, &bitoff_start) != ZX_OK &&
+            block_map_.Find(false, 0, goal, count, &bitoff_start) != ZX_OK &&
+            block_map_.Find(false, goal, block_map_.size(), 1, &bitoff_start) != ZX_OK &&
+            block_map_.Find(false, 0, goal, 1, &bitoff_start) != ZX_OK) {
+            // The reservation should have made this impossible.
+            return ZX_ERR_NO_SPACE;
+        }
+    } else {
+        bitoff_start = goal;
+    }
+    const size_t bitoff_end = fbl::min(bitoff_start + count, block_map_.size());
+    *out_count = static_cast<blk_t>(block_map_.Scan(bitoff_start, bitoff_end, false) -
+                                    bitoff_start);
+    reserved_blocks_ -= *out_count;
+    return BlockClaim(txn, bitoff_start, *out_count, out_bno);
+}
+
+zx_status_t Minfs::BlockReserve(blk_t count) {
+    zx_status_t status;
+    if ((status = EnsureBlocksFree(count)) != ZX_OK) {
+        return status;
+    }
+    reserved_blocks_ += count;
+    return ZX_OK;
+}
+
+void Minfs::BlockUnreserve(blk_t count) {
+    ZX_DEBUG_ASSERT(count <= reserved_blocks_);
+    reserved_blocks_ -= count;
+}
+
+zx_status_t Minfs::EnsureBlocksFree(blk_t count) {
+    while (info_.alloc_block_count + reserved_blocks_ + count > info_.block_count) {
+        zx_status_t status;
+        if ((status = AddBlocks()) != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Minfs::BlockClaim(WriteTxn* txn, size_t bitoff_start, blk_t count,
+                              blk_t* out_bno) {
+    zx_status_t status = block_map_.Set(bitoff_start, bitoff_start + count);
     assert(status == ZX_OK);
-    info_.alloc_block_count++;
+    info_.alloc_block_count += count;
     blk_t bno = static_cast<blk_t>(bitoff_start);
     ValidateBno(bno);
+    ValidateBno(bno + count - 1);
 
-    // obtain the in-memory bitmap block
+    // obtain the in-memory bitmap blocks
     blk_t bmbno_rel = bno / kMinfsBlockBits;       // bmbno relative to bitmap
     blk_t bmbno_abs = info_.abm_block + bmbno_rel; // bmbno relative to block device
+    blk_t bmblocks = (bno + count - 1) / kMinfsBlockBits - bmbno_rel + 1;
 
 // commit the bitmap
 #ifdef __Fuchsia__
-    txn->Enqueue(block_map_.StorageUnsafe()->GetVmo(), bmbno_rel, bmbno_abs, 1);
+    txn->Enqueue(block_map_.StorageUnsafe()->GetVmo(), bmbno_rel, bmbno_abs, bmblocks);
 #else
-    void* bmdata = fs::GetBlock<kMinfsBlockSize>(block_map_.StorageUnsafe()->GetData(), bmbno_rel);
-    bc_->Writeblk(bmbno_abs, bmdata);
+    for (blk_t i = 0; i < bmblocks; i++) {
+        void* bmdata = fs::GetBlock<kMinfsBlockSize>(block_map_.StorageUnsafe()->GetData(),
+                                                     bmbno_rel + i);
+        bc_->Writeblk(bmbno_abs + i, bmdata);
+    }
 #endif
     *out_bno = bno;
 
@@ -906,18 +1049,7 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info,
         return status;
     }
 
-    fbl::unique_ptr<MappedVmo> buffer;
-    // TODO(smklein): Create max buffer size relative to total RAM size.
-    constexpr size_t kWriteBufferSize = 64 * (1LU << 20);
-    static_assert(kWriteBufferSize % kMinfsBlockSize == 0,
-                  "Buffer Size must be a multiple of the MinFS Block Size");
-    if ((status = MappedVmo::Create(kWriteBufferSize, "minfs-writeback",
-                                    &buffer)) != ZX_OK) {
-        return status;
-    }
-
-    if ((status = WritebackBuffer::Create(fs->bc_.get(), fbl::move(buffer),
-                                          &fs->writeback_)) != ZX_OK) {
+    if ((status = fs->CreateWriteback()) != ZX_OK) {
         return status;
     }
 
@@ -946,6 +1078,70 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info,
     return ZX_OK;
 }
 
+#ifdef __Fuchsia__
+zx_status_t Minfs::CreateWriteback() {
+    fbl::unique_ptr<MappedVmo> buffer;
+    // TODO(smklein): Create max buffer size relative to total RAM size.
+    constexpr size_t kWriteBufferSize = 64 * (1LU << 20);
+    static_assert(kWriteBufferSize % kMinfsBlockSize == 0,
+                  "Buffer Size must be a multiple of the MinFS Block Size");
+    zx_status_t status;
+    if ((status = MappedVmo::Create(kWriteBufferSize, "minfs-writeback",
+                                    &buffer)) != ZX_OK) {
+        return status;
+    }
+
+    return WritebackBuffer::Create(bc_.get(), fbl::move(buffer), &info_, &writeback_);
+}
+#endif
+
+zx_status_t Minfs::UpgradeVersion() {
+    if (info_.version == kMinfsVersion) {
+        return ZX_OK;
+    }
+
+    // Inodes already on disk keep their block maps, and directories are left unindexed
+    // until they next grow; both are still understood. New inodes are mapped by extents,
+    // and large directories indexed, which older versions do not understand, so the
+    // upgrade is recorded before anything else is written.
+    FS_TRACE_WARN("minfs: upgrading FS version %08x to %08x\n", info_.version, kMinfsVersion);
+    info_.version = kMinfsVersion;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(bc_.get()));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Older versions have no journal. One is made from the first free run long enough to
+    // hold it; a volume without one carries on writing metadata in place.
+    zx_status_t status;
+    const uint32_t journal_blocks = minfs_journal_size(info_.block_count);
+    const bool add_journal = info_.journal_blocks == 0 && journal_blocks > 0;
+    size_t bitoff_start;
+    if (add_journal && block_map_.Find(false, 1, block_map_.size(), journal_blocks,
+                                       &bitoff_start) == ZX_OK) {
+        info_.journal_start = static_cast<blk_t>(bitoff_start);
+        info_.journal_blocks = journal_blocks;
+        if ((status = minfs_journal_format(bc_.get(), &info_)) != ZX_OK) {
+            return status;
+        }
+        blk_t bno;
+        BlockClaim(wb->txn(), bitoff_start, journal_blocks, &bno);
+    }
+    status = CountUpdate(wb->txn());
+    EnqueueWork(fbl::move(wb));
+
+#ifdef __Fuchsia__
+    if (status == ZX_OK && add_journal && info_.journal_blocks > 0) {
+        // The upgrade is written in place; metadata which follows passes through the journal.
+        writeback_ = nullptr;
+        status = CreateWriteback();
+    }
+#endif
+    return status;
+}
+
 zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* root_out) {
     TRACE_DURATION("minfs", "minfs_mount");
     zx_status_t status;
@@ -955,7 +1151,11 @@ zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinf
         FS_TRACE_ERROR("minfs: could not read info block\n");
         return status;
     }
-    const minfs_info_t* info = reinterpret_cast<minfs_info_t*>(blk);
+    minfs_info_t* info = reinterpret_cast<minfs_info_t*>(blk);
+    if ((status = minfs_journal_replay(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not replay journal\n");
+        return status;
+    }
 
     fbl::RefPtr<Minfs> fs;
     if ((status = Minfs::Create(fbl::move(bc), info, &fs)) != ZX_OK) {
@@ -963,6 +1163,11 @@ zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinf
         return status;
     }
 
+    if ((status = fs->UpgradeVersion()) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not upgrade filesystem\n");
+        return status;
+    }
+
     fbl::RefPtr<VnodeMinfs> vn;
     if ((status = fs->VnodeGet(&vn, kMinfsRootIno)) != ZX_OK) {
         FS_TRACE_ERROR("minfs: cannot find root inode\n");
@@ -990,6 +1195,13 @@ zx_status_t MountAndServe(fs::Vfs *vfs, fbl::unique_ptr<Bcache> bc, zx::channel
 
 zx_status_t Minfs::Unmount() {
 #ifdef __Fuchsia__
+    // Dirty blocks are only held in memory, so the filesystem stays mounted rather than
+    // lose them.
+    zx_status_t status;
+    if ((status = FlushDirtyVnodes()) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: Failed to write back on unmount: %d\n", status);
+        return status;
+    }
     // Ensure writeback buffer completes before auxilliary structures
     // are deleted.
     writeback_ = nullptr;
@@ -1158,6 +1370,19 @@ zx_status_t Mkfs(fbl::unique_ptr<Bcache> bc) {
     abm.Set(0, 2);
     info.alloc_block_count++;
 
+    // Reserve the blocks which follow for the metadata journal
+    info.journal_blocks = minfs_journal_size(info.block_count);
+    if (info.journal_blocks > 0) {
+        info.journal_start = 2;
+        abm.Set(info.journal_start, info.journal_start + info.journal_blocks);
+        info.alloc_block_count += info.journal_blocks;
+        if ((status = minfs_journal_format(bc.get(), &info)) != ZX_OK) {
+            FS_TRACE_ERROR("mkfs: Failed to write journal\n");
+            minfs_free_slices(bc.get(), &info);
+            return status;
+        }
+    }
+
     // write allocation bitmap
     for (uint32_t n = 0; n < abmblks; n++) {
         void* bmdata = fs::GetBlock<kMinfsBlockSize>(abm.StorageUnsafe()->GetData(), n);
@@ -1185,7 +1410,12 @@ zx_status_t Mkfs(fbl::unique_ptr<Bcache> bc) {
     ino[kMinfsRootIno].block_count = 1;
     ino[kMinfsRootIno].link_count = 2;
     ino[kMinfsRootIno].dirent_count = 2;
-    ino[kMinfsRootIno].dnum[0] = 1;
+    ino[kMinfsRootIno].flags = kMinfsInodeFlagExtents;
+    minfs_extent_map_t* map = MinfsExtentMap(&ino[kMinfsRootIno]);
+    map->count = 1;
+    map->extents[0].file_block = 0;
+    map->extents[0].start = 1;
+    map->extents[0].length = 1;
     bc->Writeblk(info.ino_block, blk);
 
     memset(blk, 0, sizeof(blk));
@@ -14,6 +14,7 @@ COMMON_SRCS := \
     $(LOCAL_DIR)/vnode.cpp \
     $(LOCAL_DIR)/writeback.cpp \
     $(LOCAL_DIR)/fsck.cpp \
+    $(LOCAL_DIR)/journal.cpp \
 
 # minfs implementation
 MODULE_SRCS := \
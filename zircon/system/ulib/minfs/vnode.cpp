@@ -85,6 +85,16 @@ void VnodeMinfs::InodeSync(WriteTxn* txn, uint32_t flags) {
         }
     }
 
+#ifdef __Fuchsia__
+    if (HasDirtyBlocks()) {
+        minfs_inode_t inode = inode_;
+        inode.size = DurableSize();
+        size_synced_ = inode.size;
+        fs_->InodeSync(txn, ino_, &inode);
+        return;
+    }
+    size_synced_ = inode_.size;
+#endif
     fs_->InodeSync(txn, ino_, &inode_);
 }
 
@@ -115,16 +125,18 @@ zx_status_t VnodeMinfs::BlocksShrinkIndirect(WriteTxn* txn, uint32_t bindex, siz
         }
         fs_->ValidateBno(iarray[i]);
 
+        zx_status_t status;
 #ifdef __Fuchsia__
         uint32_t* entry;
-        ReadIndirectVmoBlock(ib_vmo_offset + i, &entry);
+        if ((status = ReadIndirectVmoBlock(ib_vmo_offset + i, iarray[i], &entry)) != ZX_OK) {
+            return status;
+        }
 #else
         uint32_t entry[kMinfsBlockSize];
         ReadIndirectBlock(iarray[i], entry);
 #endif
 
         // release the blocks pointed at by the entries in the indirect block
-        zx_status_t status;
         uint32_t direct_start = i == 0 ? bindex : 0;
         if ((status = BlocksShrinkDirect(txn, kMinfsDirectPerIndirect - direct_start,
                                          &entry[direct_start], dirty)) != ZX_OK) {
@@ -166,9 +178,13 @@ zx_status_t VnodeMinfs::BlocksShrinkDoublyIndirect(WriteTxn *txn, uint32_t ibind
 
         fs_->ValidateBno(diarray[i]);
 
+        zx_status_t status;
 #ifdef __Fuchsia__
         uint32_t* dientry;
-        ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
+        if ((status = ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), diarray[i],
+                                           &dientry)) != ZX_OK) {
+            return status;
+        }
 #else
         uint32_t dientry[kMinfsBlockSize];
         ReadIndirectBlock(diarray[i], dientry);
@@ -177,7 +193,6 @@ zx_status_t VnodeMinfs::BlocksShrinkDoublyIndirect(WriteTxn *txn, uint32_t ibind
         // release the blocks pointed at by the entries in the indirect block
         uint32_t indirect_start = i == 0 ? ibindex : 0;
         uint32_t direct_start = (i == 0 && indirect_start == ibindex) ? bindex : 0;
-        zx_status_t status;
         if ((status = BlocksShrinkIndirect(txn, direct_start,
                                            kMinfsDirectPerIndirect - indirect_start,
                                            ib_vmo_offset + i + indirect_start,
@@ -212,6 +227,10 @@ zx_status_t VnodeMinfs::BlocksShrinkDoublyIndirect(WriteTxn *txn, uint32_t ibind
 // Delete all blocks (relative to a file) from "start" (inclusive) to the end of
 // the file. Does not update mtime/atime.
 zx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, blk_t start) {
+    if (UsesExtents()) {
+        return BlocksShrinkExtents(txn, start);
+    }
+
     bool dirty = false;
     zx_status_t status = ZX_OK;
     size_t size = (kMinfsIndirect + kMinfsDoublyIndirect) * kMinfsBlockSize;
@@ -265,9 +284,15 @@ zx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, blk_t start) {
 
 #ifdef __Fuchsia__
     if (vmo_indirect_ != nullptr && vmo_indirect_->GetSize() > size) {
+        const size_t old_size = vmo_indirect_->GetSize();
         if ((status = vmo_indirect_->Shrink(size)) != ZX_OK) {
             return status;
         }
+        // Blocks dropped by the shrink must be read in again if the VMO regrows.
+        if ((status = indirect_loaded_.Clear(size / kMinfsBlockSize,
+                                             old_size / kMinfsBlockSize)) != ZX_OK) {
+            return status;
+        }
     }
 #endif
 
@@ -279,55 +304,14 @@ zx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, blk_t start) {
 }
 
 #ifdef __Fuchsia__
-zx_status_t VnodeMinfs::LoadIndirectBlocks(blk_t* iarray, uint32_t count, uint32_t offset,
-                                           uint64_t size) {
-    zx_status_t status;
-    if ((status = InitIndirectVmo()) != ZX_OK) {
-        return status;
-    }
-
-    if (vmo_indirect_->GetSize() < size) {
-        zx_status_t status;
-        if ((status = vmo_indirect_->Grow(size)) != ZX_OK) {
-            return status;
-        }
-    }
-
-    ReadTxn txn(fs_->bc_.get());
-
-    for (uint32_t i = 0; i < count; i++) {
-        blk_t ibno;
-        if ((ibno = iarray[i]) != 0) {
-            fs_->ValidateBno(ibno);
-            txn.Enqueue(vmoid_indirect_, offset + i, ibno + fs_->info_.dat_block, 1);
-        }
-    }
-
-    return txn.Flush();
-}
-
-zx_status_t VnodeMinfs::LoadIndirectWithinDoublyIndirect(uint32_t dindex) {
-    uint32_t* dientry;
-
-    size_t size = GetVmoSizeForIndirect(dindex);
-    if (vmo_indirect_->GetSize() >= size) {
-        // We've already loaded this indirect (within dind) block.
-        return ZX_OK;
-    }
-
-    ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(dindex), &dientry);
-    return LoadIndirectBlocks(dientry, kMinfsDirectPerIndirect,
-                              GetVmoOffsetForIndirect(dindex), size);
-}
-
 zx_status_t VnodeMinfs::InitIndirectVmo() {
     if (vmo_indirect_ != nullptr) {
         return ZX_OK;
     }
 
     zx_status_t status;
-    if ((status = MappedVmo::Create(kMinfsBlockSize * (kMinfsIndirect + kMinfsDoublyIndirect),
-                                    "minfs-indirect", &vmo_indirect_)) != ZX_OK) {
+    if ((status = MappedVmo::Create(GetVmoSizeForDoublyIndirect(), "minfs-indirect",
+                                    &vmo_indirect_)) != ZX_OK) {
         return status;
     }
     if ((status = fs_->bc_->AttachVmo(vmo_indirect_->GetVmo(), &vmoid_indirect_)) != ZX_OK) {
@@ -335,30 +319,36 @@ zx_status_t VnodeMinfs::InitIndirectVmo() {
         return status;
     }
 
-    // Load initial set of indirect blocks
-    if ((status = LoadIndirectBlocks(inode_.inum, kMinfsIndirect, 0, 0)) != ZX_OK) {
-        vmo_indirect_ = nullptr;
-        return status;
-    }
+    // Indirect blocks are read in by ReadIndirectVmoBlock as they are used.
+    indirect_loaded_.ClearAll();
+    return ZX_OK;
+}
 
-    // Load doubly indirect blocks
-    if ((status = LoadIndirectBlocks(inode_.dinum, kMinfsDoublyIndirect,
-                                     GetVmoOffsetForDoublyIndirect(0),
-                                     GetVmoSizeForDoublyIndirect()) != ZX_OK)) {
-        vmo_indirect_ = nullptr;
+zx_status_t VnodeMinfs::GrowIndirectVmo(uint32_t offset) {
+    zx_status_t status;
+    if ((status = InitIndirectVmo()) != ZX_OK) {
         return status;
     }
 
+    // A doubly indirect block is grown along with the set of indirect blocks it points to,
+    // so that pointers into it stay valid (the mapping may move) while they are read.
+    size_t size = GetVmoSizeForDoublyIndirect();
+    if (offset >= GetVmoOffsetForIndirect(0)) {
+        size = GetVmoSizeForIndirect((offset - GetVmoOffsetForIndirect(0)) /
+                                     kMinfsDirectPerIndirect);
+    } else if (offset >= GetVmoOffsetForDoublyIndirect(0)) {
+        size = GetVmoSizeForIndirect(offset - GetVmoOffsetForDoublyIndirect(0));
+    }
+    if (vmo_indirect_->GetSize() < size) {
+        if ((status = vmo_indirect_->Grow(size)) != ZX_OK) {
+            return status;
+        }
+    }
     return ZX_OK;
 }
 
-// Since we cannot yet register the filesystem as a paging service (and cleanly
-// fault on pages when they are actually needed), we currently read an entire
-// file to a VMO when a file's data block are accessed.
-//
-// TODO(smklein): Even this hack can be optimized; a bitmap could be used to
-// track all 'empty/read/dirty' blocks for each vnode, rather than reading
-// the entire file.
+// The VMO is sized to the whole file, but no data is read until it is
+// accessed; LoadVmoBlocks reads in the blocks of each range as it is used.
 zx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return ZX_OK;
@@ -377,89 +367,189 @@ zx_status_t VnodeMinfs::InitVmo() {
         vmo_.reset();
         return status;
     }
-    ReadTxn txn(fs_->bc_.get());
+    vmo_loaded_.ClearAll();
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::LoadVmoBlocks(blk_t start, blk_t end) {
+    // Nothing past the end of the file is on disk.
+    const blk_t file_blocks = static_cast<blk_t>(fbl::round_up(inode_.size, kMinfsBlockSize) /
+                                                 kMinfsBlockSize);
+    end = fbl::min(end, file_blocks);
+    if (start >= end) {
+        return ZX_OK;
+    }
+
+    size_t first_unloaded;
+    if (vmo_loaded_.Get(start, end, &first_unloaded)) {
+        return ZX_OK;
+    }
+    start = static_cast<blk_t>(first_unloaded);
 
-    // Initialize all direct blocks
-    blk_t bno;
-    for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
+    // Sparse blocks are already zero in the VMO, so only allocated blocks are read.
+    // Adjacent blocks are merged into a single request by the transaction.
+    zx_status_t status;
+    ReadTxn txn(fs_->bc_.get());
+    for (blk_t n = start; n < end; n++) {
+        if (vmo_loaded_.Get(n, n + 1)) {
+            continue;
+        }
+        blk_t bno;
+        if ((status = GetBno(nullptr, n, &bno)) != ZX_OK) {
+            return status;
+        }
+        if (bno != 0) {
             fs_->ValidateBno(bno);
-            txn.Enqueue(vmoid_, d, bno + fs_->info_.dat_block, 1);
+            txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
         }
     }
 
-    // Initialize all indirect blocks
-    for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        blk_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
-
-            // Only initialize the indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+    return vmo_loaded_.Set(start, end);
+}
+
+uint32_t VnodeMinfs::DurableSize() const {
+    // The size may only pass the end of the file on disk by as far as the blocks which
+    // have been allocated.
+    for (const auto& range : vmo_dirty_) {
+        const blk_t end = static_cast<blk_t>(range.bitoff + range.bitlen);
+        blk_t n = static_cast<blk_t>(range.bitoff);
+        while (n < end) {
+            blk_t bno;
+            const blk_t run = ExtentRun(n, end, &bno);
+            if (bno == 0 && static_cast<uint64_t>(n + run) * kMinfsBlockSize > size_synced_) {
+                const uint64_t size = fbl::max<uint64_t>(static_cast<uint64_t>(n) *
+                                                         kMinfsBlockSize, size_synced_);
+                return static_cast<uint32_t>(fbl::min<uint64_t>(inode_.size, size));
             }
+            n += run;
+        }
+    }
+    return inode_.size;
+}
 
-            uint32_t* ientry;
-            ReadIndirectVmoBlock(i, &ientry);
+blk_t VnodeMinfs::DirtyBlockCount() const {
+    size_t count = 0;
+    for (const auto& range : vmo_dirty_) {
+        count += range.bitlen;
+    }
+    return static_cast<blk_t>(count);
+}
 
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * kMinfsDirectPerIndirect + j;
-                    txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                }
-            }
-        }
+void VnodeMinfs::EnqueueVmoBlocks(WriteTxn* txn, blk_t n, blk_t bno, blk_t count) {
+    if (IsDirectory()) {
+        txn->Enqueue(vmo_.get(), n, bno + fs_->info_.dat_block, count);
+    } else {
+        txn->EnqueueData(vmo_.get(), n, bno + fs_->info_.dat_block, count);
     }
+}
 
-    // Initialize all doubly indirect blocks
-    for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
-        blk_t dibno;
+zx_status_t VnodeMinfs::FlushDirtyBlocks() {
+    if (!HasDirtyBlocks()) {
+        return ZX_OK;
+    }
+    TRACE_DURATION("minfs", "VnodeMinfs::FlushDirtyBlocks", "ino", ino_,
+                   "blocks", DirtyBlockCount());
 
-        if ((dibno = inode_.dinum[i]) != 0) {
-            fs_->ValidateBno(dibno);
+    zx_status_t status;
+    if ((status = LoadExtents()) != ZX_OK) {
+        return status;
+    }
 
-            // Only initialize the doubly indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
-                vmo_.reset();
-                return status;
+    fbl::unique_ptr<WritebackWork> wb;
+    while (HasDirtyBlocks()) {
+        if (wb == nullptr) {
+            fbl::AllocChecker ac;
+            wb.reset(new (&ac) WritebackWork(fs_->bc_.get()));
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
             }
+        }
 
-            uint32_t* dientry;
-            ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                blk_t ibno;
-                if ((ibno = dientry[j]) != 0) {
-                    fs_->ValidateBno(ibno);
-
-                    // Only initialize the indirect vmo if it is being used.
-                    if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
-                        vmo_.reset();
-                        return status;
-                    }
-
-                    uint32_t* ientry;
-                    ReadIndirectVmoBlock(GetVmoOffsetForIndirect(i) + j, &ientry);
-
-                    for (uint32_t k = 0; k < kMinfsDirectPerIndirect; k++) {
-                        if ((bno = ientry[k]) != 0) {
-                            fs_->ValidateBno(bno);
-                            uint32_t n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect
-                                         + j * kMinfsDirectPerIndirect + k;
-                            txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                        }
-                    }
+        // Take the first run of dirty blocks which are either all on disk, or all new.
+        const auto& range = *vmo_dirty_.begin();
+        const blk_t n = static_cast<blk_t>(range.bitoff);
+        const blk_t len = static_cast<blk_t>(fbl::min<size_t>(range.bitlen, kMinfsDirtyBlocksMax));
+        blk_t bno;
+        blk_t count = ExtentRun(n, n + len, &bno);
+        if (bno == 0) {
+            // New blocks are allocated together, following the extent before them on disk
+            // where they can.
+            const size_t i = ExtentUpperBound(n);
+            const blk_t goal = (i > 0) ? extents_[i - 1].start + extents_[i - 1].length : 0;
+            if ((status = fs_->BlockNewRange(wb->txn(), goal, count, &bno, &count)) != ZX_OK) {
+                break;
+            }
+            if ((status = ExtentInsert(i, n, bno, count)) != ZX_OK) {
+                for (blk_t b = 0; b < count; b++) {
+                    fs_->BlockFree(wb->txn(), bno + b);
                 }
+                fs_->BlockReserve(count);
+                break;
+            }
+            vmo_reserved_ -= count;
+            inode_.block_count += count;
+            if ((status = SyncExtents(wb->txn())) != ZX_OK) {
+                break;
             }
         }
+        EnqueueVmoBlocks(wb->txn(), n, bno, count);
+        if ((status = vmo_dirty_.Clear(n, n + count)) != ZX_OK) {
+            break;
+        }
+
+        // Allocation adds requests for the bitmap, superblock, extents and inode, so a
+        // transaction is sent before it can fill.
+        if (wb->txn()->Count() >= kMinfsFlushRequestsMax ||
+            wb->txn()->BlkCount() >= kMinfsDirtyBlocksMax) {
+            InodeSync(wb->txn(), kMxFsSyncDefault);
+            wb->PinVnode(fbl::WrapRefPtr(this));
+            fs_->EnqueueWork(fbl::move(wb));
+        }
     }
 
-    status = txn.Flush();
-    ValidateVmoTail();
+    if (wb != nullptr) {
+        InodeSync(wb->txn(), kMxFsSyncDefault);
+        wb->PinVnode(fbl::WrapRefPtr(this));
+        fs_->EnqueueWork(fbl::move(wb));
+    }
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("minfs: Failed to write back ino %u: %d\n", ino_, status);
+    }
     return status;
 }
+
+zx_status_t VnodeMinfs::DiscardDirtyBlocks(blk_t start) {
+    if (!HasDirtyBlocks()) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if ((status = LoadExtents()) != ZX_OK) {
+        return status;
+    }
+    blk_t unreserve = 0;
+    for (const auto& range : vmo_dirty_) {
+        const blk_t end = static_cast<blk_t>(range.bitoff + range.bitlen);
+        blk_t n = fbl::max(start, static_cast<blk_t>(range.bitoff));
+        while (n < end) {
+            blk_t bno;
+            const blk_t run = ExtentRun(n, end, &bno);
+            if (bno == 0) {
+                unreserve += run;
+            }
+            n += run;
+        }
+    }
+    if ((status = vmo_dirty_.Clear(start, kMinfsMaxFileBlock)) != ZX_OK) {
+        return status;
+    }
+    vmo_reserved_ -= unreserve;
+    fs_->BlockUnreserve(unreserve);
+    return ZX_OK;
+}
 #endif
 
 zx_status_t VnodeMinfs::GetBnoDirect(WriteTxn* txn, blk_t* bno, bool* dirty) {
@@ -486,15 +576,8 @@ zx_status_t VnodeMinfs::GetBnoDirect(WriteTxn* txn, blk_t* bno, bool* dirty) {
 
 zx_status_t VnodeMinfs::GetBnoIndirect(WriteTxn* txn, uint32_t bindex, uint32_t ib_vmo_offset,
                                        blk_t* ibno, blk_t* bno, bool* dirty) {
-    // we should have initialized vmo before calling this method
     zx_status_t status;
 
-#ifdef __Fuchsia__
-    if ((status = VnodeMinfs::InitIndirectVmo()) != ZX_OK) {
-        return status;
-    }
-#endif
-
     // retrieve indirect block at this index
     if (*ibno == 0) {
         if (txn == nullptr) {
@@ -507,7 +590,9 @@ zx_status_t VnodeMinfs::GetBnoIndirect(WriteTxn* txn, uint32_t bindex, uint32_t
         }
 
 #ifdef __Fuchsia__
-        ClearIndirectVmoBlock(ib_vmo_offset);
+        if ((status = ClearIndirectVmoBlock(ib_vmo_offset)) != ZX_OK) {
+            return status;
+        }
 #else
         ClearIndirectBlock(*ibno);
 #endif
@@ -518,7 +603,9 @@ zx_status_t VnodeMinfs::GetBnoIndirect(WriteTxn* txn, uint32_t bindex, uint32_t
 
 #ifdef __Fuchsia__
     uint32_t* ientry;
-    ReadIndirectVmoBlock(ib_vmo_offset, &ientry);
+    if ((status = ReadIndirectVmoBlock(ib_vmo_offset, *ibno, &ientry)) != ZX_OK) {
+        return status;
+    }
 #else
     uint32_t ientry[kMinfsBlockSize];
     ReadIndirectBlock(*ibno, ientry);
@@ -562,7 +649,9 @@ zx_status_t VnodeMinfs::GetBnoDoublyIndirect(WriteTxn* txn, uint32_t ibindex, ui
         }
 
 #ifdef __Fuchsia__
-        ClearIndirectVmoBlock(dib_vmo_offset);
+        if ((status = ClearIndirectVmoBlock(dib_vmo_offset)) != ZX_OK) {
+            return status;
+        }
 #else
         ClearIndirectBlock(*dibno);
 #endif
@@ -575,7 +664,9 @@ zx_status_t VnodeMinfs::GetBnoDoublyIndirect(WriteTxn* txn, uint32_t ibindex, ui
     // read from doubly indirect block
 #ifdef __Fuchsia__
     uint32_t* dientry;
-    ReadIndirectVmoBlock(dib_vmo_offset, &dientry);
+    if ((status = ReadIndirectVmoBlock(dib_vmo_offset, *dibno, &dientry)) != ZX_OK) {
+        return status;
+    }
 #else
     uint32_t dientry[kMinfsBlockSize];
     ReadIndirectBlock(*dibno, dientry);
@@ -602,18 +693,40 @@ zx_status_t VnodeMinfs::GetBnoDoublyIndirect(WriteTxn* txn, uint32_t ibindex, ui
 }
 
 #ifdef __Fuchsia__
-void VnodeMinfs::ReadIndirectVmoBlock(uint32_t offset, uint32_t** entry) {
-    ZX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
+zx_status_t VnodeMinfs::ReadIndirectVmoBlock(uint32_t offset, blk_t bno, uint32_t** entry) {
+    zx_status_t status;
+    if ((status = GrowIndirectVmo(offset)) != ZX_OK) {
+        return status;
+    }
+
+    if (!indirect_loaded_.Get(offset, offset + 1)) {
+        fs_->ValidateBno(bno);
+        ReadTxn txn(fs_->bc_.get());
+        txn.Enqueue(vmoid_indirect_, offset, bno + fs_->info_.dat_block, 1);
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+        if ((status = indirect_loaded_.Set(offset, offset + 1)) != ZX_OK) {
+            return status;
+        }
+    }
+
     uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
     validate_vmo_size(vmo_indirect_->GetVmo(), offset);
     *entry = reinterpret_cast<uint32_t*>(addr + kMinfsBlockSize * offset);
+    return ZX_OK;
 }
 
-void VnodeMinfs::ClearIndirectVmoBlock(uint32_t offset) {
-    ZX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
+zx_status_t VnodeMinfs::ClearIndirectVmoBlock(uint32_t offset) {
+    zx_status_t status;
+    if ((status = GrowIndirectVmo(offset)) != ZX_OK) {
+        return status;
+    }
+
     uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
     validate_vmo_size(vmo_indirect_->GetVmo(), offset);
     memset(reinterpret_cast<void*>(addr + kMinfsBlockSize * offset), 0, kMinfsBlockSize);
+    return indirect_loaded_.Set(offset, offset + 1);
 }
 #else
 void VnodeMinfs::ReadIndirectBlock(blk_t bno, uint32_t* entry) {
@@ -629,6 +742,10 @@ void VnodeMinfs::ClearIndirectBlock(blk_t bno) {
 
 // Get the bno corresponding to the nth logical block within the file.
 zx_status_t VnodeMinfs::GetBno(WriteTxn* txn, blk_t n, blk_t* bno) {
+    if (UsesExtents()) {
+        return GetBnoExtent(txn, n, bno);
+    }
+
     bool dirty = false;
 
     if (n < kMinfsDirect) {
@@ -661,22 +778,6 @@ zx_status_t VnodeMinfs::GetBno(WriteTxn* txn, blk_t n, blk_t* bno) {
         // index of direct block within indirect block
         uint32_t bindex = n % kMinfsDirectPerIndirect;
 
-    #ifdef __Fuchsia__
-        zx_status_t status;
-        // If the vmo_indirect_ vmo has not been created, make it now.
-        if ((status = InitIndirectVmo()) != ZX_OK) {
-            return status;
-        }
-
-        // Grow VMO if we need more space to fit this set of indirect blocks
-        uint64_t vmo_size = GetVmoSizeForIndirect(dibindex);
-        if (vmo_indirect_->GetSize() < vmo_size) {
-            if ((status = vmo_indirect_->Grow(vmo_size)) != ZX_OK) {
-                return status;
-            }
-        }
-    #endif
-
         return GetBnoDoublyIndirect(txn, ibindex, bindex, GetVmoOffsetForDoublyIndirect(dibindex),
                                     GetVmoOffsetForIndirect(dibindex), &inode_.dinum[dibindex], bno,
                                     &dirty);
@@ -685,99 +786,467 @@ zx_status_t VnodeMinfs::GetBno(WriteTxn* txn, blk_t n, blk_t* bno) {
     return ZX_ERR_OUT_OF_RANGE;
 }
 
-// Immediately stop iterating over the directory.
-#define DIR_CB_DONE 0
-// Access the next direntry in the directory. Offsets updated.
-#define DIR_CB_NEXT 1
-// Identify that the direntry record was modified. Stop iterating.
-#define DIR_CB_SAVE_SYNC 2
-
-zx_status_t VnodeMinfs::ReadExactInternal(void* data, size_t len, size_t off) {
-    size_t actual;
-    zx_status_t status = ReadInternal(data, len, off, &actual);
-    if (status != ZX_OK) {
-        return status;
-    } else if (actual != len) {
-        return ZX_ERR_IO;
+size_t VnodeMinfs::ExtentUpperBound(blk_t n) const {
+    size_t lo = 0;
+    size_t hi = extents_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (extents_[mid].file_block <= n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return ZX_OK;
+    return lo;
 }
 
-zx_status_t VnodeMinfs::WriteExactInternal(WriteTxn* txn, const void* data,
-                                           size_t len, size_t off) {
-    size_t actual;
-    zx_status_t status = WriteInternal(txn, data, len, off, &actual);
-    if (status != ZX_OK) {
+zx_status_t VnodeMinfs::GetBnoExtent(WriteTxn* txn, blk_t n, blk_t* bno) {
+    if (n >= kMinfsMaxFileBlock) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    zx_status_t status;
+    if ((status = LoadExtents()) != ZX_OK) {
         return status;
-    } else if (actual != len) {
-        return ZX_ERR_IO;
     }
-    InodeSync(txn, kMxFsSyncMtime);
-    return ZX_OK;
-}
 
-static zx_status_t validate_dirent(minfs_dirent_t* de, size_t bytes_read, size_t off) {
-    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
-    if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
-        FS_TRACE_ERROR("vn_dir: Could not read dirent at offset: %zd\n", off);
-        return ZX_ERR_IO;
-    } else if ((off + reclen > kMinfsMaxDirectorySize) || (reclen & 3)) {
-        FS_TRACE_ERROR("vn_dir: bad reclen %u > %u\n", reclen, kMinfsMaxDirectorySize);
-        return ZX_ERR_IO;
-    } else if (de->ino != 0) {
-        if ((de->namelen == 0) ||
-            (de->namelen > (reclen - MINFS_DIRENT_SIZE))) {
-            FS_TRACE_ERROR("vn_dir: bad namelen %u / %u\n", de->namelen, reclen);
-            return ZX_ERR_IO;
+    // Only the extent before the first one which starts past n may hold it.
+    size_t i = ExtentUpperBound(n);
+    if (i > 0) {
+        const minfs_extent_t& extent = extents_[i - 1];
+        if (n - extent.file_block < extent.length) {
+            *bno = extent.start + (n - extent.file_block);
+            return ZX_OK;
         }
     }
-    return ZX_OK;
+
+    if (txn == nullptr) {
+        *bno = 0;
+        return ZX_OK;
+    }
+
+    // Try for the block which follows the previous extent on disk, so that it may be
+    // extended; otherwise, start a new extent with room to grow.
+    blk_t hint = 0;
+    if (i > 0) {
+        hint = extents_[i - 1].start + extents_[i - 1].length;
+    }
+    blk_t run = fbl::clamp(n, kMinfsExtentRunMin, kMinfsExtentRunMax);
+    if ((status = fs_->BlockNewRun(txn, hint, run, bno)) != ZX_OK) {
+        return status;
+    }
+    if ((status = ExtentInsert(i, n, *bno, 1)) != ZX_OK) {
+        fs_->BlockFree(txn, *bno);
+        return status;
+    }
+    inode_.block_count++;
+    return SyncExtents(txn);
 }
 
-// Updates offset information to move to the next direntry in the directory.
-static zx_status_t do_next_dirent(minfs_dirent_t* de, DirectoryOffset* offs) {
-    offs->off_prev = offs->off;
-    offs->off += MinfsReclen(de, offs->off);
-    return DIR_CB_NEXT;
+blk_t VnodeMinfs::ExtentRun(blk_t n, blk_t end, blk_t* bno) const {
+    ZX_DEBUG_ASSERT(n < end);
+    size_t i = ExtentUpperBound(n);
+    if (i > 0) {
+        const minfs_extent_t& extent = extents_[i - 1];
+        if (n - extent.file_block < extent.length) {
+            *bno = extent.start + (n - extent.file_block);
+            return fbl::min(end, extent.file_block + extent.length) - n;
+        }
+    }
+    *bno = 0;
+    if (i < extents_.size()) {
+        end = fbl::min(end, extents_[i].file_block);
+    }
+    return end - n;
 }
 
-zx_status_t VnodeMinfs::DirentCallbackFind(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
-                                           DirArgs* args, DirectoryOffset* offs) {
-    if ((de->ino != 0) && fbl::StringPiece(de->name, de->namelen) == args->name) {
-        args->ino = de->ino;
-        args->type = de->type;
-        return DIR_CB_DONE;
+zx_status_t VnodeMinfs::ExtentInsert(size_t i, blk_t n, blk_t bno, blk_t count) {
+    if (i > 0 && extents_[i - 1].file_block + extents_[i - 1].length == n &&
+        extents_[i - 1].start + extents_[i - 1].length == bno) {
+        extents_[i - 1].length += count;
+        i--;
     } else {
-        return do_next_dirent(de, offs);
+        minfs_extent_t extent;
+        extent.file_block = n;
+        extent.start = bno;
+        extent.length = count;
+        fbl::AllocChecker ac;
+        extents_.insert(i, extent, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
     }
-}
 
-zx_status_t VnodeMinfs::CanUnlink() const {
-    // directories must be empty (dirent_count == 2)
-    if (IsDirectory()) {
-        if (inode_.dirent_count != 2) {
-            // if we have more than "." and "..", not empty, cannot unlink
-            return ZX_ERR_NOT_EMPTY;
-#ifdef __Fuchsia__
-        } else if (IsRemote()) {
-            // we cannot unlink mount points
-            return ZX_ERR_UNAVAILABLE;
-#endif
+    // Filling a hole may join extent i to the one after it.
+    if (i + 1 < extents_.size()) {
+        minfs_extent_t& extent = extents_[i];
+        const minfs_extent_t& next = extents_[i + 1];
+        if (extent.file_block + extent.length == next.file_block &&
+            extent.start + extent.length == next.start) {
+            extent.length += next.length;
+            extents_.erase(i + 1);
         }
     }
+
+    MarkExtentsDirty(i);
     return ZX_OK;
 }
 
-zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
-                                    fbl::RefPtr<VnodeMinfs> childvn,
-                                    minfs_dirent_t* de, DirectoryOffset* offs) {
-    // Coalesce the current dirent with the previous/next dirent, if they
-    // (1) exist and (2) are free.
-    size_t off_prev = offs->off_prev;
-    size_t off = offs->off;
-    size_t off_next = off + MinfsReclen(de, off);
-    minfs_dirent_t de_prev, de_next;
+zx_status_t VnodeMinfs::LoadExtents() {
+    if (extents_loaded_) {
+        return ZX_OK;
+    }
+
+    const minfs_extent_map_t* map = MinfsExtentMap(&inode_);
+    const uint32_t leaves = GetExtentLeafCount(map->count);
+    if (leaves > kMinfsExtentLeavesPerIndex || (leaves == 0) != (map->tree == 0) ||
+        map->tree >= fs_->info_.block_count) {
+        FS_TRACE_ERROR("minfs: ino %u has a bad extent map\n", ino_);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::Vector<minfs_extent_t> extents;
+    extents.reserve(map->count, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::Vector<blk_t> extent_leaves;
+    extent_leaves.reserve(leaves, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    const uint32_t inline_count = fbl::min(map->count, kMinfsInlineExtents);
+    for (uint32_t i = 0; i < inline_count; i++) {
+        extents.push_back(map->extents[i]);
+    }
+
+    if (leaves > 0) {
+#ifdef __Fuchsia__
+        zx_status_t status;
+        // Grow the VMO for every leaf up front, so that the index stays mapped, and read
+        // all the leaves together.
+        if ((status = GrowIndirectVmo(GetVmoOffsetForExtentLeaf(leaves - 1))) != ZX_OK) {
+            return status;
+        }
+        uint32_t* index_data;
+        if ((status = ReadIndirectVmoBlock(0, map->tree, &index_data)) != ZX_OK) {
+            return status;
+        }
+#else
+        uint32_t index_data[kMinfsBlockSize / sizeof(uint32_t)];
+        ReadIndirectBlock(map->tree, index_data);
+#endif
+        const minfs_extent_index_t* index = reinterpret_cast<minfs_extent_index_t*>(index_data);
+        for (uint32_t l = 0; l < leaves; l++) {
+            if (index[l].bno == 0 || index[l].bno >= fs_->info_.block_count) {
+                FS_TRACE_ERROR("minfs: ino %u has a bad extent leaf\n", ino_);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            extent_leaves.push_back(index[l].bno);
+        }
+
+#ifdef __Fuchsia__
+        ReadTxn txn(fs_->bc_.get());
+        for (uint32_t l = 0; l < leaves; l++) {
+            const uint32_t offset = GetVmoOffsetForExtentLeaf(l);
+            if (!indirect_loaded_.Get(offset, offset + 1)) {
+                txn.Enqueue(vmoid_indirect_, offset, extent_leaves[l] + fs_->info_.dat_block, 1);
+            }
+        }
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+        if ((status = indirect_loaded_.Set(GetVmoOffsetForExtentLeaf(0),
+                                           GetVmoOffsetForExtentLeaf(leaves))) != ZX_OK) {
+            return status;
+        }
+#endif
+
+        for (uint32_t l = 0; l < leaves; l++) {
+#ifdef __Fuchsia__
+            uint32_t* leaf_data;
+            if ((status = ReadIndirectVmoBlock(GetVmoOffsetForExtentLeaf(l), extent_leaves[l],
+                                               &leaf_data)) != ZX_OK) {
+                return status;
+            }
+#else
+            uint32_t leaf_data[kMinfsBlockSize / sizeof(uint32_t)];
+            ReadIndirectBlock(extent_leaves[l], leaf_data);
+#endif
+            const minfs_extent_leaf_t* leaf = reinterpret_cast<minfs_extent_leaf_t*>(leaf_data);
+            const uint32_t expected = fbl::min(map->count - static_cast<uint32_t>(extents.size()),
+                                               kMinfsExtentsPerLeaf);
+            if (leaf->count != expected ||
+                leaf->extents[0].file_block != index[l].file_block) {
+                FS_TRACE_ERROR("minfs: ino %u has a bad extent leaf\n", ino_);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            for (uint32_t i = 0; i < leaf->count; i++) {
+                extents.push_back(leaf->extents[i]);
+            }
+        }
+    }
+
+    // Extents must be sorted, and may neither overlap nor stray outside the data blocks.
+    blk_t next = 0;
+    for (const minfs_extent_t& extent : extents) {
+        if (extent.length == 0 || extent.file_block < next ||
+            extent.file_block >= kMinfsMaxFileBlock ||
+            extent.length > kMinfsMaxFileBlock - extent.file_block ||
+            extent.start == 0 || extent.start >= fs_->info_.block_count ||
+            extent.length > fs_->info_.block_count - extent.start) {
+            FS_TRACE_ERROR("minfs: ino %u has a bad extent at block %u\n", ino_,
+                           extent.file_block);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        next = extent.file_block + extent.length;
+    }
+
+    extents_ = fbl::move(extents);
+    extent_leaves_ = fbl::move(extent_leaves);
+    extents_loaded_ = true;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::WriteExtentBlock(WriteTxn* txn, uint32_t offset, blk_t bno,
+                                         const void* data) {
+    fs_->ValidateBno(bno);
+#ifdef __Fuchsia__
     zx_status_t status;
+    if ((status = GrowIndirectVmo(offset)) != ZX_OK) {
+        return status;
+    }
+    uintptr_t addr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
+    validate_vmo_size(vmo_indirect_->GetVmo(), offset);
+    memcpy(reinterpret_cast<void*>(addr + kMinfsBlockSize * offset), data, kMinfsBlockSize);
+    if ((status = indirect_loaded_.Set(offset, offset + 1)) != ZX_OK) {
+        return status;
+    }
+    txn->Enqueue(vmo_indirect_->GetVmo(), offset, bno + fs_->info_.dat_block, 1);
+    return ZX_OK;
+#else
+    return fs_->bc_->Writeblk(bno + fs_->info_.dat_block, data);
+#endif
+}
+
+zx_status_t VnodeMinfs::SyncExtents(WriteTxn* txn) {
+    ZX_DEBUG_ASSERT(extents_loaded_);
+    minfs_extent_map_t* map = MinfsExtentMap(&inode_);
+    const uint32_t count = static_cast<uint32_t>(extents_.size());
+    const uint32_t leaves = GetExtentLeafCount(count);
+    const size_t old_leaves = extent_leaves_.size();
+    zx_status_t status;
+
+    // Fit the tree to the extents. Extent blocks are allocated away from the file's data,
+    // which they would otherwise split.
+    fbl::AllocChecker ac;
+    extent_leaves_.reserve(leaves, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (leaves > 0 && map->tree == 0) {
+        if ((status = fs_->BlockNew(txn, 0, &map->tree)) != ZX_OK) {
+            return status;
+        }
+        inode_.block_count++;
+    }
+    while (extent_leaves_.size() < leaves) {
+        blk_t bno;
+        if ((status = fs_->BlockNew(txn, map->tree, &bno)) != ZX_OK) {
+            return status;
+        }
+        extent_leaves_.push_back(bno);
+        inode_.block_count++;
+    }
+    while (extent_leaves_.size() > leaves) {
+        fs_->BlockFree(txn, extent_leaves_[extent_leaves_.size() - 1]);
+        extent_leaves_.pop_back();
+        inode_.block_count--;
+    }
+    if (leaves == 0 && map->tree != 0) {
+        fs_->BlockFree(txn, map->tree);
+        map->tree = 0;
+        inode_.block_count--;
+    }
+
+    const uint32_t inline_count = fbl::min(count, kMinfsInlineExtents);
+    map->count = count;
+    memset(map->extents, 0, sizeof(map->extents));
+    memcpy(map->extents, extents_.get(), inline_count * sizeof(minfs_extent_t));
+
+    // Leaves are packed, so every leaf from the one holding the first changed extent
+    // is rewritten.
+    size_t first = leaves;
+    if (extents_dirty_ < kMinfsInlineExtents) {
+        first = 0;
+    } else if (extents_dirty_ != SIZE_MAX) {
+        first = fbl::min<size_t>((extents_dirty_ - kMinfsInlineExtents) / kMinfsExtentsPerLeaf,
+                                 leaves);
+    }
+    extents_dirty_ = SIZE_MAX;
+
+    uint32_t data[kMinfsBlockSize / sizeof(uint32_t)];
+    for (size_t l = first; l < leaves; l++) {
+        const size_t begin = kMinfsInlineExtents + l * kMinfsExtentsPerLeaf;
+        minfs_extent_leaf_t* leaf = reinterpret_cast<minfs_extent_leaf_t*>(data);
+        memset(data, 0, sizeof(data));
+        leaf->count = static_cast<uint32_t>(fbl::min<size_t>(count - begin,
+                                                             kMinfsExtentsPerLeaf));
+        memcpy(leaf->extents, &extents_[begin], leaf->count * sizeof(minfs_extent_t));
+        if ((status = WriteExtentBlock(txn, GetVmoOffsetForExtentLeaf(static_cast<uint32_t>(l)),
+                                       extent_leaves_[l], data)) != ZX_OK) {
+            return status;
+        }
+    }
+
+    if (leaves > 0 && (first < leaves || leaves != old_leaves)) {
+        minfs_extent_index_t* index = reinterpret_cast<minfs_extent_index_t*>(data);
+        memset(data, 0, sizeof(data));
+        for (uint32_t l = 0; l < leaves; l++) {
+            index[l].file_block = extents_[kMinfsInlineExtents + l * kMinfsExtentsPerLeaf]
+                                      .file_block;
+            index[l].bno = extent_leaves_[l];
+        }
+        if ((status = WriteExtentBlock(txn, 0, map->tree, data)) != ZX_OK) {
+            return status;
+        }
+    }
+
+    InodeSync(txn, kMxFsSyncDefault);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::BlocksShrinkExtents(WriteTxn* txn, blk_t start) {
+    zx_status_t status;
+    if ((status = LoadExtents()) != ZX_OK) {
+        return status;
+    }
+
+    // Extents are sorted, so those past |start| are all at the end.
+    bool dirty = false;
+    while (!extents_.is_empty()) {
+        const size_t i = extents_.size() - 1;
+        minfs_extent_t& extent = extents_[i];
+        if (extent.file_block + extent.length <= start) {
+            break;
+        }
+        const blk_t keep = start > extent.file_block ? start - extent.file_block : 0;
+        for (blk_t n = keep; n < extent.length; n++) {
+            fs_->BlockFree(txn, extent.start + n);
+            inode_.block_count--;
+        }
+        MarkExtentsDirty(i);
+        dirty = true;
+        if (keep > 0) {
+            extent.length = keep;
+            break;
+        }
+        extents_.pop_back();
+    }
+
+    if (dirty) {
+        return SyncExtents(txn);
+    }
+    return ZX_OK;
+}
+
+// Immediately stop iterating over the directory.
+#define DIR_CB_DONE 0
+// Access the next direntry in the directory. Offsets updated.
+#define DIR_CB_NEXT 1
+// Identify that the direntry record was modified. Stop iterating.
+#define DIR_CB_SAVE_SYNC 2
+
+zx_status_t VnodeMinfs::ReadExactInternal(void* data, size_t len, size_t off) {
+    size_t actual;
+    zx_status_t status = ReadInternal(data, len, off, &actual);
+    if (status != ZX_OK) {
+        return status;
+    } else if (actual != len) {
+        return ZX_ERR_IO;
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::WriteExactInternal(WriteTxn* txn, const void* data,
+                                           size_t len, size_t off) {
+    size_t actual;
+    zx_status_t status = WriteInternal(txn, data, len, off, &actual);
+    if (status != ZX_OK) {
+        return status;
+    } else if (actual != len) {
+        return ZX_ERR_IO;
+    }
+    InodeSync(txn, kMxFsSyncMtime);
+    return ZX_OK;
+}
+
+static zx_status_t validate_dirent(minfs_dirent_t* de, size_t bytes_read, size_t off) {
+    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
+    if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
+        FS_TRACE_ERROR("vn_dir: Could not read dirent at offset: %zd\n", off);
+        return ZX_ERR_IO;
+    } else if ((off + reclen > kMinfsMaxDirectorySize) || (reclen & 3)) {
+        FS_TRACE_ERROR("vn_dir: bad reclen %u > %u\n", reclen, kMinfsMaxDirectorySize);
+        return ZX_ERR_IO;
+    } else if (de->ino != 0) {
+        if ((de->namelen == 0) ||
+            (de->namelen > (reclen - MINFS_DIRENT_SIZE))) {
+            FS_TRACE_ERROR("vn_dir: bad namelen %u / %u\n", de->namelen, reclen);
+            return ZX_ERR_IO;
+        }
+    }
+    return ZX_OK;
+}
+
+// Updates offset information to move to the next direntry in the directory.
+static zx_status_t do_next_dirent(minfs_dirent_t* de, DirectoryOffset* offs) {
+    offs->off_prev = offs->off;
+    offs->off += MinfsReclen(de, offs->off);
+    return DIR_CB_NEXT;
+}
+
+zx_status_t VnodeMinfs::DirentCallbackFind(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
+                                           DirArgs* args, DirectoryOffset* offs) {
+    if ((de->ino != 0) && fbl::StringPiece(de->name, de->namelen) == args->name) {
+        args->ino = de->ino;
+        args->type = de->type;
+        return DIR_CB_DONE;
+    } else {
+        return do_next_dirent(de, offs);
+    }
+}
+
+zx_status_t VnodeMinfs::CanUnlink() const {
+    // directories must be empty (dirent_count == 2)
+    if (IsDirectory()) {
+        if (inode_.dirent_count != 2) {
+            // if we have more than "." and "..", not empty, cannot unlink
+            return ZX_ERR_NOT_EMPTY;
+#ifdef __Fuchsia__
+        } else if (IsRemote()) {
+            // we cannot unlink mount points
+            return ZX_ERR_UNAVAILABLE;
+#endif
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
+                                    fbl::RefPtr<VnodeMinfs> childvn,
+                                    minfs_dirent_t* de, DirectoryOffset* offs) {
+    // Coalesce the current dirent with the previous/next dirent, if they
+    // (1) exist and (2) are free.
+    size_t off_prev = offs->off_prev;
+    size_t off = offs->off;
+    size_t off_next = off + MinfsReclen(de, off);
+    minfs_dirent_t de_prev, de_next;
+    zx_status_t status;
+
+    DirIndexRemove(wb, fbl::StringPiece(de->name, de->namelen), off);
 
     // Read the direntries we're considering merging with.
     // Verify they are free and small enough to merge.
@@ -827,6 +1296,7 @@ zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
     }
 
     if (de->reclen & kMinfsReclenLast) {
+        DirIndexSetTail(off);
         // Truncating the directory merely removed unused space; if it fails,
         // the directory contents are still valid.
         TruncateInternal(wb->txn(), off + MINFS_DIRENT_SIZE);
@@ -898,176 +1368,661 @@ zx_status_t VnodeMinfs::DirentCallbackForceUnlink(fbl::RefPtr<VnodeMinfs> vndir,
     if ((status = vndir->fs_->VnodeGet(&vn, de->ino)) < 0) {
         return status;
     }
-    return vndir->UnlinkChild(args->wb, fbl::move(vn), de, offs);
+    return vndir->UnlinkChild(args->wb, fbl::move(vn), de, offs);
+}
+
+// Given a (name, inode, type) combination:
+//   - If no corresponding 'name' is found, ZX_ERR_NOT_FOUND is returned
+//   - If the 'name' corresponds to a vnode, check that the target vnode:
+//      - Does not have the same inode as the argument inode
+//      - Is the same type as the argument 'type'
+//      - Is unlinkable
+//   - If the previous checks pass, then:
+//      - Remove the old vnode (decrement link count by one)
+//      - Replace the old vnode's position in the directory with the new inode
+zx_status_t VnodeMinfs::DirentCallbackAttemptRename(fbl::RefPtr<VnodeMinfs> vndir,
+                                                    minfs_dirent_t* de, DirArgs* args,
+                                                    DirectoryOffset* offs) {
+    if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
+        return do_next_dirent(de, offs);
+    }
+
+    fbl::RefPtr<VnodeMinfs> vn;
+    zx_status_t status;
+    if ((status = vndir->fs_->VnodeGet(&vn, de->ino)) < 0) {
+        return status;
+    } else if (args->ino == vn->ino_) {
+        // cannot rename node to itself
+        return ZX_ERR_BAD_STATE;
+    } else if (args->type != de->type) {
+        // cannot rename directory to file (or vice versa)
+        return ZX_ERR_BAD_STATE;
+    } else if ((status = vn->CanUnlink()) != ZX_OK) {
+        // if we cannot unlink the target, we cannot rename the target
+        return status;
+    }
+
+    // If we are renaming ON TOP of a directory, then we can skip
+    // updating the parent link count -- the old directory had a ".." entry to
+    // the parent (link count of 1), but the new directory will ALSO have a ".."
+    // entry, making the rename operation idempotent w.r.t. the parent link
+    // count.
+    vn->RemoveInodeLink(args->wb->txn());
+
+    de->ino = args->ino;
+    status = vndir->WriteExactInternal(args->wb->txn(), de, DirentSize(de->namelen), offs->off);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    args->wb->PinVnode(vn);
+    args->wb->PinVnode(vndir);
+    return DIR_CB_SAVE_SYNC;
+}
+
+zx_status_t VnodeMinfs::DirentCallbackUpdateInode(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
+                                                  DirArgs* args, DirectoryOffset* offs) {
+    if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
+        return do_next_dirent(de, offs);
+    }
+
+    de->ino = args->ino;
+    zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de,
+                                                   DirentSize(de->namelen),
+                                                   offs->off);
+    if (status != ZX_OK) {
+        return status;
+    }
+    args->wb->PinVnode(vndir);
+    return DIR_CB_SAVE_SYNC;
+}
+
+zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
+                                             DirArgs* args, DirectoryOffset* offs) {
+    auto add_dirent = [](fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de, DirArgs* args,
+                         size_t off) {
+        de->ino = args->ino;
+        de->type = static_cast<uint8_t>(args->type);
+        de->namelen = static_cast<uint8_t>(args->name.length());
+        memcpy(de->name, args->name.data(), de->namelen);
+        zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de, DirentSize(de->namelen),
+                                                       off);
+        if (status != ZX_OK) {
+            return status;
+        }
+        vndir->DirIndexInsert(args->wb, args->name, off);
+        if (de->reclen & kMinfsReclenLast) {
+            vndir->DirIndexSetTail(off);
+        }
+        vndir->inode_.dirent_count++;
+        if (args->type == kMinfsTypeDir) {
+            // Child directory has '..' which will point to parent directory
+            vndir->inode_.link_count++;
+        }
+        args->wb->PinVnode(fbl::move(vndir));
+        return DIR_CB_SAVE_SYNC;
+    };
+
+    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, offs->off));
+    if (de->ino == 0) {
+        // empty entry, do we fit?
+        if (args->reclen > reclen) {
+            return do_next_dirent(de, offs);
+        }
+        return add_dirent(fbl::move(vndir), de, args, offs->off);
+    } else {
+        // filled entry, can we sub-divide?
+        uint32_t size = static_cast<uint32_t>(DirentSize(de->namelen));
+        if (size > reclen) {
+            FS_TRACE_ERROR("bad reclen (smaller than dirent) %u < %u\n", reclen, size);
+            return ZX_ERR_IO;
+        }
+        uint32_t extra = reclen - size;
+        if (extra < args->reclen) {
+            return do_next_dirent(de, offs);
+        }
+        // shrink existing entry
+        bool was_last_record = de->reclen & kMinfsReclenLast;
+        de->reclen = size;
+        zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de,
+                                                       DirentSize(de->namelen),
+                                                       offs->off);
+        if (status != ZX_OK) {
+            return status;
+        }
+        offs->off += size;
+        // create new entry in the remaining space
+        char data[kMinfsMaxDirentSize];
+        de = (minfs_dirent_t*) data;
+        de->reclen = extra | (was_last_record ? kMinfsReclenLast : 0);
+        return add_dirent(fbl::move(vndir), de, args, offs->off);
+    }
+}
+
+// Calls a callback 'func' on all direntries in a directory 'vn' with the
+// provided arguments, reacting to the return code of the callback.
+//
+// When 'func' is called, it receives a few arguments:
+//  'vndir': The directory on which the callback is operating
+//  'de': A pointer the start of a single dirent.
+//        Only DirentSize(de->namelen) bytes are guaranteed to exist in
+//        memory from this starting pointer.
+//  'args': Additional arguments plumbed through ForEachDirent
+//  'offs': Offset info about where in the directory this direntry is located.
+//          Since 'func' may create / remove surrounding dirents, it is responsible for
+//          updating the offset information to access the next dirent.
+zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func) {
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    DirectoryOffset offs = {
+        .off = 0,
+        .off_prev = 0,
+    };
+    while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+        xprintf("Reading dirent at offset %zd\n", offs.off);
+        size_t r;
+        zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
+            return status;
+        }
+
+        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
+        case DIR_CB_NEXT:
+            break;
+        case DIR_CB_SAVE_SYNC:
+            SyncDirents(args->wb);
+            return ZX_OK;
+        case DIR_CB_DONE:
+        default:
+            return status;
+        }
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+void VnodeMinfs::SyncDirents(WritebackWork* wb) {
+    inode_.seq_num++;
+    DirIndexSync(wb);
+    InodeSync(wb->txn(), kMxFsSyncMtime);
+    wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+}
+
+// Returns the index of the first entry of |leaf| with a hash of at least |hash|.
+static uint32_t dir_index_lower_bound(const minfs_dir_index_leaf_t* leaf, uint32_t hash) {
+    uint32_t lo = 0;
+    uint32_t hi = leaf->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (leaf->entries[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Inserts |entry| into |leaf|, which must have room for it, after any entries of equal hash.
+static void dir_index_leaf_insert(minfs_dir_index_leaf_t* leaf, minfs_dir_index_entry_t entry) {
+    uint32_t i = leaf->count;
+    while (i > 0 && leaf->entries[i - 1].hash > entry.hash) {
+        leaf->entries[i] = leaf->entries[i - 1];
+        i--;
+    }
+    leaf->entries[i] = entry;
+    leaf->count++;
+}
+
+static int dir_index_entry_compare(const void* a, const void* b) {
+    const minfs_dir_index_entry_t* ea = static_cast<const minfs_dir_index_entry_t*>(a);
+    const minfs_dir_index_entry_t* eb = static_cast<const minfs_dir_index_entry_t*>(b);
+    if (ea->hash != eb->hash) {
+        return ea->hash < eb->hash ? -1 : 1;
+    }
+    return ea->off < eb->off ? -1 : (ea->off > eb->off ? 1 : 0);
+}
+
+zx_status_t VnodeMinfs::FindDirent(DirArgs* args, const DirentCallback func) {
+    // A directory whose index cannot be used is scanned; the index is dropped if the
+    // directory is then modified.
+    zx_status_t status = DirIndexLoad();
+    if (status != ZX_OK) {
+        return ForEachDirent(args, func);
+    }
+
+    const uint32_t hash = MinfsDirIndexHash(args->name.data(), args->name.length());
+    minfs_dir_index_leaf_t leaf;
+    if ((status = DirIndexReadLeaf(dir_index_root_->leaves[DirIndexFindLeaf(hash)].block,
+                                   &leaf)) != ZX_OK) {
+        return status;
+    }
+
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    for (uint32_t i = dir_index_lower_bound(&leaf, hash);
+         i < leaf.count && leaf.entries[i].hash == hash; i++) {
+        // The previous record is not known, so a dirent unlinked through the index is only
+        // merged with the free space after it.
+        DirectoryOffset offs = {
+            .off = leaf.entries[i].off,
+            .off_prev = leaf.entries[i].off,
+        };
+        size_t r;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r)) != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
+            return status;
+        }
+
+        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
+        case DIR_CB_NEXT:
+            break;
+        case DIR_CB_SAVE_SYNC:
+            SyncDirents(args->wb);
+            return ZX_OK;
+        case DIR_CB_DONE:
+        default:
+            return status;
+        }
+    }
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
+    zx_status_t status = DirIndexLoad();
+    if (status != ZX_OK && status != ZX_ERR_NOT_FOUND) {
+        DirIndexDrop(args->wb->txn());
+        status = ZX_ERR_NOT_FOUND;
+    }
+    if (status == ZX_ERR_NOT_FOUND && inode_.size >= kMinfsDirIndexMinSize) {
+        if ((status = DirIndexBuild(args->wb)) != ZX_OK) {
+            FS_TRACE_WARN("minfs: could not index directory %u: %d\n", ino_, status);
+        }
+    }
+
+    if (status == ZX_OK) {
+        // The last record runs to the end of the largest possible directory, so the dirent
+        // is placed there without a scan until the directory fills up; only then is the
+        // space freed by earlier unlinks sought.
+        char data[kMinfsMaxDirentSize];
+        minfs_dirent_t* de = (minfs_dirent_t*) data;
+        DirectoryOffset offs = {
+            .off = dir_index_root_->tail,
+            .off_prev = dir_index_root_->tail,
+        };
+        size_t r;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r)) != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
+            return status;
+        }
+
+        if (!(de->reclen & kMinfsReclenLast)) {
+            FS_TRACE_WARN("minfs: dropping index of directory %u: bad tail\n", ino_);
+            DirIndexDrop(args->wb->txn());
+        } else {
+            switch ((status = DirentCallbackAppend(fbl::RefPtr<VnodeMinfs>(this), de, args,
+                                                   &offs))) {
+            case DIR_CB_NEXT:
+                break;
+            case DIR_CB_SAVE_SYNC:
+                SyncDirents(args->wb);
+                return ZX_OK;
+            default:
+                return status;
+            }
+        }
+    }
+    return ForEachDirent(args, DirentCallbackAppend);
+}
+
+zx_status_t VnodeMinfs::DirIndexLoad() {
+    if (inode_.dir_index == 0) {
+        return ZX_ERR_NOT_FOUND;
+    } else if (dir_index_root_ != nullptr) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    if (dir_index_ == nullptr &&
+        (status = fs_->VnodeGet(&dir_index_, inode_.dir_index)) != ZX_OK) {
+        return status;
+    }
+    if (dir_index_->IsDirectory()) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<minfs_dir_index_root_t> root(new (&ac) minfs_dir_index_root_t);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = dir_index_->ReadExactInternal(root.get(), sizeof(*root), 0)) != ZX_OK) {
+        return status;
+    }
+
+    // An index written before the last change to the directory may not describe it.
+    if ((root->magic != kMinfsDirIndexMagic) || (root->seq_num != inode_.seq_num) ||
+        (root->entry_count != inode_.dirent_count) ||
+        (root->tail + MINFS_DIRENT_SIZE > inode_.size) ||
+        (root->leaf_count == 0) || (root->leaf_count > kMinfsDirIndexMaxLeaves) ||
+        (root->leaves[0].hash != 0)) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const blk_t index_blocks = static_cast<blk_t>(dir_index_->inode_.size / kMinfsBlockSize);
+    for (uint32_t i = 0; i < root->leaf_count; i++) {
+        if ((i > 0 && root->leaves[i].hash <= root->leaves[i - 1].hash) ||
+            (root->leaves[i].block == 0) || (root->leaves[i].block >= index_blocks)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    dir_index_root_ = fbl::move(root);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::DirIndexBuild(WritebackWork* wb) {
+    // Gather the hash and offset of every dirent, and sort them by hash.
+    fbl::AllocChecker ac;
+    fbl::Vector<minfs_dir_index_entry_t> entries;
+    entries.reserve(inode_.dirent_count, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status;
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    size_t off = 0;
+    bool found_tail = false;
+    while (!found_tail && off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+        size_t r;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, off, &r)) != ZX_OK) {
+            return status;
+        } else if ((status = validate_dirent(de, r, off)) != ZX_OK) {
+            return status;
+        }
+        if (de->ino != 0) {
+            minfs_dir_index_entry_t entry = {
+                .hash = MinfsDirIndexHash(de->name, de->namelen),
+                .off = static_cast<uint32_t>(off),
+            };
+            entries.push_back(entry, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            found_tail = true;
+        } else {
+            off += MinfsReclen(de, off);
+        }
+    }
+    if (!found_tail || entries.size() != inode_.dirent_count) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    qsort(entries.get(), entries.size(), sizeof(minfs_dir_index_entry_t),
+          dir_index_entry_compare);
+
+    fbl::unique_ptr<minfs_dir_index_root_t> root(new (&ac) minfs_dir_index_root_t());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    root->magic = kMinfsDirIndexMagic;
+    root->seq_num = inode_.seq_num;
+    root->entry_count = static_cast<uint32_t>(entries.size());
+    root->tail = static_cast<uint32_t>(off);
+
+    fbl::RefPtr<VnodeMinfs> vn;
+    if ((status = fs_->VnodeNew(wb->txn(), &vn, kMinfsTypeFile)) != ZX_OK) {
+        return status;
+    }
+    inode_.dir_index = vn->ino_;
+    dir_index_ = fbl::move(vn);
+
+    // Split the entries among leaves, which are partly filled so that dirents added later do
+    // not immediately split them, and which never divide the entries of one hash.
+    minfs_dir_index_leaf_t leaf;
+    size_t start = 0;
+    do {
+        size_t end = fbl::min(start + kMinfsDirIndexBuildFill, entries.size());
+        while (end < entries.size() && entries[end].hash == entries[end - 1].hash) {
+            if (end - start == kMinfsDirIndexEntriesPerLeaf) {
+                status = ZX_ERR_NO_SPACE;
+                break;
+            }
+            end++;
+        }
+        if (status == ZX_OK && root->leaf_count == kMinfsDirIndexMaxLeaves) {
+            status = ZX_ERR_NO_SPACE;
+        }
+        if (status != ZX_OK) {
+            DirIndexDrop(wb->txn());
+            return status;
+        }
+
+        memset(&leaf, 0, sizeof(leaf));
+        leaf.count = static_cast<uint32_t>(end - start);
+        memcpy(leaf.entries, &entries[start], leaf.count * sizeof(minfs_dir_index_entry_t));
+        minfs_dir_index_node_t* node = &root->leaves[root->leaf_count];
+        node->hash = (root->leaf_count == 0) ? 0 : entries[start].hash;
+        node->block = root->leaf_count + 1;
+        root->leaf_count++;
+        if ((status = DirIndexWriteLeaf(wb, node->block, &leaf)) != ZX_OK) {
+            DirIndexDrop(wb->txn());
+            return status;
+        }
+        start = end;
+    } while (start < entries.size());
+
+    dir_index_root_ = fbl::move(root);
+    if ((status = dir_index_->WriteExactInternal(wb->txn(), dir_index_root_.get(),
+                                                 sizeof(minfs_dir_index_root_t), 0)) != ZX_OK) {
+        DirIndexDrop(wb->txn());
+        return status;
+    }
+    InodeSync(wb->txn(), kMxFsSyncDefault);
+    return ZX_OK;
+}
+
+void VnodeMinfs::DirIndexDrop(WriteTxn* txn) {
+    if (inode_.dir_index == 0) {
+        return;
+    }
+    if (dir_index_ != nullptr || fs_->VnodeGet(&dir_index_, inode_.dir_index) == ZX_OK) {
+        // Only free an inode which could be this directory's index.
+        if (!dir_index_->IsDirectory() && dir_index_->inode_.link_count == 1) {
+            dir_index_->RemoveInodeLink(txn);
+        }
+    }
+    dir_index_.reset();
+    dir_index_root_.reset();
+    inode_.dir_index = 0;
+    InodeSync(txn, kMxFsSyncDefault);
 }
 
-// Given a (name, inode, type) combination:
-//   - If no corresponding 'name' is found, ZX_ERR_NOT_FOUND is returned
-//   - If the 'name' corresponds to a vnode, check that the target vnode:
-//      - Does not have the same inode as the argument inode
-//      - Is the same type as the argument 'type'
-//      - Is unlinkable
-//   - If the previous checks pass, then:
-//      - Remove the old vnode (decrement link count by one)
-//      - Replace the old vnode's position in the directory with the new inode
-zx_status_t VnodeMinfs::DirentCallbackAttemptRename(fbl::RefPtr<VnodeMinfs> vndir,
-                                                    minfs_dirent_t* de, DirArgs* args,
-                                                    DirectoryOffset* offs) {
-    if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
-        return do_next_dirent(de, offs);
+size_t VnodeMinfs::DirIndexFindLeaf(uint32_t hash) const {
+    // The first leaf starts at hash 0, so every hash has a leaf.
+    size_t lo = 1;
+    size_t hi = dir_index_root_->leaf_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (dir_index_root_->leaves[mid].hash <= hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
+    return lo - 1;
+}
 
-    fbl::RefPtr<VnodeMinfs> vn;
+zx_status_t VnodeMinfs::DirIndexReadLeaf(blk_t block, minfs_dir_index_leaf_t* leaf) {
     zx_status_t status;
-    if ((status = vndir->fs_->VnodeGet(&vn, de->ino)) < 0) {
-        return status;
-    } else if (args->ino == vn->ino_) {
-        // cannot rename node to itself
-        return ZX_ERR_BAD_STATE;
-    } else if (args->type != de->type) {
-        // cannot rename directory to file (or vice versa)
-        return ZX_ERR_BAD_STATE;
-    } else if ((status = vn->CanUnlink()) != ZX_OK) {
-        // if we cannot unlink the target, we cannot rename the target
+    if ((status = dir_index_->ReadExactInternal(leaf, sizeof(*leaf),
+                                                block * kMinfsBlockSize)) != ZX_OK) {
         return status;
+    } else if (leaf->count > kMinfsDirIndexEntriesPerLeaf) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
     }
+    return ZX_OK;
+}
 
-    // If we are renaming ON TOP of a directory, then we can skip
-    // updating the parent link count -- the old directory had a ".." entry to
-    // the parent (link count of 1), but the new directory will ALSO have a ".."
-    // entry, making the rename operation idempotent w.r.t. the parent link
-    // count.
-    vn->RemoveInodeLink(args->wb->txn());
-
-    de->ino = args->ino;
-    status = vndir->WriteExactInternal(args->wb->txn(), de, DirentSize(de->namelen), offs->off);
-    if (status != ZX_OK) {
+zx_status_t VnodeMinfs::DirIndexWriteLeaf(WritebackWork* wb, blk_t block,
+                                          const minfs_dir_index_leaf_t* leaf) {
+    zx_status_t status;
+    if ((status = dir_index_->WriteExactInternal(wb->txn(), leaf, sizeof(*leaf),
+                                                 block * kMinfsBlockSize)) != ZX_OK) {
         return status;
     }
+    wb->PinVnode(dir_index_);
+    return ZX_OK;
+}
 
-    args->wb->PinVnode(vn);
-    args->wb->PinVnode(vndir);
-    return DIR_CB_SAVE_SYNC;
+void VnodeMinfs::DirIndexInsert(WritebackWork* wb, fbl::StringPiece name, size_t off) {
+    zx_status_t status = DirIndexLoad();
+    if (status == ZX_OK) {
+        minfs_dir_index_entry_t entry = {
+            .hash = MinfsDirIndexHash(name.data(), name.length()),
+            .off = static_cast<uint32_t>(off),
+        };
+        status = DirIndexInsertEntry(wb, entry);
+    }
+    if (status != ZX_OK && status != ZX_ERR_NOT_FOUND) {
+        FS_TRACE_WARN("minfs: dropping index of directory %u: %d\n", ino_, status);
+        DirIndexDrop(wb->txn());
+    }
 }
 
-zx_status_t VnodeMinfs::DirentCallbackUpdateInode(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
-                                                  DirArgs* args, DirectoryOffset* offs) {
-    if ((de->ino == 0) || fbl::StringPiece(de->name, de->namelen) != args->name) {
-        return do_next_dirent(de, offs);
+void VnodeMinfs::DirIndexRemove(WritebackWork* wb, fbl::StringPiece name, size_t off) {
+    zx_status_t status = DirIndexLoad();
+    if (status == ZX_OK) {
+        minfs_dir_index_entry_t entry = {
+            .hash = MinfsDirIndexHash(name.data(), name.length()),
+            .off = static_cast<uint32_t>(off),
+        };
+        status = DirIndexRemoveEntry(wb, entry);
     }
+    if (status != ZX_OK && status != ZX_ERR_NOT_FOUND) {
+        FS_TRACE_WARN("minfs: dropping index of directory %u: %d\n", ino_, status);
+        DirIndexDrop(wb->txn());
+    }
+}
 
-    de->ino = args->ino;
-    zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de,
-                                                   DirentSize(de->namelen),
-                                                   offs->off);
-    if (status != ZX_OK) {
+zx_status_t VnodeMinfs::DirIndexInsertEntry(WritebackWork* wb, minfs_dir_index_entry_t entry) {
+    minfs_dir_index_root_t* root = dir_index_root_.get();
+    const size_t index = DirIndexFindLeaf(entry.hash);
+    minfs_dir_index_leaf_t leaf;
+    zx_status_t status;
+    if ((status = DirIndexReadLeaf(root->leaves[index].block, &leaf)) != ZX_OK) {
         return status;
     }
-    args->wb->PinVnode(vndir);
-    return DIR_CB_SAVE_SYNC;
-}
 
-zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de,
-                                             DirArgs* args, DirectoryOffset* offs) {
-    auto add_dirent = [](fbl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t* de, DirArgs* args,
-                         size_t off) {
-        de->ino = args->ino;
-        de->type = static_cast<uint8_t>(args->type);
-        de->namelen = static_cast<uint8_t>(args->name.length());
-        memcpy(de->name, args->name.data(), de->namelen);
-        zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de, DirentSize(de->namelen),
-                                                       off);
-        if (status != ZX_OK) {
-            return status;
+    if (leaf.count == kMinfsDirIndexEntriesPerLeaf) {
+        // Split the full leaf between the entries of different hashes nearest its middle,
+        // moving the upper half to a new leaf at the end of the index.
+        if (root->leaf_count == kMinfsDirIndexMaxLeaves) {
+            return ZX_ERR_NO_SPACE;
         }
-        vndir->inode_.dirent_count++;
-        if (args->type == kMinfsTypeDir) {
-            // Child directory has '..' which will point to parent directory
-            vndir->inode_.link_count++;
+        const uint32_t mid = leaf.count / 2;
+        uint32_t split = 0;
+        for (uint32_t d = 0; d < mid && split == 0; d++) {
+            if (leaf.entries[mid + d].hash != leaf.entries[mid + d - 1].hash) {
+                split = mid + d;
+            } else if (leaf.entries[mid - d].hash != leaf.entries[mid - d - 1].hash) {
+                split = mid - d;
+            }
         }
-        args->wb->PinVnode(fbl::move(vndir));
-        return DIR_CB_SAVE_SYNC;
-    };
-
-    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, offs->off));
-    if (de->ino == 0) {
-        // empty entry, do we fit?
-        if (args->reclen > reclen) {
-            return do_next_dirent(de, offs);
+        if (split == 0) {
+            return ZX_ERR_NO_SPACE;
         }
-        return add_dirent(fbl::move(vndir), de, args, offs->off);
-    } else {
-        // filled entry, can we sub-divide?
-        uint32_t size = static_cast<uint32_t>(DirentSize(de->namelen));
-        if (size > reclen) {
-            FS_TRACE_ERROR("bad reclen (smaller than dirent) %u < %u\n", reclen, size);
-            return ZX_ERR_IO;
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<minfs_dir_index_leaf_t> upper(new (&ac) minfs_dir_index_leaf_t());
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
         }
-        uint32_t extra = reclen - size;
-        if (extra < args->reclen) {
-            return do_next_dirent(de, offs);
+        upper->count = leaf.count - split;
+        memcpy(upper->entries, &leaf.entries[split],
+               upper->count * sizeof(minfs_dir_index_entry_t));
+        memset(&leaf.entries[split], 0, upper->count * sizeof(minfs_dir_index_entry_t));
+        leaf.count = split;
+
+        memmove(&root->leaves[index + 2], &root->leaves[index + 1],
+                (root->leaf_count - index - 1) * sizeof(minfs_dir_index_node_t));
+        minfs_dir_index_node_t* node = &root->leaves[index + 1];
+        node->hash = upper->entries[0].hash;
+        node->block = root->leaf_count + 1;
+        root->leaf_count++;
+
+        if (entry.hash >= node->hash) {
+            dir_index_leaf_insert(upper.get(), entry);
+        } else {
+            dir_index_leaf_insert(&leaf, entry);
         }
-        // shrink existing entry
-        bool was_last_record = de->reclen & kMinfsReclenLast;
-        de->reclen = size;
-        zx_status_t status = vndir->WriteExactInternal(args->wb->txn(), de,
-                                                       DirentSize(de->namelen),
-                                                       offs->off);
-        if (status != ZX_OK) {
+        if ((status = DirIndexWriteLeaf(wb, node->block, upper.get())) != ZX_OK) {
             return status;
         }
-        offs->off += size;
-        // create new entry in the remaining space
-        char data[kMinfsMaxDirentSize];
-        de = (minfs_dirent_t*) data;
-        de->reclen = extra | (was_last_record ? kMinfsReclenLast : 0);
-        return add_dirent(fbl::move(vndir), de, args, offs->off);
+    } else {
+        dir_index_leaf_insert(&leaf, entry);
+    }
+
+    if ((status = DirIndexWriteLeaf(wb, root->leaves[index].block, &leaf)) != ZX_OK) {
+        return status;
     }
+    root->entry_count++;
+    return ZX_OK;
 }
 
-// Calls a callback 'func' on all direntries in a directory 'vn' with the
-// provided arguments, reacting to the return code of the callback.
-//
-// When 'func' is called, it receives a few arguments:
-//  'vndir': The directory on which the callback is operating
-//  'de': A pointer the start of a single dirent.
-//        Only DirentSize(de->namelen) bytes are guaranteed to exist in
-//        memory from this starting pointer.
-//  'args': Additional arguments plumbed through ForEachDirent
-//  'offs': Offset info about where in the directory this direntry is located.
-//          Since 'func' may create / remove surrounding dirents, it is responsible for
-//          updating the offset information to access the next dirent.
-zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func) {
-    char data[kMinfsMaxDirentSize];
-    minfs_dirent_t* de = (minfs_dirent_t*) data;
-    DirectoryOffset offs = {
-        .off = 0,
-        .off_prev = 0,
-    };
-    while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
-        xprintf("Reading dirent at offset %zd\n", offs.off);
-        size_t r;
-        zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r);
-        if (status != ZX_OK) {
-            return status;
-        } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
+zx_status_t VnodeMinfs::DirIndexRemoveEntry(WritebackWork* wb, minfs_dir_index_entry_t entry) {
+    const blk_t block = dir_index_root_->leaves[DirIndexFindLeaf(entry.hash)].block;
+    minfs_dir_index_leaf_t leaf;
+    zx_status_t status;
+    if ((status = DirIndexReadLeaf(block, &leaf)) != ZX_OK) {
+        return status;
+    }
+
+    for (uint32_t i = dir_index_lower_bound(&leaf, entry.hash);
+         i < leaf.count && leaf.entries[i].hash == entry.hash; i++) {
+        if (leaf.entries[i].off != entry.off) {
+            continue;
+        }
+        leaf.count--;
+        memmove(&leaf.entries[i], &leaf.entries[i + 1],
+                (leaf.count - i) * sizeof(minfs_dir_index_entry_t));
+        memset(&leaf.entries[leaf.count], 0, sizeof(minfs_dir_index_entry_t));
+        if ((status = DirIndexWriteLeaf(wb, block, &leaf)) != ZX_OK) {
             return status;
         }
+        dir_index_root_->entry_count--;
+        return ZX_OK;
+    }
 
-        switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
-        case DIR_CB_NEXT:
-            break;
-        case DIR_CB_SAVE_SYNC:
-            inode_.seq_num++;
-            InodeSync(args->wb->txn(), kMxFsSyncMtime);
-            args->wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
-            return ZX_OK;
-        case DIR_CB_DONE:
-        default:
-            return status;
+    // The dirent was never indexed.
+    return ZX_ERR_IO_DATA_INTEGRITY;
+}
+
+void VnodeMinfs::DirIndexSetTail(size_t off) {
+    if (dir_index_root_ != nullptr) {
+        dir_index_root_->tail = static_cast<uint32_t>(off);
+    }
+}
+
+void VnodeMinfs::DirIndexSync(WritebackWork* wb) {
+    zx_status_t status = DirIndexLoad();
+    if (status == ZX_OK) {
+        dir_index_root_->seq_num = inode_.seq_num;
+        if ((status = dir_index_->WriteExactInternal(wb->txn(), dir_index_root_.get(),
+                                                     sizeof(minfs_dir_index_root_t),
+                                                     0)) == ZX_OK) {
+            wb->PinVnode(dir_index_);
         }
     }
-    return ZX_ERR_NOT_FOUND;
+    if (status != ZX_OK && status != ZX_ERR_NOT_FOUND) {
+        FS_TRACE_WARN("minfs: dropping index of directory %u: %d\n", ino_, status);
+        DirIndexDrop(wb->txn());
+    }
 }
 
 void VnodeMinfs::fbl_recycle() {
@@ -1086,6 +2041,9 @@ void VnodeMinfs::fbl_recycle() {
 
 VnodeMinfs::~VnodeMinfs() {
 #ifdef __Fuchsia__
+    // Release the space held for any data which could not be written back.
+    fs_->BlockUnreserve(vmo_reserved_);
+
     // Detach the vmoids from the underlying block device,
     // so the underlying VMO may be released.
     size_t request_count = 0;
@@ -1128,16 +2086,16 @@ zx_status_t VnodeMinfs::Open(uint32_t flags, fbl::RefPtr<Vnode>* out_redirect) {
 void VnodeMinfs::Purge(WriteTxn* txn) {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
     ZX_DEBUG_ASSERT(IsUnlinked());
+    DirIndexDrop(txn);
 #ifdef __Fuchsia__
+    // Data which was never written back needs no blocks.
+    DiscardDirtyBlocks(0);
     {
         fbl::AutoLock lock(&fs_->hash_lock_);
         fs_->VnodeReleaseLocked(this);
     }
-    // TODO(smklein): Only init indirect vmo if it's needed
-    if (InitIndirectVmo() == ZX_OK) {
-        fs_->InoFree(this, txn);
-    } else {
-        fprintf(stderr, "minfs: Failed to Init Indirect VMO while purging %u\n", ino_);
+    if (fs_->InoFree(this, txn) != ZX_OK) {
+        fprintf(stderr, "minfs: Failed to read indirect blocks while purging %u\n", ino_);
     }
 #else
     fs_->VnodeReleaseLocked(this);
@@ -1154,6 +2112,13 @@ zx_status_t VnodeMinfs::Close() {
         Purge(wb->txn());
         fs_->EnqueueWork(fbl::move(wb));
     }
+#ifdef __Fuchsia__
+    if (fd_count_ == 0) {
+        // Once the file is no longer open, its data is written back. An unlinked file has
+        // had its dirty blocks discarded by Purge.
+        return FlushDirtyBlocks();
+    }
+#endif
     return ZX_OK;
 }
 
@@ -1184,8 +2149,16 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 
     zx_status_t status;
 #ifdef __Fuchsia__
+    const blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    const blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) /
+                                         kMinfsBlockSize);
+    const uint32_t readahead = readahead_.Update(off, len);
+    TRACE_COUNTER("minfs", "readahead", ino_, "window", readahead,
+                  "sequential_reads", readahead_.sequential_reads());
     if ((status = InitVmo()) != ZX_OK) {
         return status;
+    } else if ((status = LoadVmoBlocks(start, end + readahead)) != ZX_OK) {
+        return status;
     } else if ((status = vmo_.read(data, off, len, actual)) != ZX_OK) {
         return status;
     }
@@ -1241,7 +2214,21 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
-    zx_status_t status = WriteInternal(wb->txn(), data, len, offset, out_actual);
+    zx_status_t status;
+#ifdef __Fuchsia__
+    if (UsesExtents()) {
+        status = WriteDelayed(data, len, offset, out_actual);
+        if (status == ZX_ERR_NO_SPACE && (status = FlushDirtyBlocks()) == ZX_OK) {
+            // There is not enough space to reserve for the whole write, so it is made a
+            // block at a time, to fill what space remains.
+            status = WriteInternal(wb->txn(), data, len, offset, out_actual);
+        }
+    } else {
+        status = WriteInternal(wb->txn(), data, len, offset, out_actual);
+    }
+#else
+    status = WriteInternal(wb->txn(), data, len, offset, out_actual);
+#endif
     if (status != ZX_OK) {
         return status;
     }
@@ -1250,6 +2237,12 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
         wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
         fs_->EnqueueWork(fbl::move(wb));
     }
+#ifdef __Fuchsia__
+    if (DirtyBlockCount() >= kMinfsDirtyBlocksMax &&
+        (status = FlushDirtyBlocks()) != ZX_OK) {
+        return status;
+    }
+#endif
     return ZX_OK;
 }
 
@@ -1260,6 +2253,69 @@ zx_status_t VnodeMinfs::Append(const void* data, size_t len, size_t* out_end,
     return status;
 }
 
+#ifdef __Fuchsia__
+zx_status_t VnodeMinfs::WriteDelayed(const void* data, size_t len, size_t off,
+                                     size_t* actual) {
+    if (len == 0) {
+        *actual = 0;
+        return ZX_OK;
+    } else if (off >= kMinfsMaxFileSize) {
+        return ZX_ERR_FILE_BIG;
+    }
+    len = fbl::min<size_t>(len, kMinfsMaxFileSize - off);
+
+    zx_status_t status;
+    if ((status = InitVmo()) != ZX_OK) {
+        return status;
+    } else if ((status = LoadExtents()) != ZX_OK) {
+        return status;
+    }
+
+    // Space is reserved for each block which is neither on disk nor already dirty.
+    const blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    const blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) /
+                                         kMinfsBlockSize);
+    blk_t reserve = 0;
+    for (blk_t n = start; n < end;) {
+        blk_t bno;
+        const blk_t run = ExtentRun(n, end, &bno);
+        for (blk_t b = n; bno == 0 && b < n + run; b++) {
+            if (!vmo_dirty_.Get(b, b + 1)) {
+                reserve++;
+            }
+        }
+        n += run;
+    }
+    if ((status = fs_->BlockReserve(reserve)) != ZX_OK) {
+        return status;
+    }
+
+    if (off + len > inode_.size &&
+        (status = vmo_.set_size(end * kMinfsBlockSize)) != ZX_OK) {
+        fs_->BlockUnreserve(reserve);
+        return status;
+    }
+    // A partial block must merge with what is already on disk.
+    if ((off % kMinfsBlockSize != 0 && (status = LoadVmoBlocks(start, start + 1)) != ZX_OK) ||
+        ((off + len) % kMinfsBlockSize != 0 &&
+         (status = LoadVmoBlocks(end - 1, end)) != ZX_OK) ||
+        (status = VmoWriteExact(data, off, len)) != ZX_OK ||
+        (status = vmo_loaded_.Set(start, end)) != ZX_OK ||
+        (status = vmo_dirty_.Set(start, end)) != ZX_OK) {
+        fs_->BlockUnreserve(reserve);
+        return status;
+    }
+    vmo_reserved_ += reserve;
+
+    if (off + len > inode_.size) {
+        inode_.size = static_cast<uint32_t>(off + len);
+    }
+    *actual = len;
+    ValidateVmoTail();
+    return ZX_OK;
+}
+#endif
+
 // Internal write. Usable on directories.
 zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
                                       size_t len, size_t off, size_t* actual) {
@@ -1298,6 +2354,15 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
             }
         }
 
+        // A partial write must merge with what is already on disk. Either way, the block
+        // is loaded once it has been written.
+        if (xfer != kMinfsBlockSize && (status = LoadVmoBlocks(n, n + 1)) != ZX_OK) {
+            goto done;
+        }
+        if ((status = vmo_loaded_.Set(n, n + 1)) != ZX_OK) {
+            goto done;
+        }
+
         // Update this block of the in-memory VMO
         if ((status = VmoWriteExact(data, xfer_off, xfer)) != ZX_OK) {
             goto done;
@@ -1309,7 +2374,7 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
             goto done;
         }
         ZX_DEBUG_ASSERT(bno != 0);
-        txn->Enqueue(vmo_.get(), n, bno + fs_->info_.dat_block, 1);
+        EnqueueVmoBlocks(txn, n, bno, 1);
 #else
         blk_t bno;
         if ((status = GetBno(txn, n, &bno)) != ZX_OK) {
@@ -1371,7 +2436,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -1530,6 +2595,8 @@ zx_status_t VnodeMinfs::Allocate(Minfs* fs, uint32_t type, fbl::RefPtr<VnodeMinf
     (*out)->inode_.magic = MinfsMagic(type);
     (*out)->inode_.create_time = (*out)->inode_.modify_time = minfs_gettime_utc();
     (*out)->inode_.link_count = (type == kMinfsTypeDir ? 2 : 1);
+    (*out)->inode_.flags = kMinfsInodeFlagExtents;
+    (*out)->extents_loaded_ = true;
     return ZX_OK;
 }
 
@@ -1542,6 +2609,9 @@ zx_status_t VnodeMinfs::Recreate(Minfs* fs, ino_t ino, const minfs_inode_t* inod
     }
     memcpy(&(*out)->inode_, inode, kMinfsInodeSize);
     (*out)->ino_ = ino;
+#ifdef __Fuchsia__
+    (*out)->size_synced_ = inode->size;
+#endif
     return ZX_OK;
 }
 
@@ -1560,7 +2630,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -1596,7 +2666,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -1628,7 +2698,9 @@ zx_status_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, vo
             info->fs_id = fs_->GetFsId();
 #endif
             info->total_bytes = fs_->info_.block_count * fs_->info_.block_size;
-            info->used_bytes = fs_->info_.alloc_block_count * fs_->info_.block_size;
+            // Space reserved for data not yet written back is counted as used.
+            info->used_bytes = (fs_->info_.alloc_block_count + fs_->ReservedBlockCount()) *
+                               fs_->info_.block_size;
             info->total_nodes = fs_->info_.inode_count;
             info->used_nodes = fs_->info_.alloc_inode_count;
             memcpy(info->name, kFsName, strlen(kFsName));
@@ -1667,6 +2739,20 @@ zx_status_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, vo
             }
             return len > 0 ? ZX_OK : static_cast<zx_status_t>(len);
         }
+        case IOCTL_VFS_GET_EXTENT_COUNT: {
+            if (out_len < sizeof(uint32_t)) {
+                return ZX_ERR_INVALID_ARGS;
+            } else if (!UsesExtents()) {
+                return ZX_ERR_NOT_SUPPORTED;
+            }
+            zx_status_t status;
+            if ((status = LoadExtents()) != ZX_OK) {
+                return status;
+            }
+            *static_cast<uint32_t*>(out_buf) = static_cast<uint32_t>(extents_.size());
+            *out_actual = sizeof(uint32_t);
+            return ZX_OK;
+        }
 #endif
         default: {
             return ZX_ERR_NOT_SUPPORTED;
@@ -1690,7 +2776,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.wb = wb.get();
-    zx_status_t status = ForEachDirent(&args, DirentCallbackUnlink);
+    zx_status_t status = FindDirent(&args, DirentCallbackUnlink);
     if (status == ZX_OK) {
         wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
         fs_->EnqueueWork(fbl::move(wb));
@@ -1704,6 +2790,23 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
         return ZX_ERR_NOT_FILE;
     }
 
+#ifdef __Fuchsia__
+    if (len < inode_.size && HasDirtyBlocks()) {
+        // Dirty blocks past the new end of the file are never written back. If the new last
+        // block is dirty, it is written back first, so that it has a block on disk in which
+        // its tail can be zeroed.
+        const blk_t end = static_cast<blk_t>(fbl::round_up(len, kMinfsBlockSize) /
+                                             kMinfsBlockSize);
+        zx_status_t status;
+        if ((status = DiscardDirtyBlocks(end)) != ZX_OK) {
+            return status;
+        } else if (len % kMinfsBlockSize != 0 && vmo_dirty_.Get(end - 1, end) &&
+                   (status = FlushDirtyBlocks()) != ZX_OK) {
+            return status;
+        }
+    }
+#endif
+
     fbl::AllocChecker ac;
     fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
     if (!ac.check()) {
@@ -1722,11 +2825,11 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
 zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     zx_status_t r = 0;
 #ifdef __Fuchsia__
-    // TODO(smklein): We should only init up to 'len'; no need
-    // to read in the portion of a large file we plan on deleting.
     if (InitVmo() != ZX_OK) {
         return ZX_ERR_IO;
     }
+    const size_t old_blocks = fbl::round_up(inode_.size, kMinfsBlockSize) / kMinfsBlockSize;
+    const size_t new_blocks = fbl::round_up(len, kMinfsBlockSize) / kMinfsBlockSize;
 #endif
 
     if (len < inode_.size) {
@@ -1742,6 +2845,14 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
                 return r;
             }
 
+            if (start_bno == 0 && !UsesExtents() && inode_.block_count == 0) {
+                // Nothing is left of the block map of an inode from an older version of
+                // minfs, so the file is mapped by extents from here on.
+                inode_.flags |= kMinfsInodeFlagExtents;
+                memset(MinfsExtentMap(&inode_), 0, sizeof(minfs_extent_map_t));
+                extents_loaded_ = true;
+            }
+
             if (start_bno * kMinfsBlockSize < inode_.size) {
                 inode_.size = start_bno * kMinfsBlockSize;
             }
@@ -1757,6 +2868,9 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
+                if ((r = LoadVmoBlocks(rel_bno, rel_bno + 1)) != ZX_OK) {
+                    return r;
+                }
                 if ((r = VmoReadExact(bdata, len - adjust, adjust)) != ZX_OK) {
                     return ZX_ERR_IO;
                 }
@@ -1765,7 +2879,7 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
                 if ((r = VmoWriteExact(bdata, len - adjust, kMinfsBlockSize)) != ZX_OK) {
                     return ZX_ERR_IO;
                 }
-                txn->Enqueue(vmo_.get(), rel_bno, bno + fs_->info_.dat_block, 1);
+                EnqueueVmoBlocks(txn, rel_bno, bno, 1);
 #else
                 if (fs_->bc_->Readblk(bno + fs_->info_.dat_block, bdata)) {
                     return ZX_ERR_IO;
@@ -1788,7 +2902,10 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
 
     inode_.size = static_cast<uint32_t>(len);
 #ifdef __Fuchsia__
-    if ((r = vmo_.set_size(fbl::round_up(len, kMinfsBlockSize))) != ZX_OK) {
+    if ((r = vmo_.set_size(new_blocks * kMinfsBlockSize)) != ZX_OK) {
+        return r;
+    }
+    if (new_blocks < old_blocks && (r = vmo_loaded_.Clear(new_blocks, old_blocks)) != ZX_OK) {
         return r;
     }
 #endif
@@ -1833,7 +2950,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1857,11 +2974,11 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     args.name = newname;
     args.ino = oldvn->ino_;
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
-    status = newdir->ForEachDirent(&args, DirentCallbackAttemptRename);
+    status = newdir->FindDirent(&args, DirentCallbackAttemptRename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
-        if ((status = newdir->ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+        if ((status = newdir->AppendDirent(&args)) < 0) {
             return status;
         }
     } else if (status != ZX_OK) {
@@ -1878,7 +2995,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
+        if ((status = vn->FindDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
     }
@@ -1889,7 +3006,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    status = ForEachDirent(&args, DirentCallbackForceUnlink);
+    status = FindDirent(&args, DirentCallbackForceUnlink);
     wb->PinVnode(oldvn);
     wb->PinVnode(newdir);
     fs_->EnqueueWork(fbl::move(wb));
@@ -1916,7 +3033,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -1929,7 +3046,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
 
 #ifdef __Fuchsia__
 #include <fbl/auto_lock.h>
@@ -27,11 +29,11 @@ namespace minfs {
 
 #ifdef __Fuchsia__
 
-void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
-                       uint64_t nblocks) {
+void WriteTxn::EnqueueRequest(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                              uint64_t nblocks, bool data) {
     validate_vmo_size(vmo, static_cast<blk_t>(vmo_offset));
     for (size_t i = 0; i < count_; i++) {
-        if (requests_[i].vmo != vmo) {
+        if (requests_[i].vmo != vmo || requests_[i].data != data) {
             continue;
         }
 
@@ -55,6 +57,7 @@ void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset
     requests_[count_].vmo_offset = vmo_offset;
     requests_[count_].dev_offset = dev_offset;
     requests_[count_].length = nblocks;
+    requests_[count_].data = data;
     count_++;
 
     // "-1" so we can split a txn into two if we need to wrap around the log.
@@ -117,10 +120,7 @@ void WritebackWork::Reset() {
 // consumed
 size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
     size_t blk_count = txn_.BlkCount();
-    zx_status_t status = txn_.Flush(vmo, vmoid);
-    if (closure_) {
-        closure_(status);
-    }
+    SignalClosure(txn_.Flush(vmo, vmoid));
     Reset();
     return blk_count;
 }
@@ -129,6 +129,13 @@ void WritebackWork::SetClosure(SyncCallback closure) {
     ZX_DEBUG_ASSERT(!closure_);
     closure_ = fbl::move(closure);
 }
+
+void WritebackWork::SignalClosure(zx_status_t status) {
+    if (closure_) {
+        closure_(status);
+        closure_ = nullptr;
+    }
+}
 #else
 void WritebackWork::Complete() {
     txn_.Flush();
@@ -151,11 +158,346 @@ void WritebackWork::PinVnode(fbl::RefPtr<VnodeMinfs> vn) {
 
 #ifdef __Fuchsia__
 
+zx_status_t Journal::Create(Bcache* bc, const minfs_info_t* info,
+                            fbl::unique_ptr<Journal>* out) {
+    ZX_DEBUG_ASSERT(info->journal_blocks >= kMinfsJournalMinBlocks);
+    fbl::unique_ptr<MappedVmo> buffer;
+    zx_status_t status;
+    if ((status = MappedVmo::Create(info->journal_blocks * kMinfsBlockSize, "minfs-journal",
+                                    &buffer)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Journal> journal(new (&ac) Journal(bc, info->dat_block + info->journal_start,
+                                                       info->journal_blocks - 1,
+                                                       fbl::move(buffer)));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    journal->group_.reset(new (&ac) Update[journal->entry_max_], journal->entry_max_);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    journal->checkpoint_.reset(new (&ac) Update[journal->ring_], journal->ring_);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = bc->AttachVmo(journal->buffer_->GetVmo(), &journal->vmoid_)) != ZX_OK) {
+        return status;
+    }
+
+    // The journal has been replayed, so new entries follow the last.
+    minfs_journal_info_t* journal_info =
+        reinterpret_cast<minfs_journal_info_t*>(journal->buffer_->GetData());
+    if ((status = bc->Readblk(journal->start_, journal_info)) != ZX_OK) {
+        return status;
+    }
+    if (journal_info->magic != kMinfsJournalMagic || journal_info->start >= journal->ring_) {
+        FS_TRACE_ERROR("minfs: bad journal info\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    journal->head_ = journal_info->start;
+    journal->tail_ = journal_info->start;
+    journal->sequence_ = journal_info->sequence;
+
+    *out = fbl::move(journal);
+    return ZX_OK;
+}
+
+Journal::Journal(Bcache* bc, blk_t start, uint32_t ring, fbl::unique_ptr<MappedVmo> buffer) :
+    bc_(bc), start_(start), ring_(ring),
+    entry_max_(fbl::min(kMinfsJournalEntryMax, ring - 2)), buffer_(fbl::move(buffer)) {}
+
+Journal::~Journal() {
+    ZX_DEBUG_ASSERT(group_works_.is_empty());
+    ZX_DEBUG_ASSERT(checkpoint_works_.is_empty() || status_ != ZX_OK);
+    while (!checkpoint_works_.is_empty()) {
+        auto work = checkpoint_works_.pop();
+        work->Reset();
+    }
+    if (vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.txnid = bc_->TxnId();
+        request.vmoid = vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        bc_->Txn(&request, 1);
+    }
+}
+
+void Journal::Commit(WorkQueue* works, MappedVmo* buffer, vmoid_t vmoid) {
+    TRACE_DURATION("minfs", "Journal::Commit");
+    group_buffer_ = buffer;
+    while (!works->is_empty()) {
+        auto work = works->pop();
+        WriteTxn* txn = work->txn();
+        write_request_t* reqs = txn->Requests();
+
+        size_t metadata = 0;
+        bool overlaps = false;
+        for (size_t i = 0; i < txn->Count(); i++) {
+            if (!reqs[i].data) {
+                metadata += reqs[i].length;
+            } else if (Overlaps(reqs[i].dev_offset, reqs[i].length)) {
+                overlaps = true;
+            }
+        }
+
+        if (metadata > entry_max_ || overlaps) {
+            // Data written over a block which was metadata must follow it in place, or replay
+            // could overwrite the data. A transaction too large for any entry is written in
+            // place, as it would be without a journal, once everything before it is.
+            CommitGroup();
+            Checkpoint();
+        } else if (group_count_ + metadata > entry_max_) {
+            CommitGroup();
+        }
+
+        if (status_ != ZX_OK) {
+            // Nothing more is written once the journal has failed, so that the entries
+            // which were not written in place stay intact for replay.
+            txn->Clear();
+            work->SignalClosure(status_);
+            work->Reset();
+            continue;
+        } else if (metadata > entry_max_) {
+            work->Complete(buffer->GetVmo(), vmoid);
+            continue;
+        }
+
+        for (size_t i = 0; i < txn->Count(); i++) {
+            if (reqs[i].data) {
+                EnqueueWrite(vmoid, reqs[i].vmo_offset, reqs[i].dev_offset, reqs[i].length);
+                continue;
+            }
+            for (size_t b = 0; b < reqs[i].length; b++) {
+                Update* update = &group_[group_count_];
+                update->target = static_cast<blk_t>(reqs[i].dev_offset + b);
+                update->source = static_cast<uint32_t>(reqs[i].vmo_offset + b);
+                update->order = static_cast<uint32_t>(group_count_++);
+            }
+        }
+        txn->Clear();
+        group_works_.push(fbl::move(work));
+    }
+    CommitGroup();
+
+    // Leave room for the next group.
+    if (used_ > ring_ / 2) {
+        Checkpoint();
+    }
+}
+
+void Journal::CommitGroup() {
+    if (group_works_.is_empty()) {
+        return;
+    }
+
+    // File data goes to disk before the metadata which refers to it is committed.
+    zx_status_t status = FlushWrites();
+    const uint32_t count = static_cast<uint32_t>(Coalesce(group_.get(), group_count_));
+    group_count_ = 0;
+    if (status == ZX_OK && count > 0 && ring_ - used_ < count + 2) {
+        status = Checkpoint();
+    }
+    if (status == ZX_OK && count > 0) {
+        TRACE_DURATION("minfs", "Journal::CommitGroup", "blocks", count);
+        minfs_journal_header_t* header = reinterpret_cast<minfs_journal_header_t*>(
+            RingBlock(head_));
+        memset(header, 0, kMinfsBlockSize);
+        header->magic = kMinfsJournalHeaderMagic;
+        header->sequence = sequence_;
+        header->count = count;
+        for (uint32_t i = 0; i < count; i++) {
+            header->target[i] = group_[i].target;
+        }
+        uint32_t checksum = MinfsJournalChecksum(FNV32_OFFSET_BASIS, header, kMinfsBlockSize);
+        const uint8_t* source = static_cast<const uint8_t*>(group_buffer_->GetData());
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t* copy = RingBlock(head_ + 1 + i);
+            memcpy(copy, source + group_[i].source * kMinfsBlockSize, kMinfsBlockSize);
+            checksum = MinfsJournalChecksum(checksum, copy, kMinfsBlockSize);
+        }
+        minfs_journal_commit_t* commit = reinterpret_cast<minfs_journal_commit_t*>(
+            RingBlock(head_ + 1 + count));
+        memset(commit, 0, kMinfsBlockSize);
+        commit->magic = kMinfsJournalCommitMagic;
+        commit->sequence = sequence_;
+        commit->checksum = checksum;
+
+        // The entry is a single sequential write, split only where it wraps around the ring.
+        const uint32_t length = count + 2;
+        const uint32_t first = fbl::min(length, ring_ - head_);
+        EnqueueWrite(vmoid_, 1 + head_, start_ + 1 + head_, first);
+        if (first < length) {
+            EnqueueWrite(vmoid_, 1, start_ + 1, length - first);
+        }
+        if ((status = FlushWrites()) == ZX_OK) {
+            head_ = (head_ + length) % ring_;
+            used_ += length;
+            sequence_++;
+        }
+    }
+
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("minfs: failed to commit journal entry: %d\n", status);
+    }
+    while (!group_works_.is_empty()) {
+        auto work = group_works_.pop();
+        work->SignalClosure(status);
+        checkpoint_works_.push(fbl::move(work));
+    }
+}
+
+zx_status_t Journal::Checkpoint() {
+    if (status_ != ZX_OK) {
+        return status_;
+    }
+
+    zx_status_t status = ZX_OK;
+    if (used_ > 0) {
+        TRACE_DURATION("minfs", "Journal::Checkpoint", "blocks", used_);
+
+        // Where entries update the same block, only the last copy is written.
+        size_t count = 0;
+        uint32_t order = 0;
+        for (uint32_t offset = tail_; offset != head_;) {
+            const minfs_journal_header_t* header =
+                reinterpret_cast<const minfs_journal_header_t*>(RingBlock(offset));
+            for (uint32_t i = 0; i < header->count; i++) {
+                Update* update = &checkpoint_[count++];
+                update->target = header->target[i];
+                update->source = 1 + (offset + 1 + i) % ring_;
+                update->order = order++;
+            }
+            offset = (offset + header->count + 2) % ring_;
+        }
+        count = Coalesce(checkpoint_.get(), count);
+        for (size_t i = 0; i < count; i++) {
+            EnqueueWrite(vmoid_, checkpoint_[i].source, checkpoint_[i].target, 1);
+        }
+
+        // Once the blocks are in place, replay starts from the next entry.
+        if ((status = FlushWrites()) == ZX_OK) {
+            minfs_journal_info_t* info = reinterpret_cast<minfs_journal_info_t*>(
+                buffer_->GetData());
+            info->sequence = sequence_;
+            info->start = head_;
+            EnqueueWrite(vmoid_, 0, start_, 1);
+            status = FlushWrites();
+        }
+        if (status != ZX_OK) {
+            // Replay still needs every entry, so they are kept, along with the works which
+            // pin their Vnodes, and the journal commits nothing more.
+            FS_TRACE_ERROR("minfs: failed to checkpoint journal: %d\n", status);
+            status_ = status;
+            return status;
+        }
+        tail_ = head_;
+        used_ = 0;
+    }
+
+    while (!checkpoint_works_.is_empty()) {
+        auto work = checkpoint_works_.pop();
+        work->Reset();
+    }
+    return status;
+}
+
+int Journal::CompareUpdates(const void* a, const void* b) {
+    const Update* ua = static_cast<const Update*>(a);
+    const Update* ub = static_cast<const Update*>(b);
+    if (ua->target != ub->target) {
+        return ua->target < ub->target ? -1 : 1;
+    }
+    return ua->order < ub->order ? -1 : (ua->order > ub->order ? 1 : 0);
+}
+
+size_t Journal::Coalesce(Update* updates, size_t count) {
+    qsort(updates, count, sizeof(Update), CompareUpdates);
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i + 1 < count && updates[i + 1].target == updates[i].target) {
+            continue;
+        }
+        updates[kept++] = updates[i];
+    }
+    return kept;
+}
+
+bool Journal::Overlaps(size_t dev_offset, size_t length) const {
+    auto overlaps = [dev_offset, length](blk_t target) {
+        return dev_offset <= target && target < dev_offset + length;
+    };
+    for (size_t i = 0; i < group_count_; i++) {
+        if (overlaps(group_[i].target)) {
+            return true;
+        }
+    }
+    for (uint32_t offset = tail_; offset != head_;) {
+        const minfs_journal_header_t* header =
+            reinterpret_cast<const minfs_journal_header_t*>(RingBlock(offset));
+        for (uint32_t i = 0; i < header->count; i++) {
+            if (overlaps(header->target[i])) {
+                return true;
+            }
+        }
+        offset = (offset + header->count + 2) % ring_;
+    }
+    return false;
+}
+
+uint8_t* Journal::RingBlock(uint32_t offset) const {
+    return static_cast<uint8_t*>(buffer_->GetData()) + (1 + offset % ring_) * kMinfsBlockSize;
+}
+
+void Journal::EnqueueWrite(vmoid_t vmoid, size_t vmo_offset, size_t dev_offset,
+                           size_t length) {
+    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc_->BlockSize();
+    vmo_offset *= kDiskBlocksPerMinfsBlock;
+    dev_offset *= kDiskBlocksPerMinfsBlock;
+    length *= kDiskBlocksPerMinfsBlock;
+    if (write_count_ > 0) {
+        block_fifo_request_t* last = &writes_[write_count_ - 1];
+        if (last->vmoid == vmoid && last->vmo_offset + last->length == vmo_offset &&
+            last->dev_offset + last->length == dev_offset) {
+            last->length += static_cast<uint32_t>(length);
+            return;
+        }
+    }
+    if (write_count_ == fbl::count_of(writes_)) {
+        zx_status_t status = FlushWrites();
+        write_status_ = (write_status_ != ZX_OK) ? write_status_ : status;
+    }
+    block_fifo_request_t* request = &writes_[write_count_++];
+    request->txnid = bc_->TxnId();
+    request->vmoid = vmoid;
+    request->opcode = BLOCKIO_WRITE;
+    request->vmo_offset = vmo_offset;
+    request->dev_offset = dev_offset;
+    request->length = static_cast<uint32_t>(length);
+}
+
+zx_status_t Journal::FlushWrites() {
+    zx_status_t status = bc_->Txn(writes_, write_count_);
+    write_count_ = 0;
+    if (write_status_ != ZX_OK) {
+        status = write_status_;
+        write_status_ = ZX_OK;
+    }
+    return status;
+}
+
 zx_status_t WritebackBuffer::Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffer,
+                                    const minfs_info_t* info,
                                     fbl::unique_ptr<WritebackBuffer>* out) {
     fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(buffer)));
+    zx_status_t status;
     if (wb->buffer_->GetSize() % kMinfsBlockSize != 0) {
         return ZX_ERR_INVALID_ARGS;
+    } else if (info->journal_blocks > 0 &&
+               (status = Journal::Create(bc, info, &wb->journal_)) != ZX_OK) {
+        return status;
     } else if (cnd_init(&wb->consumer_cvar_) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
     } else if (cnd_init(&wb->producer_cvar_) != thrd_success) {
@@ -165,7 +507,7 @@ zx_status_t WritebackBuffer::Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffe
                                      "minfs-writeback") != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
     }
-    zx_status_t status = wb->bc_->AttachVmo(wb->buffer_->GetVmo(), &wb->buffer_vmoid_);
+    status = wb->bc_->AttachVmo(wb->buffer_->GetVmo(), &wb->buffer_vmoid_);
     if (status != ZX_OK) {
         return status;
     }
@@ -276,6 +618,7 @@ void WritebackBuffer::CopyToBufferLocked(WriteTxn* txn) {
             reqs[i].dev_offset = dev_offset;
             reqs[i].vmo_offset = 0;
             reqs[i].length = wb_len;
+            reqs[i].data = reqs[i - 1].data;
             txn->count_++;
         }
     }
@@ -320,6 +663,31 @@ int WritebackBuffer::WritebackThread(void* arg) {
 
     b->writeback_lock_.Acquire();
     while (true) {
+        if (!b->work_queue_.is_empty() && b->journal_ != nullptr) {
+            // Everything queued while the last group was written forms the next group.
+            Journal::WorkQueue group;
+            size_t blks_consumed = 0;
+            while (!b->work_queue_.is_empty()) {
+                auto work = b->work_queue_.pop();
+                TRACE_FLOW_END("minfs", "writeback",
+                               reinterpret_cast<trace_flow_id_t>(work.get()));
+                blks_consumed += work->txn()->BlkCount();
+                group.push(fbl::move(work));
+            }
+            TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
+
+            // Stay unlocked while committing the group
+            b->writeback_lock_.Release();
+            b->journal_->Commit(&group, b->buffer_.get(), b->buffer_vmoid_);
+
+            // The group has been copied into the journal, so its space may be reused.
+            b->writeback_lock_.Acquire();
+            b->start_ = (b->start_ + blks_consumed) % b->cap_;
+            b->len_ -= blks_consumed;
+            cnd_signal(&b->producer_cvar_);
+            continue;
+        }
+
         while (!b->work_queue_.is_empty()) {
             auto work = b->work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
@@ -344,9 +712,28 @@ int WritebackBuffer::WritebackThread(void* arg) {
         // Before waiting, we should check if we're unmounting.
         if (b->unmounting_) {
             b->writeback_lock_.Release();
+            if (b->journal_ != nullptr) {
+                b->journal_->Checkpoint();
+            }
             b->bc_->FreeTxnId();
             return 0;
         }
+
+        if (b->journal_ != nullptr && b->journal_->HasCommitted()) {
+            // Committed work is checkpointed once no more arrives for a while.
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += kMinfsCheckpointDelayMs * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            if (cnd_timedwait(&b->consumer_cvar_, b->writeback_lock_.GetInternal(),
+                              &deadline) == thrd_timedout && b->work_queue_.is_empty()) {
+                b->writeback_lock_.Release();
+                b->journal_->Checkpoint();
+                b->writeback_lock_.Acquire();
+            }
+            continue;
+        }
         cnd_wait(&b->consumer_cvar_, b->writeback_lock_.GetInternal());
     }
 }
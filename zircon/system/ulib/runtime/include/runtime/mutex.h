@@ -43,6 +43,17 @@ void zxr_mutex_unlock(zxr_mutex_t* mutex);
 // zxr_mutex_unlock() will wake that thread.
 void zxr_mutex_lock_with_waiter(zxr_mutex_t* mutex);
 
+// Priority inheritance variants of the functions above.  While locked, the
+// mutex holds the handle of the owning thread, so that the kernel can run
+// the owner with the priority of the highest priority waiter (see
+// zx_futex_wait_pi).  |self| is the calling thread's handle.  A mutex must
+// be used either only with these functions or only with the ones above.
+zx_status_t zxr_mutex_trylock_pi(zxr_mutex_t* mutex, zx_handle_t self);
+zx_status_t __zxr_mutex_timedlock_pi(zxr_mutex_t* mutex, zx_handle_t self,
+                                     zx_time_t abstime);
+void zxr_mutex_lock_pi(zxr_mutex_t* mutex, zx_handle_t self);
+void zxr_mutex_unlock_pi(zxr_mutex_t* mutex);
+
 #pragma GCC visibility pop
 
 __END_CDECLS
@@ -111,3 +111,74 @@ void zxr_mutex_unlock(zxr_mutex_t* mutex) {
             break;
     }
 }
+
+// In the priority inheritance variants, the futex holds UNLOCKED, or the
+// owner's thread handle, with ZX_FUTEX_PI_WAITERS set if there may be
+// waiters.  A thread that had to wait sets ZX_FUTEX_PI_WAITERS when it
+// claims the mutex, for the same reason as in lock_slow_path().
+
+zx_status_t zxr_mutex_trylock_pi(zxr_mutex_t* mutex, zx_handle_t self) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, (int)self)) {
+        return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t __zxr_mutex_timedlock_pi(zxr_mutex_t* mutex, zx_handle_t self,
+                                     zx_time_t abstime) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, (int)self)) {
+        return ZX_OK;
+    }
+
+    for (;;) {
+        if (old_state == UNLOCKED) {
+            if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                               (int)self | ZX_FUTEX_PI_WAITERS)) {
+                return ZX_OK;
+            }
+            continue;
+        }
+
+        // Record that there is a waiter, then wait while lending our
+        // priority to the owner.
+        int waiting_state = old_state | ZX_FUTEX_PI_WAITERS;
+        if (old_state == waiting_state ||
+            atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                           waiting_state)) {
+            zx_status_t status = _zx_futex_wait_pi(
+                    &mutex->futex, waiting_state, abstime);
+            switch (status) {
+            case ZX_OK:
+            case ZX_ERR_BAD_STATE:
+                break;
+            case ZX_ERR_TIMED_OUT:
+                return ZX_ERR_TIMED_OUT;
+            default:
+                // Either we already own the mutex, or it does not hold the
+                // handle of a live thread of this process.
+                __builtin_trap();
+            }
+        }
+        old_state = atomic_load(&mutex->futex);
+    }
+}
+
+void zxr_mutex_lock_pi(zxr_mutex_t* mutex, zx_handle_t self) {
+    zx_status_t status = __zxr_mutex_timedlock_pi(mutex, self, ZX_TIME_INFINITE);
+    if (status != ZX_OK)
+        __builtin_trap();
+}
+
+void zxr_mutex_unlock_pi(zxr_mutex_t* mutex) {
+    int old_state = atomic_exchange(&mutex->futex, UNLOCKED);
+    if (old_state == UNLOCKED)
+        __builtin_trap();
+    if (old_state & ZX_FUTEX_PI_WAITERS) {
+        // This also ends any priority we inherited from the waiters.
+        zx_status_t status = _zx_futex_wake_pi(&mutex->futex);
+        if (status != ZX_OK)
+            __builtin_trap();
+    }
+}
@@ -11,11 +11,17 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <blobstore/format.h>
+#include <blobstore/lz4.h>
 #include <digest/merkle-tree.h>
+#include <fdio/vfs.h>
+#include <fs-management/mount.h>
 #include <zircon/device/vfs.h>
 #include <zircon/device/rtc.h>
 #include <zircon/syscalls.h>
+#include <fbl/algorithm.h>
 #include <fbl/new.h>
+#include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <unittest/unittest.h>
@@ -65,7 +71,9 @@ static int GetStartTime() {
 
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size) {
+// If |compressible| is set, the data is made of short runs of repeated bytes.
+static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size,
+                         bool compressible = false) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
@@ -74,7 +82,11 @@ static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size) {
     EXPECT_EQ(ac.check(), true);
     unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
     for (size_t i = 0; i < blob_size; i++) {
-        info->data[i] = (char)rand_r(&seed);
+        if (compressible && i % 16 != 0) {
+            info->data[i] = info->data[i - 1];
+        } else {
+            info->data[i] = (char)rand_r(&seed);
+        }
     }
     info->size_data = blob_size;
 
@@ -468,6 +480,234 @@ static bool EndBlobstoreBenchmark() {
     return true;
 }
 
+// Finds the block device the benchmark partition is mounted from.
+static bool GetDevicePath(char* device_path, size_t len) {
+    int mountfd = open(MOUNT_PATH, O_RDONLY | O_ADMIN);
+    ASSERT_GT(mountfd, 0, "Failed to open mount point");
+    ssize_t r = ioctl_vfs_get_device_path(mountfd, device_path, len - 1);
+    ASSERT_EQ(close(mountfd), 0, "Failed to close mount point");
+    ASSERT_GT(r, 0, "Failed to find the benchmark's block device");
+    device_path[r] = '\0';
+    return true;
+}
+
+// Mounts the benchmark partition from |device_path| again, once it has been unmounted.
+static bool MountBenchmark(const char* device_path) {
+    int devfd = open(device_path, O_RDWR);
+    ASSERT_GT(devfd, 0, "Failed to open block device");
+    ASSERT_EQ(mount(devfd, MOUNT_PATH, DISK_FORMAT_BLOBFS, &default_mount_options,
+                    launch_stdio_async), ZX_OK, "Failed to remount blobstore");
+    return true;
+}
+
+// Rewrites the blob |info| on the unmounted blobstore at |device_path| the way the host
+// tool stores blobs with --compress, returning the blocks this frees to the allocator.
+static bool CompressBlobOnDisk(const char* device_path, const blob_info_t& info) {
+    constexpr size_t kBlockSize = blobstore::kBlobstoreBlockSize;
+    fbl::unique_fd fd(open(device_path, O_RDWR));
+    ASSERT_TRUE(fd, "Could not open block device");
+
+    uint8_t block[kBlockSize];
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    blobstore::blobstore_info_t super;
+    memcpy(&super, block, sizeof(super));
+
+    Digest digest;
+    const char* name = strrchr(info.path, '/') + 1;
+    ASSERT_EQ(digest.Parse(name, strlen(name)), ZX_OK);
+
+    uint8_t node_block[kBlockSize];
+    off_t node_off = -1;
+    blobstore::blobstore_inode_t* inode = nullptr;
+    for (uint64_t b = 0; b < blobstore::NodeMapBlocks(super) && inode == nullptr; b++) {
+        node_off = (blobstore::NodeMapStartBlock(super) + b) * kBlockSize;
+        ASSERT_EQ(pread(fd.get(), node_block, kBlockSize, node_off), (ssize_t)kBlockSize);
+        auto nodes = reinterpret_cast<blobstore::blobstore_inode_t*>(node_block);
+        for (size_t i = 0; i < blobstore::kBlobstoreInodesPerBlock; i++) {
+            if (nodes[i].start_block >= blobstore::kStartBlockMinimum &&
+                digest == nodes[i].merkle_root_hash) {
+                inode = &nodes[i];
+                break;
+            }
+        }
+    }
+    ASSERT_NONNULL(inode, "Could not find the blob's inode");
+
+    fbl::AllocChecker ac;
+    const size_t bound = fbl::round_up(blobstore::BlobCompressBound(info.size_data), kBlockSize);
+    fbl::unique_ptr<uint8_t[]> compressed(new (&ac) uint8_t[bound]());
+    ASSERT_TRUE(ac.check());
+    size_t compressed_size;
+    ASSERT_EQ(blobstore::BlobCompress(info.data.get(), info.size_data, compressed.get(),
+                                      &compressed_size), ZX_OK);
+
+    const uint64_t old_blocks = inode->num_blocks;
+    const uint64_t merkle_blocks = old_blocks - blobstore::BlobDataBlocks(*inode);
+    blobstore::BlobSetCompressedSize(inode, compressed_size);
+    ASSERT_LT(inode->num_blocks, old_blocks, "Blob did not compress");
+
+    const size_t data_len = (inode->num_blocks - merkle_blocks) * kBlockSize;
+    const off_t data_off = (blobstore::DataStartBlock(super) + inode->start_block +
+                            merkle_blocks) * kBlockSize;
+    ASSERT_EQ(pwrite(fd.get(), compressed.get(), data_len, data_off), (ssize_t)data_len);
+    ASSERT_EQ(pwrite(fd.get(), node_block, kBlockSize, node_off), (ssize_t)kBlockSize);
+
+    for (uint64_t n = inode->start_block + inode->num_blocks;
+         n < inode->start_block + old_blocks; n++) {
+        const off_t map_off = (blobstore::BlockMapStartBlock(super) +
+                               n / blobstore::kBlobstoreBlockBits) * kBlockSize;
+        ASSERT_EQ(pread(fd.get(), block, kBlockSize, map_off), (ssize_t)kBlockSize);
+        const size_t bit = n % blobstore::kBlobstoreBlockBits;
+        block[bit / 8] = static_cast<uint8_t>(block[bit / 8] & ~(1 << (bit % 8)));
+        ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, map_off), (ssize_t)kBlockSize);
+    }
+    super.alloc_block_count -= old_blocks - inode->num_blocks;
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    memcpy(block, &super, sizeof(super));
+    ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    return true;
+}
+
+// Writes blobs to the benchmark partition, stores them compressed as the host tool does
+// with --compress, and remounts it so that none of them are in memory. Each is then read
+// once, reporting the read throughput, the time blobstore spent decompressing, and the
+// space the blobs take on disk.
+template <size_t BlobSize, size_t BlobCount>
+static bool benchmark_blob_compressed() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, DEFAULT));
+
+    char device_path[PATH_MAX];
+    ASSERT_TRUE(GetDevicePath(device_path, sizeof(device_path)));
+
+    fbl::AllocChecker ac;
+    fbl::Vector<fbl::unique_ptr<blob_info_t>> blobs;
+    for (size_t i = 0; i < BlobCount; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(&info, BlobSize, true));
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        ASSERT_GT(fd, 0, "Failed to create blob");
+        ASSERT_EQ(ftruncate(fd, BlobSize), 0, "Failed to truncate blob");
+        ASSERT_EQ(StreamAll(write, fd, info->data.get(), BlobSize), 0, "Failed to write Data");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+        blobs.push_back(fbl::move(info), &ac);
+        ASSERT_TRUE(ac.check());
+    }
+
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Failed to unmount blobstore");
+    for (const auto& info : blobs) {
+        ASSERT_TRUE(CompressBlobOnDisk(device_path, *info));
+    }
+    ASSERT_TRUE(MountBenchmark(device_path));
+
+    fbl::unique_ptr<char[]> buf(new (&ac) char[BlobSize]);
+    ASSERT_TRUE(ac.check());
+    uint64_t disk_bytes = 0;
+    zx_time_t ticks = 0;
+    for (const auto& info : blobs) {
+        int fd = open(info->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        struct stat s;
+        ASSERT_EQ(fstat(fd, &s), 0, "Failed to stat blob");
+        disk_bytes += s.st_blocks * VNATTR_BLKSIZE;
+
+        zx_time_t start = zx_ticks_get();
+        ASSERT_EQ(StreamAll(read, fd, buf.get(), BlobSize), 0, "Failed to read data");
+        ticks += zx_ticks_get() - start;
+        ASSERT_EQ(memcmp(buf.get(), info->data.get(), BlobSize), 0, "Read bad data");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+    }
+
+    vfs_blobstore_metrics_t metrics;
+    int mountfd = open(MOUNT_PATH, O_RDONLY);
+    ASSERT_GT(mountfd, 0, "Failed to open mount point");
+    ssize_t r = ioctl_vfs_get_blobstore_metrics(mountfd, &metrics);
+    ASSERT_EQ(close(mountfd), 0, "Failed to close mount point");
+    ASSERT_EQ(r, (ssize_t)sizeof(metrics), "Failed to get blobstore metrics");
+    ASSERT_GE(metrics.chunks_decompressed, BlobCount, "Blobs were not decompressed");
+
+    const uint64_t blob_bytes = BlobSize * BlobCount;
+    double msec = static_cast<double>(ticks) * 1000.0 /
+                  static_cast<double>(zx_ticks_per_second());
+    double mb_per_sec = msec > 0 ? (static_cast<double>(blob_bytes) / MB) / (msec / 1000.0) : 0;
+    double decompress_msec = static_cast<double>(metrics.decompress_ns) / 1000000.0;
+    double saved = 1.0 - static_cast<double>(disk_bytes) / static_cast<double>(blob_bytes);
+    printf("\nBenchmark %10s: [%10lu] bytes read in [%8.2f] msec, [%8.2f] MB/sec, [%8.2f] msec decompressing [%lu] chunks - [%10lu] bytes on disk ([%5.2f] saved)",
+           "compressed", blob_bytes, msec, mb_per_sec, decompress_msec,
+           metrics.chunks_decompressed, disk_bytes, saved);
+
+    ASSERT_TRUE(EndBlobstoreBenchmark());
+    END_TEST;
+}
+
+// Fills the benchmark partition with small blobs, then reports how long remounting it
+// takes, and how long opening blobs by name takes once it is remounted, in random order.
+// Neither should grow with the number of blobs.
+template <size_t BlobCount>
+static bool benchmark_blob_lookup() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(64 * B, BlobCount, RANDOM));
+    char device_path[PATH_MAX];
+    ASSERT_TRUE(GetDevicePath(device_path, sizeof(device_path)));
+
+    // Only the names are kept, as the blobs are too many to keep whole.
+    constexpr size_t kNameLen = Digest::kLength * 2 + 1;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> names(new (&ac) char[BlobCount * kNameLen]);
+    ASSERT_TRUE(ac.check());
+    const size_t prefix_len = strlen(MOUNT_PATH "/");
+    for (size_t i = 0; i < BlobCount; i++) {
+        if (i % 10000 == 0) {
+            printf("\nCreating blob: %lu", i);
+        }
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(&info, 64 * B));
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        ASSERT_GT(fd, 0, "Failed to create blob");
+        ASSERT_EQ(ftruncate(fd, info->size_data), 0, "Failed to truncate blob");
+        ASSERT_EQ(StreamAll(write, fd, info->data.get(), info->size_data), 0,
+                  "Failed to write Data");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+        strcpy(&names[i * kNameLen], info->path + prefix_len);
+    }
+
+    zx_time_t start = zx_ticks_get();
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Failed to unmount blobstore");
+    ASSERT_TRUE(MountBenchmark(device_path));
+    zx_time_t remount_ticks = zx_ticks_get() - start;
+
+    fbl::unique_ptr<size_t[]> order(new (&ac) size_t[BlobCount]);
+    ASSERT_TRUE(ac.check());
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    for (size_t i = 0; i < BlobCount; i++) {
+        size_t j = rand_r(&seed) % (i + 1);
+        order[i] = order[j];
+        order[j] = i;
+    }
+    zx_time_t open_ticks = 0;
+    zx_time_t max_open_ticks = 0;
+    for (size_t i = 0; i < BlobCount; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), MOUNT_PATH "/%s", &names[order[i] * kNameLen]);
+        start = zx_ticks_get();
+        int fd = open(path, O_RDONLY);
+        zx_time_t ticks = zx_ticks_get() - start;
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+        open_ticks += ticks;
+        max_open_ticks = fbl::max(max_open_ticks, ticks);
+    }
+
+    const double ticks_per_msec = static_cast<double>(zx_ticks_per_second()) / 1000.0;
+    printf("\nBenchmark %10s: [%10lu] blobs, remount: [%8.2f] msec, open average: [%8.4f] msec, max: [%8.4f] msec",
+           "lookup", BlobCount, static_cast<double>(remount_ticks) / ticks_per_msec,
+           static_cast<double>(open_ticks) / ticks_per_msec / static_cast<double>(BlobCount),
+           static_cast<double>(max_open_ticks) / ticks_per_msec);
+
+    ASSERT_TRUE(EndBlobstoreBenchmark());
+    END_TEST;
+}
+
 template <size_t BlobSize, size_t BlobCount, traversal_order_t Order>
 static bool benchmark_blob_basic() {
     BEGIN_TEST;
@@ -482,9 +722,16 @@ static bool benchmark_blob_basic() {
 
 BEGIN_TEST_CASE(blobstore_benchmarks)
 
+RUN_TEST_PERFORMANCE((benchmark_blob_compressed<MB, 64>))
+
+RUN_TEST_PERFORMANCE((benchmark_blob_lookup<10000>))
+RUN_TEST_PERFORMANCE((benchmark_blob_lookup<100000>))
+RUN_TEST_PERFORMANCE((benchmark_blob_lookup<1000000>))
+
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, 128 * B, 500);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, 128 * B, 1000);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, 128 * B, 10000);
+RUN_TEST_PERFORMANCE((benchmark_blob_basic<128 * B, 100000, RANDOM>))
 
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, 512 * B, 500);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, 512 * B, 1000);
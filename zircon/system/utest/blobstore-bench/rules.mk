@@ -14,15 +14,21 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/blobstore-bench.cpp \
 
 MODULE_STATIC_LIBS := \
+    system/ulib/blobstore \
     system/ulib/digest \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
     system/ulib/zxcpp \
     system/ulib/fbl \
 
 MODULE_LIBS := \
     system/ulib/c \
     system/ulib/fdio \
+    system/ulib/fs-management \
     system/ulib/zircon \
     system/ulib/unittest \
 
+MODULE_COMPILEFLAGS := \
+    -Isystem/ulib/blobstore/include \
+
 include make/module.mk
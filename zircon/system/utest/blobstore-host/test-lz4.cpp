@@ -0,0 +1,196 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <blobstore/format.h>
+#include <blobstore/lz4.h>
+#include <digest/merkle-tree.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace blobstore {
+namespace {
+
+// A compressed blob, as the host tool writes it.
+struct Compressed {
+    blobstore_inode_t node;
+    fbl::unique_ptr<uint8_t[]> data;
+    fbl::unique_ptr<uint8_t[]> compressed;
+    size_t compressed_len;
+};
+
+// Fills |len| bytes with data which compresses, but not to nothing.
+void FillData(uint8_t* data, size_t len) {
+    uint32_t seed = 1;
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = static_cast<uint8_t>((i / 64) % 7 == 0 ? seed >> 16 : i % 13);
+    }
+}
+
+bool Compress(size_t blob_size, Compressed* out) {
+    BEGIN_HELPER;
+    memset(&out->node, 0, sizeof(out->node));
+    out->node.blob_size = blob_size;
+
+    fbl::AllocChecker ac;
+    out->data.reset(new (&ac) uint8_t[blob_size]);
+    ASSERT_TRUE(ac.check());
+    FillData(out->data.get(), blob_size);
+
+    const size_t bound = BlobCompressBound(blob_size);
+    out->compressed.reset(new (&ac) uint8_t[bound]());
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(BlobCompress(out->data.get(), blob_size, out->compressed.get(),
+                           &out->compressed_len), ZX_OK);
+    ASSERT_LE(out->compressed_len, bound);
+    END_HELPER;
+}
+
+void SetTableEntry(Compressed* c, uint64_t n, uint64_t value) {
+    memcpy(c->compressed.get() + n * sizeof(uint64_t), &value, sizeof(value));
+}
+
+// Every chunk of a blob of |kSize| bytes decompresses back to its data, one at a time.
+template <size_t kSize>
+bool TestRoundTrip(void) {
+    BEGIN_TEST;
+    Compressed c;
+    ASSERT_TRUE(Compress(kSize, &c));
+
+    const uint64_t chunks = BlobChunks(c.node);
+    ASSERT_EQ(chunks, fbl::round_up(kSize, kBlobstoreChunkSize) / kBlobstoreChunkSize);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[kBlobstoreChunkSize]);
+    ASSERT_TRUE(ac.check());
+
+    uint64_t prev_end = BlobChunkTableSize(c.node);
+    for (uint64_t n = 0; n < chunks; n++) {
+        uint64_t start, end;
+        ASSERT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, n, &start, &end),
+                  ZX_OK);
+        ASSERT_EQ(start, prev_end, "frames are not back to back");
+        prev_end = end;
+
+        const size_t off = n * kBlobstoreChunkSize;
+        const size_t len = fbl::min(kSize - off, kBlobstoreChunkSize);
+        memset(out.get(), 0, kBlobstoreChunkSize);
+        ASSERT_EQ(BlobDecompressChunk(out.get(), len, c.compressed.get() + start, end - start),
+                  ZX_OK);
+        ASSERT_EQ(memcmp(out.get(), c.data.get() + off, len), 0);
+    }
+    ASSERT_EQ(prev_end, c.compressed_len);
+    END_TEST;
+}
+
+// Frames cut short, and frames decompressed to the wrong size, are rejected.
+bool TestTruncatedFrame(void) {
+    BEGIN_TEST;
+    constexpr size_t kSize = kBlobstoreChunkSize + 1;
+    Compressed c;
+    ASSERT_TRUE(Compress(kSize, &c));
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[kBlobstoreChunkSize]);
+    ASSERT_TRUE(ac.check());
+
+    for (uint64_t n = 0; n < BlobChunks(c.node); n++) {
+        uint64_t start, end;
+        ASSERT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, n, &start, &end),
+                  ZX_OK);
+        const uint8_t* frame = c.compressed.get() + start;
+        const size_t frame_len = end - start;
+        const size_t len = fbl::min(kSize - n * kBlobstoreChunkSize, kBlobstoreChunkSize);
+
+        EXPECT_EQ(BlobDecompressChunk(out.get(), len, frame, frame_len - 1),
+                  ZX_ERR_IO_DATA_INTEGRITY);
+        EXPECT_EQ(BlobDecompressChunk(out.get(), len, frame, frame_len / 2),
+                  ZX_ERR_IO_DATA_INTEGRITY);
+        EXPECT_EQ(BlobDecompressChunk(out.get(), len, frame, 0), ZX_ERR_IO_DATA_INTEGRITY);
+        if (len > 1) {
+            EXPECT_EQ(BlobDecompressChunk(out.get(), len - 1, frame, frame_len),
+                      ZX_ERR_IO_DATA_INTEGRITY);
+        }
+        if (len < kBlobstoreChunkSize) {
+            EXPECT_EQ(BlobDecompressChunk(out.get(), len + 1, frame, frame_len),
+                      ZX_ERR_IO_DATA_INTEGRITY);
+        }
+    }
+    END_TEST;
+}
+
+// Tables of chunks which point outside the compressed blocks are rejected.
+bool TestCorruptChunkTable(void) {
+    BEGIN_TEST;
+    Compressed c;
+    ASSERT_TRUE(Compress(3 * kBlobstoreChunkSize, &c));
+    uint64_t start, end;
+    uint64_t end0, end1;
+    ASSERT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 0, &start, &end0),
+              ZX_OK);
+    ASSERT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 1, &start, &end1),
+              ZX_OK);
+
+    // The frame of chunk 1 would start after it ends.
+    SetTableEntry(&c, 0, end1 + 1);
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 1, &start, &end),
+              ZX_ERR_IO_DATA_INTEGRITY);
+
+    // The frame of chunk 1 would start within the table.
+    SetTableEntry(&c, 0, 0);
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 1, &start, &end),
+              ZX_ERR_IO_DATA_INTEGRITY);
+    SetTableEntry(&c, 0, end0);
+
+    // The frame of chunk 2 would end past the compressed blocks.
+    SetTableEntry(&c, 2, c.compressed_len + 1);
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 2, &start, &end),
+              ZX_ERR_IO_DATA_INTEGRITY);
+    SetTableEntry(&c, 2, c.compressed_len);
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 2, &start, &end),
+              ZX_OK);
+
+    // There is no chunk 3, and the table must fit in the compressed blocks.
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), c.compressed_len, 3, &start, &end),
+              ZX_ERR_IO_DATA_INTEGRITY);
+    EXPECT_EQ(BlobChunkFrame(c.node, c.compressed.get(), BlobChunkTableSize(c.node) - 1, 0,
+                             &start, &end),
+              ZX_ERR_IO_DATA_INTEGRITY);
+    END_TEST;
+}
+
+// A compressed inode covers its Merkle Tree and the blocks of its compressed data.
+bool TestSetCompressedSize(void) {
+    BEGIN_TEST;
+    Compressed c;
+    ASSERT_TRUE(Compress(4 * kBlobstoreChunkSize, &c));
+
+    const size_t merkle_blocks = fbl::round_up(
+        digest::MerkleTree::GetTreeLength(c.node.blob_size), kBlobstoreBlockSize) /
+        kBlobstoreBlockSize;
+    BlobSetCompressedSize(&c.node, c.compressed_len);
+    EXPECT_NE(c.node.flags & kBlobstoreInodeFlagLZ4, 0u);
+    EXPECT_EQ(c.node.num_blocks, merkle_blocks +
+              fbl::round_up(c.compressed_len, kBlobstoreBlockSize) / kBlobstoreBlockSize);
+    EXPECT_LT(c.node.num_blocks, merkle_blocks + BlobDataBlocks(c.node));
+    END_TEST;
+}
+
+} // namespace
+} // namespace blobstore
+
+BEGIN_TEST_CASE(blobstore_lz4_tests)
+RUN_TEST(blobstore::TestRoundTrip<1>)
+RUN_TEST(blobstore::TestRoundTrip<blobstore::kBlobstoreChunkSize>)
+RUN_TEST(blobstore::TestRoundTrip<blobstore::kBlobstoreChunkSize + 1>)
+RUN_TEST(blobstore::TestRoundTrip<5 * blobstore::kBlobstoreChunkSize - 3>)
+RUN_TEST(blobstore::TestTruncatedFrame)
+RUN_TEST(blobstore::TestCorruptChunkTable)
+RUN_TEST(blobstore::TestSetCompressedSize)
+END_TEST_CASE(blobstore_lz4_tests)
@@ -20,6 +20,7 @@
 #include <utime.h>
 
 #include <blobstore/format.h>
+#include <blobstore/lz4.h>
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fs-management/mount.h>
@@ -33,6 +34,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/vector.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
 #include <unittest/unittest.h>
@@ -349,7 +351,9 @@ typedef struct blob_info {
 
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
+// If |compressible| is set, the data is made of short runs of repeated bytes.
+static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out,
+                         bool compressible = false) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
@@ -359,7 +363,11 @@ static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
     static unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
 
     for (size_t i = 0; i < size_data; i++) {
-        info->data[i] = (char)rand_r(&seed);
+        if (compressible && i % 16 != 0) {
+            info->data[i] = info->data[i - 1];
+        } else {
+            info->data[i] = (char)rand_r(&seed);
+        }
     }
     info->size_data = size_data;
 
@@ -844,6 +852,255 @@ static bool CreateUmountRemountSmall(void) {
     END_TEST;
 }
 
+// Creates many blobs, and unlinks and recreates every other one, checking that
+// each is found by name only while it exists, both before and after remounting.
+template <fs_test_type_t TestType>
+static bool CreateUnlinkMany(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    constexpr size_t kBlobCount = 256;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<fbl::unique_ptr<blob_info_t>[]> info(
+        new (&ac) fbl::unique_ptr<blob_info_t>[kBlobCount]);
+    ASSERT_TRUE(ac.check());
+
+    int fd;
+    for (size_t i = 0; i < kBlobCount; i++) {
+        ASSERT_TRUE(GenerateBlob(64, &info[i]));
+        ASSERT_TRUE(MakeBlob(info[i]->path, info[i]->merkle.get(), info[i]->size_merkle,
+                             info[i]->data.get(), info[i]->size_data, &fd));
+        ASSERT_EQ(close(fd), 0);
+    }
+    for (size_t i = 0; i < kBlobCount; i += 2) {
+        ASSERT_EQ(unlink(info[i]->path), 0);
+    }
+    for (size_t i = 0; i < kBlobCount; i++) {
+        fd = open(info[i]->path, O_RDONLY);
+        if (i % 2 == 0) {
+            ASSERT_LT(fd, 0, "Opened unlinked blob");
+            continue;
+        }
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        ASSERT_TRUE(VerifyContents(fd, info[i]->data.get(), info[i]->size_data));
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    for (size_t i = 0; i < kBlobCount; i += 2) {
+        ASSERT_TRUE(MakeBlob(info[i]->path, info[i]->merkle.get(), info[i]->size_merkle,
+                             info[i]->data.get(), info[i]->size_data, &fd));
+        ASSERT_EQ(close(fd), 0);
+    }
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+    for (size_t i = 0; i < kBlobCount; i++) {
+        fd = open(info[i]->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to open blob");
+        ASSERT_TRUE(VerifyContents(fd, info[i]->data.get(), info[i]->size_data));
+        ASSERT_EQ(close(fd), 0);
+        ASSERT_EQ(unlink(info[i]->path), 0);
+    }
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+// Maps single pages of a blob which is not yet in memory, at offsets through it.
+template <fs_test_type_t TestType>
+static bool MmapRemountPartial(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 22, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    for (size_t i = 7; i > 0; i--) {
+        const size_t off = fbl::round_down(i * (info->size_data / 7) - 1,
+                                          static_cast<size_t>(PAGE_SIZE));
+        void* addr = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_SHARED, fd, off);
+        ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+        ASSERT_EQ(memcmp(addr, &info->data[off], PAGE_SIZE), 0, "Mmap data invalid");
+        ASSERT_EQ(munmap(addr, PAGE_SIZE), 0, "Could not unmap blob");
+    }
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+// Reads parts of a blob which is not yet in memory, out of order, and then
+// maps the rest of it.
+template <fs_test_type_t TestType>
+static bool ReadRemountPartial(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 20, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    constexpr size_t kPiece = 3000;
+    char buf[kPiece];
+    for (size_t i = 1; i < 8; i++) {
+        const size_t off = info->size_data - i * (info->size_data / 8);
+        ASSERT_EQ(pread(fd, buf, kPiece, off), kPiece);
+        ASSERT_EQ(memcmp(buf, &info->data[off], kPiece), 0, "Read data, but it was bad");
+    }
+
+    void* addr = mmap(NULL, info->size_data, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+    ASSERT_EQ(memcmp(addr, info->data.get(), info->size_data), 0, "Mmap data invalid");
+    ASSERT_EQ(munmap(addr, info->size_data), 0, "Could not unmap blob");
+    ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd), 0, "Could not close blob");
+    ASSERT_EQ(unlink(info->path), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+// Rewrites the blob |info| on the unmounted blobstore at |device_path| the way the host
+// tool stores blobs with --compress: its data blocks are replaced by the table of chunks
+// and their LZ4 frames, and the blocks this frees are returned to the allocator.
+static bool CompressBlobOnDisk(const char* device_path, const blob_info_t& info) {
+    constexpr size_t kBlockSize = blobstore::kBlobstoreBlockSize;
+    fbl::unique_fd fd(open(device_path, O_RDWR));
+    ASSERT_TRUE(fd, "Could not open block device");
+
+    uint8_t block[kBlockSize];
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    blobstore::blobstore_info_t super;
+    memcpy(&super, block, sizeof(super));
+
+    Digest digest;
+    const char* name = strrchr(info.path, '/') + 1;
+    ASSERT_EQ(digest.Parse(name, strlen(name)), ZX_OK);
+
+    // Find the blob's inode.
+    uint8_t node_block[kBlockSize];
+    off_t node_off = -1;
+    blobstore::blobstore_inode_t* inode = nullptr;
+    for (uint64_t b = 0; b < blobstore::NodeMapBlocks(super) && inode == nullptr; b++) {
+        node_off = (blobstore::NodeMapStartBlock(super) + b) * kBlockSize;
+        ASSERT_EQ(pread(fd.get(), node_block, kBlockSize, node_off), (ssize_t)kBlockSize);
+        auto nodes = reinterpret_cast<blobstore::blobstore_inode_t*>(node_block);
+        for (size_t i = 0; i < blobstore::kBlobstoreInodesPerBlock; i++) {
+            if (nodes[i].start_block >= blobstore::kStartBlockMinimum &&
+                digest == nodes[i].merkle_root_hash) {
+                inode = &nodes[i];
+                break;
+            }
+        }
+    }
+    ASSERT_NONNULL(inode, "Could not find the blob's inode");
+
+    fbl::AllocChecker ac;
+    const size_t bound = fbl::round_up(blobstore::BlobCompressBound(info.size_data), kBlockSize);
+    fbl::unique_ptr<uint8_t[]> compressed(new (&ac) uint8_t[bound]());
+    ASSERT_TRUE(ac.check());
+    size_t compressed_size;
+    ASSERT_EQ(blobstore::BlobCompress(info.data.get(), info.size_data, compressed.get(),
+                                      &compressed_size), ZX_OK);
+
+    const uint64_t old_blocks = inode->num_blocks;
+    const uint64_t merkle_blocks = old_blocks - blobstore::BlobDataBlocks(*inode);
+    blobstore::BlobSetCompressedSize(inode, compressed_size);
+    ASSERT_LT(inode->num_blocks, old_blocks, "Blob did not compress");
+
+    const size_t data_len = (inode->num_blocks - merkle_blocks) * kBlockSize;
+    const off_t data_off = (blobstore::DataStartBlock(super) + inode->start_block +
+                            merkle_blocks) * kBlockSize;
+    ASSERT_EQ(pwrite(fd.get(), compressed.get(), data_len, data_off), (ssize_t)data_len);
+    ASSERT_EQ(pwrite(fd.get(), node_block, kBlockSize, node_off), (ssize_t)kBlockSize);
+
+    // Free the blocks the compressed blob no longer uses.
+    for (uint64_t n = inode->start_block + inode->num_blocks;
+         n < inode->start_block + old_blocks; n++) {
+        const off_t map_off = (blobstore::BlockMapStartBlock(super) +
+                               n / blobstore::kBlobstoreBlockBits) * kBlockSize;
+        ASSERT_EQ(pread(fd.get(), block, kBlockSize, map_off), (ssize_t)kBlockSize);
+        const size_t bit = n % blobstore::kBlobstoreBlockBits;
+        block[bit / 8] = static_cast<uint8_t>(block[bit / 8] & ~(1 << (bit % 8)));
+        ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, map_off), (ssize_t)kBlockSize);
+    }
+    super.alloc_block_count -= old_blocks - inode->num_blocks;
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    memcpy(block, &super, sizeof(super));
+    ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, 0), (ssize_t)kBlockSize);
+    return true;
+}
+
+// Reads parts of a blob stored compressed, out of order and across chunk boundaries,
+// after a remount, then maps pages of it and finally the whole blob.
+template <fs_test_type_t TestType>
+static bool ReadCompressedRemountPartial(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob((1 << 20) + 1234, &info, true));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_TRUE(CompressBlobOnDisk(test_info.ramdisk_path, *info));
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open blob");
+    constexpr size_t kPiece = 3000;
+    char buf[kPiece];
+    // The last, partial chunk first, then pieces straddling chunk boundaries.
+    size_t off = info->size_data - kPiece;
+    ASSERT_EQ(pread(fd, buf, kPiece, off), kPiece);
+    ASSERT_EQ(memcmp(buf, &info->data[off], kPiece), 0, "Read data, but it was bad");
+    for (size_t i = 25; i > 0; i -= 6) {
+        off = i * blobstore::kBlobstoreChunkSize - kPiece / 2;
+        ASSERT_EQ(pread(fd, buf, kPiece, off), kPiece);
+        ASSERT_EQ(memcmp(buf, &info->data[off], kPiece), 0, "Read data, but it was bad");
+    }
+
+    for (size_t i = 7; i > 0; i--) {
+        off = fbl::round_down(i * (info->size_data / 7) - 1, static_cast<size_t>(PAGE_SIZE));
+        void* addr = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_SHARED, fd, off);
+        ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+        ASSERT_EQ(memcmp(addr, &info->data[off], PAGE_SIZE), 0, "Mmap data invalid");
+        ASSERT_EQ(munmap(addr, PAGE_SIZE), 0, "Could not unmap blob");
+    }
+
+    void* addr = mmap(NULL, info->size_data, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+    ASSERT_EQ(memcmp(addr, info->data.get(), info->size_data), 0, "Mmap data invalid");
+    ASSERT_EQ(munmap(addr, info->size_data), 0, "Could not unmap blob");
+    ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd), 0, "Could not close blob");
+    ASSERT_EQ(unlink(info->path), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 enum TestState {
     empty,
     configured,
@@ -1563,6 +1820,70 @@ static bool ResizePartition(void) {
     END_TEST;
 }
 
+// Returns the number of nodes of the mounted blobstore.
+static bool GetNodeCount(uint64_t* out_nodes) {
+    int fd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(fd, 0);
+    char buf[sizeof(vfs_query_info_t) + MAX_FS_NAME_LEN + 1];
+    vfs_query_info_t* info = reinterpret_cast<vfs_query_info_t*>(buf);
+    ssize_t rv = ioctl_vfs_query_fs(fd, info, sizeof(buf) - 1);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_GT(rv, (ssize_t)sizeof(vfs_query_info_t), "Failed to query filesystem");
+    *out_nodes = info->total_nodes;
+    return true;
+}
+
+// Opens every blob of |blobs| by name and checks its contents.
+static bool LookupAll(const fbl::Vector<fbl::unique_ptr<blob_info_t>>& blobs) {
+    for (const auto& info : blobs) {
+        int fd = open(info->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to look up blob");
+        ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+        ASSERT_EQ(close(fd), 0);
+    }
+    return true;
+}
+
+// Creates more blobs than the partition has nodes at first, so that nodes are added
+// and the index of nodes by Merkle root is regrown several times, then looks up every
+// blob by name, both before and after a remount rebuilds the index.
+template <fs_test_type_t TestType>
+static bool LookupAfterAddInodes(void) {
+    BEGIN_TEST;
+    ASSERT_EQ(TestType, FS_TEST_FVM);
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    uint64_t initial_nodes;
+    ASSERT_TRUE(GetNodeCount(&initial_nodes));
+    fbl::AllocChecker ac;
+    fbl::Vector<fbl::unique_ptr<blob_info_t>> blobs;
+    for (size_t i = 0; i < initial_nodes * 3 + 1; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(64, &info));
+        int fd;
+        ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                             info->data.get(), info->size_data, &fd));
+        ASSERT_EQ(close(fd), 0);
+        blobs.push_back(fbl::move(info), &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    uint64_t nodes;
+    ASSERT_TRUE(GetNodeCount(&nodes));
+    ASSERT_GT(nodes, initial_nodes * 3, "Expected nodes to be added");
+
+    ASSERT_TRUE(LookupAll(blobs));
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+    ASSERT_TRUE(LookupAll(blobs));
+
+    for (const auto& info : blobs) {
+        ASSERT_EQ(unlink(info->path), 0);
+    }
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 template <fs_test_type_t TestType>
 static bool CorruptAtMount(void) {
     BEGIN_TEST;
@@ -1608,6 +1929,10 @@ RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedBlob)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedDigest)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, EdgeAllocation)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CreateUmountRemountSmall)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, CreateUnlinkMany)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, ReadRemountPartial)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, MmapRemountPartial)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, ReadCompressedRemountPartial)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, EarlyRead)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, WaitForRead)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, WriteSeekIgnored)
@@ -1620,6 +1945,7 @@ RUN_TEST_FOR_ALL_TYPES(LARGE, NoSpace)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, QueryDevicePath)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestReadOnly)
 RUN_TEST_MEDIUM(ResizePartition<FS_TEST_FVM>)
+RUN_TEST_MEDIUM(LookupAfterAddInodes<FS_TEST_FVM>)
 RUN_TEST_MEDIUM(CorruptAtMount<FS_TEST_FVM>)
 END_TEST_CASE(blobstore_tests)
 
@@ -0,0 +1,242 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/batch.h>
+#include <zircon/syscalls/port.h>
+#include <fbl/algorithm.h>
+
+#include <unittest/unittest.h>
+
+static bool channel_vmo_test() {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0u, &channel[0], &channel[1]), ZX_OK);
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0u, &vmo), ZX_OK);
+
+    char msg[] = "hello";
+    char vmo_data[] = "world";
+    char msg_out[16] = {};
+    char vmo_out[16] = {};
+
+    zx_batch_op_t ops[4] = {};
+    ops[0] = {ZX_BATCH_OP_CHANNEL_WRITE, channel[0], 0u, 0u, 0u, msg, sizeof(msg)};
+    ops[1] = {ZX_BATCH_OP_VMO_WRITE, vmo, 0u, 0u, 16u, vmo_data, sizeof(vmo_data)};
+    ops[2] = {ZX_BATCH_OP_CHANNEL_READ, channel[1], 0u, 0u, 0u, msg_out, sizeof(msg_out)};
+    ops[3] = {ZX_BATCH_OP_VMO_READ, vmo, 0u, 0u, 16u, vmo_out, sizeof(vmo_data)};
+    zx_batch_result_t results[4];
+
+    ASSERT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, ZX_HANDLE_INVALID, 0u), ZX_OK);
+    for (size_t i = 0; i < fbl::count_of(results); i++) {
+        EXPECT_EQ(results[i].status, ZX_OK);
+    }
+    EXPECT_EQ(results[0].actual, sizeof(msg));
+    EXPECT_EQ(results[1].actual, sizeof(vmo_data));
+    EXPECT_EQ(results[2].actual, sizeof(msg));
+    EXPECT_EQ(results[3].actual, sizeof(vmo_data));
+    EXPECT_EQ(memcmp(msg_out, msg, sizeof(msg)), 0);
+    EXPECT_EQ(memcmp(vmo_out, vmo_data, sizeof(vmo_data)), 0);
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
+static bool socket_fifo_test() {
+    BEGIN_TEST;
+
+    zx_handle_t socket[2];
+    ASSERT_EQ(zx_socket_create(0u, &socket[0], &socket[1]), ZX_OK);
+    zx_handle_t fifo[2];
+    ASSERT_EQ(zx_fifo_create(4u, sizeof(uint64_t), 0u, &fifo[0], &fifo[1]), ZX_OK);
+
+    char data[] = "socket";
+    char data_out[16] = {};
+    uint64_t elems[2] = {1u, 2u};
+    uint64_t elems_out[4] = {};
+
+    zx_batch_op_t ops[4] = {};
+    ops[0] = {ZX_BATCH_OP_SOCKET_WRITE, socket[0], 0u, 0u, 0u, data, sizeof(data)};
+    ops[1] = {ZX_BATCH_OP_FIFO_WRITE, fifo[0], 0u, 0u, 0u, elems, sizeof(elems)};
+    ops[2] = {ZX_BATCH_OP_SOCKET_READ, socket[1], 0u, 0u, 0u, data_out, sizeof(data_out)};
+    ops[3] = {ZX_BATCH_OP_FIFO_READ, fifo[1], 0u, 0u, 0u, elems_out, sizeof(elems_out)};
+    zx_batch_result_t results[4];
+
+    ASSERT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, ZX_HANDLE_INVALID, 0u), ZX_OK);
+    for (size_t i = 0; i < fbl::count_of(results); i++) {
+        EXPECT_EQ(results[i].status, ZX_OK);
+    }
+    EXPECT_EQ(results[0].actual, sizeof(data));
+    EXPECT_EQ(results[1].actual, 2u);
+    EXPECT_EQ(results[2].actual, sizeof(data));
+    EXPECT_EQ(results[3].actual, 2u);
+    EXPECT_EQ(memcmp(data_out, data, sizeof(data)), 0);
+    EXPECT_EQ(elems_out[0], 1u);
+    EXPECT_EQ(elems_out[1], 2u);
+
+    EXPECT_EQ(zx_handle_close(socket[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(socket[1]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(fifo[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(fifo[1]), ZX_OK);
+
+    END_TEST;
+}
+
+// A failed operation is reported in its result and does not stop the batch.
+static bool partial_failure_test() {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0u, &channel[0], &channel[1]), ZX_OK);
+
+    char msg[] = "too big";
+    char small[2];
+
+    zx_batch_op_t ops[4] = {};
+    ops[0] = {ZX_BATCH_OP_CHANNEL_READ, channel[1], 0u, 0u, 0u, small, sizeof(small)};
+    ops[1] = {ZX_BATCH_OP_CHANNEL_WRITE, channel[0], 0u, 0u, 0u, msg, sizeof(msg)};
+    ops[2] = {ZX_BATCH_OP_CHANNEL_READ, channel[1], 0u, 0u, 0u, small, sizeof(small)};
+    ops[3] = {0u, channel[0], 0u, 0u, 0u, nullptr, 0u};
+    zx_batch_result_t results[4];
+
+    ASSERT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, ZX_HANDLE_INVALID, 0u), ZX_OK);
+    EXPECT_EQ(results[0].status, ZX_ERR_SHOULD_WAIT);
+    EXPECT_EQ(results[1].status, ZX_OK);
+    EXPECT_EQ(results[2].status, ZX_ERR_BUFFER_TOO_SMALL);
+    EXPECT_EQ(results[2].actual, sizeof(msg));
+    EXPECT_EQ(results[3].status, ZX_ERR_NOT_SUPPORTED);
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK);
+
+    END_TEST;
+}
+
+// A message carrying handles is left in the channel for zx_channel_read().
+static bool channel_handles_test() {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0u, &channel[0], &channel[1]), ZX_OK);
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK);
+
+    char msg[] = "handle";
+    ASSERT_EQ(zx_channel_write(channel[0], 0u, msg, sizeof(msg), &event, 1u), ZX_OK);
+
+    char msg_out[16] = {};
+    zx_batch_op_t ops[2] = {};
+    ops[0] = {ZX_BATCH_OP_CHANNEL_READ, channel[1], 0u, 0u, 0u, msg_out, sizeof(msg_out)};
+    ops[1] = {ZX_BATCH_OP_CHANNEL_READ, channel[1], ZX_CHANNEL_READ_MAY_DISCARD, 0u, 0u,
+              msg_out, sizeof(msg_out)};
+    zx_batch_result_t results[2];
+
+    ASSERT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, ZX_HANDLE_INVALID, 0u), ZX_OK);
+    for (size_t i = 0; i < fbl::count_of(results); i++) {
+        EXPECT_EQ(results[i].status, ZX_ERR_BUFFER_TOO_SMALL);
+        EXPECT_EQ(results[i].actual, sizeof(msg));
+    }
+
+    zx_handle_t handle_out = ZX_HANDLE_INVALID;
+    uint32_t actual_bytes, actual_handles;
+    ASSERT_EQ(zx_channel_read(channel[1], 0u, msg_out, &handle_out, sizeof(msg_out), 1u,
+                              &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(actual_bytes, sizeof(msg));
+    EXPECT_EQ(actual_handles, 1u);
+    EXPECT_EQ(memcmp(msg_out, msg, sizeof(msg)), 0);
+
+    EXPECT_EQ(zx_handle_close(handle_out), ZX_OK);
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK);
+
+    END_TEST;
+}
+
+static bool port_notification_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0u, &port), ZX_OK);
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK);
+
+    uint8_t byte = 0u;
+    zx_batch_op_t ops[2] = {};
+    ops[0] = {ZX_BATCH_OP_VMO_READ, event, 0u, 0u, 0u, &byte, sizeof(byte)};
+    ops[1] = {ZX_BATCH_OP_SOCKET_WRITE, ZX_HANDLE_INVALID, 0u, 0u, 0u, &byte, sizeof(byte)};
+    zx_batch_result_t results[2];
+
+    ASSERT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, port, 42u), ZX_OK);
+    EXPECT_EQ(results[0].status, ZX_ERR_WRONG_TYPE);
+    EXPECT_EQ(results[1].status, ZX_ERR_BAD_HANDLE);
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, 0u, &packet, 0u), ZX_OK);
+    EXPECT_EQ(packet.key, 42u);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_USER);
+    EXPECT_EQ(packet.user.u64[0], 2u);
+    EXPECT_EQ(packet.user.u64[1], 2u);
+
+    EXPECT_EQ(zx_handle_close(event), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+static bool invalid_args_test() {
+    BEGIN_TEST;
+
+    zx_batch_op_t ops[ZX_BATCH_MAX_OPS + 1] = {};
+    zx_batch_result_t results[ZX_BATCH_MAX_OPS + 1];
+
+    EXPECT_EQ(zx_batch_execute(ops, fbl::count_of(ops), results, ZX_HANDLE_INVALID, 0u),
+              ZX_ERR_OUT_OF_RANGE);
+    EXPECT_EQ(zx_batch_execute(nullptr, 1u, results, ZX_HANDLE_INVALID, 0u),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_batch_execute(ops, 1u, nullptr, ZX_HANDLE_INVALID, 0u),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_batch_execute(ops, 0u, nullptr, ZX_HANDLE_INVALID, 0u), ZX_OK);
+
+    // A bad results pointer fails the call before any operation runs.
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0u, &channel[0], &channel[1]), ZX_OK);
+    char msg[] = "unsent";
+    ops[0] = {ZX_BATCH_OP_CHANNEL_WRITE, channel[0], 0u, 0u, 0u, msg, sizeof(msg)};
+    EXPECT_EQ(zx_batch_execute(ops, 1u, nullptr, ZX_HANDLE_INVALID, 0u), ZX_ERR_INVALID_ARGS);
+    uint32_t actual_bytes, actual_handles;
+    EXPECT_EQ(zx_channel_read(channel[1], 0u, msg, nullptr, sizeof(msg), 0u,
+                              &actual_bytes, &actual_handles), ZX_ERR_SHOULD_WAIT);
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK);
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK);
+    ops[0] = {};
+
+    // Reserved fields must be zero.
+    ops[0].op = ZX_BATCH_OP_VMO_READ;
+    ops[0].reserved = 1u;
+    ASSERT_EQ(zx_batch_execute(ops, 1u, results, ZX_HANDLE_INVALID, 0u), ZX_OK);
+    EXPECT_EQ(results[0].status, ZX_ERR_INVALID_ARGS);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(batch_tests)
+RUN_TEST(channel_vmo_test)
+RUN_TEST(socket_fifo_test)
+RUN_TEST(partial_failure_test)
+RUN_TEST(channel_handles_test)
+RUN_TEST(port_notification_test)
+RUN_TEST(invalid_args_test)
+END_TEST_CASE(batch_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
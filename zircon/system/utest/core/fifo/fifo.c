@@ -118,8 +118,96 @@ static bool options_test(void) {
     END_TEST;
 }
 
+static bool shared_ring_test(void) {
+    BEGIN_TEST;
+    zx_handle_t a, b;
+    uint64_t n[8] = { 1, 2, 3, 4, 5, 6, 7, 8};
+    uint32_t actual;
+
+    ASSERT_EQ(zx_fifo_create(8, 8, ZX_FIFO_SHARED_RING, &a, &b), ZX_OK, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+
+    zx_fifo_ring_info_t info;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_fifo_get_ring(a, &info, &vmo), ZX_OK, "");
+    EXPECT_EQ(info.elem_count, 8u, "");
+    EXPECT_EQ(info.elem_size, 8u, "");
+
+    // both ends see the same rings, crossed over
+    zx_fifo_ring_info_t peer_info;
+    zx_handle_t peer_vmo;
+    ASSERT_EQ(zx_fifo_get_ring(b, &peer_info, &peer_vmo), ZX_OK, "");
+    EXPECT_EQ(peer_info.read_ring_offset, info.write_ring_offset, "");
+    EXPECT_EQ(peer_info.write_ring_offset, info.read_ring_offset, "");
+    zx_handle_close(peer_vmo);
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, info.vmo_size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr), ZX_OK, "");
+    zx_fifo_ring_t* out = (zx_fifo_ring_t*)(addr + info.write_ring_offset);
+    uint64_t* out_entries = (uint64_t*)((uintptr_t)out + ZX_FIFO_RING_ENTRIES_OFFSET);
+    zx_fifo_ring_t* in = (zx_fifo_ring_t*)(addr + info.read_ring_offset);
+    uint64_t* in_entries = (uint64_t*)((uintptr_t)in + ZX_FIFO_RING_ENTRIES_OFFSET);
+
+    // produce three entries from |a| without the kernel
+    for (uint32_t i = 0; i < 3; i++) {
+        out_entries[i] = n[i];
+    }
+    __atomic_store_n(&out->head, 3u, __ATOMIC_SEQ_CST);
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+
+    // ring the doorbell
+    ASSERT_EQ(zx_fifo_write(a, NULL, 0, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 0u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_READABLE | ZX_FIFO_WRITABLE);
+
+    // the kernel copy path consumes from the same ring
+    memset(n, 0, sizeof(n));
+    ASSERT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 3u, "");
+    EXPECT_EQ(n[0], 1u, "");
+    EXPECT_EQ(n[2], 3u, "");
+    EXPECT_EQ(__atomic_load_n(&out->tail, __ATOMIC_SEQ_CST), 3u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+
+    // and the kernel produces entries that |a| consumes from shared memory
+    n[0] = 42u;
+    ASSERT_EQ(zx_fifo_write(b, n, sizeof(uint64_t), &actual), ZX_OK, "");
+    ASSERT_EQ(actual, 1u, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_READABLE | ZX_FIFO_WRITABLE);
+    ASSERT_EQ(__atomic_load_n(&in->head, __ATOMIC_SEQ_CST), 1u, "");
+    EXPECT_EQ(in_entries[0], 42u, "");
+    __atomic_store_n(&in->tail, 1u, __ATOMIC_SEQ_CST);
+    ASSERT_EQ(zx_fifo_read(a, NULL, 0, &actual), ZX_OK, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+
+    // corrupt indices are rejected
+    __atomic_store_n(&out->head, 100u, __ATOMIC_SEQ_CST);
+    EXPECT_EQ(zx_fifo_write(a, n, sizeof(uint64_t), &actual), ZX_ERR_BAD_STATE, "");
+
+    // the ring pages cannot be taken away from the kernel
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, info.vmo_size, NULL, 0),
+              ZX_ERR_BAD_STATE, "");
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, info.vmo_size), ZX_OK, "");
+    zx_handle_close(vmo);
+    zx_handle_close(b);
+    zx_handle_close(a);
+
+    // plain fifos have no ring
+    ASSERT_EQ(zx_fifo_create(8, 8, 0, &a, &b), ZX_OK, "");
+    EXPECT_EQ(zx_fifo_get_ring(a, &info, &vmo), ZX_ERR_NOT_SUPPORTED, "");
+    zx_handle_close(b);
+    zx_handle_close(a);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
+RUN_TEST(options_test)
+RUN_TEST(shared_ring_test)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
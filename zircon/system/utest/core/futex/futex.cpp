@@ -3,7 +3,9 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <unittest/unittest.h>
@@ -526,6 +528,218 @@ static bool test_event_signaling() {
     END_TEST;
 }
 
+static bool test_futex_wait_pi_bad_owner() {
+    BEGIN_TEST;
+    int futex_value = 0;
+    // An unowned futex has no owner to wait for.
+    EXPECT_EQ(zx_futex_wait_pi(&futex_value, 0, ZX_TIME_INFINITE), ZX_ERR_INVALID_ARGS);
+
+    // Waiting on a futex we own would never return.
+    futex_value = static_cast<int>(thrd_get_zx_handle(thrd_current()));
+    EXPECT_EQ(zx_futex_wait_pi(&futex_value, futex_value, ZX_TIME_INFINITE),
+              ZX_ERR_INVALID_ARGS);
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0, &event), ZX_OK);
+    futex_value = static_cast<int>(event);
+    EXPECT_EQ(zx_futex_wait_pi(&futex_value, futex_value, ZX_TIME_INFINITE),
+              ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_handle_close(event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_pi(&futex_value, futex_value, ZX_TIME_INFINITE),
+              ZX_ERR_BAD_HANDLE);
+    END_TEST;
+}
+
+struct PiWaiter {
+    volatile int* futex;
+    int value;
+    zx_time_t deadline;
+    volatile zx_status_t status;
+    volatile bool done;
+    // If nonzero, the priority the waiter runs at.
+    int32_t priority;
+};
+
+static int pi_waiter_thread(void* arg) {
+    auto waiter = static_cast<PiWaiter*>(arg);
+    if (waiter->priority != 0)
+        waiter->status = zx_thread_set_priority(waiter->priority);
+    if (waiter->priority == 0 || waiter->status == ZX_OK)
+        waiter->status = zx_futex_wait_pi(const_cast<int*>(waiter->futex), waiter->value,
+                                          waiter->deadline);
+    waiter->done = true;
+    return 0;
+}
+
+static int32_t effective_priority(zx_handle_t thread) {
+    zx_info_thread_t info;
+    if (zx_object_get_info(thread, ZX_INFO_THREAD, &info, sizeof(info), NULL, NULL) != ZX_OK)
+        return -1;
+    return info.effective_priority;
+}
+
+// Starts a thread running |waiter|, and returns once it is blocked, or done.
+static bool start_pi_waiter(PiWaiter* waiter, thrd_t* thread) {
+    ASSERT_EQ(thrd_create_with_name(thread, pi_waiter_thread, waiter, "pi_waiter"),
+              thrd_success);
+    zx_handle_t handle = thrd_get_zx_handle(*thread);
+    for (;;) {
+        zx_info_thread_t info;
+        ASSERT_EQ(zx_object_get_info(handle, ZX_INFO_THREAD, &info, sizeof(info), NULL, NULL),
+                  ZX_OK);
+        if (info.state == ZX_THREAD_STATE_BLOCKED || waiter->done)
+            return true;
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    }
+}
+
+// The current thread owns the futex, and another thread waits for it.
+static bool test_futex_wait_pi_wake() {
+    BEGIN_TEST;
+    volatile int futex_value =
+        static_cast<int>(thrd_get_zx_handle(thrd_current())) | ZX_FUTEX_PI_WAITERS;
+
+    // A stale value is reported as such once the owner has been checked.
+    int stale = futex_value & ~ZX_FUTEX_PI_WAITERS;
+    PiWaiter mismatch = {&futex_value, stale, ZX_TIME_INFINITE, ZX_ERR_INTERNAL, false};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, pi_waiter_thread, &mismatch, "pi_waiter"),
+              thrd_success);
+    ASSERT_EQ(thrd_join(thread, NULL), thrd_success);
+    EXPECT_EQ(mismatch.status, ZX_ERR_BAD_STATE);
+
+    PiWaiter timeout = {&futex_value, futex_value, zx_deadline_after(ZX_MSEC(10)),
+                        ZX_ERR_INTERNAL, false};
+    ASSERT_EQ(thrd_create_with_name(&thread, pi_waiter_thread, &timeout, "pi_waiter"),
+              thrd_success);
+    ASSERT_EQ(thrd_join(thread, NULL), thrd_success);
+    EXPECT_EQ(timeout.status, ZX_ERR_TIMED_OUT);
+
+    PiWaiter waiter = {&futex_value, futex_value, ZX_TIME_INFINITE, ZX_ERR_INTERNAL, false};
+    ASSERT_EQ(thrd_create_with_name(&thread, pi_waiter_thread, &waiter, "pi_waiter"),
+              thrd_success);
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(100)));
+    EXPECT_FALSE(waiter.done, "waiter returned while the futex was owned");
+
+    // Release the futex and hand it to the waiter.
+    futex_value = 0;
+    EXPECT_EQ(zx_futex_wake_pi(const_cast<int*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(thread, NULL), thrd_success);
+    EXPECT_EQ(waiter.status, ZX_OK);
+
+    // Waking a futex with no waiters does nothing.
+    EXPECT_EQ(zx_futex_wake_pi(const_cast<int*>(&futex_value)), ZX_OK);
+    END_TEST;
+}
+
+// The current thread owns the futex while higher priority threads wait for
+// it, and runs with their priority.  This needs zx_thread_set_priority(), and
+// so the thread.set.priority.allowed kernel command line option.
+static bool test_futex_wait_pi_priority() {
+    BEGIN_TEST;
+    zx_handle_t self = thrd_get_zx_handle(thrd_current());
+    const int32_t base = effective_priority(self);
+    ASSERT_GE(base, 0);
+    volatile int futex_value = static_cast<int>(self) | ZX_FUTEX_PI_WAITERS;
+
+    thrd_t high_thread;
+    PiWaiter high = {&futex_value, futex_value, ZX_TIME_INFINITE, ZX_ERR_INTERNAL, false,
+                     base + 8};
+    ASSERT_TRUE(start_pi_waiter(&high, &high_thread));
+    if (high.done && high.status == ZX_ERR_NOT_SUPPORTED) {
+        unittest_printf("zx_thread_set_priority() is disabled; skipping\n");
+        ASSERT_EQ(thrd_join(high_thread, NULL), thrd_success);
+        END_TEST;
+    }
+    EXPECT_FALSE(high.done, "waiter returned while the futex was owned");
+    EXPECT_EQ(effective_priority(self), base + 8);
+
+    thrd_t low_thread;
+    PiWaiter low = {&futex_value, futex_value, ZX_TIME_INFINITE, ZX_ERR_INTERNAL, false,
+                    base + 4};
+    ASSERT_TRUE(start_pi_waiter(&low, &low_thread));
+    EXPECT_EQ(effective_priority(self), base + 8);
+
+    // Waking hands the futex to the highest priority waiter, which returns
+    // without taking it.  Then the current thread takes it again without
+    // waiting, as a thread barging in would.
+    futex_value = 0;
+    EXPECT_EQ(zx_futex_wake_pi(const_cast<int*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(high_thread, NULL), thrd_success);
+    EXPECT_EQ(high.status, ZX_OK);
+    EXPECT_EQ(effective_priority(self), base);
+    futex_value = static_cast<int>(self) | ZX_FUTEX_PI_WAITERS;
+
+    // The next waiter names the current thread as the owner, and the one
+    // still waiting lends its priority to the current thread again, rather
+    // than to the thread that was woken.
+    thrd_t next_thread;
+    PiWaiter next = {&futex_value, futex_value, ZX_TIME_INFINITE, ZX_ERR_INTERNAL, false,
+                     base + 2};
+    ASSERT_TRUE(start_pi_waiter(&next, &next_thread));
+    EXPECT_EQ(effective_priority(self), base + 4);
+
+    futex_value = 0;
+    EXPECT_EQ(zx_futex_wake_pi(const_cast<int*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(low_thread, NULL), thrd_success);
+    EXPECT_EQ(low.status, ZX_OK);
+    EXPECT_EQ(zx_futex_wake_pi(const_cast<int*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(next_thread, NULL), thrd_success);
+    EXPECT_EQ(next.status, ZX_OK);
+    EXPECT_EQ(effective_priority(self), base);
+    END_TEST;
+}
+
+static int pi_mutex_thread(void* arg) {
+    auto mutex = static_cast<pthread_mutex_t*>(arg);
+    for (int i = 0; i < 1000; i++) {
+        if (pthread_mutex_lock(mutex) != 0)
+            return -1;
+        if (pthread_mutex_unlock(mutex) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static bool test_pthread_mutex_prio_inherit() {
+    BEGIN_TEST;
+    pthread_mutexattr_t attr;
+    ASSERT_EQ(pthread_mutexattr_init(&attr), 0);
+    int protocol;
+    ASSERT_EQ(pthread_mutexattr_getprotocol(&attr, &protocol), 0);
+    EXPECT_EQ(protocol, PTHREAD_PRIO_NONE);
+    ASSERT_EQ(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT), 0);
+    ASSERT_EQ(pthread_mutexattr_getprotocol(&attr, &protocol), 0);
+    EXPECT_EQ(protocol, PTHREAD_PRIO_INHERIT);
+    EXPECT_EQ(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_PROTECT), ENOTSUP);
+
+    pthread_mutex_t mutex;
+    ASSERT_EQ(pthread_mutex_init(&mutex, &attr), 0);
+    ASSERT_EQ(pthread_mutexattr_destroy(&attr), 0);
+
+    // Relocking a priority inheritance mutex is reported rather than
+    // deadlocking, since the kernel would refuse the wait.
+    ASSERT_EQ(pthread_mutex_lock(&mutex), 0);
+    EXPECT_EQ(pthread_mutex_trylock(&mutex), EBUSY);
+    EXPECT_EQ(pthread_mutex_lock(&mutex), EDEADLK);
+    ASSERT_EQ(pthread_mutex_unlock(&mutex), 0);
+
+    constexpr int kThreads = 4;
+    thrd_t threads[kThreads];
+    for (int i = 0; i < kThreads; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], pi_mutex_thread, &mutex, "pi_mutex"),
+                  thrd_success);
+    }
+    for (int i = 0; i < kThreads; i++) {
+        int result;
+        ASSERT_EQ(thrd_join(threads[i], &result), thrd_success);
+        EXPECT_EQ(result, 0);
+    }
+
+    ASSERT_EQ(pthread_mutex_destroy(&mutex), 0);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(futex_tests)
 RUN_TEST(test_futex_wait_value_mismatch);
 RUN_TEST(test_futex_wait_timeout);
@@ -545,6 +759,10 @@ RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
 RUN_TEST(test_event_signaling);
+RUN_TEST(test_futex_wait_pi_bad_owner);
+RUN_TEST(test_futex_wait_pi_wake);
+RUN_TEST(test_futex_wait_pi_priority);
+RUN_TEST(test_pthread_mutex_prio_inherit);
 END_TEST_CASE(futex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -82,7 +82,201 @@ static bool interrupt_test_multiple(void) {
     END_TEST;
 }
 
+// Tests the interrupt affinity property
+static bool interrupt_affinity_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t handle;
+    zx_handle_t rsrc = get_root_resource();
+    uint32_t cpu;
+
+    ASSERT_EQ(zx_interrupt_create(rsrc, 0, &handle), ZX_OK, "");
+
+    ASSERT_EQ(zx_object_get_property(handle, ZX_PROP_INTERRUPT_AFFINITY, &cpu, sizeof(cpu)),
+              ZX_OK, "");
+    ASSERT_EQ(cpu, ZX_INTERRUPT_AFFINITY_DEFAULT, "");
+
+    // Every online cpu is a valid target.
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        ASSERT_EQ(zx_object_set_property(handle, ZX_PROP_INTERRUPT_AFFINITY, &i, sizeof(i)),
+                  ZX_OK, "");
+        ASSERT_EQ(zx_object_get_property(handle, ZX_PROP_INTERRUPT_AFFINITY, &cpu, sizeof(cpu)),
+                  ZX_OK, "");
+        ASSERT_EQ(cpu, i, "");
+    }
+
+    // Virtual interrupts bound after the affinity is set still work.
+    ASSERT_EQ(zx_interrupt_bind(handle, 0, rsrc, 0, ZX_INTERRUPT_VIRTUAL), ZX_OK, "");
+    uint64_t slots;
+    ASSERT_EQ(zx_interrupt_signal(handle, 0, 1), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_wait(handle, &slots), ZX_OK, "");
+    ASSERT_EQ(slots, 1ul, "");
+
+    uint32_t bad_cpu = num_cpus;
+    ASSERT_EQ(zx_object_set_property(handle, ZX_PROP_INTERRUPT_AFFINITY,
+                                     &bad_cpu, sizeof(bad_cpu)),
+              ZX_ERR_INVALID_ARGS, "");
+    bad_cpu = ZX_INTERRUPT_AFFINITY_DEFAULT;
+    ASSERT_EQ(zx_object_set_property(handle, ZX_PROP_INTERRUPT_AFFINITY,
+                                     &bad_cpu, sizeof(bad_cpu)),
+              ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_object_set_property(handle, ZX_PROP_INTERRUPT_AFFINITY, &cpu, 1),
+              ZX_ERR_BUFFER_TOO_SMALL, "");
+
+    // The failed attempts left the affinity alone.
+    ASSERT_EQ(zx_object_get_property(handle, ZX_PROP_INTERRUPT_AFFINITY, &cpu, sizeof(cpu)),
+              ZX_OK, "");
+    ASSERT_EQ(cpu, num_cpus - 1, "");
+
+    // The property only applies to interrupts.
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(4096, 0, &vmo), ZX_OK, "");
+    ASSERT_EQ(zx_object_get_property(vmo, ZX_PROP_INTERRUPT_AFFINITY, &cpu, sizeof(cpu)),
+              ZX_ERR_WRONG_TYPE, "");
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK, "");
+
+    ASSERT_EQ(zx_handle_close(handle), ZX_OK, "");
+
+    END_TEST;
+}
+
+// Identifies QEMU's "edu" test device, added with "-device edu". Writing its
+// interrupt raise register makes it send an MSI.
+#define EDU_VENDOR_ID 0x1234
+#define EDU_DEVICE_ID 0x11e8
+#define EDU_REG_IRQ_RAISE 0x60
+#define EDU_REG_IRQ_ACK 0x64
+
+#define PCI_CFG_CAPABILITIES_PTR 0x34
+#define PCI_CAP_ID_MSI 0x05
+
+// Returns the config space offset of the capability |id| of |dev|, or 0.
+static uint16_t find_pci_cap(zx_handle_t dev, uint8_t id) {
+    uint32_t ptr;
+    if (zx_pci_config_read(dev, PCI_CFG_CAPABILITIES_PTR, 1, &ptr) != ZX_OK) {
+        return 0;
+    }
+    // Capabilities live above the standard header, 4 byte aligned.
+    for (int i = 0; i < 48 && ptr >= 0x40; i++) {
+        uint32_t cap_id, next;
+        ptr &= ~0x3u;
+        if (zx_pci_config_read(dev, (uint16_t)ptr, 1, &cap_id) != ZX_OK ||
+            zx_pci_config_read(dev, (uint16_t)(ptr + 1), 1, &next) != ZX_OK) {
+            return 0;
+        }
+        if (cap_id == id) {
+            return (uint16_t)ptr;
+        }
+        ptr = next;
+    }
+    return 0;
+}
+
+// Returns the number of hardware interrupts taken by |cpu| so far.
+static uint64_t cpu_interrupt_count(zx_handle_t rsrc, uint32_t cpu) {
+    zx_info_cpu_stats_t stats[cpu + 1];
+    size_t actual, avail;
+    if (zx_object_get_info(rsrc, ZX_INFO_CPU_STATS, stats, sizeof(stats),
+                           &actual, &avail) != ZX_OK || actual <= cpu) {
+        return 0;
+    }
+    return stats[cpu].ints;
+}
+
+// Tests that setting the affinity of an MSI steers it to the chosen cpu. This
+// needs the edu device, so it only runs under QEMU started with it.
+static bool interrupt_msi_affinity_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rsrc = get_root_resource();
+    zx_handle_t dev = ZX_HANDLE_INVALID;
+    zx_pcie_device_info_t info;
+    for (uint32_t i = 0; dev == ZX_HANDLE_INVALID; i++) {
+        zx_handle_t h;
+        if (zx_pci_get_nth_device(rsrc, i, &info, &h) != ZX_OK) {
+            break;
+        }
+        if (info.vendor_id == EDU_VENDOR_ID && info.device_id == EDU_DEVICE_ID) {
+            dev = h;
+        } else {
+            zx_handle_close(h);
+        }
+    }
+    if (dev == ZX_HANDLE_INVALID) {
+        unittest_printf("no edu device; skipping\n");
+        END_TEST;
+    }
+
+    zx_pci_bar_t bar;
+    zx_handle_t bar_vmo;
+    ASSERT_EQ(zx_pci_get_bar(dev, 0, &bar, &bar_vmo), ZX_OK, "");
+    ASSERT_EQ(bar.type, (uint32_t)PCI_BAR_TYPE_MMIO, "");
+    ASSERT_EQ(zx_vmo_set_cache_policy(bar_vmo, ZX_CACHE_POLICY_UNCACHED_DEVICE), ZX_OK, "");
+    uintptr_t regs;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, bar_vmo, 0, bar.size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | ZX_VM_FLAG_MAP_RANGE,
+                          &regs), ZX_OK, "");
+    volatile uint32_t* raise = (volatile uint32_t*)(regs + EDU_REG_IRQ_RAISE);
+    volatile uint32_t* ack = (volatile uint32_t*)(regs + EDU_REG_IRQ_ACK);
+
+    uint32_t max_irqs;
+    ASSERT_EQ(zx_pci_query_irq_mode(dev, ZX_PCIE_IRQ_MODE_MSI, &max_irqs), ZX_OK, "");
+    ASSERT_EQ(zx_pci_set_irq_mode(dev, ZX_PCIE_IRQ_MODE_MSI, 1), ZX_OK, "");
+    ASSERT_EQ(zx_pci_enable_bus_master(dev, true), ZX_OK, "");
+    zx_handle_t irq;
+    ASSERT_EQ(zx_pci_map_interrupt(dev, 0, &irq), ZX_OK, "");
+    uint16_t msi = find_pci_cap(dev, PCI_CAP_ID_MSI);
+    ASSERT_NE(msi, 0, "");
+
+    const uint32_t kRaises = 50;
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    uint32_t first_addr = 0;
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        zx_status_t status = zx_object_set_property(irq, ZX_PROP_INTERRUPT_AFFINITY,
+                                                    &cpu, sizeof(cpu));
+        if (status == ZX_ERR_NOT_SUPPORTED) {
+            // Only the x86 platform can steer MSIs so far.
+            unittest_printf("MSI affinity not supported; skipping\n");
+            break;
+        }
+        ASSERT_EQ(status, ZX_OK, "");
+
+        // The device's MSI target address now names the cpu. On x86 the
+        // destination APIC ID is in bits 19:12.
+        uint32_t addr;
+        ASSERT_EQ(zx_pci_config_read(dev, (uint16_t)(msi + 4), 4, &addr), ZX_OK, "");
+#if defined(__x86_64__)
+        ASSERT_EQ(addr >> 20, 0xfeeu, "");
+#endif
+        if (cpu == 0) {
+            first_addr = addr;
+        } else {
+            ASSERT_NE(addr, first_addr, "");
+        }
+
+        // Every interrupt the device raises is taken by the chosen cpu.
+        uint64_t before = cpu_interrupt_count(rsrc, cpu);
+        for (uint32_t i = 0; i < kRaises; i++) {
+            *raise = 1;
+            uint64_t slots;
+            ASSERT_EQ(zx_interrupt_wait(irq, &slots), ZX_OK, "");
+            *ack = 1;
+        }
+        ASSERT_GE(cpu_interrupt_count(rsrc, cpu) - before, (uint64_t)kRaises, "");
+    }
+
+    ASSERT_EQ(zx_handle_close(irq), ZX_OK, "");
+    ASSERT_EQ(zx_vmar_unmap(zx_vmar_root_self(), regs, bar.size), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(bar_vmo), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(dev), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(interrupt_tests)
 RUN_TEST(interrupt_test)
 RUN_TEST(interrupt_test_multiple)
+RUN_TEST(interrupt_affinity_test)
+RUN_TEST(interrupt_msi_affinity_test)
 END_TEST_CASE(interrupt_tests)
@@ -0,0 +1,84 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+#include <unittest/unittest.h>
+
+// Tests getting and setting the preferred NUMA node of a VMO
+static bool vmo_numa_node_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(4096, 0, &vmo), ZX_OK, "");
+
+    uint32_t node = 0;
+    ASSERT_EQ(zx_object_get_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK, "");
+    EXPECT_EQ(node, ZX_VMO_NUMA_NODE_LOCAL, "defaults to the local node");
+
+    // Node 0 has memory on every system.
+    node = 0;
+    ASSERT_EQ(zx_object_set_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK, "");
+    node = ZX_VMO_NUMA_NODE_LOCAL;
+    ASSERT_EQ(zx_object_get_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK, "");
+    EXPECT_EQ(node, 0u, "");
+
+    // Committing pages works with a preferred node.
+    uint8_t data = 1;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_write(vmo, &data, 0, sizeof(data), &actual), ZX_OK, "");
+
+    // A node without memory is rejected and leaves the value alone.
+    node = ZX_VMO_NUMA_NODE_LOCAL - 1;
+    EXPECT_EQ(zx_object_set_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)),
+              ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_object_get_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK, "");
+    EXPECT_EQ(node, 0u, "");
+
+    // Clones inherit the node.
+    zx_handle_t clone;
+    ASSERT_EQ(zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, 4096, &clone), ZX_OK, "");
+    node = ZX_VMO_NUMA_NODE_LOCAL;
+    ASSERT_EQ(zx_object_get_property(clone, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK,
+              "");
+    EXPECT_EQ(node, 0u, "");
+    EXPECT_EQ(zx_handle_close(clone), ZX_OK, "");
+
+    // Setting it back to the local node works.
+    node = ZX_VMO_NUMA_NODE_LOCAL;
+    EXPECT_EQ(zx_object_set_property(vmo, ZX_PROP_VMO_NUMA_NODE, &node, sizeof(node)), ZX_OK, "");
+
+    uint8_t small = 0;
+    EXPECT_EQ(zx_object_get_property(vmo, ZX_PROP_VMO_NUMA_NODE, &small, sizeof(small)),
+              ZX_ERR_BUFFER_TOO_SMALL, "");
+    EXPECT_EQ(zx_object_set_property(vmo, ZX_PROP_VMO_NUMA_NODE, &small, sizeof(small)),
+              ZX_ERR_BUFFER_TOO_SMALL, "");
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+
+    // Only VMOs have the property.
+    node = 0;
+    EXPECT_EQ(zx_object_get_property(zx_process_self(), ZX_PROP_VMO_NUMA_NODE, &node,
+                                     sizeof(node)),
+              ZX_ERR_WRONG_TYPE, "");
+    EXPECT_EQ(zx_object_set_property(zx_process_self(), ZX_PROP_VMO_NUMA_NODE, &node,
+                                     sizeof(node)),
+              ZX_ERR_WRONG_TYPE, "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(vmo_numa_tests)
+RUN_TEST(vmo_numa_node_test)
+END_TEST_CASE(vmo_numa_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
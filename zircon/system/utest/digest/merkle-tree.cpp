@@ -5,8 +5,10 @@
 #include <digest/merkle-tree.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <digest/digest.h>
+#include <fbl/algorithm.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
 #include <unittest/unittest.h>
@@ -378,6 +380,38 @@ bool CreateByteByByte(void) {
     END_TEST;
 }
 
+// Trees created on several threads must match, byte for byte, those created
+// by consuming the data in order, however many CPUs the system has.
+bool CreateParallel(void) {
+    BEGIN_TEST_WITH_RC;
+    // Fill the data from a generator of our own rather than rand(), so that
+    // the sequence later tests draw from does not depend on this one.
+    uint32_t seed = 1;
+    for (uint64_t i = 0; i < kUnalignedLarge; ++i) {
+        seed = seed * 1103515245 + 12345;
+        gData[i] = static_cast<uint8_t>(seed >> 16);
+    }
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    ASSERT_EQ(tree_len, sizeof(gTree));
+    uint8_t tree[sizeof(gTree)];
+    memset(tree, 0xff, sizeof(tree));
+    MerkleTree merkleTree;
+    ASSERT_OK(merkleTree.CreateInit(kUnalignedLarge, tree_len));
+    ASSERT_OK(merkleTree.CreateUpdate(gData, kUnalignedLarge, tree));
+    Digest expected;
+    ASSERT_OK(merkleTree.CreateFinal(tree, &expected));
+    for (size_t threads = 1; threads <= 8; threads *= 2) {
+        memset(gTree, 0xff, sizeof(gTree));
+        Digest actual;
+        ASSERT_OK(MerkleTree::CreateParallel(gData, kUnalignedLarge, gTree, tree_len, &actual,
+                                             threads));
+        ASSERT_TRUE(actual == expected, "Incorrect root digest");
+        ASSERT_EQ(memcmp(gTree, tree, tree_len), 0, "Incorrect tree");
+    }
+    memset(gData, 0xff, sizeof(gData));
+    END_TEST;
+}
+
 bool CreateMissingData(void) {
     BEGIN_TEST_WITH_RC;
     size_t tree_len = MerkleTree::GetTreeLength(kSmall);
@@ -603,6 +637,24 @@ bool VerifyBadTree(void) {
     END_TEST;
 }
 
+// Replaces the digest of the first leaf to match modified data, so that only
+// the nodes above it show the change.
+bool VerifyBadTreeShortRange(void) {
+    BEGIN_TEST_WITH_RC;
+    size_t tree_len = MerkleTree::GetTreeLength(kLarge);
+    Digest digest;
+    ASSERT_OK(MerkleTree::Create(gData, kLarge, gTree, tree_len, &digest));
+    uint8_t tree[kNodeSize * 3];
+    Digest modified;
+    gData[0] ^= 1;
+    ASSERT_OK(MerkleTree::Create(gData, kLarge, tree, tree_len, &modified));
+    memcpy(gTree, tree, Digest::kLength);
+    ASSERT_ERR(
+        ZX_ERR_IO_DATA_INTEGRITY,
+        MerkleTree::Verify(gData, kLarge, gTree, tree_len, 0, 1, digest));
+    END_TEST;
+}
+
 bool VerifyGoodPartOfBadLeaves(void) {
     BEGIN_TEST_WITH_RC;
     size_t tree_len = MerkleTree::GetTreeLength(kSmall);
@@ -626,6 +678,23 @@ bool VerifyBadLeaves(void) {
     END_TEST;
 }
 
+// Returns whether Verify() covers byte |index| of the tree for |data_len|
+// bytes of data.  Every level is hashed a whole node at a time except the
+// top one, of which only the digests it actually holds are hashed.
+bool TreeByteIsVerified(size_t data_len, size_t index) {
+    size_t offset = 0;
+    while (data_len > kNodeSize) {
+        size_t next_len = fbl::round_up(data_len, kNodeSize) / kNodeSize * Digest::kLength;
+        size_t next_aligned = fbl::round_up(next_len, kNodeSize);
+        if (next_aligned == kNodeSize) {
+            return index >= offset && index < offset + next_len;
+        }
+        offset += next_aligned;
+        data_len = next_aligned;
+    }
+    return false;
+}
+
 bool CreateAndVerifyHugePRNGData(void) {
     BEGIN_TEST_WITH_RC;
     Digest digest;
@@ -666,8 +735,10 @@ bool CreateAndVerifyHugePRNGData(void) {
                        MerkleTree::Verify(gData, data_len, gTree, tree_len, 0,
                                           data_len, digest));
             break;
-        case 3:
+        case 3: {
             // Flip bit in tree (if large enough to have a tree)
+            uint8_t saved[sizeof(gTree)];
+            memcpy(saved, gTree, tree_len);
             for (uint64_t i = 0; i < n && tree_len > 0; ++i) {
                 uint8_t tmp = static_cast<uint8_t>(rand()) % 8;
                 gTree[rand() % tree_len] ^= static_cast<uint8_t>(1 << tmp);
@@ -675,13 +746,22 @@ bool CreateAndVerifyHugePRNGData(void) {
             rc = MerkleTree::Verify(gData, data_len, gTree, tree_len, 0,
                                     data_len, digest);
 
-            if (tree_len <= kNodeSize) {
+            // Flips that cancel out or land in the unhashed tail of the top
+            // node go unnoticed.
+            bool detectable = false;
+            for (size_t i = 0; i < tree_len; ++i) {
+                if (gTree[i] != saved[i] && TreeByteIsVerified(data_len, i)) {
+                    detectable = true;
+                }
+            }
+            if (!detectable) {
                 ASSERT_EQ(rc, ZX_OK, zx_status_get_string(rc));
             } else {
                 ASSERT_EQ(rc, ZX_ERR_IO_DATA_INTEGRITY,
                           zx_status_get_string(rc));
             }
             break;
+        }
         default:
             // Normal verification without modification
             ASSERT_OK(MerkleTree::Verify(gData, data_len, gTree, tree_len, 0,
@@ -719,6 +799,7 @@ RUN_TEST(CreateAll)
 RUN_TEST(CreateFinalCAll)
 RUN_TEST(CreateCAll)
 RUN_TEST(CreateByteByByte)
+RUN_TEST(CreateParallel)
 RUN_TEST(CreateMissingData)
 RUN_TEST(CreateMissingTree)
 RUN_TEST(CreateTreeTooSmall)
@@ -737,6 +818,7 @@ RUN_TEST(VerifyZeroLength)
 RUN_TEST(VerifyBadRoot)
 RUN_TEST(VerifyGoodPartOfBadTree)
 RUN_TEST(VerifyBadTree)
+RUN_TEST(VerifyBadTreeShortRange)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
 RUN_TEST(CreateAndVerifyHugePRNGData)
@@ -48,6 +48,12 @@ inline void time_end(const char *str, uint64_t start) {
     printf("Benchmark %s: [%10lu] msec\n", str, (end - start) / ticks_per_msec);
 }
 
+inline void time_per_op(const char *str, uint64_t start, size_t ops) {
+    uint64_t end = zx_ticks_get();
+    uint64_t ticks_per_usec = zx_ticks_per_second() / 1000000;
+    printf("Benchmark %s: [%10lu] usec/op\n", str, (end - start) / ticks_per_usec / ops);
+}
+
 constexpr int kWriteReadCycles = 3;
 
 // The goal of this benchmark is to get a basic idea of some large read / write
@@ -106,6 +112,58 @@ bool benchmark_write_read(void) {
     END_TEST;
 }
 
+// Reads a file which is not in memory, first from start to end and then at
+// random offsets, to compare the cost of each access pattern. The file is
+// closed and reopened before each pass, so that it must be read from disk.
+template <size_t DataSize, size_t NumOps>
+bool benchmark_cold_read(void) {
+    BEGIN_TEST;
+    int fd = open(MOUNT_POINT "/coldfile", O_CREAT | O_RDWR, 0644);
+    ASSERT_GT(fd, 0, "Cannot create file (FS benchmarks assume mounted FS exists at '/benchmark')");
+    const size_t size_mb = (DataSize * NumOps) / MB;
+    printf("\nBenchmarking Cold Read (%lu MB, %lu KB reads)\n", size_mb, DataSize / KB);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[DataSize]);
+    ASSERT_EQ(ac.check(), true);
+    memset(data.get(), kMagicByte, DataSize);
+
+    size_t count = NumOps;
+    while (count--) {
+        ASSERT_EQ(write(fd, data.get(), DataSize), DataSize);
+    }
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    uint64_t start;
+    fd = open(MOUNT_POINT "/coldfile", O_RDONLY);
+    ASSERT_GT(fd, 0);
+    start = zx_ticks_get();
+    count = NumOps;
+    while (count--) {
+        ASSERT_EQ(read(fd, data.get(), DataSize), DataSize);
+        ASSERT_EQ(data[0], kMagicByte);
+    }
+    time_end("sequential read", start);
+    ASSERT_EQ(close(fd), 0);
+
+    unsigned int seed = 1;
+    fd = open(MOUNT_POINT "/coldfile", O_RDONLY);
+    ASSERT_GT(fd, 0);
+    start = zx_ticks_get();
+    count = NumOps;
+    while (count--) {
+        off_t off = (rand_r(&seed) % NumOps) * DataSize;
+        ASSERT_EQ(pread(fd, data.get(), DataSize, off), DataSize);
+        ASSERT_EQ(data[0], kMagicByte);
+    }
+    time_end("random read", start);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink(MOUNT_POINT "/coldfile"), 0);
+    END_TEST;
+}
+
 #define START_STRING "/aaa"
 
 size_t constexpr kComponentLength = fbl::constexpr_strlen(START_STRING);
@@ -202,14 +260,114 @@ bool benchmark_path_walk(void) {
     END_TEST;
 }
 
+#define LOOKUP_DIR MOUNT_POINT "/lookup"
+
+// Measures the cost of operations on names in a single large directory, where
+// a filesystem which scans its entries slows down as the directory grows.
+template <size_t NumEntries>
+bool benchmark_dir_lookup(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Directory lookup (%lu entries)\n", NumEntries);
+    ASSERT_EQ(mkdir(LOOKUP_DIR, 0755), 0, "Could not make directory");
+
+    char path[PATH_MAX];
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), LOOKUP_DIR "/%08zu", i);
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        ASSERT_GT(fd, 0, "Could not create file");
+        ASSERT_EQ(close(fd), 0);
+    }
+    time_per_op("create", start, NumEntries);
+
+    // Visit the entries out of order, so that neither lookups nor the cache
+    // favour the most recently created names.
+    unsigned int seed = 1;
+    struct stat buf;
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), LOOKUP_DIR "/%08zu", rand_r(&seed) % NumEntries);
+        ASSERT_EQ(stat(path, &buf), 0, "Could not stat file");
+    }
+    time_per_op("stat (present)", start, NumEntries);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), LOOKUP_DIR "/missing%08zu", i);
+        ASSERT_EQ(stat(path, &buf), -1, "Unexpected file");
+    }
+    time_per_op("stat (missing)", start, NumEntries);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), LOOKUP_DIR "/%08zu", (i * 7919) % NumEntries);
+        ASSERT_EQ(unlink(path), 0, "Could not unlink file");
+    }
+    time_per_op("unlink", start, NumEntries);
+
+    ASSERT_EQ(unlink(LOOKUP_DIR), 0, "Could not unlink directory");
+    int fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
+#define SYNC_DIR MOUNT_POINT "/sync"
+
+// Measures the cost of small synchronous updates, where each file is created,
+// written, and flushed to disk before the next, so that the cost is dominated
+// by writing metadata rather than data.
+template <size_t DataSize, size_t NumFiles>
+bool benchmark_small_sync(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Small file fsync (%lu files of %lu bytes)\n", NumFiles, DataSize);
+    ASSERT_EQ(mkdir(SYNC_DIR, 0755), 0, "Could not make directory");
+
+    uint8_t data[DataSize];
+    memset(data, kMagicByte, sizeof(data));
+
+    char path[PATH_MAX];
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(path, sizeof(path), SYNC_DIR "/%08zu", i);
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        ASSERT_GT(fd, 0, "Could not create file");
+        ASSERT_EQ(write(fd, data, sizeof(data)), sizeof(data));
+        ASSERT_EQ(fsync(fd), 0);
+        ASSERT_EQ(close(fd), 0);
+    }
+    time_per_op("create + write + fsync", start, NumFiles);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumFiles; i++) {
+        snprintf(path, sizeof(path), SYNC_DIR "/%08zu", i);
+        ASSERT_EQ(unlink(path), 0, "Could not unlink file");
+    }
+    time_per_op("unlink", start, NumFiles);
+
+    ASSERT_EQ(unlink(SYNC_DIR), 0, "Could not unlink directory");
+    int fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(basic_benchmarks)
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 1024>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 2048>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 4096>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 8192>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 16384>))
+RUN_TEST_PERFORMANCE((benchmark_cold_read<4 * KB, 4096>))
+RUN_TEST_PERFORMANCE((benchmark_cold_read<64 * KB, 1024>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<125>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<250>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<500>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<1000>))
+RUN_TEST_PERFORMANCE((benchmark_dir_lookup<1000>))
+RUN_TEST_PERFORMANCE((benchmark_dir_lookup<10000>))
+RUN_TEST_PERFORMANCE((benchmark_dir_lookup<40000>))
+RUN_TEST_PERFORMANCE((benchmark_small_sync<4 * KB, 1000>))
 END_TEST_CASE(basic_benchmarks)
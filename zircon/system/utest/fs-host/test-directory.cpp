@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
+
 #include "util.h"
 
 bool check_dir_contents(const char* dirname, expected_dirent_t* edirents, size_t len) {
@@ -115,8 +117,111 @@ bool test_directory_readdir_large(void) {
     END_TEST;
 }
 
+constexpr size_t kIndexedEntries = 4000;
+
+bool create_indexed_dir(const char* dirname, size_t num_entries) {
+    BEGIN_HELPER;
+    ASSERT_EQ(emu_mkdir(dirname, 0755), 0, "");
+    for (size_t i = 0; i < num_entries; i++) {
+        char path[100];
+        snprintf(path, sizeof(path), "%s/entry-%05zu", dirname, i);
+        int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(emu_close(fd), 0, "");
+    }
+    END_HELPER;
+}
+
+// Large directories are indexed by name hash; the index follows creation and
+// removal of entries, and survives a remount.
+bool test_directory_index(void) {
+    BEGIN_TEST;
+
+    ASSERT_TRUE(create_indexed_dir("::indexed", kIndexedEntries), "");
+    minfs::minfs_inode_t inode;
+    ASSERT_TRUE(get_inode("::indexed", &inode), "");
+    ASSERT_NE(inode.dir_index, 0u, "Large directory was not indexed");
+    ASSERT_TRUE(check_image(), "");
+
+    for (size_t i = 0; i < kIndexedEntries; i += 2) {
+        char path[100];
+        snprintf(path, sizeof(path), "::indexed/entry-%05zu", i);
+        ASSERT_EQ(emu_unlink(path), 0, "");
+    }
+    ASSERT_TRUE(check_image(), "");
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0, "");
+    for (size_t i = 0; i < kIndexedEntries; i++) {
+        char path[100];
+        snprintf(path, sizeof(path), "::indexed/entry-%05zu", i);
+        struct stat s;
+        ASSERT_EQ(emu_stat(path, &s), (i % 2) ? 0 : -ENOENT, "");
+    }
+
+    // The index does not change the order in which entries are read.
+    DIR* dir = emu_opendir("::indexed");
+    ASSERT_NONNULL(dir, "");
+    struct dirent* de;
+    size_t i = 1;
+    while ((de = emu_readdir(dir)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+        char name[100];
+        snprintf(name, sizeof(name), "entry-%05zu", i);
+        ASSERT_EQ(strcmp(de->d_name, name), 0, "Unexpected dirent");
+        i += 2;
+    }
+    ASSERT_EQ(i, kIndexedEntries + 1, "Did not see all expected entries");
+    ASSERT_EQ(emu_closedir(dir), 0, "");
+
+    END_TEST;
+}
+
+// An index which no longer matches its directory is ignored by lookups, and
+// replaced on the next change to the directory.
+bool test_directory_index_stale(void) {
+    BEGIN_TEST;
+
+    ASSERT_TRUE(create_indexed_dir("::stale", kIndexedEntries / 4), "");
+    minfs::minfs_inode_t inode;
+    ASSERT_TRUE(get_inode("::stale", &inode), "");
+    ASSERT_NE(inode.dir_index, 0u, "");
+    minfs::minfs_inode_t index_inode;
+    ASSERT_TRUE(read_inode(inode.dir_index, &index_inode), "");
+
+    uint8_t blk[minfs::kMinfsBlockSize];
+    ASSERT_TRUE(read_block(0, blk), "");
+    const minfs::blk_t dat_block = reinterpret_cast<minfs::minfs_info_t*>(blk)->dat_block;
+    const minfs::minfs_extent_map_t* map = minfs::MinfsExtentMap(&index_inode);
+    const minfs::blk_t root_block = dat_block + map->extents[0].start;
+    ASSERT_TRUE(read_block(root_block, blk), "");
+    minfs::minfs_dir_index_root_t* root = reinterpret_cast<minfs::minfs_dir_index_root_t*>(blk);
+    ASSERT_EQ(root->magic, minfs::kMinfsDirIndexMagic, "");
+    root->seq_num--;
+    ASSERT_TRUE(write_block(root_block, blk), "");
+    ASSERT_FALSE(check_image(), "Stale index passed fsck");
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0, "");
+    struct stat s;
+    ASSERT_EQ(emu_stat("::stale/entry-00000", &s), 0, "");
+    ASSERT_EQ(emu_stat("::stale/missing", &s), -ENOENT, "");
+
+    int fd = emu_open("::stale/fresh", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(emu_close(fd), 0, "");
+    ASSERT_TRUE(get_inode("::stale", &inode), "");
+    ASSERT_NE(inode.dir_index, 0u, "Index was not rebuilt");
+    ASSERT_TRUE(check_image(), "");
+    ASSERT_EQ(emu_stat("::stale/fresh", &s), 0, "");
+
+    END_TEST;
+}
+
 RUN_MINFS_TESTS(directory_tests,
     RUN_TEST_LARGE(test_directory_large)
     RUN_TEST_MEDIUM(test_directory_readdir)
     RUN_TEST_MEDIUM(test_directory_readdir_large)
+    RUN_TEST_MEDIUM(test_directory_index)
+    RUN_TEST_MEDIUM(test_directory_index_stale)
 )
@@ -0,0 +1,219 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/format.h>
+
+#include "util.h"
+
+namespace {
+
+constexpr size_t kBlockSize = minfs::kMinfsBlockSize;
+
+uint8_t block_fill(size_t block) {
+    return static_cast<uint8_t>(block * 7 + 1);
+}
+
+// A file written from start to end should be laid out as a single run.
+bool test_extents_sequential(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 1024;
+    constexpr size_t kWriteSize = 8 * kBlockSize;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kWriteSize]);
+    ASSERT_TRUE(ac.check());
+
+    int fd = emu_open("::sequential", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t b = 0; b < kBlocks; b += kWriteSize / kBlockSize) {
+        for (size_t i = 0; i < kWriteSize / kBlockSize; i++) {
+            memset(&buf[i * kBlockSize], block_fill(b + i), kBlockSize);
+        }
+        ASSERT_STREAM_ALL(emu_write, fd, buf.get(), kWriteSize);
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    minfs::minfs_inode_t inode;
+    ASSERT_TRUE(get_inode("::sequential", &inode));
+    ASSERT_NE(inode.flags & minfs::kMinfsInodeFlagExtents, 0u);
+    const minfs::minfs_extent_map_t* map = minfs::MinfsExtentMap(&inode);
+    ASSERT_EQ(map->count, 1u, "sequential file was fragmented");
+    ASSERT_EQ(map->extents[0].length, kBlocks);
+    ASSERT_EQ(inode.block_count, kBlocks);
+    ASSERT_TRUE(check_image());
+
+    // The data survives a remount.
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    fd = emu_open("::sequential", O_RDONLY, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t b = 0; b < kBlocks; b++) {
+        ASSERT_STREAM_ALL(emu_read, fd, buf.get(), kBlockSize);
+        for (size_t i = 0; i < kBlockSize; i++) {
+            ASSERT_EQ(buf[i], block_fill(b));
+        }
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    END_TEST;
+}
+
+// Writing every other block leaves each block in an extent of its own, which
+// overflows the inode into the extent tree.
+bool test_extents_overflow(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kExtents = minfs::kMinfsInlineExtents + minfs::kMinfsExtentsPerLeaf + 100;
+    uint8_t buf[kBlockSize];
+
+    int fd = emu_open("::overflow", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t e = 0; e < kExtents; e++) {
+        memset(buf, block_fill(e * 2), sizeof(buf));
+        ASSERT_EQ(emu_pwrite(fd, buf, sizeof(buf), e * 2 * kBlockSize),
+                  static_cast<ssize_t>(sizeof(buf)));
+    }
+
+    minfs::minfs_inode_t inode;
+    ASSERT_TRUE(get_inode("::overflow", &inode));
+    const minfs::minfs_extent_map_t* map = minfs::MinfsExtentMap(&inode);
+    ASSERT_EQ(map->count, kExtents);
+    ASSERT_NE(map->tree, 0u);
+    // One index and two leaf blocks.
+    ASSERT_EQ(inode.block_count, kExtents + 3);
+    ASSERT_TRUE(check_image());
+
+    // Both the blocks and the holes between them read back after a remount.
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    fd = emu_open("::overflow", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t b = 0; b < kExtents * 2 - 1; b++) {
+        ASSERT_EQ(emu_pread(fd, buf, sizeof(buf), b * kBlockSize),
+                  static_cast<ssize_t>(sizeof(buf)));
+        const uint8_t expected = (b % 2) ? 0 : block_fill(b);
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            ASSERT_EQ(buf[i], expected);
+        }
+    }
+
+    // Shrinking back into a single leaf frees the other.
+    constexpr size_t kShrunkExtents = minfs::kMinfsInlineExtents + 10;
+    ASSERT_EQ(emu_ftruncate(fd, (kShrunkExtents * 2 - 1) * kBlockSize), 0);
+    ASSERT_TRUE(get_inode("::overflow", &inode));
+    ASSERT_EQ(map->count, kShrunkExtents);
+    ASSERT_EQ(inode.block_count, kShrunkExtents + 2);
+    ASSERT_TRUE(check_image());
+
+    // Shrinking into the inode frees the tree.
+    ASSERT_EQ(emu_ftruncate(fd, 3 * kBlockSize), 0);
+    ASSERT_TRUE(get_inode("::overflow", &inode));
+    ASSERT_EQ(map->count, 2u);
+    ASSERT_EQ(map->tree, 0u);
+    ASSERT_EQ(inode.block_count, 2u);
+    ASSERT_TRUE(check_image());
+
+    ASSERT_EQ(emu_ftruncate(fd, 0), 0);
+    ASSERT_TRUE(get_inode("::overflow", &inode));
+    ASSERT_EQ(map->count, 0u);
+    ASSERT_EQ(inode.block_count, 0u);
+    ASSERT_TRUE(check_image());
+    ASSERT_EQ(emu_close(fd), 0);
+
+    END_TEST;
+}
+
+// An image from the previous version, whose inodes all use block maps, is
+// upgraded on mount; its files stay readable, and move to extents once they
+// are rewritten from scratch.
+bool test_extents_upgrade(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 4;
+    uint8_t buf[kBlockSize];
+    int fd = emu_open("::legacy", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t b = 0; b < kBlocks; b++) {
+        memset(buf, block_fill(b), sizeof(buf));
+        ASSERT_STREAM_ALL(emu_write, fd, buf, sizeof(buf));
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    // Rewrite the image as the previous version would have laid it out.
+    minfs::minfs_inode_t inode;
+    minfs::ino_t ino;
+    ASSERT_TRUE(get_inode("::legacy", &inode, &ino));
+    minfs::minfs_extent_map_t* map = minfs::MinfsExtentMap(&inode);
+    ASSERT_EQ(map->count, 1u);
+    const minfs::minfs_extent_t extent = map->extents[0];
+    memset(map, 0, sizeof(*map));
+    for (minfs::blk_t b = 0; b < extent.length; b++) {
+        inode.dnum[b] = extent.start + b;
+    }
+    inode.flags = 0;
+    ASSERT_TRUE(write_inode(ino, &inode));
+
+    ASSERT_TRUE(read_inode(minfs::kMinfsRootIno, &inode));
+    ASSERT_EQ(map->count, 1u);
+    const minfs::blk_t root_block = map->extents[0].start;
+    memset(map, 0, sizeof(*map));
+    inode.dnum[0] = root_block;
+    inode.flags = 0;
+    ASSERT_TRUE(write_inode(minfs::kMinfsRootIno, &inode));
+
+    uint8_t blk[kBlockSize];
+    ASSERT_TRUE(read_block(0, blk));
+    minfs::minfs_info_t* info = reinterpret_cast<minfs::minfs_info_t*>(blk);
+    info->version = minfs::kMinfsVersionBlockMap;
+    ASSERT_TRUE(write_block(0, blk));
+    ASSERT_TRUE(check_image());
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_TRUE(read_block(0, blk));
+    ASSERT_EQ(info->version, minfs::kMinfsVersion);
+
+    fd = emu_open("::legacy", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t b = 0; b < kBlocks; b++) {
+        ASSERT_STREAM_ALL(emu_read, fd, buf, sizeof(buf));
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            ASSERT_EQ(buf[i], block_fill(b));
+        }
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    // New files in the old directory use extents.
+    fd = emu_open("::fresh", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_STREAM_ALL(emu_write, fd, buf, sizeof(buf));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_TRUE(get_inode("::fresh", &inode));
+    ASSERT_NE(inode.flags & minfs::kMinfsInodeFlagExtents, 0u);
+    ASSERT_TRUE(check_image());
+
+    // The old file keeps its block map until it is emptied.
+    fd = emu_open("::legacy", O_RDWR | O_TRUNC, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_STREAM_ALL(emu_write, fd, buf, sizeof(buf));
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_TRUE(get_inode("::legacy", &inode));
+    ASSERT_NE(inode.flags & minfs::kMinfsInodeFlagExtents, 0u);
+    ASSERT_EQ(map->count, 1u);
+    ASSERT_TRUE(check_image());
+
+    END_TEST;
+}
+
+} // namespace
+
+RUN_MINFS_TESTS(extent_tests,
+    RUN_TEST_MEDIUM(test_extents_sequential)
+    RUN_TEST_MEDIUM(test_extents_overflow)
+    RUN_TEST_MEDIUM(test_extents_upgrade)
+)
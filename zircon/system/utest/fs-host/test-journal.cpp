@@ -0,0 +1,126 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <minfs/format.h>
+
+#include "util.h"
+
+namespace {
+
+constexpr size_t kBlockSize = minfs::kMinfsBlockSize;
+
+// Writes an entry which updates |target| to |data| into the journal at |offset| of
+// its ring, with the commit block's checksum off by |corrupt|.
+bool write_entry(const minfs::minfs_info_t* info, uint32_t offset, uint64_t sequence,
+                 minfs::blk_t target, const uint8_t* data, uint32_t corrupt) {
+    BEGIN_HELPER;
+    const minfs::blk_t ring = info->dat_block + info->journal_start + 1;
+    uint8_t blk[kBlockSize];
+    memset(blk, 0, sizeof(blk));
+    minfs::minfs_journal_header_t* header = reinterpret_cast<minfs::minfs_journal_header_t*>(blk);
+    header->magic = minfs::kMinfsJournalHeaderMagic;
+    header->sequence = sequence;
+    header->count = 1;
+    header->target[0] = target;
+    uint32_t checksum = minfs::MinfsJournalChecksum(FNV32_OFFSET_BASIS, blk, kBlockSize);
+    checksum = minfs::MinfsJournalChecksum(checksum, data, kBlockSize);
+    ASSERT_TRUE(write_block(ring + offset, blk));
+    ASSERT_TRUE(write_block(ring + offset + 1, data));
+
+    memset(blk, 0, sizeof(blk));
+    minfs::minfs_journal_commit_t* commit = reinterpret_cast<minfs::minfs_journal_commit_t*>(blk);
+    commit->magic = minfs::kMinfsJournalCommitMagic;
+    commit->sequence = sequence;
+    commit->checksum = checksum + corrupt;
+    ASSERT_TRUE(write_block(ring + offset + 2, blk));
+    END_HELPER;
+}
+
+bool read_journal_info(minfs::minfs_info_t* info, minfs::minfs_journal_info_t* journal) {
+    BEGIN_HELPER;
+    uint8_t blk[kBlockSize];
+    ASSERT_TRUE(read_block(0, blk));
+    memcpy(info, blk, sizeof(*info));
+    ASSERT_GE(info->journal_blocks, minfs::kMinfsJournalMinBlocks);
+    ASSERT_TRUE(read_block(info->dat_block + info->journal_start, blk));
+    memcpy(journal, blk, sizeof(*journal));
+    ASSERT_EQ(journal->magic, minfs::kMinfsJournalMagic);
+    END_HELPER;
+}
+
+// Entries committed to the journal are written in place on mount, up to the first which
+// was not committed in full.
+bool test_journal_replay(void) {
+    BEGIN_TEST;
+
+    int fd = emu_open("::replay", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(emu_close(fd), 0);
+
+    minfs::minfs_info_t info;
+    minfs::minfs_journal_info_t journal;
+    ASSERT_TRUE(read_journal_info(&info, &journal));
+    minfs::minfs_inode_t inode;
+    minfs::ino_t ino;
+    ASSERT_TRUE(get_inode("::replay", &inode, &ino));
+
+    // Two entries update the file's inode; the second is torn.
+    const minfs::blk_t bno = info.ino_block + ino / minfs::kMinfsInodesPerBlock;
+    const size_t off = (ino % minfs::kMinfsInodesPerBlock) * minfs::kMinfsInodeSize;
+    uint8_t blk[kBlockSize];
+    ASSERT_TRUE(read_block(bno, blk));
+    minfs::minfs_inode_t* copy = reinterpret_cast<minfs::minfs_inode_t*>(blk + off);
+    copy->modify_time = inode.modify_time + 1;
+    ASSERT_TRUE(write_entry(&info, journal.start, journal.sequence, bno, blk, 0));
+    copy->modify_time = inode.modify_time + 2;
+    ASSERT_TRUE(write_entry(&info, journal.start + 3, journal.sequence + 1, bno, blk, 1));
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_TRUE(read_inode(ino, &inode));
+    ASSERT_EQ(inode.modify_time, copy->modify_time - 1);
+
+    // Replay moves the journal past the entry, so it is not written again.
+    minfs::minfs_journal_info_t replayed;
+    ASSERT_TRUE(read_journal_info(&info, &replayed));
+    ASSERT_EQ(replayed.start, journal.start + 3);
+    ASSERT_EQ(replayed.sequence, journal.sequence + 1);
+    ASSERT_TRUE(check_image());
+
+    END_TEST;
+}
+
+// An entry whose header does not carry the expected sequence number, such as one left from
+// an earlier pass around the ring, is not replayed.
+bool test_journal_stale(void) {
+    BEGIN_TEST;
+
+    minfs::minfs_info_t info;
+    minfs::minfs_journal_info_t journal;
+    ASSERT_TRUE(read_journal_info(&info, &journal));
+
+    uint8_t root[kBlockSize];
+    ASSERT_TRUE(read_block(info.ino_block, root));
+    uint8_t blk[kBlockSize];
+    memset(blk, 0, sizeof(blk));
+    ASSERT_GT(journal.sequence, 0u);
+    ASSERT_TRUE(write_entry(&info, journal.start, journal.sequence - 1, info.ino_block, blk, 0));
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_TRUE(read_block(info.ino_block, blk));
+    ASSERT_EQ(memcmp(blk, root, sizeof(blk)), 0);
+    ASSERT_TRUE(check_image());
+
+    END_TEST;
+}
+
+} // namespace
+
+RUN_MINFS_TESTS(journal_tests,
+    RUN_TEST_MEDIUM(test_journal_replay)
+    RUN_TEST_MEDIUM(test_journal_stale)
+)
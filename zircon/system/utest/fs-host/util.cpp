@@ -7,6 +7,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/bcache.h>
+#include <minfs/fsck.h>
+
 #include "util.h"
 
 void setup_fs_test(size_t disk_size) {
@@ -42,4 +49,71 @@ void teardown_fs_test() {
     if (unlink(MOUNT_PATH) < 0) {
         exit(-1);
     }
-}
\ No newline at end of file
+}
+
+bool check_image(void) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd(open(MOUNT_PATH, O_RDWR));
+    ASSERT_TRUE(fd);
+    struct stat s;
+    ASSERT_EQ(fstat(fd.get(), &s), 0);
+    fbl::unique_ptr<minfs::Bcache> bc;
+    const uint32_t blocks = static_cast<uint32_t>(s.st_size / minfs::kMinfsBlockSize);
+    ASSERT_EQ(minfs::Bcache::Create(&bc, fbl::move(fd), blocks), ZX_OK);
+    ASSERT_EQ(minfs::minfs_check(fbl::move(bc)), ZX_OK);
+    END_HELPER;
+}
+
+bool read_block(minfs::blk_t bno, void* data) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd(open(MOUNT_PATH, O_RDONLY));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(pread(fd.get(), data, minfs::kMinfsBlockSize, bno * minfs::kMinfsBlockSize),
+              static_cast<ssize_t>(minfs::kMinfsBlockSize));
+    END_HELPER;
+}
+
+bool write_block(minfs::blk_t bno, const void* data) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd(open(MOUNT_PATH, O_RDWR));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(pwrite(fd.get(), data, minfs::kMinfsBlockSize, bno * minfs::kMinfsBlockSize),
+              static_cast<ssize_t>(minfs::kMinfsBlockSize));
+    END_HELPER;
+}
+
+bool read_inode(minfs::ino_t ino, minfs::minfs_inode_t* inode) {
+    BEGIN_HELPER;
+    uint8_t blk[minfs::kMinfsBlockSize];
+    ASSERT_TRUE(read_block(0, blk));
+    const minfs::minfs_info_t* info = reinterpret_cast<minfs::minfs_info_t*>(blk);
+    const minfs::blk_t bno = info->ino_block + ino / minfs::kMinfsInodesPerBlock;
+    ASSERT_TRUE(read_block(bno, blk));
+    memcpy(inode, blk + (ino % minfs::kMinfsInodesPerBlock) * minfs::kMinfsInodeSize,
+           sizeof(*inode));
+    END_HELPER;
+}
+
+bool write_inode(minfs::ino_t ino, const minfs::minfs_inode_t* inode) {
+    BEGIN_HELPER;
+    uint8_t blk[minfs::kMinfsBlockSize];
+    ASSERT_TRUE(read_block(0, blk));
+    const minfs::minfs_info_t* info = reinterpret_cast<minfs::minfs_info_t*>(blk);
+    const minfs::blk_t bno = info->ino_block + ino / minfs::kMinfsInodesPerBlock;
+    ASSERT_TRUE(read_block(bno, blk));
+    memcpy(blk + (ino % minfs::kMinfsInodesPerBlock) * minfs::kMinfsInodeSize, inode,
+           sizeof(*inode));
+    ASSERT_TRUE(write_block(bno, blk));
+    END_HELPER;
+}
+
+bool get_inode(const char* path, minfs::minfs_inode_t* inode, minfs::ino_t* ino) {
+    BEGIN_HELPER;
+    struct stat s;
+    ASSERT_EQ(emu_stat(path, &s), 0);
+    ASSERT_TRUE(read_inode(static_cast<minfs::ino_t>(s.st_ino), inode));
+    if (ino != nullptr) {
+        *ino = static_cast<minfs::ino_t>(s.st_ino);
+    }
+    END_HELPER;
+}
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <unittest/unittest.h>
+#include <minfs/format.h>
 #include <minfs/host.h>
 #include <fcntl.h>
 
@@ -19,6 +20,18 @@ typedef struct expected_dirent {
 void setup_fs_test(size_t disk_size);
 void teardown_fs_test(void);
 
+// Helpers which inspect or modify the image at MOUNT_PATH directly. Host writes
+// go straight to the image, so it may be examined while mounted.
+
+// Runs fsck over the image.
+bool check_image(void);
+bool read_block(minfs::blk_t bno, void* data);
+bool write_block(minfs::blk_t bno, const void* data);
+bool read_inode(minfs::ino_t ino, minfs::minfs_inode_t* inode);
+bool write_inode(minfs::ino_t ino, const minfs::minfs_inode_t* inode);
+// Reads the inode of |path|, returning its number in |ino| if it is not null.
+bool get_inode(const char* path, minfs::minfs_inode_t* inode, minfs::ino_t* ino = nullptr);
+
 #define BEGIN_FS_TEST_CASE(case_name, disk_size) \
     BEGIN_TEST_CASE(case_name)                   \
     setup_fs_test(disk_size);
@@ -13,6 +13,7 @@
 #include <unistd.h>
 
 #include <zircon/compiler.h>
+#include <zircon/device/vfs.h>
 #include <zircon/syscalls.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
@@ -172,6 +173,163 @@ bool test_persist_with_data(void) {
     END_TEST;
 }
 
+// Reads and writes scattered pieces of a file which is not yet cached, rather
+// than reading it from the start.
+template <size_t BufferSize>
+bool test_persist_partial_access(void) {
+    BEGIN_TEST;
+
+    if (!test_info->can_be_mounted) {
+        fprintf(stderr, "Filesystem cannot be mounted; cannot test persistence\n");
+        return true;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buffer(new (&ac) uint8_t[BufferSize]);
+    ASSERT_TRUE(ac.check());
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    unittest_printf("Partial access test using seed: %u\n", seed);
+    for (size_t i = 0; i < BufferSize; i++) {
+        buffer[i] = (uint8_t) rand_r(&seed);
+    }
+    int fd = open("::partial", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(write(fd, &buffer[0], BufferSize), BufferSize);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_TRUE(check_remount(), "Could not remount filesystem");
+
+    // Read small pieces from the end of the file back towards the start.
+    constexpr size_t kPiece = 100;
+    uint8_t rbuf[kPiece];
+    fd = open("::partial", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    for (size_t i = 0; i < 7; i++) {
+        const size_t off = BufferSize - kPiece - i * (BufferSize / 7);
+        ASSERT_EQ(pread(fd, rbuf, kPiece, off), kPiece);
+        ASSERT_EQ(memcmp(rbuf, &buffer[off], kPiece), 0);
+    }
+
+    // Overwrite part of a block which has not been read.
+    const size_t woff = BufferSize / 2 + 1;
+    memset(&buffer[woff], 'a', kPiece);
+    ASSERT_EQ(pwrite(fd, &buffer[woff], kPiece, woff), kPiece);
+
+    // Cut the file in the middle of a block which has not been read.
+    const size_t len = BufferSize / 3 + 5;
+    ASSERT_EQ(ftruncate(fd, len), 0);
+
+    fbl::unique_ptr<uint8_t[]> check(new (&ac) uint8_t[BufferSize]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(pread(fd, &check[0], BufferSize, 0), len);
+    ASSERT_EQ(memcmp(&check[0], &buffer[0], len), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    // Grow the file again; the cut off part should read back as zeroes.
+    ASSERT_TRUE(check_remount(), "Could not remount filesystem");
+    fd = open("::partial", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(ftruncate(fd, BufferSize), 0);
+    ASSERT_EQ(pread(fd, &check[0], BufferSize, 0), BufferSize);
+    ASSERT_EQ(memcmp(&check[0], &buffer[0], len), 0);
+    for (size_t i = len; i < BufferSize; i++) {
+        ASSERT_EQ(check[i], 0);
+    }
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::partial"), 0);
+
+    END_TEST;
+}
+
+// minfs writes back dirty file data in runs of at most kWritebackBlocks blocks
+// of kBlockSize bytes.
+constexpr size_t kBlockSize = 8192;
+constexpr size_t kWritebackBlocks = 1024;
+
+// Writes two open files a chunk at a time, in turn, and cuts one short before
+// either is closed, so that data written but not yet written back is both
+// kept and discarded.
+template <size_t BufferSize, size_t ChunkSize>
+bool test_persist_interleaved(void) {
+    BEGIN_TEST;
+
+    if (!test_info->can_be_mounted) {
+        fprintf(stderr, "Filesystem cannot be mounted; cannot test persistence\n");
+        return true;
+    }
+
+    const char* const files[] = {
+        "::interleaved-a",
+        "::interleaved-b",
+    };
+    fbl::unique_ptr<uint8_t[]> buffers[fbl::count_of(files)];
+    int fds[fbl::count_of(files)];
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    unittest_printf("Interleaved write test using seed: %u\n", seed);
+    fbl::AllocChecker ac;
+    for (size_t i = 0; i < fbl::count_of(files); i++) {
+        buffers[i].reset(new (&ac) uint8_t[BufferSize]);
+        ASSERT_TRUE(ac.check());
+        for (size_t j = 0; j < BufferSize; j++) {
+            buffers[i][j] = (uint8_t) rand_r(&seed);
+        }
+        fds[i] = open(files[i], O_RDWR | O_CREAT, 0644);
+        ASSERT_GT(fds[i], 0);
+    }
+
+    for (size_t off = 0; off < BufferSize; off += ChunkSize) {
+        const size_t len = fbl::min(ChunkSize, BufferSize - off);
+        for (size_t i = 0; i < fbl::count_of(files); i++) {
+            ASSERT_EQ(write(fds[i], &buffers[i][off], len), static_cast<ssize_t>(len));
+        }
+    }
+
+    const size_t cut = BufferSize / 2 + 7;
+    ASSERT_EQ(ftruncate(fds[1], cut), 0);
+    for (size_t i = 0; i < fbl::count_of(files); i++) {
+        ASSERT_EQ(close(fds[i]), 0);
+    }
+
+    ASSERT_TRUE(check_remount(), "Could not remount filesystem");
+
+    fbl::unique_ptr<uint8_t[]> rbuf(new (&ac) uint8_t[BufferSize]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < fbl::count_of(files); i++) {
+        const size_t size = (i == 1) ? cut : BufferSize;
+        int fd = open(files[i], O_RDWR, 0644);
+        ASSERT_GT(fd, 0);
+        struct stat buf;
+        ASSERT_EQ(fstat(fd, &buf), 0);
+        ASSERT_EQ(buf.st_size, static_cast<off_t>(size));
+        ASSERT_EQ(read(fd, &rbuf[0], BufferSize), static_cast<ssize_t>(size));
+        ASSERT_EQ(memcmp(&rbuf[0], &buffers[i][0], size), 0);
+
+        // Filesystems which report extents should not have interleaved the files on disk:
+        // each run of blocks written back together stays in one piece.
+        uint32_t extents;
+        ssize_t r = ioctl_vfs_get_extent_count(fd, &extents);
+        if (r != ZX_ERR_NOT_SUPPORTED) {
+            ASSERT_EQ(r, static_cast<ssize_t>(sizeof(extents)));
+            const size_t blocks = fbl::round_up(size, kBlockSize) / kBlockSize;
+            ASSERT_LE(extents, fbl::round_up(blocks, kWritebackBlocks) / kWritebackBlocks);
+        }
+
+        // The part which was cut off reads back as zeroes once the file grows.
+        if (size < BufferSize) {
+            ASSERT_EQ(ftruncate(fd, BufferSize), 0);
+            ASSERT_EQ(pread(fd, &rbuf[0], BufferSize - size, size),
+                      static_cast<ssize_t>(BufferSize - size));
+            for (size_t j = 0; j < BufferSize - size; j++) {
+                ASSERT_EQ(rbuf[j], 0);
+            }
+        }
+        ASSERT_EQ(close(fd), 0);
+        ASSERT_EQ(unlink(files[i]), 0);
+    }
+
+    END_TEST;
+}
+
 constexpr size_t kMaxLoopLength = 26;
 
 template <bool MoveDirectory, size_t LoopLength, size_t Moves>
@@ -268,6 +426,10 @@ RUN_FOR_ALL_FILESYSTEMS(persistence_tests,
     RUN_TEST_LARGE((test_persist_with_data<8192>))
     RUN_TEST_LARGE((test_persist_with_data<8192 + 1>))
     RUN_TEST_LARGE((test_persist_with_data<8192 * 128>))
+    RUN_TEST_MEDIUM((test_persist_partial_access<8192 * 8 + 1>))
+    RUN_TEST_LARGE((test_persist_partial_access<8192 * 128>))
+    RUN_TEST_MEDIUM((test_persist_interleaved<8192 * 16 + 1, 8192 * 3>))
+    RUN_TEST_LARGE((test_persist_interleaved<8192 * 2048, 1 << 16>))
     RUN_TEST_MEDIUM((test_rename_loop<false, 2, 2>));
     RUN_TEST_LARGE((test_rename_loop<false, 2, 100>));
     RUN_TEST_LARGE((test_rename_loop<false, 15, 100>));
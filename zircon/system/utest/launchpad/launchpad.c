@@ -9,13 +9,19 @@
 #include <elfload/elfload.h>
 
 #include <launchpad/launchpad.h>
+#include <launchpad/loader-service.h>
 #include <launchpad/vmo.h>
 
 #include <zircon/process.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <fdio/util.h>
 
@@ -125,11 +131,291 @@ static bool argument_size_test(void) {
     return ok;
 }
 
+static const char* const sh_argv[] = { "/boot/bin/sh", "-c", "exit 3" };
+
+// Launch sh_argv, loading it from |tmpl| if it is not NULL.
+static bool launch_sh(const launchpad_template_t* tmpl, zx_handle_t* proc) {
+    BEGIN_HELPER;
+
+    launchpad_t* lp;
+    ASSERT_EQ(launchpad_create(ZX_HANDLE_INVALID, "template test", &lp),
+              ZX_OK, "");
+    EXPECT_EQ(launchpad_set_args(lp, countof(sh_argv), sh_argv), ZX_OK, "");
+    if (tmpl != NULL) {
+        EXPECT_EQ(launchpad_clone_template(lp, tmpl), ZX_OK, "");
+    } else {
+        EXPECT_EQ(launchpad_load_from_file(lp, sh_argv[0]), ZX_OK, "");
+    }
+
+    const char* errmsg = "???";
+    ASSERT_EQ(launchpad_go(lp, proc, &errmsg), ZX_OK, errmsg);
+
+    END_HELPER;
+}
+
+// Wait for |proc| to exit, check that it exited as sh_argv says, and close it.
+static bool wait_sh(zx_handle_t proc) {
+    BEGIN_HELPER;
+
+    EXPECT_EQ(zx_object_wait_one(proc, ZX_PROCESS_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    zx_info_process_t info;
+    EXPECT_EQ(zx_object_get_info(proc, ZX_INFO_PROCESS,
+                                 &info, sizeof(info), NULL, NULL), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(proc), ZX_OK, "");
+
+    EXPECT_EQ(info.return_code, 3, "shell exit status");
+
+    END_HELPER;
+}
+
+static bool run_sh(const launchpad_template_t* tmpl) {
+    BEGIN_HELPER;
+
+    zx_handle_t proc = ZX_HANDLE_INVALID;
+    ASSERT_TRUE(launch_sh(tmpl, &proc), "");
+    EXPECT_TRUE(wait_sh(proc), "");
+
+    END_HELPER;
+}
+
+static bool template_test(void) {
+    BEGIN_TEST;
+
+    launchpad_template_t* tmpl;
+    ASSERT_EQ(launchpad_template_create_from_file(sh_argv[0], ZX_HANDLE_INVALID,
+                                                  &tmpl), ZX_OK, "");
+
+    // The template is not used up; it can start any number of processes.
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(run_sh(tmpl), "");
+    }
+
+    launchpad_template_destroy(tmpl);
+
+    END_TEST;
+}
+
+static bool template_vdso_test(void) {
+    BEGIN_TEST;
+
+    launchpad_template_t* tmpl;
+    ASSERT_EQ(launchpad_template_create_from_file(sh_argv[0], ZX_HANDLE_INVALID,
+                                                  &tmpl), ZX_OK, "");
+
+    // A vDSO set after the template was made is loaded instead of the
+    // cached one, so a bogus one makes the clone fail.
+    zx_handle_t bogus;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &bogus), ZX_OK, "");
+    zx_handle_t vdso = launchpad_set_vdso_vmo(bogus);
+
+    launchpad_t* lp;
+    ASSERT_EQ(launchpad_create(ZX_HANDLE_INVALID, "template vdso test", &lp),
+              ZX_OK, "");
+    EXPECT_NE(launchpad_clone_template(lp, tmpl), ZX_OK, "");
+    launchpad_destroy(lp);
+
+    EXPECT_EQ(zx_handle_close(launchpad_set_vdso_vmo(vdso)), ZX_OK, "");
+
+    // With the original vDSO back, the cached one is used again.
+    EXPECT_TRUE(run_sh(tmpl), "");
+
+    launchpad_template_destroy(tmpl);
+
+    END_TEST;
+}
+
+// Compare the launch latency of loading from a file and from a template.
+// Only the time to launchpad_go() counts, not the time the process runs.
+static bool template_benchmark(void) {
+    BEGIN_TEST;
+
+    const int kLaunches = 100;
+
+    launchpad_template_t* tmpl;
+    ASSERT_EQ(launchpad_template_create_from_file(sh_argv[0], ZX_HANDLE_INVALID,
+                                                  &tmpl), ZX_OK, "");
+
+    zx_time_t from_file = 0;
+    zx_time_t from_template = 0;
+    for (int i = 0; i < kLaunches; i++) {
+        zx_handle_t proc;
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_TRUE(launch_sh(NULL, &proc), "");
+        from_file += zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        ASSERT_TRUE(wait_sh(proc), "");
+
+        start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_TRUE(launch_sh(tmpl, &proc), "");
+        from_template += zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        ASSERT_TRUE(wait_sh(proc), "");
+    }
+
+    printf("Benchmark launch from file: [%10" PRIu64 "] ns/op\n",
+           from_file / kLaunches);
+    printf("Benchmark launch from template: [%10" PRIu64 "] ns/op\n",
+           from_template / kLaunches);
+
+    launchpad_template_destroy(tmpl);
+
+    END_TEST;
+}
+
+static bool template_bad_file_test(void) {
+    BEGIN_TEST;
+
+    launchpad_template_t* tmpl = NULL;
+    EXPECT_NE(launchpad_template_create_from_file("/boot/does-not-exist",
+                                                  ZX_HANDLE_INVALID, &tmpl),
+              ZX_OK, "");
+
+    // Not an ELF file.
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &vmo), ZX_OK, "");
+    EXPECT_NE(launchpad_template_create(vmo, ZX_HANDLE_INVALID, &tmpl), ZX_OK, "");
+    EXPECT_NULL(tmpl, "");
+
+    END_TEST;
+}
+
+static bool template_loader_service_test(void) {
+    BEGIN_TEST;
+
+    // The template borrows the loader service and leaves it open.
+    zx_handle_t svc;
+    ASSERT_EQ(loader_service_get_default(&svc), ZX_OK, "");
+
+    launchpad_template_t* tmpl;
+    ASSERT_EQ(launchpad_template_create_from_file(sh_argv[0], svc, &tmpl),
+              ZX_OK, "");
+    EXPECT_EQ(zx_object_get_info(svc, ZX_INFO_HANDLE_VALID, NULL, 0,
+                                 NULL, NULL), ZX_OK, "");
+
+    EXPECT_TRUE(run_sh(tmpl), "");
+
+    launchpad_template_destroy(tmpl);
+    EXPECT_EQ(zx_handle_close(svc), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool write_file(const char* path, const char* contents) {
+    BEGIN_HELPER;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0, "open");
+    size_t len = strlen(contents);
+    EXPECT_EQ(write(fd, contents, len), (ssize_t)len, "write");
+    EXPECT_EQ(close(fd), 0, "close");
+
+    END_HELPER;
+}
+
+// Asks |svc| for the file at |path| and checks that it holds |contents|.
+static bool load_abspath(zx_handle_t svc, const char* path,
+                         const char* contents, zx_handle_t* out) {
+    BEGIN_HELPER;
+
+    struct {
+        zx_loader_svc_msg_t header;
+        uint8_t data[PATH_MAX];
+    } msg;
+    memset(&msg.header, 0, sizeof(msg.header));
+    msg.header.opcode = LOADER_SVC_OP_LOAD_SCRIPT_INTERP;
+    size_t len = strlen(path) + 1;
+    memcpy(msg.data, path, len);
+
+    zx_loader_svc_msg_t reply;
+    zx_channel_call_args_t call = {
+        .wr_bytes = &msg,
+        .wr_num_bytes = sizeof(msg.header) + len,
+        .rd_bytes = &reply,
+        .rd_handles = out,
+        .rd_num_bytes = sizeof(reply),
+        .rd_num_handles = 1,
+    };
+    uint32_t reply_size, handle_count;
+    zx_status_t read_status = ZX_OK;
+    ASSERT_EQ(zx_channel_call(svc, 0, ZX_TIME_INFINITE, &call,
+                              &reply_size, &handle_count, &read_status),
+              ZX_OK, "zx_channel_call");
+    ASSERT_EQ(reply.arg, ZX_OK, "load status");
+    ASSERT_EQ(handle_count, 1u, "reply handle");
+
+    char buf[64];
+    size_t actual;
+    len = strlen(contents);
+    ASSERT_EQ(zx_vmo_read(*out, buf, 0, sizeof(buf), &actual), ZX_OK, "");
+    ASSERT_GE(actual, len, "");
+    EXPECT_BYTES_EQ((const uint8_t*)buf, (const uint8_t*)contents, len, "");
+
+    END_HELPER;
+}
+
+static bool loader_service_cache_test(void) {
+    BEGIN_TEST;
+
+    static const char path[] = "/tmp/loader-service-cache-test";
+    loader_service_cache_flush();
+    ASSERT_TRUE(write_file(path, "first"), "");
+
+    loader_service_t* ls;
+    ASSERT_EQ(loader_service_create_fs("cache-test", &ls), ZX_OK, "");
+    zx_handle_t svc;
+    ASSERT_EQ(loader_service_connect(ls, &svc), ZX_OK, "");
+
+    // The second load comes from the cache: a distinct clone of the same
+    // contents that can't be written through.
+    zx_handle_t vmo1, vmo2;
+    ASSERT_TRUE(load_abspath(svc, path, "first", &vmo1), "");
+    ASSERT_TRUE(load_abspath(svc, path, "first", &vmo2), "");
+    EXPECT_NE(vmo1, vmo2, "");
+    size_t actual;
+    EXPECT_EQ(zx_vmo_write(vmo2, "x", 0, 1, &actual), ZX_ERR_ACCESS_DENIED, "");
+    zx_handle_close(vmo1);
+    zx_handle_close(vmo2);
+
+    // Changing the file invalidates the cached copy.
+    ASSERT_TRUE(write_file(path, "second!"), "");
+    ASSERT_TRUE(load_abspath(svc, path, "second!", &vmo1), "");
+    zx_handle_close(vmo1);
+
+    zx_handle_close(svc);
+    EXPECT_EQ(unlink(path), 0, "");
+    loader_service_cache_flush();
+
+    END_TEST;
+}
+
+static bool loader_service_prewarm_test(void) {
+    BEGIN_TEST;
+
+    const char* names[] = { "libc.so" };
+    EXPECT_EQ(loader_service_prewarm(names, 1), ZX_OK, "");
+    names[0] = "libdoes-not-exist.so";
+    EXPECT_EQ(loader_service_prewarm(names, 1), ZX_ERR_NOT_FOUND, "");
+    EXPECT_EQ(loader_service_prewarm_from_file("/boot/does-not-exist"),
+              ZX_ERR_NOT_FOUND, "");
+    loader_service_cache_flush();
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(launchpad_tests)
 RUN_TEST(launchpad_test);
 RUN_TEST(argument_size_test);
+RUN_TEST(template_test);
+RUN_TEST(template_vdso_test);
+RUN_TEST(template_bad_file_test);
+RUN_TEST(template_loader_service_test);
+RUN_TEST(loader_service_cache_test);
+RUN_TEST(loader_service_prewarm_test);
 END_TEST_CASE(launchpad_tests)
 
+BEGIN_TEST_CASE(launchpad_benchmarks)
+RUN_TEST_PERFORMANCE(template_benchmark);
+END_TEST_CASE(launchpad_benchmarks)
+
 int main(int argc, char **argv)
 {
     program_path = argv[0];
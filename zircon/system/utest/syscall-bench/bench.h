@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdio.h>
+
+#include <fbl/unique_ptr.h>
+#include <zircon/types.h>
+
+namespace syscall_bench {
+
+// A benchmark is instantiated once on each thread that runs it, so any
+// objects it operates on are private to that thread.
+class Benchmark {
+public:
+    virtual ~Benchmark() = default;
+
+    // Called once, on the benchmark thread, before any operations.
+    virtual zx_status_t Init() { return ZX_OK; }
+
+    // Called before each Run(); not part of the measured time.
+    virtual zx_status_t Prepare() { return ZX_OK; }
+
+    // The operation being measured.
+    virtual zx_status_t Run() = 0;
+};
+
+typedef zx_status_t (*BenchmarkFactory)(fbl::unique_ptr<Benchmark>* out);
+
+// Runs the benchmark made by |factory| on 1, 2, 4, ... threads, up to the
+// number of CPUs, and records the latency of each operation. Returns false
+// if any operation failed.
+bool RunBenchmark(const char* name, BenchmarkFactory factory);
+
+// Writes every result recorded by RunBenchmark() to |f| as a JSON object.
+void WriteResults(FILE* f);
+
+} // namespace syscall_bench
@@ -0,0 +1,388 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <threads.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include "bench.h"
+
+namespace syscall_bench {
+namespace {
+
+template <typename T>
+zx_status_t Create(fbl::unique_ptr<Benchmark>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<T> bench(new (&ac) T());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    *out = fbl::move(bench);
+    return ZX_OK;
+}
+
+// Benchmarks that measure a round trip to another thread run that
+// thread for as long as the benchmark exists.
+class PeerBenchmark : public Benchmark {
+protected:
+    zx_status_t StartPeer() {
+        int ret = thrd_create(&peer_, [](void* arg) {
+            static_cast<PeerBenchmark*>(arg)->PeerLoop();
+            return 0;
+        }, this);
+        if (ret != thrd_success)
+            return ZX_ERR_NO_RESOURCES;
+        peer_started_ = true;
+        return ZX_OK;
+    }
+
+    // Runs on the peer thread; must return once the derived class's
+    // destructor has told it to stop.
+    virtual void PeerLoop() = 0;
+
+    // Derived classes call this at the end of their destructors, after
+    // telling PeerLoop() to stop, so that the loop has finished with
+    // their state before it goes away.
+    void JoinPeer() {
+        if (peer_started_) {
+            thrd_join(peer_, nullptr);
+            peer_started_ = false;
+        }
+    }
+
+private:
+    thrd_t peer_;
+    bool peer_started_ = false;
+};
+
+// The cheapest syscall there is.
+class NullSyscall : public Benchmark {
+public:
+    zx_status_t Run() override {
+        return zx_syscall_test_0();
+    }
+};
+
+class HandleDuplicateClose : public Benchmark {
+public:
+    ~HandleDuplicateClose() override {
+        zx_handle_close(event_);
+    }
+
+    zx_status_t Init() override {
+        return zx_event_create(0, &event_);
+    }
+
+    zx_status_t Run() override {
+        zx_handle_t dup;
+        zx_status_t status = zx_handle_duplicate(event_, ZX_RIGHT_SAME_RIGHTS, &dup);
+        if (status != ZX_OK)
+            return status;
+        return zx_handle_close(dup);
+    }
+
+private:
+    zx_handle_t event_ = ZX_HANDLE_INVALID;
+};
+
+// Signal the peer through an event pair and wait for it to signal back.
+class EventPingPong : public PeerBenchmark {
+public:
+    ~EventPingPong() override {
+        zx_handle_close(local_);
+        JoinPeer();
+        zx_handle_close(remote_);
+    }
+
+    zx_status_t Init() override {
+        zx_status_t status = zx_eventpair_create(0, &local_, &remote_);
+        if (status != ZX_OK)
+            return status;
+        return StartPeer();
+    }
+
+    zx_status_t Run() override {
+        zx_status_t status = zx_object_signal_peer(local_, 0, ZX_USER_SIGNAL_0);
+        if (status != ZX_OK)
+            return status;
+        status = zx_object_wait_one(local_, ZX_USER_SIGNAL_1, ZX_TIME_INFINITE, nullptr);
+        if (status != ZX_OK)
+            return status;
+        return zx_object_signal(local_, ZX_USER_SIGNAL_1, 0);
+    }
+
+private:
+    void PeerLoop() override {
+        for (;;) {
+            zx_signals_t pending;
+            if (zx_object_wait_one(remote_, ZX_USER_SIGNAL_0 | ZX_EPAIR_PEER_CLOSED,
+                                   ZX_TIME_INFINITE, &pending) != ZX_OK ||
+                (pending & ZX_EPAIR_PEER_CLOSED)) {
+                return;
+            }
+            zx_object_signal(remote_, ZX_USER_SIGNAL_0, 0);
+            zx_object_signal_peer(remote_, 0, ZX_USER_SIGNAL_1);
+        }
+    }
+
+    zx_handle_t local_ = ZX_HANDLE_INVALID;
+    zx_handle_t remote_ = ZX_HANDLE_INVALID;
+};
+
+// zx_channel_call() to a peer that echoes each message back.
+class ChannelCall : public PeerBenchmark {
+public:
+    ~ChannelCall() override {
+        zx_handle_close(local_);
+        JoinPeer();
+        zx_handle_close(remote_);
+    }
+
+    zx_status_t Init() override {
+        zx_status_t status = zx_channel_create(0, &local_, &remote_);
+        if (status != ZX_OK)
+            return status;
+        return StartPeer();
+    }
+
+    zx_status_t Run() override {
+        uint32_t request[2] = {0, 0};
+        uint32_t reply[2];
+        zx_channel_call_args_t args = {
+            .wr_bytes = request,
+            .wr_handles = nullptr,
+            .rd_bytes = reply,
+            .rd_handles = nullptr,
+            .wr_num_bytes = sizeof(request),
+            .wr_num_handles = 0,
+            .rd_num_bytes = sizeof(reply),
+            .rd_num_handles = 0,
+        };
+        uint32_t actual_bytes, actual_handles;
+        zx_status_t read_status;
+        zx_status_t status = zx_channel_call(local_, 0, ZX_TIME_INFINITE, &args,
+                                             &actual_bytes, &actual_handles,
+                                             &read_status);
+        return status == ZX_ERR_CALL_FAILED ? read_status : status;
+    }
+
+private:
+    void PeerLoop() override {
+        for (;;) {
+            if (zx_object_wait_one(remote_, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                   ZX_TIME_INFINITE, nullptr) != ZX_OK) {
+                return;
+            }
+            uint32_t msg[2];
+            uint32_t actual_bytes;
+            if (zx_channel_read(remote_, 0, msg, nullptr, sizeof(msg), 0,
+                                &actual_bytes, nullptr) != ZX_OK ||
+                zx_channel_write(remote_, 0, msg, actual_bytes, nullptr, 0) != ZX_OK) {
+                return;
+            }
+        }
+    }
+
+    zx_handle_t local_ = ZX_HANDLE_INVALID;
+    zx_handle_t remote_ = ZX_HANDLE_INVALID;
+};
+
+// Hand a futex back and forth with the peer: each side waits for the
+// other to change the value and wake it.
+class FutexHandoff : public PeerBenchmark {
+public:
+    ~FutexHandoff() override {
+        futex_.store(kStop);
+        zx_futex_wake(Futex(), 1);
+        JoinPeer();
+    }
+
+    zx_status_t Init() override {
+        return StartPeer();
+    }
+
+    zx_status_t Run() override {
+        futex_.store(kPeerTurn);
+        zx_status_t status = zx_futex_wake(Futex(), 1);
+        if (status != ZX_OK)
+            return status;
+        while (futex_.load() == kPeerTurn) {
+            status = zx_futex_wait(Futex(), kPeerTurn, ZX_TIME_INFINITE);
+            if (status != ZX_OK && status != ZX_ERR_BAD_STATE)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+private:
+    static constexpr int kOurTurn = 0;
+    static constexpr int kPeerTurn = 1;
+    static constexpr int kStop = 2;
+
+    zx_futex_t* Futex() {
+        return reinterpret_cast<zx_futex_t*>(&futex_);
+    }
+
+    void PeerLoop() override {
+        for (;;) {
+            int value;
+            while ((value = futex_.load()) == kOurTurn)
+                zx_futex_wait(Futex(), kOurTurn, ZX_TIME_INFINITE);
+            if (value == kStop)
+                return;
+            futex_.store(kOurTurn);
+            zx_futex_wake(Futex(), 1);
+        }
+    }
+
+    fbl::atomic<int> futex_{kOurTurn};
+};
+
+// Queue a user packet and take it straight back off the port.
+class PortQueueWait : public Benchmark {
+public:
+    ~PortQueueWait() override {
+        zx_handle_close(port_);
+    }
+
+    zx_status_t Init() override {
+        return zx_port_create(0, &port_);
+    }
+
+    zx_status_t Run() override {
+        zx_port_packet_t packet = {};
+        packet.type = ZX_PKT_TYPE_USER;
+        zx_status_t status = zx_port_queue(port_, &packet, 0);
+        if (status != ZX_OK)
+            return status;
+        return zx_port_wait(port_, ZX_TIME_INFINITE, &packet, 0);
+    }
+
+private:
+    zx_handle_t port_ = ZX_HANDLE_INVALID;
+};
+
+class VmoCreateMapUnmap : public Benchmark {
+public:
+    zx_status_t Run() override {
+        zx_handle_t vmo;
+        zx_status_t status = zx_vmo_create(PAGE_SIZE, 0, &vmo);
+        if (status != ZX_OK)
+            return status;
+        uintptr_t addr;
+        status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE,
+                             ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+        zx_handle_close(vmo);
+        if (status != ZX_OK)
+            return status;
+        return zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE);
+    }
+};
+
+// Each operation is a write to a page that isn't committed yet. Once all
+// the pages have been touched they're decommitted, outside the timing.
+class PageFault : public Benchmark {
+public:
+    ~PageFault() override {
+        if (addr_ != 0)
+            zx_vmar_unmap(zx_vmar_root_self(), addr_, kSize);
+        zx_handle_close(vmo_);
+    }
+
+    zx_status_t Init() override {
+        zx_status_t status = zx_vmo_create(kSize, 0, &vmo_);
+        if (status != ZX_OK)
+            return status;
+        return zx_vmar_map(zx_vmar_root_self(), 0, vmo_, 0, kSize,
+                           ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr_);
+    }
+
+    zx_status_t Prepare() override {
+        if (next_ < kPages)
+            return ZX_OK;
+        next_ = 0;
+        return zx_vmo_op_range(vmo_, ZX_VMO_OP_DECOMMIT, 0, kSize, nullptr, 0);
+    }
+
+    zx_status_t Run() override {
+        *reinterpret_cast<volatile uint8_t*>(addr_ + next_++ * PAGE_SIZE) = 1;
+        return ZX_OK;
+    }
+
+private:
+    static constexpr size_t kPages = 64;
+    static constexpr size_t kSize = kPages * PAGE_SIZE;
+
+    zx_handle_t vmo_ = ZX_HANDLE_INVALID;
+    uintptr_t addr_ = 0;
+    size_t next_ = kPages;
+};
+
+bool null_syscall_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("null_syscall", Create<NullSyscall>), "");
+    END_TEST;
+}
+
+bool handle_duplicate_close_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("handle_duplicate_close", Create<HandleDuplicateClose>), "");
+    END_TEST;
+}
+
+bool event_ping_pong_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("event_ping_pong", Create<EventPingPong>), "");
+    END_TEST;
+}
+
+bool channel_call_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("channel_call", Create<ChannelCall>), "");
+    END_TEST;
+}
+
+bool futex_handoff_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("futex_handoff", Create<FutexHandoff>), "");
+    END_TEST;
+}
+
+bool port_queue_wait_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("port_queue_wait", Create<PortQueueWait>), "");
+    END_TEST;
+}
+
+bool vmo_create_map_unmap_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("vmo_create_map_unmap", Create<VmoCreateMapUnmap>), "");
+    END_TEST;
+}
+
+bool page_fault_bench() {
+    BEGIN_TEST;
+    EXPECT_TRUE(RunBenchmark("page_fault", Create<PageFault>), "");
+    END_TEST;
+}
+
+} // namespace
+} // namespace syscall_bench
+
+BEGIN_TEST_CASE(syscall_bench)
+RUN_TEST(syscall_bench::null_syscall_bench)
+RUN_TEST(syscall_bench::handle_duplicate_close_bench)
+RUN_TEST(syscall_bench::event_ping_pong_bench)
+RUN_TEST(syscall_bench::channel_call_bench)
+RUN_TEST(syscall_bench::futex_handoff_bench)
+RUN_TEST(syscall_bench::port_queue_wait_bench)
+RUN_TEST(syscall_bench::vmo_create_map_unmap_bench)
+RUN_TEST(syscall_bench::page_fault_bench)
+END_TEST_CASE(syscall_bench)
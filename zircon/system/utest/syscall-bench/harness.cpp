@@ -0,0 +1,191 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+
+namespace syscall_bench {
+namespace {
+
+// Small enough to keep a full run short under emulation.
+constexpr size_t kWarmupIterations = 100;
+constexpr size_t kIterations = 1000;
+
+struct Result {
+    const char* name;
+    uint32_t threads;
+    size_t samples;
+    uint64_t min_ns;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+fbl::Vector<Result> results;
+
+struct ThreadState {
+    BenchmarkFactory factory;
+    fbl::atomic<uint32_t>* ready;
+    fbl::atomic<bool>* go;
+    zx_ticks_t* samples;
+    zx_status_t status;
+};
+
+zx_status_t RunIterations(Benchmark* bench, size_t count, zx_ticks_t* samples) {
+    for (size_t i = 0; i < count; i++) {
+        zx_status_t status = bench->Prepare();
+        if (status != ZX_OK)
+            return status;
+        zx_ticks_t start = zx_ticks_get();
+        status = bench->Run();
+        zx_ticks_t end = zx_ticks_get();
+        if (status != ZX_OK)
+            return status;
+        if (samples != nullptr)
+            samples[i] = end - start;
+    }
+    return ZX_OK;
+}
+
+int BenchmarkThread(void* arg) {
+    ThreadState* state = static_cast<ThreadState*>(arg);
+
+    fbl::unique_ptr<Benchmark> bench;
+    state->status = state->factory(&bench);
+    if (state->status == ZX_OK)
+        state->status = bench->Init();
+    if (state->status == ZX_OK)
+        state->status = RunIterations(bench.get(), kWarmupIterations, nullptr);
+
+    // Start measuring on all threads at once, even if this one failed,
+    // so that the others aren't left waiting.
+    state->ready->fetch_add(1);
+    while (!state->go->load())
+        thrd_yield();
+
+    if (state->status == ZX_OK)
+        state->status = RunIterations(bench.get(), kIterations, state->samples);
+    return 0;
+}
+
+int CompareTicks(const void* a, const void* b) {
+    zx_ticks_t x = *static_cast<const zx_ticks_t*>(a);
+    zx_ticks_t y = *static_cast<const zx_ticks_t*>(b);
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+uint64_t TicksToNs(zx_ticks_t ticks) {
+    return static_cast<uint64_t>(static_cast<double>(ticks) * ZX_SEC(1) /
+                                 static_cast<double>(zx_ticks_per_second()));
+}
+
+// |samples| must be sorted.
+uint64_t Percentile(const zx_ticks_t* samples, size_t count, uint32_t percent) {
+    return TicksToNs(samples[(count - 1) * percent / 100]);
+}
+
+bool RunThreads(const char* name, BenchmarkFactory factory, uint32_t thread_count) {
+    BEGIN_HELPER;
+
+    size_t total = thread_count * kIterations;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_ticks_t[]> samples(new (&ac) zx_ticks_t[total]);
+    ASSERT_TRUE(ac.check(), "");
+    fbl::unique_ptr<ThreadState[]> states(new (&ac) ThreadState[thread_count]);
+    ASSERT_TRUE(ac.check(), "");
+    fbl::unique_ptr<thrd_t[]> threads(new (&ac) thrd_t[thread_count]);
+    ASSERT_TRUE(ac.check(), "");
+
+    fbl::atomic<uint32_t> ready(0);
+    fbl::atomic<bool> go(false);
+    uint32_t started = 0;
+    for (; started < thread_count; started++) {
+        ThreadState* state = &states[started];
+        state->factory = factory;
+        state->ready = &ready;
+        state->go = &go;
+        state->samples = &samples[started * kIterations];
+        state->status = ZX_OK;
+        if (thrd_create(&threads[started], BenchmarkThread, state) != thrd_success)
+            break;
+    }
+    if (started == thread_count) {
+        while (ready.load() < thread_count)
+            thrd_yield();
+    }
+    go.store(true);
+    for (uint32_t i = 0; i < started; i++) {
+        thrd_join(threads[i], nullptr);
+    }
+    ASSERT_EQ(started, thread_count, "thrd_create failed");
+    for (uint32_t i = 0; i < thread_count; i++) {
+        ASSERT_EQ(states[i].status, ZX_OK, name);
+    }
+
+    qsort(samples.get(), total, sizeof(zx_ticks_t), CompareTicks);
+    zx_ticks_t sum = 0;
+    for (size_t i = 0; i < total; i++) {
+        sum += samples[i];
+    }
+
+    Result result = {
+        .name = name,
+        .threads = thread_count,
+        .samples = total,
+        .min_ns = TicksToNs(samples[0]),
+        .mean_ns = TicksToNs(sum / total),
+        .p50_ns = Percentile(samples.get(), total, 50),
+        .p90_ns = Percentile(samples.get(), total, 90),
+        .p99_ns = Percentile(samples.get(), total, 99),
+        .max_ns = TicksToNs(samples[total - 1]),
+    };
+    unittest_printf("%s x%u: p50 %" PRIu64 " ns, p99 %" PRIu64 " ns\n",
+                    name, thread_count, result.p50_ns, result.p99_ns);
+    results.push_back(result, &ac);
+    ASSERT_TRUE(ac.check(), "");
+
+    END_HELPER;
+}
+
+} // namespace
+
+bool RunBenchmark(const char* name, BenchmarkFactory factory) {
+    BEGIN_HELPER;
+
+    uint32_t cpus = zx_system_get_num_cpus();
+    for (uint32_t threads = 1; threads < cpus; threads *= 2) {
+        ASSERT_TRUE(RunThreads(name, factory, threads), "");
+    }
+    ASSERT_TRUE(RunThreads(name, factory, cpus), "");
+
+    END_HELPER;
+}
+
+void WriteResults(FILE* f) {
+    fprintf(f, "{\n  \"cpus\": %u,\n  \"results\": [", zx_system_get_num_cpus());
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"threads\": %u, \"samples\": %zu, "
+                "\"min_ns\": %" PRIu64 ", \"mean_ns\": %" PRIu64 ", "
+                "\"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64 ", "
+                "\"p99_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 "}",
+                i == 0 ? "" : ",", r.name, r.threads, r.samples,
+                r.min_ns, r.mean_ns, r.p50_ns, r.p90_ns, r.p99_ns, r.max_ns);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+} // namespace syscall_bench
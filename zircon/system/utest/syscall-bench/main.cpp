@@ -0,0 +1,26 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+
+#include <unittest/unittest.h>
+
+#include "bench.h"
+
+#define RESULT_FILE "/tmp/syscall-bench.json"
+
+int main(int argc, char** argv) {
+    bool success = unittest_run_all_tests(argc, argv);
+
+    // Results go to the console, where they can be collected from the
+    // log of an automated run, and to a file for local use.
+    syscall_bench::WriteResults(stdout);
+    FILE* f = fopen(RESULT_FILE, "w");
+    if (f != NULL) {
+        syscall_bench::WriteResults(f);
+        fclose(f);
+    }
+
+    return success ? 0 : -1;
+}
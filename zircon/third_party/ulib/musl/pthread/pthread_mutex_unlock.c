@@ -14,7 +14,15 @@ int pthread_mutex_unlock(pthread_mutex_t* m) {
             return m->_m_count--, 0;
     }
     cont = atomic_exchange(&m->_m_lock, 0);
-    if (waiters || cont < 0)
-        __wake(&m->_m_lock, 1);
+    if (waiters || cont < 0) {
+        // This also ends any priority we inherited from the waiters.
+        if (m->_m_type & PTHREAD_MUTEX_PRIO_INHERIT_BIT) {
+            // This can only fail if the mutex is misaligned, which would
+            // leave its waiters blocked for good.
+            if (_zx_futex_wake_pi(&m->_m_lock) != ZX_OK)
+                __builtin_trap();
+        } else
+            __wake(&m->_m_lock, 1);
+    }
     return 0;
 }
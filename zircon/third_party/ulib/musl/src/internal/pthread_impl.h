@@ -125,6 +125,9 @@ static inline struct pthread* tp_to_pthread(void* tp) {
 // The bit used in the recursive and errorchecking cases, which track thread owners.
 #define PTHREAD_MUTEX_OWNED_LOCK_BIT 0x80000000
 #define PTHREAD_MUTEX_OWNED_LOCK_MASK 0x7fffffff
+// Set in the type of mutexes using the PTHREAD_PRIO_INHERIT protocol.  These
+// always track their owner, and wait with zx_futex_wait_pi.
+#define PTHREAD_MUTEX_PRIO_INHERIT_BIT 0x4
 
 extern void* __pthread_tsd_main[];
 extern volatile size_t __pthread_tsd_size;
@@ -166,6 +169,11 @@ int __pthread_key_delete(tss_t k) ATTR_LIBC_VISIBILITY;
 int __timedwait(atomic_int*, int, clockid_t, const struct timespec*)
     ATTR_LIBC_VISIBILITY;
 
+// The same, using zx_futex_wait_pi.  |val| names the thread that owns the
+// futex.
+int __timedwait_pi(atomic_int*, int, clockid_t, const struct timespec*)
+    ATTR_LIBC_VISIBILITY;
+
 // Loading a library can introduce more thread_local variables. Thread
 // allocation bases bookkeeping decisions based on the current state
 // of thread_locals in the program, so thread creation needs to be
@@ -3,9 +3,9 @@
 #include <zircon/syscalls.h>
 #include <time.h>
 
-int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
+static int timedwait_deadline(clockid_t clk, const struct timespec* at, zx_time_t* deadline) {
     struct timespec to;
-    zx_time_t deadline = ZX_TIME_INFINITE;
+    *deadline = ZX_TIME_INFINITE;
 
     if (at) {
         if (at->tv_nsec >= ZX_SEC(1))
@@ -19,8 +19,16 @@ int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec
         }
         if (to.tv_sec < 0)
             return ETIMEDOUT;
-        deadline = _zx_deadline_after(ZX_SEC(to.tv_sec) + to.tv_nsec);
+        *deadline = _zx_deadline_after(ZX_SEC(to.tv_sec) + to.tv_nsec);
     }
+    return 0;
+}
+
+int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
+    zx_time_t deadline;
+    int r = timedwait_deadline(clk, at, &deadline);
+    if (r)
+        return r;
 
     // zx_futex_wait will return ZX_ERR_BAD_STATE if someone modifying *addr
     // races with this call. But this is indistinguishable from
@@ -37,3 +45,23 @@ int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec
         __builtin_trap();
     }
 }
+
+int __timedwait_pi(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
+    zx_time_t deadline;
+    int r = timedwait_deadline(clk, at, &deadline);
+    if (r)
+        return r;
+
+    // As above, a racing change of *futex is reported as a wakeup.  Any
+    // other error means |val| does not name a live thread of this process,
+    // so the mutex is corrupt or its owner exited while holding it.
+    switch (_zx_futex_wait_pi(futex, val, deadline)) {
+    case ZX_OK:
+    case ZX_ERR_BAD_STATE:
+        return 0;
+    case ZX_ERR_TIMED_OUT:
+        return ETIMEDOUT;
+    default:
+        __builtin_trap();
+    }
+}